@@ -49,8 +49,21 @@ KEARasterBand::KEARasterBand( KEADataset *pDataset, int nSrcBand, GDALAccess eAc
     this->nBand = nSrcBand; // this is the band we are
     this->m_eKEADataType = pImageIO->getImageBandDataType(nSrcBand); // get the data type as KEA enum
     this->eDataType = KEA_to_GDAL_Type( m_eKEADataType );       // convert to GDAL enum
-    this->nBlockXSize = pImageIO->getImageBlockSize(nSrcBand);  // get the native blocksize
-    this->nBlockYSize = pImageIO->getImageBlockSize(nSrcBand);
+#ifndef HAVE_GDT_FLOAT16
+    // no Float16 in this GDAL so have kealib convert to Float32
+    if( m_eKEADataType == kealib::kea_16float )
+        this->m_eKEADataType = kealib::kea_32float;
+#endif
+    if( kealib::getDataTypeNBits( m_eKEADataType ) > 0 )
+    {
+        // packed band - report the same way as GTiff
+        GDALRasterBand::SetMetadataItem( "NBITS", 
+            CPLSPrintf( "%d", kealib::getDataTypeNBits( m_eKEADataType ) ), "IMAGE_STRUCTURE" );
+    }
+    uint32_t nBlockXSizeKEA, nBlockYSizeKEA;
+    pImageIO->getImageBlockSize(nSrcBand, &nBlockXSizeKEA, &nBlockYSizeKEA);  // get the native blocksize
+    this->nBlockXSize = nBlockXSizeKEA;
+    this->nBlockYSize = nBlockYSizeKEA;
     this->nRasterXSize = this->poDS->GetRasterXSize();          // ask the dataset for the total image size
     this->nRasterYSize = this->poDS->GetRasterYSize();
     this->eAccess = eAccess;
@@ -445,6 +458,9 @@ CPLErr KEARasterBand::SetMetadataItem(const char *pszName, const char *pszValue,
 const char *KEARasterBand::GetMetadataItem (const char *pszName, const char *pszDomain)
 {
     CPLMutexHolderD( &m_hMutex );
+    // NBITS for packed bands
+    if( ( pszDomain != nullptr ) && EQUAL( pszDomain, "IMAGE_STRUCTURE" ) )
+        return GDALRasterBand::GetMetadataItem( pszName, pszDomain );
     // only deal with 'default' domain - no geolocation etc
     if( ( pszDomain != nullptr ) && ( *pszDomain != '\0' ) )
         return nullptr;
@@ -467,6 +483,9 @@ CSLConstList KEARasterBand::GetMetadata(const char *pszDomain)
 char **KEARasterBand::GetMetadata(const char *pszDomain)
 #endif
 {
+    // NBITS for packed bands
+    if( ( pszDomain != nullptr ) && EQUAL( pszDomain, "IMAGE_STRUCTURE" ) )
+        return GDALRasterBand::GetMetadata( pszDomain );
     // only deal with 'default' domain - no geolocation etc
     if( ( pszDomain != nullptr ) && ( *pszDomain != '\0' ) )
         return nullptr;
@@ -491,6 +510,7 @@ CPLErr KEARasterBand::SetMetadata(char **papszMetadata, const char *pszDomain)
     int nIndex = 0;
     char *pszName;
     const char *pszValue;
+    std::vector< std::pair<std::string, std::string> > data;
     try
     {
         // iterate through each one
@@ -517,11 +537,12 @@ CPLErr KEARasterBand::SetMetadata(char **papszMetadata, const char *pszDomain)
             }
             else
             {
-                // write it into the image
-                this->m_pImageIO->setImageBandMetaData(this->nBand, pszName, pszValue );
+                // written into the image below
+                data.push_back(std::pair<std::string, std::string>(pszName, pszValue));
             }
             nIndex++;
         }
+        this->m_pImageIO->setImageBandMetaData(this->nBand, data);
     }
     catch (const kealib::KEAIOException &e)
     {
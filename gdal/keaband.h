@@ -45,6 +45,13 @@
     #pragma message ("HAVE_METADATA_CSLCONST_LIST not present")
 #endif
 
+#if (GDAL_VERSION_MAJOR > 3) || ((GDAL_VERSION_MAJOR == 3) && (GDAL_VERSION_MINOR >= 11))
+    #define HAVE_GDT_FLOAT16
+    #pragma message ("defining HAVE_GDT_FLOAT16")
+#else
+    #pragma message ("HAVE_GDT_FLOAT16 not present")
+#endif
+
 #include "keadataset.h"
 
 class KEAOverview;
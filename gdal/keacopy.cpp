@@ -54,56 +54,56 @@ bool KEACopyRasterData( GDALRasterBand *pBand, kealib::KEAImageIO *pImageIO, int
         eKeaType = pImageIO->getImageBandDataType(nBand);
         eGDALType = pBand->GetRasterDataType();
     }
-    unsigned int nBlockSize;
+    uint32_t nBlockXSize, nBlockYSize;
     if( (nOverview == COPY_OVERVIEW_NONE ) || (nOverview == COPY_MASK) )
-        nBlockSize = pImageIO->getImageBlockSize( nBand );
+        pImageIO->getImageBlockSize( nBand, &nBlockXSize, &nBlockYSize );
     else
-        nBlockSize = pImageIO->getOverviewBlockSize(nBand, nOverview);
+        pImageIO->getOverviewBlockSize( nBand, nOverview, &nBlockXSize, &nBlockYSize );
         
     unsigned int nXSize = pBand->GetXSize();
     unsigned int nYSize = pBand->GetYSize();
 
     // allocate some space
     int nPixelSize = GDALGetDataTypeSize( eGDALType ) / 8;
-    void *pData = CPLMalloc( nPixelSize * nBlockSize * nBlockSize);
+    void *pData = CPLMalloc( nPixelSize * nBlockXSize * nBlockYSize);
     if( pData == nullptr )
     {
         CPLError( CE_Failure, CPLE_AppDefined, "Unable to allocate memory" );        
         return false;
     }
     // for progress
-    int nTotalBlocks = std::ceil( (double)nXSize / (double)nBlockSize ) * std::ceil( (double)nYSize / (double)nBlockSize );
+    int nTotalBlocks = std::ceil( (double)nXSize / (double)nBlockXSize ) * std::ceil( (double)nYSize / (double)nBlockYSize );
     int nBlocksComplete = 0;
     double dLastFraction = -1;
     // go through the image
-    for( unsigned int nY = 0; nY < nYSize; nY += nBlockSize )
+    for( unsigned int nY = 0; nY < nYSize; nY += nBlockYSize )
     {
         // adjust for edge blocks
-        unsigned int nysize = nBlockSize;
-        unsigned int nytotalsize = nY + nBlockSize;
+        unsigned int nysize = nBlockYSize;
+        unsigned int nytotalsize = nY + nBlockYSize;
         if( nytotalsize > nYSize )
             nysize -= (nytotalsize - nYSize);
-        for( unsigned int nX = 0; nX < nXSize; nX += nBlockSize )
+        for( unsigned int nX = 0; nX < nXSize; nX += nBlockXSize )
         {
             // adjust for edge blocks
-            unsigned int nxsize = nBlockSize;
-            unsigned int nxtotalsize = nX + nBlockSize;
+            unsigned int nxsize = nBlockXSize;
+            unsigned int nxtotalsize = nX + nBlockXSize;
             if( nxtotalsize > nXSize )
                 nxsize -= (nxtotalsize - nXSize);
 
             // read in from GDAL
-            if( pBand->RasterIO( GF_Read, nX, nY, nxsize, nysize, pData, nxsize, nysize, eGDALType, nPixelSize, nPixelSize * nBlockSize) != CE_None )
+            if( pBand->RasterIO( GF_Read, nX, nY, nxsize, nysize, pData, nxsize, nysize, eGDALType, nPixelSize, nPixelSize * nBlockXSize) != CE_None )
             {
                 CPLError( CE_Failure, CPLE_AppDefined, "Unable to read block at %d %d\n", nX, nY );
                 return false;
             }
             // write out to KEA
             if( nOverview == COPY_OVERVIEW_NONE )
-                pImageIO->writeImageBlock2Band( nBand, pData, nX, nY, nxsize, nysize, nBlockSize, nBlockSize, eKeaType);
+                pImageIO->writeImageBlock2Band( nBand, pData, nX, nY, nxsize, nysize, nBlockXSize, nBlockYSize, eKeaType);
             else if( nOverview == COPY_MASK )
-                pImageIO->writeImageBlock2BandMask( nBand, pData, nX, nY, nxsize, nysize, nBlockSize, nBlockSize, eKeaType);
+                pImageIO->writeImageBlock2BandMask( nBand, pData, nX, nY, nxsize, nysize, nBlockXSize, nBlockYSize, eKeaType);
             else
-                pImageIO->writeToOverview( nBand, nOverview, pData,  nX, nY, nxsize, nysize, nBlockSize, nBlockSize, eKeaType);
+                pImageIO->writeToOverview( nBand, nOverview, pData,  nX, nY, nxsize, nysize, nBlockXSize, nBlockYSize, eKeaType);
 
             // progress
             nBlocksComplete++;
@@ -303,6 +303,7 @@ void KEACopyMetadata( GDALMajorObject *pObject, kealib::KEAImageIO *pImageIO, in
         char *pszName;
         const char *pszValue;
         int nCount = 0;
+        std::vector< std::pair<std::string, std::string> > data;
         while( ppszMetadata[nCount] != nullptr )
         {
             pszValue = CPLParseNameValue( ppszMetadata[nCount], &pszName );
@@ -326,14 +327,16 @@ void KEACopyMetadata( GDALMajorObject *pObject, kealib::KEAImageIO *pImageIO, in
             }
             else
             {
-                // write it into the image
-                if( nBand != -1 )
-                    pImageIO->setImageBandMetaData(nBand, pszName, pszValue );
-                else
-                    pImageIO->setImageMetaData(pszName, pszValue );
+                // written into the image below
+                data.push_back(std::pair<std::string, std::string>(pszName, pszValue));
             }
             nCount++;
         }
+        // all at once
+        if( nBand != -1 )
+            pImageIO->setImageBandMetaData(nBand, data);
+        else
+            pImageIO->setImageMetaData(data);
     }
 }
 
@@ -548,9 +551,10 @@ void KEACopyGCPs(GDALDataset *pDataset, kealib::KEAImageIO *pImageIO)
 
 
 
-bool KEACopyFile( GDALDataset *pDataset, kealib::KEAImageIO *pImageIO, GDALProgressFunc pfnProgress, void *pProgressData )
+bool KEACopyFile( GDALDataset *pDataset, kealib::KEAImageIO *pImageIO, GDALProgressFunc pfnProgress, void *pProgressData, bool bThematic )
 {
     // Main function - copies pDataset to pImageIO
+    // bThematic sets all the bands to thematic, whatever the source has
 
     // copy accross the spatial info
     KEACopySpatialInfo( pDataset, pImageIO);
@@ -561,13 +565,44 @@ bool KEACopyFile( GDALDataset *pDataset, kealib::KEAImageIO *pImageIO, GDALProgr
     // GCPs
     KEACopyGCPs(pDataset, pImageIO);
     
+    // if the source is also KEA, bands stored the same way in both
+    // files can be copied without decompressing them
+    kealib::KEAImageIO *pSrcImageIO = nullptr;
+    if( ( pDataset->GetDriver() != nullptr ) && EQUAL( pDataset->GetDriver()->GetDescription(), "KEA" ) )
+        pSrcImageIO = static_cast<kealib::KEAImageIO*>( pDataset->GetInternalHandle( nullptr ) );
+
     // now copy all the bands over
     int nBands = pDataset->GetRasterCount();
     for( int nBand = 0; nBand < nBands; nBand++ )
     {
-        GDALRasterBand *pBand = pDataset->GetRasterBand(nBand + 1);
-        if( !KEACopyBand( pBand, pImageIO, nBand +1, nBands, pfnProgress, pProgressData ) )
-            return false;
+        bool bCopied = false;
+        if( pSrcImageIO != nullptr )
+        {
+            try
+            {
+                if( pImageIO->bandStorageMatches( *pSrcImageIO, nBand + 1, nBand + 1 ) )
+                {
+                    pImageIO->copyBandFrom( *pSrcImageIO, nBand + 1, nBand + 1 );
+                    bCopied = true;
+                    if( !pfnProgress( (double)(nBand + 1) / (double)nBands, nullptr, pProgressData ) )
+                        return false;
+                }
+            }
+            catch(const kealib::KEAException &e)
+            {
+                // fall back to copying the pixels
+            }
+        }
+        if( !bCopied )
+        {
+            GDALRasterBand *pBand = pDataset->GetRasterBand(nBand + 1);
+            if( !KEACopyBand( pBand, pImageIO, nBand +1, nBands, pfnProgress, pProgressData ) )
+                return false;
+        }
+
+        // after the copy as both ways bring the layer type of the source
+        if( bThematic )
+            pImageIO->setImageBandLayerType( nBand + 1, kealib::kea_thematic );
     }
 
     pfnProgress( 1.0, nullptr, pProgressData );
@@ -46,6 +46,10 @@ GDALDataType KEA_to_GDAL_Type( kealib::KEADataType ekeaType )
             egdalType = GDT_Int8;
             break;
         case kealib::kea_8uint:
+        case kealib::kea_1uint:
+        case kealib::kea_2uint:
+        case kealib::kea_4uint:
+            // the packed types are reported via NBITS
             egdalType = GDT_Byte;
             break;
         case kealib::kea_16int:
@@ -72,6 +76,14 @@ GDALDataType KEA_to_GDAL_Type( kealib::KEADataType ekeaType )
         case kealib::kea_64float:
             egdalType = GDT_Float64;
             break;
+        case kealib::kea_16float:
+#ifdef HAVE_GDT_FLOAT16
+            egdalType = GDT_Float16;
+#else
+            // read and written as Float32 - see KEARasterBand
+            egdalType = GDT_Float32;
+#endif
+            break;
         default:
             egdalType = GDT_Unknown;
             break;
@@ -115,6 +127,11 @@ kealib::KEADataType GDAL_to_KEA_Type( GDALDataType egdalType )
         case GDT_Float64:
             ekeaType = kealib::kea_64float;
             break;
+#ifdef HAVE_GDT_FLOAT16
+        case GDT_Float16:
+            ekeaType = kealib::kea_16float;
+            break;
+#endif
         default:
             ekeaType = kealib::kea_undefined;
             break;
@@ -122,6 +139,34 @@ kealib::KEADataType GDAL_to_KEA_Type( GDALDataType egdalType )
     return ekeaType;
 }
 
+// as above but also handles the NBITS creation option which
+// selects one of the packed types for Byte bands
+kealib::KEADataType GDAL_to_KEA_Type( GDALDataType egdalType, const char *pszNBits )
+{
+    kealib::KEADataType ekeaType = GDAL_to_KEA_Type( egdalType );
+    if( pszNBits == nullptr )
+        return ekeaType;
+
+    int nBits = atoi( pszNBits );
+    if( ekeaType != kealib::kea_8uint )
+    {
+        CPLError( CE_Warning, CPLE_NotSupported,
+                  "NBITS is only supported for Byte bands. Ignored." );
+    }
+    else if( nBits == 1 )
+        ekeaType = kealib::kea_1uint;
+    else if( nBits == 2 )
+        ekeaType = kealib::kea_2uint;
+    else if( nBits == 4 )
+        ekeaType = kealib::kea_4uint;
+    else if( nBits != 8 )
+    {
+        CPLError( CE_Warning, CPLE_NotSupported,
+                  "NBITS=%s not supported. Must be 1, 2, 4 or 8. Ignored.", pszNBits );
+    }
+    return ekeaType;
+}
+
 // static function - pointer set in driver 
 GDALDataset *KEADataset::Open( GDALOpenInfo * poOpenInfo )
 {
@@ -134,10 +179,18 @@ GDALDataset *KEADataset::Open( GDALOpenInfo * poOpenInfo )
             if( poOpenInfo->eAccess == GA_ReadOnly )
             {
                 // use the virtual driver so we can open files using
-                // /vsicurl etc
+                // /vsicurl etc. A page buffer helps a lot with those
+                // if the file was created with PAGE_SIZE
+                hsize_t npageBufferSize = kealib::KEA_PAGE_BUFFER_SIZE;
+                const char *pszPageBuffer = CPLGetConfigOption( "KEA_PAGE_BUFFER_SIZE", nullptr );
+                if( pszPageBuffer != nullptr )
+                    npageBufferSize = static_cast<hsize_t>(CPLAtoGIntBig( pszPageBuffer ));
+                // services that open the same file many times can share one HDF5 handle
+                bool bShared = CPLTestBool( CPLGetConfigOption( "KEA_SHARE_FILE_HANDLES", "NO" ) );
                 pH5File = kealib::KEAImageIO::openKeaH5RDOnly( poOpenInfo->pszFilename,
                     kealib::KEA_MDC_NELMTS, kealib::KEA_RDCC_NELMTS, kealib::KEA_RDCC_NBYTES, kealib::KEA_RDCC_W0, 
-                    kealib::KEA_SIEVE_BUF, kealib::KEA_META_BLOCKSIZE, HDF5VFLGetFileDriver(), nullptr);
+                    kealib::KEA_SIEVE_BUF, kealib::KEA_META_BLOCKSIZE, HDF5VFLGetFileDriver(), nullptr,
+                    npageBufferSize, bShared);
             }
             else
             {
@@ -234,6 +287,15 @@ GDALDataset *KEADataset::Create( const char * pszFilename,
     if( pszValue != nullptr )
         nimageblockSize = atol( pszValue );
 
+    // rectangular blocks, same as the GTiff options
+    unsigned int nimageblockYSize = 0;
+    pszValue = CSLFetchNameValue( papszParmList, "BLOCKXSIZE" );
+    if( pszValue != nullptr )
+        nimageblockSize = atol( pszValue );
+    pszValue = CSLFetchNameValue( papszParmList, "BLOCKYSIZE" );
+    if( pszValue != nullptr )
+        nimageblockYSize = atol( pszValue );
+
     unsigned int nattblockSize = kealib::KEA_ATT_CHUNK_SIZE;
     pszValue = CSLFetchNameValue( papszParmList, "ATTBLOCKSIZE" );
     if( pszValue != nullptr )
@@ -279,22 +341,44 @@ GDALDataset *KEADataset::Create( const char * pszFilename,
     if( pszValue != nullptr )
         bThematic = EQUAL(pszValue, "YES");
 
+    bool bPersistFreeSpace = false;
+    pszValue = CSLFetchNameValue( papszParmList, "PERSIST_FREE_SPACE" );
+    if( pszValue != nullptr )
+        bPersistFreeSpace = CPLTestBool(pszValue);
+
+    hsize_t npageSize = kealib::KEA_PAGE_SIZE;
+    pszValue = CSLFetchNameValue( papszParmList, "PAGE_SIZE" );
+    if( pszValue != nullptr )
+        npageSize = atol( pszValue );
+
+    bool bConsolidatedHeader = false;
+    pszValue = CSLFetchNameValue( papszParmList, "CONSOLIDATED_HEADER" );
+    if( pszValue != nullptr )
+        bConsolidatedHeader = CPLTestBool(pszValue);
+
+    const char *pszNBits = CSLFetchNameValue( papszParmList, "NBITS" );
+
     try
     {
         // now create it
         HighFive::File *keaImgH5File = kealib::KEAImageIO::createKEAImage( pszFilename,
-                                                    GDAL_to_KEA_Type( eType ),
+                                                    GDAL_to_KEA_Type( eType, pszNBits ),
                                                     nXSize, nYSize, nBands,
                                                     nullptr, nullptr, nimageblockSize, 
                                                     nattblockSize, nmdcElmts, nrdccNElmts,
                                                     nrdccNBytes, nrdccW0, nsieveBuf, 
-                                                    nmetaBlockSize, ndeflate );
+                                                    nmetaBlockSize, ndeflate,
+                                                    bPersistFreeSpace, npageSize, false,
+                                                    nimageblockYSize );
 
         // create our dataset object                            
         KEADataset *pDataset = new KEADataset( keaImgH5File, GA_Update );
 
         pDataset->SetDescription( pszFilename );
 
+        if( bConsolidatedHeader )
+            pDataset->m_pImageIO->createConsolidatedHeader();
+
         // set all to thematic if asked
         if( bThematic )
         {
@@ -347,6 +431,15 @@ GDALDataset *KEADataset::CreateCopy( const char * pszFilename, GDALDataset *pSrc
     if( pszValue != nullptr )
         nimageblockSize = atol( pszValue );
 
+    // rectangular blocks, same as the GTiff options
+    unsigned int nimageblockYSize = 0;
+    pszValue = CSLFetchNameValue( papszParmList, "BLOCKXSIZE" );
+    if( pszValue != nullptr )
+        nimageblockSize = atol( pszValue );
+    pszValue = CSLFetchNameValue( papszParmList, "BLOCKYSIZE" );
+    if( pszValue != nullptr )
+        nimageblockYSize = atol( pszValue );
+
     unsigned int nattblockSize = kealib::KEA_ATT_CHUNK_SIZE;
     pszValue = CSLFetchNameValue( papszParmList, "ATTBLOCKSIZE" );
     if( pszValue != nullptr )
@@ -392,6 +485,21 @@ GDALDataset *KEADataset::CreateCopy( const char * pszFilename, GDALDataset *pSrc
     if( pszValue != nullptr )
         bThematic = EQUAL(pszValue, "YES");
 
+    bool bPersistFreeSpace = false;
+    pszValue = CSLFetchNameValue( papszParmList, "PERSIST_FREE_SPACE" );
+    if( pszValue != nullptr )
+        bPersistFreeSpace = CPLTestBool(pszValue);
+
+    hsize_t npageSize = kealib::KEA_PAGE_SIZE;
+    pszValue = CSLFetchNameValue( papszParmList, "PAGE_SIZE" );
+    if( pszValue != nullptr )
+        npageSize = atol( pszValue );
+
+    bool bConsolidatedHeader = false;
+    pszValue = CSLFetchNameValue( papszParmList, "CONSOLIDATED_HEADER" );
+    if( pszValue != nullptr )
+        bConsolidatedHeader = CPLTestBool(pszValue);
+
     // get the data out of the input dataset
     int nXSize = pSrcDs->GetRasterXSize();
     int nYSize = pSrcDs->GetRasterYSize();
@@ -400,16 +508,23 @@ GDALDataset *KEADataset::CreateCopy( const char * pszFilename, GDALDataset *pSrc
                              ? GDT_Unknown
                              : pSrcDs->GetRasterBand(1)->GetRasterDataType();
 
+    // if not given keep the packing of the source
+    const char *pszNBits = CSLFetchNameValue( papszParmList, "NBITS" );
+    if( ( pszNBits == nullptr ) && ( nBands > 0 ) && ( eType == GDT_Byte ) )
+        pszNBits = pSrcDs->GetRasterBand(1)->GetMetadataItem( "NBITS", "IMAGE_STRUCTURE" );
+
     try
     {
         // now create it
         HighFive::File *keaImgH5File = kealib::KEAImageIO::createKEAImage( pszFilename,
-                                                    GDAL_to_KEA_Type( eType ),
+                                                    GDAL_to_KEA_Type( eType, pszNBits ),
                                                     nXSize, nYSize, nBands,
                                                     nullptr, nullptr, nimageblockSize, 
                                                     nattblockSize, nmdcElmts, nrdccNElmts,
                                                     nrdccNBytes, nrdccW0, nsieveBuf, 
-                                                    nmetaBlockSize, ndeflate );
+                                                    nmetaBlockSize, ndeflate,
+                                                    bPersistFreeSpace, npageSize, false,
+                                                    nimageblockYSize );
 
         // create the imageio
         kealib::KEAImageIO *pImageIO = new kealib::KEAImageIO();
@@ -418,12 +533,16 @@ GDALDataset *KEADataset::CreateCopy( const char * pszFilename, GDALDataset *pSrc
         pImageIO->openKEAImageHeader( keaImgH5File );
 
         // copy file
-        if( !KEACopyFile( pSrcDs, pImageIO, pfnProgress, pProgressData) )
+        if( !KEACopyFile( pSrcDs, pImageIO, pfnProgress, pProgressData, bThematic ) )
         {
             delete pImageIO;
             return nullptr;
         }
 
+        // now everything is set
+        if( bConsolidatedHeader )
+            pImageIO->createConsolidatedHeader();
+
         // close it
         try
         {
@@ -443,16 +562,6 @@ GDALDataset *KEADataset::CreateCopy( const char * pszFilename, GDALDataset *pSrc
         KEADataset *pDataset = new KEADataset( keaImgH5File, GA_Update );
         pDataset->SetDescription( pszFilename );
 
-        // set all to thematic if asked - overrides whatever set by CopyFile
-        if( bThematic )
-        {
-            for( int nCount = 0; nCount < nBands; nCount++ )
-            {
-                GDALRasterBand *pBand = pDataset->GetRasterBand(nCount+1);
-                pBand->SetMetadataItem("LAYER_TYPE", "thematic");
-            }
-        }
-
         return pDataset;
     }
     catch (const kealib::KEAException &e)
@@ -809,6 +918,7 @@ CPLErr KEADataset::SetMetadata(char **papszMetadata, const char *pszDomain)
     int nIndex = 0;
     char *pszName;
     const char *pszValue;
+    std::vector< std::pair<std::string, std::string> > data;
     try
     {
         // go through each item
@@ -816,10 +926,11 @@ CPLErr KEADataset::SetMetadata(char **papszMetadata, const char *pszDomain)
         {
             // get the value/name
             pszValue = CPLParseNameValue( papszMetadata[nIndex], &pszName );
-            // set it with imageio
-            this->m_pImageIO->setImageMetaData(pszName, pszValue );
+            data.push_back(std::pair<std::string, std::string>(pszName, pszValue));
             nIndex++;
         }
+        // set them all at once with imageio
+        this->m_pImageIO->setImageMetaData(data);
     }
     catch (const kealib::KEAIOException &e)
     {
@@ -840,14 +951,26 @@ CPLErr KEADataset::AddBand(GDALDataType eType, char **papszOptions)
 {
     // process any creation options in papszOptions
     unsigned int nimageBlockSize = kealib::KEA_IMAGE_CHUNK_SIZE;
+    unsigned int nimageBlockYSize = 0;
     unsigned int nattBlockSize = kealib::KEA_ATT_CHUNK_SIZE;
     unsigned int ndeflate = kealib::KEA_DEFLATE;
+    const char *pszNBits = nullptr;
     if (papszOptions != nullptr) {
         const char *pszValue = CSLFetchNameValue(papszOptions,"IMAGEBLOCKSIZE");
         if ( pszValue != nullptr ) {
             nimageBlockSize = atol(pszValue);
         }
 
+        pszValue = CSLFetchNameValue(papszOptions, "BLOCKXSIZE");
+        if (pszValue != nullptr) {
+            nimageBlockSize = atol(pszValue);
+        }
+
+        pszValue = CSLFetchNameValue(papszOptions, "BLOCKYSIZE");
+        if (pszValue != nullptr) {
+            nimageBlockYSize = atol(pszValue);
+        }
+
         pszValue = CSLFetchNameValue(papszOptions, "ATTBLOCKSIZE");
         if (pszValue != nullptr) {
             nattBlockSize = atol(pszValue);
@@ -857,11 +980,13 @@ CPLErr KEADataset::AddBand(GDALDataType eType, char **papszOptions)
         if (pszValue != nullptr) {
             ndeflate = atol(pszValue);
         }
+
+        pszNBits = CSLFetchNameValue(papszOptions, "NBITS");
     }
 
     try {
-        m_pImageIO->addImageBand(GDAL_to_KEA_Type(eType), "", nimageBlockSize,
-                nattBlockSize, ndeflate);
+        m_pImageIO->addImageBand(GDAL_to_KEA_Type(eType, pszNBits), "", nimageBlockSize,
+                nattBlockSize, ndeflate, nimageBlockYSize);
     } catch (const kealib::KEAIOException &e) {
         return CE_Failure;
     }
@@ -133,6 +133,7 @@ private:
 // conversion functions
 GDALDataType KEA_to_GDAL_Type( kealib::KEADataType ekeaType );
 kealib::KEADataType GDAL_to_KEA_Type( GDALDataType egdalType );
+kealib::KEADataType GDAL_to_KEA_Type( GDALDataType egdalType, const char *pszNBits );
 
 // A thresafe reference count. Used to manage shared pointer to
 // the kealib::KEAImageIO instance between bands and dataset.
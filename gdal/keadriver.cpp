@@ -53,6 +53,9 @@ void GDALRegister_KEA()
         poDriver->SetMetadataItem( GDAL_DMD_CREATIONDATATYPES, 
             "Byte Int8 Int16 UInt16 Int32 UInt32 " 
             "Int64 UInt64 "
+#ifdef HAVE_GDT_FLOAT16
+            "Float16 "
+#endif
             "Float32 Float64" );
         poDriver->SetMetadataItem( 
             GDAL_DMD_CREATIONOPTIONLIST, 
@@ -60,6 +63,10 @@ void GDALRegister_KEA()
                 "<CreationOptionList> "
                 "<Option name='IMAGEBLOCKSIZE' type='int' description='The size of "
                 "each block for image data' default='%d'/> "
+                "<Option name='BLOCKXSIZE' type='int' description='Block width, "
+                "overrides IMAGEBLOCKSIZE'/> "
+                "<Option name='BLOCKYSIZE' type='int' description='Block height. "
+                "Blocks are square (IMAGEBLOCKSIZE or BLOCKXSIZE) if not given'/> "
                 "<Option name='ATTBLOCKSIZE' type='int' description='The size of "
                 "each block for attribute data' default='%d'/> "
                 "<Option name='MDC_NELMTS' type='int' description='Number of "
@@ -78,6 +85,18 @@ void GDALRegister_KEA()
                 "to 9 (max compression)' default='%d'/> "
                 "<Option name='THEMATIC' type='boolean' description='If YES then "
                 "all bands are set to thematic' default='NO'/> "
+                "<Option name='NBITS' type='int' description='Store Byte bands "
+                "packed with 1, 2 or 4 bits per pixel'/> "
+                "<Option name='PERSIST_FREE_SPACE' type='boolean' description='If "
+                "YES then space freed by deleting or rewriting objects is reused in "
+                "later sessions. Requires HDF5 1.10 to read' default='NO'/> "
+                "<Option name='PAGE_SIZE' type='int' description='If set, use HDF5 "
+                "paged aggregation with this page size so the file can be read "
+                "efficiently from cloud storage (e.g. 1048576). Requires HDF5 1.10 "
+                "to read' default='0'/> "
+                "<Option name='CONSOLIDATED_HEADER' type='boolean' description='If "
+                "YES then the image and band properties are also stored together "
+                "so the file opens faster' default='NO'/> "
                 "</CreationOptionList>",
                 static_cast<int>(kealib::KEA_IMAGE_CHUNK_SIZE),
                 static_cast<int>(kealib::KEA_ATT_CHUNK_SIZE),
@@ -37,8 +37,10 @@ KEAOverview::KEAOverview(KEADataset *pDataset, int nSrcBand, GDALAccess eAccess,
 {
     this->m_nOverviewIndex = nOverviewIndex;
     // overridden from the band - not the same size as the band obviously
-    this->nBlockXSize = pImageIO->getOverviewBlockSize(nSrcBand, nOverviewIndex);
-    this->nBlockYSize = pImageIO->getOverviewBlockSize(nSrcBand, nOverviewIndex);
+    uint32_t nBlockXSizeKEA, nBlockYSizeKEA;
+    pImageIO->getOverviewBlockSize(nSrcBand, nOverviewIndex, &nBlockXSizeKEA, &nBlockYSizeKEA);
+    this->nBlockXSize = nBlockXSizeKEA;
+    this->nBlockYSize = nBlockYSizeKEA;
     this->nRasterXSize = nXSize;
     this->nRasterYSize = nYSize;
 }
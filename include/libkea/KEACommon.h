@@ -32,6 +32,7 @@
 #define KEACommon_H
 
 #include "libkea/kea_export.h"
+#include "libkea/kea-config.h"
 #include <highfive/highfive.hpp>
 
 #include <iostream>
@@ -40,6 +41,11 @@
 #include <vector>
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <atomic>
+#include <map>
+#include <chrono>
 
 #include <stdint.h>
 
@@ -85,6 +91,14 @@ namespace kealib{
     static const std::string KEA_BANDNAME_METADATA_HISTOBINFUNCTION( "/METADATA/STATISTICS_HISTOBINFUNCTION" );
     static const std::string KEA_BANDNAME_METADATA_WAVELENGTH( "/METADATA/WAVELENGTH" );
     static const std::string KEA_BANDNAME_METADATA_FWHM( "/METADATA/FWHM" );
+    // optional record of the areas written since the overviews and statistics
+    // were last updated (see KEAImageIO::trackDirtyRegions()). Rows of 
+    // xOff, yOff, xSize, ySize in pixels, aligned to the band's blocks.
+    static const std::string KEA_BANDNAME_DIRTY( "/DIRTY" );
+    static const std::string KEA_BANDNAME_DIRTY_OVERVIEWS( "/DIRTY/OVERVIEWS" );
+    static const std::string KEA_BANDNAME_DIRTY_STATISTICS( "/DIRTY/STATISTICS" );
+    // count, sum, sum of squares, min and max of each block for KEAImageIO::updateStatistics()
+    static const std::string KEA_BANDNAME_BLOCK_STATISTICS( "/BLOCK_STATISTICS" );
     
     static const std::string KEA_BANDNAME_ATT( "/ATT" );   
     static const std::string KEA_ATT_GROUPNAME_HEADER( "/ATT/HEADER" );
@@ -135,9 +149,46 @@ namespace kealib{
     static const std::string KEA_GCPS_DFY( "DF_Y" );
     static const std::string KEA_GCPS_DFZ( "DF_Z" );
     
+    // optional consolidated header. Rows are the bands, image level 
+    // values are attributes. Kept in step with the datasets above.
+    static const std::string KEA_DATASETNAME_HEADER_CONSOLIDATED( "/HEADER/CONSOLIDATED" );
+    static const std::string KEA_CONSOLIDATED_FILETYPE( "FILETYPE" );
+    static const std::string KEA_CONSOLIDATED_VERSION( "VERSION" );
+    static const std::string KEA_CONSOLIDATED_NUMBANDS( "NUMBANDS" );
+    static const std::string KEA_CONSOLIDATED_TL( "TL" );
+    static const std::string KEA_CONSOLIDATED_RES( "RES" );
+    static const std::string KEA_CONSOLIDATED_ROT( "ROT" );
+    static const std::string KEA_CONSOLIDATED_SIZE( "SIZE" );
+    static const std::string KEA_CONSOLIDATED_WKT( "WKT" );
+    static const std::string KEA_CONSOLIDATED_DESCRIP( "DESCRIPTION" );
+    static const std::string KEA_CONSOLIDATED_DT( "DATATYPE" );
+    static const std::string KEA_CONSOLIDATED_TYPE( "LAYER_TYPE" );
+    static const std::string KEA_CONSOLIDATED_USAGE( "LAYER_USAGE" );
+    static const std::string KEA_CONSOLIDATED_BLOCK_SIZE( "BLOCK_SIZE" );
+    static const std::string KEA_CONSOLIDATED_BLOCK_YSIZE( "BLOCK_YSIZE" );
+    static const std::string KEA_CONSOLIDATED_NO_DATA_DEFINED( "NO_DATA_DEFINED" );
+    static const std::string KEA_CONSOLIDATED_NO_DATA_VAL( "NO_DATA_VAL" );
+    // bumped whenever the columns above change so older layouts are ignored
+    // rather than misread. KEAImageIO::createConsolidatedHeader() replaces them.
+    static const std::string KEA_CONSOLIDATED_LAYOUT( "LAYOUT" );
+    static const uint32_t KEA_CONSOLIDATED_LAYOUT_VERSION( 1 );
+    
+    // optional compact metadata. All the items of an image or band in
+    // one dataset of name/value pairs instead of a dataset per item.
+    static const std::string KEA_DATASETNAME_METADATA_COMPACT( "/METADATA_COMPACT" );
+    static const std::string KEA_BANDNAME_METADATA_COMPACT( "/METADATA_COMPACT" );
+    static const std::string KEA_METADATA_COMPACT_NAME( "NAME" );
+    static const std::string KEA_METADATA_COMPACT_VALUE( "VALUE" );
+    
     static const std::string KEA_ATTRIBUTENAME_CLASS( "CLASS" );
 	static const std::string KEA_ATTRIBUTENAME_IMAGE_VERSION( "IMAGE_VERSION" );
     static const std::string KEA_ATTRIBUTENAME_BLOCK_SIZE( "BLOCK_SIZE" );
+    static const std::string KEA_ATTRIBUTENAME_BLOCK_XSIZE( "BLOCK_XSIZE" );
+    static const std::string KEA_ATTRIBUTENAME_BLOCK_YSIZE( "BLOCK_YSIZE" );
+    static const std::string KEA_ATTRIBUTENAME_NBITS( "NBITS" );
+    static const std::string KEA_ATTRIBUTENAME_XSIZE( "XSIZE" );
+    // image xSize, ySize then block xSize, ySize the block statistics were calculated for
+    static const std::string KEA_ATTRIBUTENAME_BLOCK_GRID( "BLOCK_GRID" );
     
     static const std::string KEA_NODATA_DEFINED( "NO_DATA_DEFINED" );
     
@@ -150,6 +201,9 @@ namespace kealib{
     static const unsigned int KEA_DEFLATE( 1 );        // 1
     static const hsize_t KEA_IMAGE_CHUNK_SIZE( 512 );  // 512
     static const hsize_t KEA_ATT_CHUNK_SIZE( 10000 );  // 10000
+    static const hsize_t KEA_PAGE_SIZE( 0 );           // 0 (not paged)
+    static const hsize_t KEA_PAGE_BUFFER_SIZE( 0 );    // 0 (no page buffer)
+    static const size_t KEA_MAX_PIXEL_SIZE( 8 );       // size of the largest KEADataType
     
     static const int FILL_IMAGE_DATA(0);
     static const int FILL_MASK_DATA(255);
@@ -166,7 +220,14 @@ namespace kealib{
         kea_32uint = 7,
         kea_64uint = 8,
         kea_32float = 9,
-        kea_64float = 10
+        kea_64float = 10,
+        // bit packed unsigned types. Only valid as a band type - they
+        // are read and written through buffers of one of the types above
+        // (a buffer of one of these types is treated as kea_8uint)
+        kea_1uint = 11,
+        kea_2uint = 12,
+        kea_4uint = 13,
+        kea_16float = 14      // IEEE half
     };
     
     enum KEALayerType
@@ -175,6 +236,23 @@ namespace kealib{
         kea_thematic = 1
     };
     
+    // the corner of the existing image that stays put when it is
+    // extended (see KEAImageIO::extendImage())
+    enum KEAImageAnchor
+    {
+        kea_anchor_topleft = 0,
+        kea_anchor_topright = 1,
+        kea_anchor_bottomleft = 2,
+        kea_anchor_bottomright = 3
+    };
+    
+    // how KEAImageIO::updateOverviews() calculates overview pixels
+    enum KEAOverviewResampling
+    {
+        kea_resample_nearest = 0,
+        kea_resample_average = 1
+    };
+    
     enum KEABandClrInterp
     {
         kea_generic = 0,
@@ -209,6 +287,29 @@ namespace kealib{
         uint64_t ySize;
     };
     
+    // a region of a band in another KEA file that makes up part of a 
+    // virtual band (see KEAImageIO::setVirtualImageBand())
+    struct KEAVirtualSource
+    {
+        std::string fileName;   // relative names are looked for next to the virtual file
+        uint32_t band;          // 1-based
+        uint64_t xSrcOff;       // window of the source band
+        uint64_t ySrcOff;
+        uint64_t xSize;
+        uint64_t ySize;
+        uint64_t xDstOff;       // where it goes in the virtual band
+        uint64_t yDstOff;
+    };
+    
+    // the no data value of a band as cached by KEAImageIO. value holds
+    // the no data in the data type of the band. dataType is kea_undefined
+    // when the no data has not been set for the band.
+    struct KEANoDataCacheItem
+    {
+        KEADataType dataType;
+        uint8_t value[KEA_MAX_PIXEL_SIZE];
+    };
+    
     struct KEAImageGCP
     {
         std::string pszId;
@@ -231,6 +332,69 @@ namespace kealib{
         double dfGCPZ;
     };
     
+    // the band info held in memory when the file has a consolidated header
+    struct KEABandInfo
+    {
+        std::string description;
+        KEADataType dataType;
+        KEALayerType layerType;
+        KEABandClrInterp clrInterp;
+        uint32_t blockXSize;
+        uint32_t blockYSize;
+    };
+    
+    // the properties of a band that can't change once it has been created
+    struct KEAImmutableBandInfo
+    {
+        KEADataType dataType;   // kea_undefined if not in the file
+        uint32_t blockXSize;    // 0 if not in the file
+        uint32_t blockYSize;
+        // chunks of the image data for counting IO. In bytes if bit 
+        // packed. 0 if not chunked (virtual) or not known
+        uint32_t chunkXSize;
+        uint32_t chunkYSize;
+        uint8_t nBits;          // 0 unless bit packed
+    };
+    
+    // one row of KEA_DATASETNAME_HEADER_CONSOLIDATED
+    struct KEABandInfo_HDF5
+    {
+        char *pszDescription;
+        uint32_t dataType;
+        uint32_t layerType;
+        uint32_t layerUsage;
+        uint32_t blockSize;     // x block size
+        uint32_t blockYSize;    // 0 in older files where blocks were square
+        int32_t noDataDefined;
+        uint64_t noDataValue; // bytes of the no data in the band's type
+    };
+    
+    // a row of the compact metadata
+    struct KEAMetaDataItem_HDF5
+    {
+        char *pszName;
+        char *pszValue;
+    };
+    
+    // counters returned by KEAImageIO::getIOStatistics(). Only the pixel
+    // reads and writes (image data, masks and overviews) are counted. 
+    // Times are in seconds and are summed over all the threads.
+    struct KEAIOStatistics
+    {
+        uint64_t readCalls;
+        uint64_t writeCalls;
+        uint64_t bytesRead;         // in the caller's buffer type
+        uint64_t bytesWritten;
+        uint64_t chunksRead;        // chunks the windows touched
+        uint64_t chunksWritten;
+        uint64_t flushes;
+        double readTime;            // in HDF5 plus any unpacking
+        double writeTime;
+        double lockWaitTime;        // waiting for the file and band locks
+        double flushTime;
+        double metadataCacheHitRate; // of the open file, -1 if unknown
+    };
+    
     inline std::string int2Str(int32_t num)
     {
         std::ostringstream convert;
@@ -310,6 +474,22 @@ namespace kealib{
         {
             strDT = "Float 64 bit";
         }
+        else if(dataType == kea_16float)
+        {
+            strDT = "Float 16 bit";
+        }
+        else if(dataType == kea_1uint)
+        {
+            strDT = "Unsigned Integer 1 bit";
+        }
+        else if(dataType == kea_2uint)
+        {
+            strDT = "Unsigned Integer 2 bit";
+        }
+        else if(dataType == kea_4uint)
+        {
+            strDT = "Unsigned Integer 4 bit";
+        }
         else
         {
             strDT = "Unknown";
@@ -318,6 +498,23 @@ namespace kealib{
         return strDT;
     }
 
+    // number of bits per pixel for the bit packed types. 0 if 
+    // the type isn't bit packed
+    inline uint8_t getDataTypeNBits(KEADataType dataType)
+    {
+        switch(dataType)
+        {
+            case kea_1uint:
+                return 1;
+            case kea_2uint:
+                return 2;
+            case kea_4uint:
+                return 4;
+            default:
+                return 0;
+        }
+    }
+
     // inline class to save/restore HDF5 exception stack trace
     // printing (we usually want this off, but want to revert back to what caller had)
     // Also, this state is per thread so if calling a method on a new thread this will
@@ -339,8 +536,221 @@ namespace kealib{
         void *m_clientData;  
     };
 
-    typedef std::recursive_mutex kea_mutex;
+    // A reader/writer lock that, like the std::recursive_mutex it replaced, 
+    // can be taken again by the thread that holds it. Functions that only 
+    // read take it shared (kea_read_lock) so readers don't wait on each other.
+    // Anything that changes the file takes it exclusively (kea_lock). A thread
+    // holding it exclusively can also take it shared, but not the other way 
+    // round - something holding a kea_read_lock must never need a kea_lock.
+    class KEASharedMutex
+    {
+    public:
+        KEASharedMutex() : m_owner(std::thread::id()), m_exclusiveCount(0)
+        {
+        }
+        KEASharedMutex(const KEASharedMutex&) = delete;
+        KEASharedMutex& operator=(const KEASharedMutex&) = delete;
+
+        void lock()
+        {
+            if( m_owner.load() == std::this_thread::get_id() )
+            {
+                ++m_exclusiveCount;
+                return;
+            }
+            m_mutex.lock();
+            m_owner.store(std::this_thread::get_id());
+            m_exclusiveCount = 1;
+        }
+        bool try_lock()
+        {
+            if( m_owner.load() == std::this_thread::get_id() )
+            {
+                ++m_exclusiveCount;
+                return true;
+            }
+            if( !m_mutex.try_lock() )
+            {
+                return false;
+            }
+            m_owner.store(std::this_thread::get_id());
+            m_exclusiveCount = 1;
+            return true;
+        }
+        void unlock()
+        {
+            if( --m_exclusiveCount == 0 )
+            {
+                m_owner.store(std::thread::id());
+                m_mutex.unlock();
+            }
+        }
+        
+        void lock_shared()
+        {
+            if( m_owner.load() == std::this_thread::get_id() )
+            {
+                // already have it exclusively
+                ++m_exclusiveCount;
+                return;
+            }
+            unsigned int &count = sharedCounts()[this];
+            if( count == 0 )
+            {
+                m_mutex.lock_shared();
+            }
+            ++count;
+        }
+        bool try_lock_shared()
+        {
+            if( m_owner.load() == std::this_thread::get_id() )
+            {
+                ++m_exclusiveCount;
+                return true;
+            }
+            unsigned int &count = sharedCounts()[this];
+            if( (count == 0) && !m_mutex.try_lock_shared() )
+            {
+                sharedCounts().erase(this);
+                return false;
+            }
+            ++count;
+            return true;
+        }
+        void unlock_shared()
+        {
+            if( m_owner.load() == std::this_thread::get_id() )
+            {
+                unlock();
+                return;
+            }
+            auto itr = sharedCounts().find(this);
+            if( --itr->second == 0 )
+            {
+                sharedCounts().erase(itr);
+                m_mutex.unlock_shared();
+            }
+        }
+        
+    private:
+        // how many times this thread holds each KEASharedMutex shared.
+        // std::shared_timed_mutex can't be locked shared twice by the same 
+        // thread (a waiting writer would deadlock it) so only the first counts.
+        static std::map<const KEASharedMutex*, unsigned int> &sharedCounts()
+        {
+            thread_local std::map<const KEASharedMutex*, unsigned int> counts;
+            return counts;
+        }
+        
+        std::shared_timed_mutex m_mutex;
+        std::atomic<std::thread::id> m_owner;
+        unsigned int m_exclusiveCount;
+    };
+
+    typedef KEASharedMutex kea_mutex;
     typedef std::lock_guard<kea_mutex> kea_lock;
+#ifdef H5_HAVE_THREADSAFE
+    typedef std::shared_lock<kea_mutex> kea_read_lock;
+#else
+    // HDF5 can only be used by one thread at a time so
+    // readers have to take the lock exclusively too
+    typedef std::unique_lock<kea_mutex> kea_read_lock;
+#endif
+
+    // measures how long something took in nanoseconds. Does nothing when
+    // the library is built without LIBKEA_WITH_IO_STATISTICS.
+    class KEAIOTimer
+    {
+    public:
+#ifdef LIBKEA_WITH_IO_STATISTICS
+        KEAIOTimer() : m_start(std::chrono::steady_clock::now())
+        {
+        }
+        uint64_t elapsed() const
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - m_start).count();
+        }
+    private:
+        std::chrono::steady_clock::time_point m_start;
+#else
+        uint64_t elapsed() const
+        {
+            return 0;
+        }
+#endif
+    };
+
+#ifdef LIBKEA_WITH_IO_STATISTICS
+    // the counters behind KEAIOStatistics. Updated by many threads at 
+    // once so they are atomics and never need a lock.
+    class KEAIOCounters
+    {
+    public:
+        void addRead(uint64_t bytes, uint64_t chunks, uint64_t ioNanos, uint64_t lockNanos)
+        {
+            ++m_readCalls;
+            m_bytesRead += bytes;
+            m_chunksRead += chunks;
+            m_readNanos += ioNanos;
+            m_lockWaitNanos += lockNanos;
+        }
+        void addWrite(uint64_t bytes, uint64_t chunks, uint64_t ioNanos, uint64_t lockNanos)
+        {
+            ++m_writeCalls;
+            m_bytesWritten += bytes;
+            m_chunksWritten += chunks;
+            m_writeNanos += ioNanos;
+            m_lockWaitNanos += lockNanos;
+        }
+        void addFlush(uint64_t nanos)
+        {
+            ++m_flushes;
+            m_flushNanos += nanos;
+        }
+        void reset()
+        {
+            m_readCalls = 0;
+            m_writeCalls = 0;
+            m_bytesRead = 0;
+            m_bytesWritten = 0;
+            m_chunksRead = 0;
+            m_chunksWritten = 0;
+            m_flushes = 0;
+            m_readNanos = 0;
+            m_writeNanos = 0;
+            m_lockWaitNanos = 0;
+            m_flushNanos = 0;
+        }
+        void get(KEAIOStatistics *stats) const
+        {
+            stats->readCalls = m_readCalls;
+            stats->writeCalls = m_writeCalls;
+            stats->bytesRead = m_bytesRead;
+            stats->bytesWritten = m_bytesWritten;
+            stats->chunksRead = m_chunksRead;
+            stats->chunksWritten = m_chunksWritten;
+            stats->flushes = m_flushes;
+            stats->readTime = double(m_readNanos) / 1e9;
+            stats->writeTime = double(m_writeNanos) / 1e9;
+            stats->lockWaitTime = double(m_lockWaitNanos) / 1e9;
+            stats->flushTime = double(m_flushNanos) / 1e9;
+            stats->metadataCacheHitRate = -1;
+        }
+    private:
+        std::atomic<uint64_t> m_readCalls{0};
+        std::atomic<uint64_t> m_writeCalls{0};
+        std::atomic<uint64_t> m_bytesRead{0};
+        std::atomic<uint64_t> m_bytesWritten{0};
+        std::atomic<uint64_t> m_chunksRead{0};
+        std::atomic<uint64_t> m_chunksWritten{0};
+        std::atomic<uint64_t> m_flushes{0};
+        std::atomic<uint64_t> m_readNanos{0};
+        std::atomic<uint64_t> m_writeNanos{0};
+        std::atomic<uint64_t> m_lockWaitNanos{0};
+        std::atomic<uint64_t> m_flushNanos{0};
+    };
+#endif
     
     // base class for KEA classes. Either create a 
     // mutex themselves, or share one from the KEAImageIO class 
@@ -41,6 +41,8 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <map>
+#include <atomic>
 
 #include <highfive/highfive.hpp>
 
@@ -134,10 +136,12 @@ namespace kealib{
          *
          * @param band    The band to create a mask band for. 1-based.
          * @param deflate The level of compression to use
+         * @param bitPacked If true the mask is stored as 1 bit per pixel (8 times smaller).
+         *                  Any non-zero value written is treated as valid and read back as 255.
          * 
          * @throws KEAIOException If there is a problem creating the mask band
          */
-        void createMask(uint32_t band, uint32_t deflate=KEA_DEFLATE);
+        void createMask(uint32_t band, uint32_t deflate=KEA_DEFLATE, bool bitPacked=false);
         
         /**
          * Writes data to the mask band
@@ -178,6 +182,29 @@ namespace kealib{
          * @throws KEAIOException 
          */
         void readImageBlock2BandMask(uint32_t band, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeIn, uint64_t ySizeIn, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType);
+        /**
+         * Reads a block of image data along with which pixels are valid
+         *
+         * Does the work of readImageBlock2Band() and readImageBlock2BandMask() in one call.
+         * The mask comes from the mask band if there is one, otherwise from the no data
+         * value. Pixels in the buffer that are off the edge of the image are never valid.
+         *
+         * @param band       The band number to read from. Band numbers start at 1.
+         * @param data       A pointer to the buffer where the image data will be stored after reading.
+         * @param maskData   A pointer to a buffer of xSizeBuf * ySizeBuf bytes that receives 255 for
+         *                   valid pixels and 0 otherwise. May be NULL if substituteNoData is true.
+         * @param xPxlOff    The horizontal pixel offset in the image from which the subset begins.
+         * @param yPxlOff    The vertical pixel offset in the image from which the subset begins.
+         * @param xSizeIn    The width of the subset to read, starting from xPxlOff.
+         * @param ySizeIn    The height of the subset to read, starting from yPxlOff.
+         * @param xSizeBuf   The width of the provided buffer where the data will be stored.
+         * @param ySizeBuf   The height of the provided buffer where the data will be stored.
+         * @param inDataType The data type of the pixel values specified as a KEADataType.
+         * @param substituteNoData If true, pixels that are not valid are set to the no data 
+         *                   value (or 0 if there isn't one) in data.
+         * @throws KEAIOException 
+         */
+        void readImageBlock2BandWithMask(uint32_t band, void *data, uint8_t *maskData, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeIn, uint64_t ySizeIn, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType, bool substituteNoData=false);
         /**
          * Determines whether a mask band has been created for the specified band
          *
@@ -212,7 +239,8 @@ namespace kealib{
          */
         std::vector< std::pair<std::string, std::string> > getImageMetaData();
         /**
-         * Set all the image metadata names and values at once
+         * Set all the image metadata names and values at once. Written
+         * together with a single flush so much quicker than setting them one by one.
          * @param data a vector of pairs describing the metadata
          * @throws KEAIOException
          */
@@ -249,13 +277,34 @@ namespace kealib{
          */
         std::vector< std::pair<std::string, std::string> > getImageBandMetaData(uint32_t band);
         /**
-         * Set all the band metadata names and values at once
+         * Set all the band metadata names and values at once. Written
+         * together with a single flush so much quicker than setting them one by one.
          * @param band  1-based index of the band to set metadata
          * @param data a vector of pairs describing the metadata
          * @throws KEAIOException
          */
         void setImageBandMetaData(uint32_t band, const std::vector< std::pair<std::string, std::string> > &data);
         
+        /**
+         * Moves the image and band metadata into compact form.
+         *
+         * Instead of a dataset for each item the items of the image and of each
+         * band are held in a single dataset of name/value pairs which is read in 
+         * one go by getImageMetaData() and getImageMetaDataNames(). Worth it for 
+         * files with thousands of items. Items set afterwards are added to the 
+         * compact form, best done with the vector setters as each call rewrites it.
+         * Versions of the library before 2.0 won't see metadata in compact form.
+         *
+         * @throws KEAIOException If the image is not open or there is a problem writing it.
+         */
+        void compactMetaData();
+        
+        /**
+         * Whether the image metadata is in compact form (see compactMetaData()).
+         * @throws KEAIOException
+         */
+        bool hasCompactMetaData();
+        
         /**
          * Set the description of an image band to a string
          *
@@ -358,12 +407,24 @@ namespace kealib{
          *             Band indexing starts at 1. Providing a value of 0 or greater than
          *             the total number of bands in the image will throw an exception.
          * @return The block size of the specified band as an unsigned 32-bit integer.
+         *         For bands with rectangular blocks this is the X block size.
          * @throws KEAIOException If the image file is not open, the band index is invalid,
          *                        the specific band dataset or block size attribute is missing,
          *                        or if an error occurs while reading the necessary data.
          */
         uint32_t getImageBlockSize(uint32_t band);
         
+        /**
+         * Get the X and Y block sizes of a band which may differ (see 
+         * addImageBand()). Both are the same for files created by older versions.
+         *
+         * @param band  1-based index of image band
+         * @param blockXSize  set to the number of columns in a block
+         * @param blockYSize  set to the number of rows in a block
+         * @throws KEAIOException
+         */
+        void getImageBlockSize(uint32_t band, uint32_t *blockXSize, uint32_t *blockYSize);
+        
         /**
          * Get the KEA data type for the specified band
          *
@@ -436,6 +497,17 @@ namespace kealib{
          * @throws KEAIOException
          */
         uint32_t getOverviewBlockSize(uint32_t band, uint32_t overview);
+        /**
+         * Get the X and Y block sizes used for an overview. Overviews have
+         * the same shape blocks as their band, limited to the overview size.
+         *
+         * @param band  1-based index of image band
+         * @param overview  0-based overview level
+         * @param blockXSize  set to the number of columns in a block
+         * @param blockYSize  set to the number of rows in a block
+         * @throws KEAIOException
+         */
+        void getOverviewBlockSize(uint32_t band, uint32_t overview, uint32_t *blockXSize, uint32_t *blockYSize);
         /**
          * Write data to an overview
          *
@@ -487,6 +559,76 @@ namespace kealib{
          * @throws KEAIOException
          */
         void getOverviewSize(uint32_t band, uint32_t overview, uint64_t *xSize, uint64_t *ySize);
+        
+        /**
+         * Start (or stop) recording the areas of a band written by writeImageBlock2Band().
+         *
+         * The areas, rounded out to whole blocks, are kept in the file so 
+         * updateOverviews() and updateStatistics() only need to recalculate what 
+         * has changed, even when the file is edited in a later session. The whole 
+         * band counts as changed when tracking starts. Not recorded for files opened 
+         * on an MPI communicator.
+         *
+         * @param band  1-based index of the band
+         * @param track Whether to record the areas written. false discards any recorded.
+         * @throws KEAIOException
+         */
+        void trackDirtyRegions(uint32_t band, bool track=true);
+        /**
+         * Whether the areas written to a band are being recorded (see trackDirtyRegions()).
+         *
+         * @param band  1-based index of the band
+         * @throws KEAIOException
+         */
+        bool isTrackingDirtyRegions(uint32_t band);
+        /**
+         * Recalculates the overviews of a band from the band's pixels.
+         *
+         * If the band is tracking dirty regions only the overview pixels covering areas
+         * written since the last call are recalculated, otherwise all of them are. 
+         * Pixels equal to the no data value are ignored by kea_resample_average.
+         *
+         * @param band       1-based index of the band
+         * @param resampling How each overview pixel is calculated.
+         * @throws KEAIOException
+         */
+        void updateOverviews(uint32_t band, KEAOverviewResampling resampling=kea_resample_nearest);
+        /**
+         * Calculates the minimum, maximum, mean and standard deviation of a band
+         * (ignoring the no data value) and writes them to the band's metadata as
+         * STATISTICS_MINIMUM etc.
+         *
+         * Totals for each block are kept in the file so if the band is tracking
+         * dirty regions only the blocks written since the last call are read.
+         *
+         * @param band  1-based index of the band
+         * @throws KEAIOException
+         */
+        void updateStatistics(uint32_t band);
+
+        /**
+         * Returns the counters of the pixel reads and writes (image data, masks and
+         * overviews) made through this object since it was created or the counters 
+         * were reset. All zero if the library was built without LIBKEA_WITH_IO_STATISTICS.
+         *
+         * @param band  1-based index of a band to only get that band's counters,
+         *              0 for all of them. Flushes are only counted for the whole object.
+         * @throws KEAIOException If the band is not present.
+         */
+        KEAIOStatistics getIOStatistics(uint32_t band=0);
+        /**
+         * Sets the counters of this object and all its bands back to zero.
+         */
+        void resetIOStatistics();
+        /**
+         * Like getIOStatistics() but totalled over every KEAImageIO in the process.
+         * The metadata cache hit rate is always -1.
+         */
+        static KEAIOStatistics getGlobalIOStatistics();
+        /**
+         * Sets the process wide counters back to zero.
+         */
+        static void resetGlobalIOStatistics();
 
         /**
          * Get the attribute table for an image band
@@ -526,6 +668,35 @@ namespace kealib{
          */
         void close();
 
+        /**
+         * Start SWMR writing so other processes can read the file while it is
+         * being written. The file must have been created with swmr=true. 
+         * Bands, overviews, masks, metadata and attribute tables can't be 
+         * added after this, only written to.
+         * @throws KEAIOException
+         */
+        void startSWMRWrite();
+
+        /**
+         * Pick up changes made by another process writing the file. For
+         * files opened with openKeaH5RDOnly(swmr=true). Re-reads the header
+         * (spatial info, bands etc) and drops what HDF5 has cached for each
+         * dataset so new chunks, overviews and metadata are seen.
+         * @throws KEAIOException
+         */
+        void refresh();
+
+        /**
+         * For files opened on an MPI communicator (see createKEAImage() and 
+         * openKeaH5RW()). By default each rank writes pixels independently, with 
+         * as many calls as it likes - but HDF5 can only do this to uncompressed 
+         * bands (deflate=0). If collective is true every rank must make the same 
+         * writeImageBlock2Band() etc calls (with an empty window if it has nothing 
+         * to write) and HDF5 combines them, which also works for compressed bands.
+         * @throws KEAIOException if kealib wasn't built against parallel HDF5
+         */
+        void setCollectiveIO(bool collective);
+
         /**
          * Adds a new image band to the KEA image file.
          *
@@ -538,11 +709,171 @@ namespace kealib{
          * @param imageBlockSize The block size used for storing the image data in the file.
          * @param attBlockSize The block size used for storing the attribute table data in the file.
          * @param deflate ThebandDescripIn compression level (0 for no compression, higher values for increasing compression).
+         * @param imageBlockYSize If not 0 the number of rows in each block, imageBlockSize 
+         *                        is then the number of columns (e.g. 1024 by 256 strips).
+         * @param growable If true the band can be resized by extendImage(). All bands
+         *                 must be growable for that to work.
          *
          * @throws KEAIOException If the image file is not open or issues occur during the band addition process.
          */
-        virtual void addImageBand(const KEADataType dataType, const std::string &bandDescrip, const uint32_t imageBlockSize = KEA_IMAGE_CHUNK_SIZE, const uint32_t attBlockSize = KEA_ATT_CHUNK_SIZE, const uint32_t deflate = KEA_DEFLATE);
+        virtual void addImageBand(const KEADataType dataType, const std::string &bandDescrip, const uint32_t imageBlockSize = KEA_IMAGE_CHUNK_SIZE, const uint32_t attBlockSize = KEA_ATT_CHUNK_SIZE, const uint32_t deflate = KEA_DEFLATE, const uint32_t imageBlockYSize = 0, const bool growable = false);
         
+        /**
+         * Adds several image bands at once.
+         *
+         * The same as calling addImageBand() for each band but the band count, consolidated
+         * header and band info are updated and the file flushed once at the end, so this is
+         * much quicker for images with hundreds of bands.
+         *
+         * @param numBands The number of bands to add.
+         * @param dataTypes Either one data type for all the new bands or one per band.
+         * @param bandDescrips Optional descriptions, one per band. Bands without one are called "Band N".
+         * @param imageBlockSize The block size used for storing the image data in the file.
+         * @param attBlockSize The block size used for storing the attribute table data in the file.
+         * @param deflate The compression level (0 for no compression, higher values for increasing compression).
+         * @param imageBlockYSize If not 0 the number of rows in each block (see addImageBand()).
+         * @param growable If true the bands can be resized by extendImage().
+         *
+         * @throws KEAIOException If the image file is not open, dataTypes is the wrong size or 
+         *                        the bands could not be added.
+         */
+        virtual void addImageBands(const uint32_t numBands, const std::vector<KEADataType> &dataTypes, const std::vector<std::string> *bandDescrips = nullptr, const uint32_t imageBlockSize = KEA_IMAGE_CHUNK_SIZE, const uint32_t attBlockSize = KEA_ATT_CHUNK_SIZE, const uint32_t deflate = KEA_DEFLATE, const uint32_t imageBlockYSize = 0, const bool growable = false);
+        
+        /**
+         * Copies a band from another KEA file (or this one) without decompressing it.
+         *
+         * The whole band is copied - image data, mask, overviews, no data, metadata, 
+         * description and attribute table - keeping the chunking, data type and compression
+         * of the source. Throughput is limited by the disk rather than by deflate.
+         *
+         * @param otherIO The (open) image to copy from. May be this object.
+         * @param srcBand The band in otherIO to copy. 1-based.
+         * @param dstBand The band to replace, or getNumOfImageBands() + 1 to append a new band.
+         *
+         * @throws KEAIOException If either image is not open, the bands are not valid or the 
+         *                        images are different sizes.
+         */
+        virtual void copyBandFrom(KEAImageIO &otherIO, uint32_t srcBand, uint32_t dstBand);
+        
+        /**
+         * Whether the image data of two bands has the same data type, size, chunking and 
+         * compression. If so the raw chunks are interchangeable and copyBandFrom() gives
+         * the same result as copying the pixels.
+         *
+         * @param otherIO The (open) image containing srcBand.
+         * @param srcBand The band in otherIO. 1-based.
+         * @param dstBand The band in this image. 1-based.
+         *
+         * @throws KEAIOException If either image is not open or the bands are not valid.
+         */
+        bool bandStorageMatches(KEAImageIO &otherIO, uint32_t srcBand, uint32_t dstBand);
+
+        /**
+         * Adds a consolidated header to the file (if it doesn't already have one).
+         *
+         * This is a single dataset holding the image size, spatial info and the 
+         * description, data type, layer type, usage and no data of every band. When
+         * present openKEAImageHeader() loads it in one read rather than reading each
+         * of the separate header and band datasets and the band getters don't go to
+         * the file. The separate datasets are still written so older versions of
+         * the library can read the file, but a file with a consolidated header must
+         * not be changed by them. Only a change to the number of bands is detected
+         * (the consolidated header is then ignored). Other changes, such as to the 
+         * spatial info, band descriptions or no data values, are not seen by this
+         * version, which will go on returning the values in the consolidated header.
+         *
+         * @throws KEAIOException If the image is not open or there is a problem writing it.
+         */
+        void createConsolidatedHeader();
+
+        /**
+         * Whether the file has a consolidated header (see createConsolidatedHeader()).
+         */
+        bool hasConsolidatedHeader();
+
+        /**
+         * Writes a compacted copy of the image to a new file.
+         *
+         * Removing bands and rewriting overviews and metadata leaves unused space in 
+         * the file which is never given back. This copies everything that is still in 
+         * use, without decompressing it, into dstPath. The header and dataset level 
+         * objects are written first, then the metadata etc for every band, then the
+         * image data of each band (mask and overviews following) with chunks in row
+         * major order. The free space settings of this file are kept. This image is 
+         * not changed.
+         *
+         * @param dstPath The file to create. Overwritten if it exists.
+         *
+         * @throws KEAIOException If the image is not open or there is a problem writing dstPath.
+         */
+        void repack(const std::string &dstPath);
+
+        /**
+         * Replaces the image data of a band with an HDF5 virtual dataset made up of
+         * regions of bands in other KEA files. Reads go straight to the source files
+         * through HDF5. Pixels not covered by a source read as the no data value if
+         * it has been set (set it first), otherwise 0. The mask, overviews, metadata 
+         * etc of the band are not changed.
+         *
+         * The sources must have the band's data type and can't be 1, 2 or 4 bit. They 
+         * are only opened when the band is read. Relative file names are looked for 
+         * in the directory of this file, then the current directory.
+         *
+         * @param band  1-based index of image band
+         * @param sources  the regions making up the band
+         * @throws KEAIOException if a region isn't within the band or there is a 
+         *                        problem creating the virtual dataset
+         */
+        void setVirtualImageBand(uint32_t band, const std::vector<KEAVirtualSource> &sources);
+
+        /**
+         * Whether the image data of a band is a virtual dataset 
+         * (see setVirtualImageBand()).
+         *
+         * @param band  1-based index of image band
+         * @throws KEAIOException
+         */
+        bool isImageBandVirtual(uint32_t band);
+
+        /**
+         * Creates a mosaic of KEA files where each band is a virtual dataset
+         * (see setVirtualImageBand()) so no pixels are copied.
+         *
+         * The inputs must all have the same number of bands, band data types, 
+         * resolution and projection, no rotation and be on the same pixel grid.
+         * The mosaic covers all of them. They shouldn't overlap as HDF5 doesn't 
+         * define which source is read where they do. Band descriptions, block sizes and no data values are taken from the 
+         * first input.
+         *
+         * @param fileName The mosaic file to create.
+         * @param inputs The KEA files to mosaic. They are stored relative to the 
+         *               mosaic's directory if they are within it, otherwise as 
+         *               absolute paths, so the mosaic can be opened from anywhere.
+         * @return A pointer to the mosaic file, open for writing like createKEAImage().
+         * @throws KEAIOException If an input can't be read or they don't match.
+         */
+        static HighFive::File* createMosaic(const std::string &fileName, const std::vector<std::string> &inputs);
+
+        /**
+         * Makes the image bigger. The image data and masks of every band are resized,
+         * only the chunks that are then written take up space. The new pixels read as 
+         * 0 (255 in a mask) until they are written. The image size and top left in the
+         * header are updated so existing pixels keep their coordinates. Overviews are
+         * recreated at the same scale to cover the new size and are empty until 
+         * rebuilt with updateOverviews().
+         *
+         * All bands must have been created growable (see createKEAImage() and 
+         * addImageBand()). Growing from the top left corner moves no data, other 
+         * anchors mean the existing data is rewritten further right and/or down.
+         *
+         * @param newXSize The new width, at least the current width.
+         * @param newYSize The new height, at least the current height.
+         * @param anchor The corner of the existing image that stays where it is.
+         * @throws KEAIOException If the image is not open, the size is smaller or a 
+         *                        band is not growable. 
+         */
+        void extendImage(uint64_t newXSize, uint64_t newYSize, KEAImageAnchor anchor=kea_anchor_topleft);
+
         /**
          * Removes an image band from the KEA image file at the specified band index.
          *
@@ -584,6 +915,29 @@ namespace kealib{
          * @param sieveBuf The size of the sieve buffer (in bytes).
          * @param metaBlockSize The size (in bytes) of blocks allocated for metadata.
          * @param deflate The compression level to use (0 = no compression, 9 = maximum compression).
+         * @param persistFreeSpace If true HDF5 keeps track of free space in the file between sessions
+         *                         so space given up by deleted or rewritten objects (e.g. overviews) 
+         *                         is reused. Files created like this need HDF5 1.10 or later to read.
+         * @param pageSize If non zero the file is created for reading from cloud storage. HDF5 paged 
+         *                 aggregation is used with this page size (1048576 is a good start) so the
+         *                 metadata is gathered into a few pages at the front of the file, newer
+         *                 (compact) group storage is used and chunks follow in the order they are 
+         *                 written. Files created like this need HDF5 1.10 or later to read.
+         * @param swmr If true the file is created so it can be written while other processes
+         *             read it (HDF5 SWMR). Create all the bands, overviews, metadata etc then
+         *             call KEAImageIO::startSWMRWrite() (or open it with openKeaH5RW(swmr=true)) 
+         *             as nothing can be added to the file once SWMR writing has started. 
+         *             Needs HDF5 1.10 or later to read.
+         * @param imageBlockYSize If not 0 the number of rows in each block, imageBlockSize 
+         *                        is then the number of columns. Square blocks are shrunk to 
+         *                        the smaller side of the image, rectangular ones to each side.
+         * @param growable If true the bands are created with unlimited dimensions so the 
+         *                 image can be made bigger with KEAImageIO::extendImage(). 
+         * @param comm Only when built against parallel HDF5. If not MPI_COMM_NULL the file is
+         *             opened with the MPI-IO driver on this communicator so every rank can write 
+         *             to it. Every rank must then make the same calls for anything other than
+         *             writing pixels (creating bands, metadata, close() etc). See setCollectiveIO().
+         * @param info MPI-IO hints for the MPI-IO driver.
          *
          * @return A pointer to the created HighFive::File object representing the KEA image file.
          *
@@ -591,7 +945,11 @@ namespace kealib{
          * @throws HighFive::Exception If there is a failure within the HighFive library while creating or modifying the file.
          * @throws std::exception For any other uncaught errors that occur during processing.
          */
-        static HighFive::File* createKEAImage(const std::string &fileName, KEADataType dataType, uint32_t xSize, uint32_t ySize, uint32_t numImgBands, std::vector<std::string> *bandDescrips=NULL, KEAImageSpatialInfo *spatialInfo=NULL, uint32_t imageBlockSize=KEA_IMAGE_CHUNK_SIZE, uint32_t attBlockSize=KEA_ATT_CHUNK_SIZE, int mdcElmts=KEA_MDC_NELMTS, hsize_t rdccNElmts=KEA_RDCC_NELMTS, hsize_t rdccNBytes=KEA_RDCC_NBYTES, double rdccW0=KEA_RDCC_W0, hsize_t sieveBuf=KEA_SIEVE_BUF, hsize_t metaBlockSize=KEA_META_BLOCKSIZE, uint32_t deflate=KEA_DEFLATE);
+        static HighFive::File* createKEAImage(const std::string &fileName, KEADataType dataType, uint64_t xSize, uint64_t ySize, uint32_t numImgBands, std::vector<std::string> *bandDescrips=NULL, KEAImageSpatialInfo *spatialInfo=NULL, uint32_t imageBlockSize=KEA_IMAGE_CHUNK_SIZE, uint32_t attBlockSize=KEA_ATT_CHUNK_SIZE, int mdcElmts=KEA_MDC_NELMTS, hsize_t rdccNElmts=KEA_RDCC_NELMTS, hsize_t rdccNBytes=KEA_RDCC_NBYTES, double rdccW0=KEA_RDCC_W0, hsize_t sieveBuf=KEA_SIEVE_BUF, hsize_t metaBlockSize=KEA_META_BLOCKSIZE, uint32_t deflate=KEA_DEFLATE, bool persistFreeSpace=false, hsize_t pageSize=KEA_PAGE_SIZE, bool swmr=false, uint32_t imageBlockYSize=0, bool growable=false
+#ifdef H5_HAVE_PARALLEL
+            , MPI_Comm comm=MPI_COMM_NULL, MPI_Info info=MPI_INFO_NULL
+#endif
+            );
         /**
          * Determines whether the specified file is a valid KEA image file.
          *
@@ -600,6 +958,9 @@ namespace kealib{
          * The file is validated as a KEA image if the file type dataset contains "KEA" and the version is
          * one of the supported versions (e.g., "1.0" or "1.1").
          *
+         * The HDF5 signature is checked first with a few small reads so files that aren't HDF5 are
+         * rejected without opening them with the HDF5 library.
+         *
          * @param fileName A string representing the path to the file being checked.
          *                 The file must be accessible and of HDF5 format.
          *
@@ -609,6 +970,18 @@ namespace kealib{
          *                        or a non-KEA related exception occurs.
          */
         static bool isKEAImage(const std::string &fileName);
+        /**
+         * Calls isKEAImage() for each of fileNames using a pool of threads.
+         *
+         * If HDF5 was not built thread safe only the check of the HDF5 signature 
+         * is done in parallel.
+         *
+         * @param fileNames The files to check.
+         * @param numThreads The number of threads to use. 0 means one per CPU.
+         *
+         * @return For each of fileNames whether it is a KEA image.
+         */
+        static std::vector<bool> identifyMany(const std::vector<std::string> &fileNames, unsigned int numThreads=0);
         /**
          * Opens a KEA HDF5 file for read-write access and returns a pointer to the file object.
          *
@@ -625,13 +998,25 @@ namespace kealib{
          * @param rdccW0 The write mode fraction for the raw data chunk cache.
          * @param sieveBuf The minimum size, in bytes, of the sieve buffer for data I/O.
          * @param metaBlockSize The size, in bytes, of the metadata aggregation block.
+         * @param swmr If true start SWMR writing once the file is open so other processes can read it
+         *             (with openKeaH5RDOnly(swmr=true)) while it is written. The file must have been
+         *             created with swmr=true and nothing can be added to it, only written to.
+         * @param comm Only when built against parallel HDF5. If not MPI_COMM_NULL the file is
+         *             opened with the MPI-IO driver on this communicator so every rank can write 
+         *             to it. Every rank must then make the same calls for anything other than
+         *             writing pixels (creating bands, metadata, close() etc). See setCollectiveIO().
+         * @param info MPI-IO hints for the MPI-IO driver.
          *
          * @return A pointer to the HighFive::File object representing the opened KEA file with read-write access.
          *
          * @throws KEAIOException If the file cannot be opened, does not exist, or any error occurs
          *                        during the file initialization or access configuration.
          */
-        static HighFive::File* openKeaH5RW(const std::string &fileName, int mdcElmts=KEA_MDC_NELMTS, hsize_t rdccNElmts=KEA_RDCC_NELMTS, hsize_t rdccNBytes=KEA_RDCC_NBYTES, double rdccW0=KEA_RDCC_W0, hsize_t sieveBuf=KEA_SIEVE_BUF, hsize_t metaBlockSize=KEA_META_BLOCKSIZE);
+        static HighFive::File* openKeaH5RW(const std::string &fileName, int mdcElmts=KEA_MDC_NELMTS, hsize_t rdccNElmts=KEA_RDCC_NELMTS, hsize_t rdccNBytes=KEA_RDCC_NBYTES, double rdccW0=KEA_RDCC_W0, hsize_t sieveBuf=KEA_SIEVE_BUF, hsize_t metaBlockSize=KEA_META_BLOCKSIZE, bool swmr=false
+#ifdef H5_HAVE_PARALLEL
+            , MPI_Comm comm=MPI_COMM_NULL, MPI_Info info=MPI_INFO_NULL
+#endif
+            );
         /**
          * Opens a KEA HDF5 image file in read-only mode and returns a pointer to the file object.
          *
@@ -649,6 +1034,19 @@ namespace kealib{
          * @param metaBlockSize Size of the metadata block allocation in bytes.
          * @param driver_id ID of HDF5 virtual filesystem driver
          * @param driver_info a pointer to be passed to the virtual filesystem driver
+         * @param pageBufferSize If non zero and the file was created with a page size (see createKEAImage)
+         *                       a page buffer of this many bytes is used so reads of metadata and 
+         *                       chunks are made a whole page at a time. Should be a multiple of the page 
+         *                       size. Ignored for other files.
+         * @param shared If true and the file is already open read-only from an earlier shared open 
+         *               a new handle on the same HDF5 file is returned, sharing its caches and file 
+         *               descriptor (the other parameters are then ignored). The file is closed once 
+         *               every handle is deleted (or closed by KEAImageIO::close()). Every KEAImageIO
+         *               opened on the handles shares one lock. Only read-only opens can be shared as
+         *               each KEAImageIO keeps its own copy of the header.
+         * @param swmr If true the file is opened for SWMR reading so it can be read while another
+         *             process writes it. Call KEAImageIO::refresh() to see newly written data. 
+         *             The page buffer is not used in this mode.
          *
          * @return A pointer to a HighFive::File object representing the opened KEA HDF5 image file.
          *         The file is opened in a read-only mode.
@@ -658,7 +1056,8 @@ namespace kealib{
          */
         static HighFive::File* openKeaH5RDOnly(const std::string &fileName, int mdcElmts=KEA_MDC_NELMTS, hsize_t rdccNElmts=KEA_RDCC_NELMTS, 
             hsize_t rdccNBytes=KEA_RDCC_NBYTES, double rdccW0=KEA_RDCC_W0, hsize_t sieveBuf=KEA_SIEVE_BUF, 
-            hsize_t metaBlockSize=KEA_META_BLOCKSIZE, hid_t driver_id=0, const void* driver_info=nullptr);
+            hsize_t metaBlockSize=KEA_META_BLOCKSIZE, hid_t driver_id=0, const void* driver_info=nullptr,
+            hsize_t pageBufferSize=KEA_PAGE_BUFFER_SIZE, bool shared=false, bool swmr=false);
         virtual ~KEAImageIO();
         
         /**
@@ -667,6 +1066,18 @@ namespace kealib{
          **/
         static HighFive::CompoundType createGCPCompType();
 
+        /**
+         * Helper method to get a HighFive::CompoundType for a row of the consolidated header
+         * @throws KEAIOException
+         **/
+        static HighFive::CompoundType createBandInfoCompType();
+
+        /**
+         * Helper method to get a HighFive::CompoundType for a row of the compact metadata
+         * @throws KEAIOException
+         **/
+        static HighFive::CompoundType createMetaDataCompType();
+
     protected:
         /********** STATIC PROTECTED **********/
         /**
@@ -740,10 +1151,12 @@ namespace kealib{
          * @param imageBlockSize The block size to use for chunking the image data. Adjusted if exceeding minimum dimension.
          * @param attBlockSize The block size to use for attribute table chunking.
          * @param deflate The compression level to use for deflating data (0-9, where higher values indicate stronger compression).
+         * @param imageBlockYSize If not 0 the number of rows in each block, imageBlockSize is then the number of columns.
+         * @param growable Whether to create the image data with unlimited dimensions.
          *
          * @throws KEAIOException If an error occurs while creating groups/datasets, writing attributes, or accessing metadata.
          */
-        static void addImageBandToFile(HighFive::File *keaImgH5File, const KEADataType dataType, const uint32_t xSize, const uint32_t ySize, const uint32_t bandIndex, const std::string &bandDescrip, const uint32_t imageBlockSize, const uint32_t attBlockSize, const uint32_t deflate);
+        static void addImageBandToFile(HighFive::File *keaImgH5File, const KEADataType dataType, const uint64_t xSize, const uint64_t ySize, const uint32_t bandIndex, const std::string &bandDescrip, const uint32_t imageBlockSize, const uint32_t attBlockSize, const uint32_t deflate, const uint32_t imageBlockYSize, const bool growable);
         
         /**
          * Removes a specified image band from the KEA image file and renames the remaining bands.
@@ -824,23 +1237,351 @@ namespace kealib{
           * @param xSizeBuf The horizontal size of the provided data buffer.
           * @param ySizeBuf The vertical size of the provided data buffer.
           * @param inDataType The data type of the input image data, specified using KEADataType.
+          * @param ismask Whether this is a mask band (only matters for bit packed datasets).
           *
           * @throws KEAIOException If there is a problem writing to the dataset
           */        
         void writeImageToDataset(HighFive::DataSet &dataset, 
             void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeOut,
-            uint64_t ySizeOut, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType);
+            uint64_t ySizeOut, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType,
+            bool ismask=false);
+
+        /**
+          * helper for extendImage() to resize an image or mask dataset
+          * and move the existing pixels right by xShift and down by yShift.
+          *
+          * @param dataset The dataset to resize. Must have unlimited dimensions.
+          * @param band 1-based index of the image band it belongs to
+          * @param dataType The band's data type (kea_8uint for a mask)
+          * @param oldXSize, oldYSize The size of the image before
+          * @param newXSize, newYSize The size of the image after
+          * @param xShift, yShift How far the existing pixels move
+          * @param ismask Whether this is a mask dataset
+          *
+          * @throws KEAIOException If there is a problem with the dataset
+          */
+        void extendImageDataset(HighFive::DataSet &dataset, uint32_t band, KEADataType dataType,
+            uint64_t oldXSize, uint64_t oldYSize, uint64_t newXSize, uint64_t newYSize,
+            uint64_t xShift, uint64_t yShift, bool ismask);
+
+        /**
+          * helper to set the parts of a buffer that are off the edge of the image
+          *
+          * Used by readImageFromDataset() when the buffer is larger than the window
+          * being read. The window is assumed to be in the top left of the buffer
+          * and only the pixels to the right of and below it are touched.
+          *
+          * @param data A pointer to the buffer
+          * @param pValue A pointer to the fill value, already in the buffer's data type
+          * @param pixelSize The size of each pixel in bytes
+          * @param xSizeIn The horizontal size of the window holding image data.
+          * @param ySizeIn The vertical size of the window holding image data.
+          * @param xSizeBuf The horizontal size of the buffer.
+          * @param ySizeBuf The vertical size of the buffer.
+          *
+          * @throws KEAIOException If the pixel size is not supported
+          */
+        static void fillImageEdges(void *data, const void *pValue, size_t pixelSize,
+            uint64_t xSizeIn, uint64_t ySizeIn, uint64_t xSizeBuf, uint64_t ySizeBuf);
+
+        /**
+          * helper to read part of an image from a bit packed HDF5 dataset
+          *
+          * Packed datasets have the NBITS and XSIZE attributes set. Pixels are
+          * stored most significant bits first along each row.
+          *
+          * @param dataset A reference to a HighFive::DataSet containing packed imagery
+          * @param data A pointer to the memory to read the data into
+          * @param xPxlOff The horizontal pixel offset in the image where the data block starts.
+          * @param yPxlOff The vertical pixel offset in the image where the data block starts.
+          * @param xSizeIn The horizontal size of the image data block to be read.
+          * @param ySizeIn The vertical size of the image data block to be read.
+          * @param xSizeBuf The horizontal size of the provided data buffer.
+          * @param ySizeBuf The vertical size of the provided data buffer.
+          * @param inDataType The data type of the buffer, specified using KEADataType.
+          * @param ismask If true a set bit is returned as 255.
+          * @param pFillValue Value (in inDataType) for the parts of the buffer off the edge of the image.
+          *
+          * @throws KEAIOException If there is a problem reading from the dataset
+          */
+        void readPackedImageFromDataset(const HighFive::DataSet &dataset, 
+            void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeIn,
+            uint64_t ySizeIn, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType,
+            bool ismask, const void *pFillValue);
+
+        /**
+          * helper to write part of an image to a bit packed HDF5 dataset
+          *
+          * Values too large for the number of bits are clamped. For a mask
+          * any non-zero value sets the bit.
+          *
+          * @param dataset A reference to a HighFive::DataSet containing packed imagery
+          * @param data A pointer to the memory containing the image data to be written.
+          * @param xPxlOff The horizontal pixel offset in the image where the data block starts.
+          * @param yPxlOff The vertical pixel offset in the image where the data block starts.
+          * @param xSizeOut The horizontal size of the output image data block to be written.
+          * @param ySizeOut The vertical size of the output image data block to be written.
+          * @param xSizeBuf The horizontal size of the provided data buffer.
+          * @param ySizeBuf The vertical size of the provided data buffer.
+          * @param inDataType The data type of the input image data, specified using KEADataType.
+          * @param ismask Whether this is a mask band.
+          *
+          * @throws KEAIOException If there is a problem writing to the dataset
+          */
+        void writePackedImageToDataset(HighFive::DataSet &dataset, 
+            void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeOut,
+            uint64_t ySizeOut, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType,
+            bool ismask);
+
+        /**
+          * unpack nBits (1, 2 or 4) wide pixels into one byte per pixel
+          *
+          * @param nBits number of bits per pixel
+          * @param pPacked the packed data
+          * @param firstPixel index of the first pixel to unpack relative to pPacked
+          * @param nPixels number of pixels to unpack
+          * @param pOut receives nPixels bytes
+          * @throws KEAIOException if nBits is not supported
+          */
+        static void unpackPixels(uint8_t nBits, const uint8_t *pPacked, uint64_t firstPixel, uint64_t nPixels, uint8_t *pOut);
+
+        /**
+          * pack one byte per pixel into nBits (1, 2 or 4) wide pixels. The 
+          * reverse of unpackPixels(). Other bits in pPacked are preserved.
+          *
+          * @throws KEAIOException if nBits is not supported
+          */
+        static void packPixels(uint8_t nBits, const uint8_t *pIn, uint64_t firstPixel, uint64_t nPixels, uint8_t *pPacked);
+
+        /**
+          * convert IEEE half floats (as stored for kea_16float) to float. Uses
+          * F16C or NEON when available.
+          *
+          * @param pIn n half floats
+          * @param pOut receives n floats
+          * @param n number of values
+          */
+        static void halfToFloat(const uint16_t *pIn, float *pOut, uint64_t n);
+
+        /**
+          * convert floats to IEEE half floats, rounding to nearest even. Values too 
+          * large for a half become infinity. Uses F16C or NEON when available.
+          *
+          * @param pIn n floats
+          * @param pOut receives n half floats
+          * @param n number of values
+          */
+        static void floatToHalf(const float *pIn, uint16_t *pOut, uint64_t n);
+
+        /**
+          * convert doubles to IEEE half floats, rounding to nearest even once 
+          * (going via float can round twice). Values too large for a half become infinity.
+          *
+          * @param pIn n doubles
+          * @param pOut receives n half floats
+          * @param n number of values
+          */
+        static void doubleToHalf(const double *pIn, uint16_t *pOut, uint64_t n);
+
+        /**
+          * get what the parts of a buffer off the edge of the image are set to.
+          * This is the no data value (or 0) for image data and 255 for masks.
+          *
+          * @param band 1-based index of the image band
+          * @param inDataType the type of the buffer
+          * @param ismask whether this is for the mask
+          * @param pFillValue receives the value. Must be at least KEA_MAX_PIXEL_SIZE bytes
+          */
+        void getEdgeFillValue(uint32_t band, KEADataType inDataType, bool ismask, void *pFillValue);
+
+        /**
+          * get the value (255) used for masks in the given type
+          */
+        static void getMaskFillValue(const HighFive::DataType &dataType, void *pFillValue);
+
+        /**
+          * helper for readImageBlock2BandWithMask(). Makes a single pass over the
+          * data either working out the mask from the no data or setting the pixels
+          * that are masked out to the no data.
+          *
+          * @throws KEAIOException if the data type is not recognised
+          */
+        static void applyMask(KEADataType dataType, void *data, uint8_t *pMask, uint64_t nPixels, 
+            const void *pNoData, bool maskFromNoData, bool substituteNoData);
+
+        /**
+          * helper to get the no data value for a band, caching it
+          *
+          * The first call for a band reads the no data from the file, later calls
+          * just convert the cached value. Does NOT lock the mutex - callers must
+          * (shared is enough, the cache has its own lock).
+          *
+          * @param band 1-based index of the image band
+          * @param data pointer that receives the no data
+          * @param inDataType data type to return the no data as
+          *
+          * @return false if the no data has not been defined for this band
+          */
+        bool getCachedNoDataValue(uint32_t band, void *data, KEADataType inDataType);
+
+        /**
+          * Loads the consolidated header. Does NOT lock the mutex - callers must.
+          *
+          * @return false if the consolidated header is missing something or is 
+          *         out of date with the file, in which case the separate datasets
+          *         should be read instead.
+          */
+        bool readConsolidatedHeader();
+
+        /**
+          * Writes the consolidated header from bandInfo, spatialInfoFile and the 
+          * no data cache. Does NOT lock the mutex - callers must.
+          */
+        void writeConsolidatedHeader();
+
+        /**
+          * Reloads bandInfo from the separate band datasets and writes the 
+          * consolidated header. Used when bands are added or removed. 
+          * Does NOT lock the mutex - callers must.
+          */
+        void rebuildConsolidatedHeader();
+
+        /**
+          * Reads all the metadata items of the image (basePath "") or a band 
+          * (basePath "/BANDn"), from the compact form and separate datasets.
+          * Does NOT lock the mutex - callers must.
+          */
+        std::vector< std::pair<std::string, std::string> > readMetaData(const std::string &basePath);
+
+        /**
+          * Reads one metadata item of the image or a band (see readMetaData()).
+          *
+          * @return false if there is no item called name.
+          */
+        bool readMetaDataItem(const std::string &basePath, const std::string &name, std::string *value);
+
+        /**
+          * Sets metadata items of the image or a band (see readMetaData()) in 
+          * the compact form if there is one, otherwise as separate datasets. 
+          * Doesn't flush. Does NOT lock the mutex - callers must.
+          */
+        void writeMetaData(const std::string &basePath, const std::vector< std::pair<std::string, std::string> > &data);
+
+        /**
+          * Replaces the compact metadata of the image or a band with items.
+          */
+        void writeMetaDataCompact(const std::string &basePath, const std::vector< std::pair<std::string, std::string> > &items);
+
+        /**
+          * Adds an area written to a band to its dirty regions if they are being tracked. 
+          * Call with the band's lock held exclusively.
+          */
+        void addDirtyRegion(uint32_t band, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSize, uint64_t ySize);
+
+        /**
+          * For when every pixel of a band may have changed (the image grown, the band 
+          * replaced). Discards the band's block statistics and adds the whole band to
+          * its dirty regions if they are being tracked. Call with the band's lock held exclusively.
+          */
+        void markBandChanged(uint32_t band);
+
+        /**
+          * Adds a pixel read or write of a window of the band's image data to the IO 
+          * statistics of this object, the band and the process. The chunks are 
+          * counted from the published band info so HDF5 isn't called. Nothing is 
+          * done without LIBKEA_WITH_IO_STATISTICS. Call with the band's lock held.
+          */
+        void countIO(uint32_t band, bool write, uint64_t xPxlOff, uint64_t yPxlOff, 
+            uint64_t xSize, uint64_t ySize, KEADataType inDataType, const KEAIOTimer &ioTimer, uint64_t lockNanos);
+        /**
+          * As above for a window of another dataset of the band (the mask or an 
+          * overview). Their chunks aren't published so are read from dataset.
+          */
+        void countIO(uint32_t band, bool write, const HighFive::DataSet &dataset, uint64_t xPxlOff, uint64_t yPxlOff, 
+            uint64_t xSize, uint64_t ySize, KEADataType inDataType, const KEAIOTimer &ioTimer, uint64_t lockNanos);
+#ifdef LIBKEA_WITH_IO_STATISTICS
+        /**
+          * What both countIO()s do once they know the chunks.
+          */
+        void addIOCounts(uint32_t band, bool write, const KEAImmutableBandInfo &chunkLayout, uint64_t xPxlOff, 
+            uint64_t yPxlOff, uint64_t xSize, uint64_t ySize, KEADataType inDataType, const KEAIOTimer &ioTimer, 
+            uint64_t lockNanos);
+#endif
+
+        /**
+          * Flushes the file, counting it in the IO statistics.
+          */
+        void flushFile();
+
+        /**
+          * Reads the data type, block size and chunks of a band from the file.
+          */
+        static KEAImmutableBandInfo readImmutableBandInfo(HighFive::File *keaImgH5File, uint32_t band);
+
+        /**
+          * Publishes the data type and block size of every band (from bandInfo 
+          * if there is a consolidated header, otherwise the file) for the getters
+          * that don't lock. Call with the lock held exclusively when the file is
+          * opened and whenever bands are added or removed.
+          */
+        void publishImmutableBandInfo();
+
+        /**
+          * The currently published band info. Needs no lock.
+          */
+        std::shared_ptr<const std::vector<KEAImmutableBandInfo> > getImmutableBandInfo();
+
+        /**
+          * The lock for operations on a single band (pixels, mask, overviews, 
+          * band metadata and the attribute table). Take m_mutex (at least 
+          * shared) first. Operations that change the file structure take 
+          * m_mutex exclusively, plus the lock of any band they replace or 
+          * remove as attribute tables only hold their band's lock. 
+          * If HDF5 isn't threadsafe this is just m_mutex.
+          */
+        std::shared_ptr<kea_mutex> getBandMutex(uint32_t band);
+
+        /**
+          * Makes bandMutexes (and the band IO statistics) match the number of 
+          * bands. Call with m_mutex held exclusively when the file is opened 
+          * and bands are added.
+          */
+        void updateBandMutexes();
+
+        /**
+          * Drops the files opened with shared=true that are no longer used
+          * anywhere else so they are closed.
+          */
+        static void releaseSharedKeaH5Files();
 
 
         
         //static std::string readString(H5::DataSet& dataset, H5::DataType strDataType);
         
         /********** PROTECTED MEMBERS **********/
-        bool fileOpen;
+        // atomic as the lock-free getters check it
+        std::atomic<bool> fileOpen;
         HighFive::File *keaImgFile;
         KEAImageSpatialInfo *spatialInfoFile;
         uint32_t numImgBands;
         std::string keaVersion;
+        std::map<uint32_t, KEANoDataCacheItem> noDataCache;
+        std::mutex noDataCacheMutex;
+        // replaced (never changed) so it can be read without the lock
+        std::shared_ptr<const std::vector<KEAImmutableBandInfo> > immutableBandInfo;
+        std::vector<std::shared_ptr<kea_mutex> > bandMutexes;
+#ifdef LIBKEA_WITH_IO_STATISTICS
+        KEAIOCounters ioCounters;
+        // pointers as atomics can't be moved
+        std::vector<std::unique_ptr<KEAIOCounters> > bandIOCounters;
+        static KEAIOCounters globalIOCounters;
+#endif
+        // file is open with the MPI-IO driver
+        bool parallelFile;
+        // used for writing pixels, set up for collective IO if requested
+        HighFive::DataTransferProps pixelXferProps;
+        bool consolidatedHeader;
+        std::vector<KEABandInfo> bandInfo;
     };
     
 }
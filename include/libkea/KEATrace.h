@@ -0,0 +1,144 @@
+/*
+ *  KEATrace.h
+ *  LibKEA
+ *
+ *  Copyright 2012 LibKEA. All rights reserved.
+ *
+ *  This file is part of LibKEA.
+ *
+ *  Permission is hereby granted, free of charge, to any person
+ *  obtaining a copy of this software and associated documentation
+ *  files (the "Software"), to deal in the Software without restriction,
+ *  including without limitation the rights to use, copy, modify,
+ *  merge, publish, distribute, sublicense, and/or sell copies of the
+ *  Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be
+ *  included in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ *  ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ *  WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef KEATrace_H
+#define KEATrace_H
+
+#include "libkea/kea_export.h"
+
+#include <string>
+#include <atomic>
+
+#include <stdint.h>
+
+namespace kealib{
+
+    // Records when the library reads and writes pixels and attribute tables,
+    // waits for locks, flushes and opens and closes files on each thread, and
+    // writes them as a Chrome trace event JSON file that chrome://tracing and
+    // Perfetto (ui.perfetto.dev) can show.
+    //
+    // Started with KEATrace::start() or by setting the KEA_TRACE environment
+    // variable to the name of the file, which is then written by an atexit
+    // handler if stop() hasn't been called. Each thread records into its own
+    // buffer, with a lock that only start() and stop() contend for. A thread's events past the first million 
+    // are dropped and only counted (droppedEvents in the file).
+    class KEA_EXPORT KEATrace
+    {
+    public:
+        /**
+         * Starts recording, discarding anything recorded before.
+         * Other threads may be using the library.
+         *
+         * @param fileName The file stop() writes the trace to.
+         */
+        static void start(const std::string &fileName);
+        /**
+         * Stops recording and writes the trace. Other threads may be using 
+         * the library, events they finish after this are dropped.
+         *
+         * @throws KEAIOException if the file can't be written.
+         */
+        static void stop();
+        /**
+         * Whether recording. Cheap enough to call anywhere.
+         */
+        static bool isEnabled()
+        {
+            return s_enabled.load(std::memory_order_relaxed);
+        }
+        /**
+         * Microseconds since recording started.
+         */
+        static double now();
+        /**
+         * Records a complete event on the calling thread. args is a (possibly
+         * empty) list of JSON members, e.g. "band":1,"xoff":0
+         */
+        static void addEvent(const char *name, const char *category, double start, double duration,
+            const std::string &args);
+    private:
+        static std::atomic<bool> s_enabled;
+    };
+
+    // An event from when this is created until it is destroyed or end()
+    // is called. Does nothing unless KEATrace is recording. name and
+    // category must be string literals as only the pointer is kept.
+    class KEA_EXPORT KEATraceScope
+    {
+    public:
+        KEATraceScope(const char *name, const char *category="kealib") :
+            m_name(KEATrace::isEnabled() ? name : nullptr), m_category(category), m_start(0)
+        {
+            if( m_name != nullptr )
+            {
+                m_start = KEATrace::now();
+            }
+        }
+        ~KEATraceScope()
+        {
+            end();
+        }
+        KEATraceScope(const KEATraceScope&) = delete;
+        KEATraceScope& operator=(const KEATraceScope&) = delete;
+
+        void addArg(const char *name, uint64_t value)
+        {
+            if( m_name != nullptr )
+            {
+                appendArg(name, value);
+            }
+        }
+        void addArg(const char *name, const std::string &value)
+        {
+            if( m_name != nullptr )
+            {
+                appendArg(name, value);
+            }
+        }
+        void end()
+        {
+            if( m_name != nullptr )
+            {
+                KEATrace::addEvent(m_name, m_category, m_start, KEATrace::now() - m_start, m_args);
+                m_name = nullptr;
+            }
+        }
+    private:
+        void appendArg(const char *name, uint64_t value);
+        void appendArg(const char *name, const std::string &value);
+
+        const char *m_name;     // nullptr when not recording
+        const char *m_category;
+        double m_start;
+        std::string m_args;
+    };
+}
+
+#endif
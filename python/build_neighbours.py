@@ -44,7 +44,11 @@ KEA_TO_NUMPY = {extrat.KEADataType.t8int: numpy.int8,
     extrat.KEADataType.t32uint: numpy.uint32,
     extrat.KEADataType.t64uint: numpy.uint64,
     extrat.KEADataType.t32float: numpy.float32,
-    extrat.KEADataType.t64float: float}
+    extrat.KEADataType.t64float: float,
+    extrat.KEADataType.t1uint: numpy.uint8,
+    extrat.KEADataType.t2uint: numpy.uint8,
+    extrat.KEADataType.t4uint: numpy.uint8,
+    extrat.KEADataType.t16float: numpy.float32}
 
 def getCmdargs():
     """     
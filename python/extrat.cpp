@@ -852,6 +852,22 @@ pybind11::object getImageBlock(pybind11::object &dataset, uint32_t nBand,
             pImageIO->readImageBlock2Band(nBand, buf.ptr, col, row, xsize, ysize, xsize, ysize, dtype);
             return result;
         }
+        else if( (dtype == kealib::kea_1uint) || (dtype == kealib::kea_2uint) || (dtype == kealib::kea_4uint) )
+        {
+            // bit packed bands come back one pixel per byte
+            auto result = pybind11::array_t<uint8_t>({ysize, xsize});
+            pybind11::buffer_info buf = result.request();
+            pImageIO->readImageBlock2Band(nBand, buf.ptr, col, row, xsize, ysize, xsize, ysize, kealib::kea_8uint);
+            return result;
+        }
+        else if( dtype == kealib::kea_16float)
+        {
+            // half floats are widened to float32
+            auto result = pybind11::array_t<float>({ysize, xsize});
+            pybind11::buffer_info buf = result.request();
+            pImageIO->readImageBlock2Band(nBand, buf.ptr, col, row, xsize, ysize, xsize, ysize, kealib::kea_32float);
+            return result;
+        }
         else
         {
             throw PyKeaLibException("Unsupported data type");
@@ -1409,6 +1425,10 @@ PYBIND11_MODULE(extrat, m) {
         .value("t64uint", kealib::kea_64uint)
         .value("t32float", kealib::kea_32float)
         .value("t64float", kealib::kea_64float)
+        .value("t1uint", kealib::kea_1uint)
+        .value("t2uint", kealib::kea_2uint)
+        .value("t4uint", kealib::kea_4uint)
+        .value("t16float", kealib::kea_16float)
         .export_values();
         
     pybind11::class_<kealib::KEAImageSpatialInfo>(m, "KEAImageSpatialInfo")
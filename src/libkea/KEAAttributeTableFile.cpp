@@ -29,6 +29,7 @@
  */
 
 #include "libkea/KEAAttributeTableFile.h"
+#include "libkea/KEATrace.h"
 #include <stdlib.h>
 #include <string.h>
 #include <algorithm>
@@ -164,7 +165,11 @@ namespace kealib{
     // RFC40
     void KEAAttributeTableFile::getBoolFields(size_t startfid, size_t len, size_t colIdx, bool *pbBuffer) const
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        KEATraceScope trace("getBoolFields", "rat");
+        trace.addArg("startfid", startfid);
+        trace.addArg("len", len);
+        trace.addArg("col", colIdx);
+        kealib::kea_read_lock lock(*this->m_mutex); 
         KEAStackPrintState printState;
 
         if((startfid+len) > numRows)
@@ -214,7 +219,11 @@ namespace kealib{
     
     void KEAAttributeTableFile::getIntFields(size_t startfid, size_t len, size_t colIdx, int64_t *pnBuffer) const
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        KEATraceScope trace("getIntFields", "rat");
+        trace.addArg("startfid", startfid);
+        trace.addArg("len", len);
+        trace.addArg("col", colIdx);
+        kealib::kea_read_lock lock(*this->m_mutex); 
         KEAStackPrintState printState;
         if((startfid+len) > numRows)
         {
@@ -257,7 +266,11 @@ namespace kealib{
     
     void KEAAttributeTableFile::getFloatFields(size_t startfid, size_t len, size_t colIdx, double *pfBuffer) const
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        KEATraceScope trace("getFloatFields", "rat");
+        trace.addArg("startfid", startfid);
+        trace.addArg("len", len);
+        trace.addArg("col", colIdx);
+        kealib::kea_read_lock lock(*this->m_mutex); 
         KEAStackPrintState printState;
         if((startfid+len) > numRows)
         {
@@ -300,7 +313,11 @@ namespace kealib{
     
     void KEAAttributeTableFile::getStringFields(size_t startfid, size_t len, size_t colIdx, std::vector<std::string> *psBuffer) const
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        KEATraceScope trace("getStringFields", "rat");
+        trace.addArg("startfid", startfid);
+        trace.addArg("len", len);
+        trace.addArg("col", colIdx);
+        kealib::kea_read_lock lock(*this->m_mutex); 
         KEAStackPrintState printState;
         if((startfid+len) > numRows)
         {
@@ -355,7 +372,7 @@ namespace kealib{
     {
         try
         {
-            kealib::kea_lock lock(*this->m_mutex); 
+            kealib::kea_read_lock lock(*this->m_mutex); 
             KEAStackPrintState printState;
             
             auto neighboursDataset = keaImg->getDataSet(bandPathBase + KEA_ATT_NEIGHBOURS_DATA);
@@ -451,6 +468,10 @@ namespace kealib{
     // RFC40
     void KEAAttributeTableFile::setBoolFields(size_t startfid, size_t len, size_t colIdx, bool *pbBuffer)
     {
+        KEATraceScope trace("setBoolFields", "rat");
+        trace.addArg("startfid", startfid);
+        trace.addArg("len", len);
+        trace.addArg("col", colIdx);
         kealib::kea_lock lock(*this->m_mutex); 
         KEAStackPrintState printState;
         if((startfid+len) > numRows)
@@ -501,6 +522,10 @@ namespace kealib{
     
     void KEAAttributeTableFile::setIntFields(size_t startfid, size_t len, size_t colIdx, int64_t *pnBuffer)
     {
+        KEATraceScope trace("setIntFields", "rat");
+        trace.addArg("startfid", startfid);
+        trace.addArg("len", len);
+        trace.addArg("col", colIdx);
         kealib::kea_lock lock(*this->m_mutex); 
         KEAStackPrintState printState;
         if((startfid+len) > numRows)
@@ -544,6 +569,10 @@ namespace kealib{
     
     void KEAAttributeTableFile::setFloatFields(size_t startfid, size_t len, size_t colIdx, double *pfBuffer)
     {
+        KEATraceScope trace("setFloatFields", "rat");
+        trace.addArg("startfid", startfid);
+        trace.addArg("len", len);
+        trace.addArg("col", colIdx);
         kealib::kea_lock lock(*this->m_mutex); 
         KEAStackPrintState printState;
         if((startfid+len) > numRows)
@@ -588,6 +617,10 @@ namespace kealib{
     
     void KEAAttributeTableFile::setStringFields(size_t startfid, size_t len, size_t colIdx, std::vector<std::string> *papszStrList)
     {
+        KEATraceScope trace("setStringFields", "rat");
+        trace.addArg("startfid", startfid);
+        trace.addArg("len", len);
+        trace.addArg("col", colIdx);
         kealib::kea_lock lock(*this->m_mutex); 
         KEAStackPrintState printState;
         if((startfid+len) > numRows)
@@ -56,7 +56,7 @@ namespace kealib{
     
     bool KEAAttributeTableInMem::getBoolField(size_t fid, size_t colIdx) const
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex); 
         if(fid >= attRows->size())
         {
             std::string message = std::string("Requested feature (") + sizet2Str(fid) + std::string(") is not within the table.");
@@ -74,7 +74,7 @@ namespace kealib{
     
     int64_t KEAAttributeTableInMem::getIntField(size_t fid, size_t colIdx) const
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex); 
         if(fid >= attRows->size())
         {
             std::string message = std::string("Requested feature (") + sizet2Str(fid) + std::string(") is not within the table.");
@@ -92,7 +92,7 @@ namespace kealib{
     
     double KEAAttributeTableInMem::getFloatField(size_t fid, size_t colIdx) const
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex); 
         if(fid >= attRows->size())
         {
             std::string message = std::string("Requested feature (") + sizet2Str(fid) + std::string(") is not within the table.");
@@ -110,7 +110,7 @@ namespace kealib{
     
     std::string KEAAttributeTableInMem::getStringField(size_t fid, size_t colIdx) const
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex); 
         if(fid >= attRows->size())
         {
             std::string message = std::string("Requested feature (") + sizet2Str(fid) + std::string(") is not within the table.");
@@ -129,7 +129,7 @@ namespace kealib{
     // RFC40
     void KEAAttributeTableInMem::getBoolFields(size_t startfid, size_t len, size_t colIdx, bool *pbBuffer) const
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex); 
         if((startfid+len) > attRows->size())
         {
             std::string message = std::string("Requested feature (") + sizet2Str(startfid+len) + std::string(") is not within the table.");
@@ -150,7 +150,7 @@ namespace kealib{
 
     void KEAAttributeTableInMem::getIntFields(size_t startfid, size_t len, size_t colIdx, int64_t *pnBuffer) const
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex); 
         if((startfid+len) > attRows->size())
         {
             std::string message = std::string("Requested feature (") + sizet2Str(startfid+len) + std::string(") is not within the table.");
@@ -171,7 +171,7 @@ namespace kealib{
 
     void KEAAttributeTableInMem::getFloatFields(size_t startfid, size_t len, size_t colIdx, double *pfBuffer) const
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex); 
         if((startfid+len) > attRows->size())
         {
             std::string message = std::string("Requested feature (") + sizet2Str(startfid+len) + std::string(") is not within the table.");
@@ -192,7 +192,7 @@ namespace kealib{
 
     void KEAAttributeTableInMem::getStringFields(size_t startfid, size_t len, size_t colIdx, std::vector<std::string> *psBuffer) const
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex); 
         if((startfid+len) > attRows->size())
         {
             std::string message = std::string("Requested feature (") + sizet2Str(startfid+len) + std::string(") is not within the table.");
@@ -419,7 +419,7 @@ namespace kealib{
     
     KEAATTFeature* KEAAttributeTableInMem::getFeature(size_t fid) const
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex); 
         if(fid >= attRows->size())
         {
             std::string message = std::string("Requested feature (") + sizet2Str(fid) + std::string(") is not within the table.");
@@ -431,7 +431,7 @@ namespace kealib{
         
     size_t KEAAttributeTableInMem::getSize() const
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex); 
         return attRows->size();
     }
     
@@ -29,28 +29,143 @@
  */
 
 #include "libkea/KEAImageIO.h"
+#include "libkea/KEATrace.h"
 
 #include <string.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <thread>
+#include <atomic>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    #include <immintrin.h>
+    #include <cpuid.h>
+#elif defined(__aarch64__)
+    #include <arm_neon.h>
+#endif
 
 HIGHFIVE_REGISTER_TYPE(kealib::KEAImageGCP_HDF5, kealib::KEAImageIO::createGCPCompType)
+HIGHFIVE_REGISTER_TYPE(kealib::KEABandInfo_HDF5, kealib::KEAImageIO::createBandInfoCompType)
+HIGHFIVE_REGISTER_TYPE(kealib::KEAMetaDataItem_HDF5, kealib::KEAImageIO::createMetaDataCompType)
 
 namespace kealib{
 
+    // A file opened with shared=true. file is a copy of the HighFive::File so
+    // holds a reference to the HDF5 file - the entry is dropped once nothing
+    // else does. Every KEAImageIO on the file uses mutex as its lock so they
+    // don't call HDF5 on it at the same time.
+    struct KEASharedKeaH5File
+    {
+        HighFive::File file;
+        std::shared_ptr<kea_mutex> mutex;
+    };
+
+    // Keyed on the canonical path and mode.
+    static std::mutex sharedKeaH5FilesMutex;
+    static std::map<std::string, KEASharedKeaH5File> &getSharedKeaH5Files()
+    {
+        // never deleted - HDF5 may already have shut down when statics are destroyed
+        static std::map<std::string, KEASharedKeaH5File> *pFiles = new std::map<std::string, KEASharedKeaH5File>();
+        return *pFiles;
+    }
+
+    // the absolute path of fileName, or fileName if it can't be found
+    static std::string getAbsolutePath(const std::string &fileName)
+    {
+#ifdef _WIN32
+        char *pszPath = _fullpath(nullptr, fileName.c_str(), 0);
+#else
+        char *pszPath = realpath(fileName.c_str(), nullptr);
+#endif
+        std::string path = (pszPath != nullptr) ? pszPath : fileName;
+        free(pszPath);
+        return path;
+    }
+
+    static std::string getSharedKeaH5Key(const std::string &fileName, const std::string &mode)
+    {
+        return getAbsolutePath(fileName) + "|" + mode;
+    }
+
+    // returns a new handle on the shared file for key, or nullptr
+    // if there isn't one. Call with sharedKeaH5FilesMutex held.
+    static HighFive::File *findSharedKeaH5File(const std::string &key)
+    {
+        auto itr = getSharedKeaH5Files().find(key);
+        if( itr == getSharedKeaH5Files().end() )
+        {
+            return nullptr;
+        }
+        if( H5Iget_ref(itr->second.file.getId()) <= 1 )
+        {
+            // everyone else has finished with it
+            getSharedKeaH5Files().erase(itr);
+            return nullptr;
+        }
+        return new HighFive::File(itr->second.file);
+    }
+
+    // the lock of the shared file with this id, or nullptr if it isn't shared
+    static std::shared_ptr<kea_mutex> findSharedKeaH5Mutex(hid_t fileId)
+    {
+        std::lock_guard<std::mutex> lock(sharedKeaH5FilesMutex);
+        for( auto &entry : getSharedKeaH5Files() )
+        {
+            if( entry.second.file.getId() == fileId )
+            {
+                return entry.second.mutex;
+            }
+        }
+        return nullptr;
+    }
+
     KEAImageIO::KEAImageIO()
     {
         this->fileOpen = false;
+        this->consolidatedHeader = false;
+        this->parallelFile = false;
     }
 
     void KEAImageIO::openKEAImageHeader(HighFive::File *keaImgH5File)
     {
+        KEATraceScope trace("openKEAImageHeader");
         KEAStackPrintState printState;
         try 
         {
+            // everything using a shared file takes the same lock
+            std::shared_ptr<kea_mutex> sharedMutex = findSharedKeaH5Mutex(keaImgH5File->getId());
+            if( sharedMutex )
+            {
+                this->m_mutex = sharedMutex;
+            }
             kealib::kea_lock lock(*this->m_mutex); 
 
             this->keaImgFile = keaImgH5File;
             this->spatialInfoFile = new KEAImageSpatialInfo();
+            this->parallelFile = false;
+            this->pixelXferProps = HighFive::DataTransferProps();
+#ifdef H5_HAVE_PARALLEL
+            hid_t faplId = H5Fget_access_plist(keaImgH5File->getId());
+            if( faplId >= 0 )
+            {
+                this->parallelFile = (H5Pget_driver(faplId) == H5FD_MPIO);
+                H5Pclose(faplId);
+            }
+#endif
+            this->consolidatedHeader = false;
+            this->bandInfo.clear();
+            this->noDataCache.clear();
+
+            // everything in one read if we can
+            if( keaImgH5File->exist(KEA_DATASETNAME_HEADER_CONSOLIDATED) && this->readConsolidatedHeader() )
+            {
+                this->publishImmutableBandInfo();
+                this->updateBandMutexes();
+                this->fileOpen = true;
+                return;
+            }
 
             // READ KEA File Type - Check it is a KEA file.
             std::string fileType = "";
@@ -161,6 +276,9 @@ namespace kealib{
             {
                 throw KEAIOException("The spatial reference (WKT String) was not specified.");
             }
+            
+            this->publishImmutableBandInfo();
+            this->updateBandMutexes();
             //std::cout << "WKT: " << this->spatialInfoFile->wktString << std::endl;
         }
         catch ( const KEAIOException &e)
@@ -179,10 +297,88 @@ namespace kealib{
         this->fileOpen = true;
     }
 
+    // HDF5 only has a half float type from 1.14.4 so for older versions
+    // make one the same way h5py does. Either way it is IEEE half, little endian.
+    class KEAHalfFloatType : public HighFive::DataType
+    {
+    public:
+        KEAHalfFloatType()
+        {
+#ifdef H5T_IEEE_F16LE
+            _hid = H5Tcopy(H5T_IEEE_F16LE);
+#else
+            _hid = H5Tcopy(H5T_IEEE_F32LE);
+            if( (H5Tset_fields(_hid, 15, 10, 5, 0, 10) < 0) || (H5Tset_size(_hid, 2) < 0) ||
+                (H5Tset_ebias(_hid, 15) < 0) )
+            {
+                H5Eprint(H5E_DEFAULT, stderr);
+                throw KEAIOException("Error creating half float type");
+            }
+#endif
+        }
+    };
+    
+    // whether a dataset is stored as half float
+    static bool isHalfFloatType(const HighFive::DataType &dataType)
+    {
+        return (dataType.getClass() == HighFive::DataTypeClass::Float) && (dataType.getSize() == 2);
+    }
+    
     void KEAImageIO::writeImageToDataset(HighFive::DataSet &dataset, 
         void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeOut,
-        uint64_t ySizeOut, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType)
+        uint64_t ySizeOut, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType,
+        bool ismask)
     {
+        if( (xSizeOut == 0) || (ySizeOut == 0) )
+        {
+            // nothing to write, but with collective MPI IO every rank has
+            // to take part in the write
+            if( this->parallelFile )
+            {
+                auto fileSpace = dataset.getSpace();
+                auto memSpace = HighFive::DataSpace({1});
+                uint8_t dummy[16] = {0};
+                if( (H5Sselect_none(fileSpace.getId()) < 0) || (H5Sselect_none(memSpace.getId()) < 0) ||
+                    (H5Dwrite(dataset.getId(), dataset.getDataType().getId(), memSpace.getId(), 
+                        fileSpace.getId(), this->pixelXferProps.getId(), dummy) < 0) )
+                {
+                    H5Eprint(H5E_DEFAULT, stderr);
+                    throw KEAIOException("Error in H5Dwrite");
+                }
+            }
+            return;
+        }
+
+        if( dataset.hasAttribute(KEA_ATTRIBUTENAME_NBITS) )
+        {
+            // 1, 2 or 4 bit band or a packed mask
+            writePackedImageToDataset(dataset, data, xPxlOff, yPxlOff, xSizeOut,
+                ySizeOut, xSizeBuf, ySizeBuf, inDataType, ismask);
+            return;
+        }
+        
+        if( ((inDataType == kea_32float) || (inDataType == kea_64float)) && 
+                isHalfFloatType(dataset.getDataType()) )
+        {
+            // convert here which is much faster than letting HDF5 do it
+            std::vector<uint16_t> halfData(xSizeOut * ySizeOut);
+            for( uint64_t y = 0; y < ySizeOut; y++ )
+            {
+                if( inDataType == kea_32float )
+                {
+                    floatToHalf(static_cast<float*>(data) + (y * xSizeBuf), &halfData[y * xSizeOut], xSizeOut);
+                }
+                else
+                {
+                    // straight from double as going via float can round twice
+                    doubleToHalf(static_cast<double*>(data) + (y * xSizeBuf), &halfData[y * xSizeOut], xSizeOut);
+                }
+            }
+            writeImageToDataset(dataset, halfData.data(), xPxlOff, yPxlOff, xSizeOut,
+                ySizeOut, xSizeOut, ySizeOut, kea_16float, ismask);
+            return;
+        }
+        
         uint64_t endXPxl = xPxlOff + xSizeOut;
         uint64_t endYPxl = yPxlOff + ySizeOut;
         auto dims = dataset.getDimensions();
@@ -282,7 +478,7 @@ namespace kealib{
                 }
 				
 				// now do the actual write
-                if( H5Dwrite(dataset.getId(), imgBandDT.getId(), dataSpace.getId(), imgBandDataspace.getId(), H5P_DEFAULT, data) < 0 )
+                if( H5Dwrite(dataset.getId(), imgBandDT.getId(), dataSpace.getId(), imgBandDataspace.getId(), this->pixelXferProps.getId(), data) < 0 )
                 {
 					H5Eprint(H5E_DEFAULT, stderr);
 					throw KEAIOException("Error in H5Dwrite");
@@ -296,7 +492,8 @@ namespace kealib{
 				std::vector<size_t> bufSize = {static_cast<size_t>(ySizeBuf), static_cast<size_t>(xSizeBuf)};
 				dataset.select(startOffset, bufSize).write_raw(
 					data,
-					imgBandDT
+					imgBandDT,
+					this->pixelXferProps
 				);
 
 			}
@@ -311,7 +508,7 @@ namespace kealib{
             std::cout << "xPxlOff: " << xPxlOff << ", yPxlOff: " << yPxlOff <<
                     std::endl;*/
             // we are writing the whole image
-            dataset.write_raw(data, imgBandDT);
+            dataset.write_raw(data, imgBandDT, this->pixelXferProps);
         }
         
     }
@@ -322,13 +519,24 @@ namespace kealib{
         KEADataType inDataType
     )
     {
-        kealib::kea_lock lock(*this->m_mutex);
+        KEATraceScope trace("writeImageBlock2Band");
+        trace.addArg("band", band);
+        trace.addArg("xoff", xPxlOff);
+        trace.addArg("yoff", yPxlOff);
+        trace.addArg("xsize", xSizeOut);
+        trace.addArg("ysize", ySizeOut);
+        KEATraceScope lockTrace("lock wait");
+        KEAIOTimer lockTimer;
+        kealib::kea_read_lock lock(*this->m_mutex);
         KEAStackPrintState printState;
 
         if (!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
+        kealib::kea_lock bandLock(*this->getBandMutex(band));
+        uint64_t lockNanos = lockTimer.elapsed();
+        lockTrace.end();
 
         try
         {
@@ -349,10 +557,20 @@ namespace kealib{
             {
                 auto imgBandDataset = this->keaImgFile->getDataSet(imageBandPath);
                 
+                KEATraceScope ioTrace("HDF5 write", "hdf5");
+                KEAIOTimer ioTimer;
                 writeImageToDataset(imgBandDataset, data, xPxlOff, yPxlOff, xSizeOut,
                     ySizeOut, xSizeBuf, ySizeBuf, inDataType);
-                // Flushing the dataset
-                this->keaImgFile->flush();
+                this->countIO(band, true, xPxlOff, yPxlOff, xSizeOut, ySizeOut, 
+                    inDataType, ioTimer, lockNanos);
+                ioTrace.end();
+                this->addDirtyRegion(band, xPxlOff, yPxlOff, xSizeOut, ySizeOut);
+                // Flushing the dataset (not with MPI as a flush is collective
+                // and ranks may be writing different numbers of blocks)
+                if( !this->parallelFile )
+                {
+                    this->flushFile();
+                }
             }
             else
             {
@@ -373,11 +591,533 @@ namespace kealib{
         }
     }
     
+    // fill a run of pixels with a value of the same size. Written in terms of
+    // a plain integer type of the right width so the compiler can vectorise it
+    template <typename T>
+    static void fillPixelRun(void *pStart, const void *pValue, uint64_t nPixels)
+    {
+        T value;
+        memcpy(&value, pValue, sizeof(T));
+        std::fill_n(static_cast<T*>(pStart), nPixels, value);
+    }
+
+    template <typename T>
+    static void fillImageEdgesTyped(void *data, const void *pValue, uint64_t xSizeIn,
+        uint64_t ySizeIn, uint64_t xSizeBuf, uint64_t ySizeBuf)
+    {
+        T *pData = static_cast<T*>(data);
+        // right hand side of each row that has image data in it
+        if( xSizeBuf > xSizeIn )
+        {
+            for( uint64_t y = 0; y < ySizeIn; y++ )
+            {
+                fillPixelRun<T>(pData + (y * xSizeBuf) + xSizeIn, pValue, xSizeBuf - xSizeIn);
+            }
+        }
+        // whole rows below the image data - these are contiguous
+        if( ySizeBuf > ySizeIn )
+        {
+            fillPixelRun<T>(pData + (ySizeIn * xSizeBuf), pValue, (ySizeBuf - ySizeIn) * xSizeBuf);
+        }
+    }
+
+    void KEAImageIO::fillImageEdges(void *data, const void *pValue, size_t pixelSize,
+        uint64_t xSizeIn, uint64_t ySizeIn, uint64_t xSizeBuf, uint64_t ySizeBuf)
+    {
+        switch(pixelSize)
+        {
+            case 1:
+                fillImageEdgesTyped<uint8_t>(data, pValue, xSizeIn, ySizeIn, xSizeBuf, ySizeBuf);
+                break;
+            case 2:
+                fillImageEdgesTyped<uint16_t>(data, pValue, xSizeIn, ySizeIn, xSizeBuf, ySizeBuf);
+                break;
+            case 4:
+                fillImageEdgesTyped<uint32_t>(data, pValue, xSizeIn, ySizeIn, xSizeBuf, ySizeBuf);
+                break;
+            case 8:
+                fillImageEdgesTyped<uint64_t>(data, pValue, xSizeIn, ySizeIn, xSizeBuf, ySizeBuf);
+                break;
+            default:
+                throw KEAIOException("Unsupported pixel size when filling image edges.");
+        }
+    }
+
+    // unpack NBITS wide pixels (most significant bits first) into one byte per pixel.
+    // firstPixel is the index of the first pixel to unpack relative to pPacked.
+    template <int NBITS>
+    static void unpackPixelsTyped(const uint8_t *pPacked, uint64_t firstPixel, uint64_t nPixels, uint8_t *pOut)
+    {
+        const uint64_t perByte = 8 / NBITS;
+        const uint8_t valMask = (1 << NBITS) - 1;
+        uint64_t i = 0;
+        uint64_t pixel = firstPixel;
+        // up to the first byte boundary
+        for( ; (i < nPixels) && ((pixel % perByte) != 0); i++, pixel++ )
+        {
+            pOut[i] = (pPacked[pixel / perByte] >> (8 - NBITS - ((pixel % perByte) * NBITS))) & valMask;
+        }
+        // whole bytes - inner loop is unrolled as perByte is a constant
+        const uint8_t *pByte = pPacked + (pixel / perByte);
+        for( ; (i + perByte) <= nPixels; i += perByte, pixel += perByte, pByte++ )
+        {
+            const uint8_t b = *pByte;
+            for( uint64_t j = 0; j < perByte; j++ )
+            {
+                pOut[i + j] = (b >> (8 - NBITS - (j * NBITS))) & valMask;
+            }
+        }
+        // whatever is left
+        for( ; i < nPixels; i++, pixel++ )
+        {
+            pOut[i] = (pPacked[pixel / perByte] >> (8 - NBITS - ((pixel % perByte) * NBITS))) & valMask;
+        }
+    }
+    
+    // the reverse of unpackPixelsTyped. Bits in pPacked outside of the pixels
+    // being written are left alone.
+    template <int NBITS>
+    static void packPixelsTyped(const uint8_t *pIn, uint64_t firstPixel, uint64_t nPixels, uint8_t *pPacked)
+    {
+        const uint64_t perByte = 8 / NBITS;
+        const uint8_t valMask = (1 << NBITS) - 1;
+        uint64_t i = 0;
+        uint64_t pixel = firstPixel;
+        for( ; (i < nPixels) && ((pixel % perByte) != 0); i++, pixel++ )
+        {
+            const int shift = 8 - NBITS - ((pixel % perByte) * NBITS);
+            uint8_t &b = pPacked[pixel / perByte];
+            b = (b & ~(valMask << shift)) | ((pIn[i] & valMask) << shift);
+        }
+        uint8_t *pByte = pPacked + (pixel / perByte);
+        for( ; (i + perByte) <= nPixels; i += perByte, pixel += perByte, pByte++ )
+        {
+            uint8_t b = 0;
+            for( uint64_t j = 0; j < perByte; j++ )
+            {
+                b |= (pIn[i + j] & valMask) << (8 - NBITS - (j * NBITS));
+            }
+            *pByte = b;
+        }
+        for( ; i < nPixels; i++, pixel++ )
+        {
+            const int shift = 8 - NBITS - ((pixel % perByte) * NBITS);
+            uint8_t &b = pPacked[pixel / perByte];
+            b = (b & ~(valMask << shift)) | ((pIn[i] & valMask) << shift);
+        }
+    }
+    
+    void KEAImageIO::unpackPixels(uint8_t nBits, const uint8_t *pPacked, uint64_t firstPixel, uint64_t nPixels, uint8_t *pOut)
+    {
+        switch(nBits)
+        {
+            case 1:
+                unpackPixelsTyped<1>(pPacked, firstPixel, nPixels, pOut);
+                break;
+            case 2:
+                unpackPixelsTyped<2>(pPacked, firstPixel, nPixels, pOut);
+                break;
+            case 4:
+                unpackPixelsTyped<4>(pPacked, firstPixel, nPixels, pOut);
+                break;
+            default:
+                throw KEAIOException("Unsupported number of bits for a packed dataset.");
+        }
+    }
+    
+    void KEAImageIO::packPixels(uint8_t nBits, const uint8_t *pIn, uint64_t firstPixel, uint64_t nPixels, uint8_t *pPacked)
+    {
+        switch(nBits)
+        {
+            case 1:
+                packPixelsTyped<1>(pIn, firstPixel, nPixels, pPacked);
+                break;
+            case 2:
+                packPixelsTyped<2>(pIn, firstPixel, nPixels, pPacked);
+                break;
+            case 4:
+                packPixelsTyped<4>(pIn, firstPixel, nPixels, pPacked);
+                break;
+            default:
+                throw KEAIOException("Unsupported number of bits for a packed dataset.");
+        }
+    }
+    
+    // IEEE half <-> float conversion. The scalar versions round to nearest even
+    // and handle subnormals, infinities and NaN. Where the CPU has hardware 
+    // conversion (F16C on x86, always on AArch64) blocks of 8/4 are done at once.
+    static inline float halfToFloatScalar(uint16_t h)
+    {
+        uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+        uint32_t exponent = (h >> 10) & 0x1f;
+        uint32_t mantissa = h & 0x3ff;
+        uint32_t bits;
+        if( exponent == 0x1f )
+        {
+            // inf or NaN (quieted the same way the hardware does)
+            bits = sign | 0x7f800000 | (mantissa << 13) | (mantissa ? 0x400000 : 0);
+        }
+        else if( exponent != 0 )
+        {
+            bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+        }
+        else if( mantissa == 0 )
+        {
+            bits = sign;
+        }
+        else
+        {
+            // subnormal half is a normal float
+            exponent = 113;
+            while( (mantissa & 0x400) == 0 )
+            {
+                mantissa <<= 1;
+                exponent--;
+            }
+            bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+        }
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+    
+    static inline uint16_t floatToHalfScalar(float f)
+    {
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+        uint32_t absBits = bits & 0x7fffffff;
+        if( absBits >= 0x7f800000 )
+        {
+            // inf or NaN (keep NaN quiet)
+            return sign | 0x7c00 | ((absBits > 0x7f800000) ? (0x200 | ((absBits >> 13) & 0x3ff)) : 0);
+        }
+        if( absBits >= 0x477ff000 )
+        {
+            // rounds to more than the largest half
+            return sign | 0x7c00;
+        }
+        if( absBits < 0x38800000 )
+        {
+            // subnormal half (or zero)
+            if( absBits < 0x33000000 )
+            {
+                return sign;
+            }
+            uint32_t exponent = absBits >> 23;
+            uint32_t mantissa = (absBits & 0x7fffff) | 0x800000;
+            uint32_t shift = 126 - exponent;
+            uint32_t half = mantissa >> shift;
+            uint32_t rem = mantissa & ((1u << shift) - 1);
+            uint32_t halfway = 1u << (shift - 1);
+            if( (rem > halfway) || ((rem == halfway) && (half & 1)) )
+            {
+                half++;
+            }
+            return sign | static_cast<uint16_t>(half);
+        }
+        // normal. Round to nearest even on the 13 bits being dropped
+        uint32_t half = ((absBits - 0x38000000) >> 13);
+        uint32_t rem = absBits & 0x1fff;
+        if( (rem > 0x1000) || ((rem == 0x1000) && (half & 1)) )
+        {
+            half++;
+        }
+        return sign | static_cast<uint16_t>(half);
+    }
+
+    // same as floatToHalfScalar() but rounding the double directly
+    static inline uint16_t doubleToHalfScalar(double d)
+    {
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof(bits));
+        uint16_t sign = static_cast<uint16_t>((bits >> 48) & 0x8000);
+        uint64_t absBits = bits & 0x7fffffffffffffffULL;
+        if( absBits >= 0x7ff0000000000000ULL )
+        {
+            // inf or NaN (keep NaN quiet)
+            return sign | 0x7c00 | ((absBits > 0x7ff0000000000000ULL) ? (0x200 | ((absBits >> 42) & 0x3ff)) : 0);
+        }
+        if( absBits >= 0x40effe0000000000ULL )
+        {
+            // rounds to more than the largest half
+            return sign | 0x7c00;
+        }
+        if( absBits < 0x3f10000000000000ULL )
+        {
+            // subnormal half (or zero)
+            if( absBits < 0x3e60000000000000ULL )
+            {
+                return sign;
+            }
+            uint64_t exponent = absBits >> 52;
+            uint64_t mantissa = (absBits & 0xfffffffffffffULL) | 0x10000000000000ULL;
+            uint64_t shift = 1051 - exponent;
+            uint64_t half = mantissa >> shift;
+            uint64_t rem = mantissa & ((1ULL << shift) - 1);
+            uint64_t halfway = 1ULL << (shift - 1);
+            if( (rem > halfway) || ((rem == halfway) && (half & 1)) )
+            {
+                half++;
+            }
+            return sign | static_cast<uint16_t>(half);
+        }
+        // normal. Round to nearest even on the 42 bits being dropped
+        uint64_t half = ((absBits - 0x3f00000000000000ULL) >> 42);
+        uint64_t rem = absBits & 0x3ffffffffffULL;
+        if( (rem > 0x20000000000ULL) || ((rem == 0x20000000000ULL) && (half & 1)) )
+        {
+            half++;
+        }
+        return sign | static_cast<uint16_t>(half);
+    }
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    // 8 at a time using F16C
+    #if defined(__F16C__)
+        #define KEA_F16C_TARGET
+    #else
+        // build for it anyway but check the CPU at runtime
+        #define KEA_F16C_TARGET __attribute__((target("avx,f16c")))
+        #define KEA_F16C_RUNTIME_CHECK
+    #endif
+    
+    KEA_F16C_TARGET
+    static uint64_t halfToFloatF16C(const uint16_t *pIn, float *pOut, uint64_t n)
+    {
+        uint64_t i = 0;
+        for( ; (i + 8) <= n; i += 8 )
+        {
+            __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pIn + i));
+            _mm256_storeu_ps(pOut + i, _mm256_cvtph_ps(h));
+        }
+        return i;
+    }
+    
+    KEA_F16C_TARGET
+    static uint64_t floatToHalfF16C(const float *pIn, uint16_t *pOut, uint64_t n)
+    {
+        uint64_t i = 0;
+        for( ; (i + 8) <= n; i += 8 )
+        {
+            __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(pIn + i), _MM_FROUND_TO_NEAREST_INT);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pOut + i), h);
+        }
+        return i;
+    }
+    
+    static bool haveF16C()
+    {
+    #ifdef KEA_F16C_RUNTIME_CHECK
+        // F16C is bit 29 of ecx. The AVX check includes the OS support for the registers
+        static const bool bHave = []() {
+            unsigned int eax, ebx, ecx, edx;
+            return __builtin_cpu_supports("avx") && __get_cpuid(1, &eax, &ebx, &ecx, &edx) && ((ecx & (1u << 29)) != 0);
+        }();
+        return bHave;
+    #else
+        return true;
+    #endif
+    }
+#endif
+
+    void KEAImageIO::halfToFloat(const uint16_t *pIn, float *pOut, uint64_t n)
+    {
+        uint64_t i = 0;
+#if defined(KEA_F16C_TARGET)
+        if( haveF16C() )
+        {
+            i = halfToFloatF16C(pIn, pOut, n);
+        }
+#elif defined(__aarch64__)
+        for( ; (i + 4) <= n; i += 4 )
+        {
+            vst1q_f32(pOut + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(pIn + i))));
+        }
+#endif
+        for( ; i < n; i++ )
+        {
+            pOut[i] = halfToFloatScalar(pIn[i]);
+        }
+    }
+    
+    void KEAImageIO::floatToHalf(const float *pIn, uint16_t *pOut, uint64_t n)
+    {
+        uint64_t i = 0;
+#if defined(KEA_F16C_TARGET)
+        if( haveF16C() )
+        {
+            i = floatToHalfF16C(pIn, pOut, n);
+        }
+#elif defined(__aarch64__)
+        for( ; (i + 4) <= n; i += 4 )
+        {
+            vst1_u16(pOut + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(pIn + i))));
+        }
+#endif
+        for( ; i < n; i++ )
+        {
+            pOut[i] = floatToHalfScalar(pIn[i]);
+        }
+    }
+    
+    void KEAImageIO::doubleToHalf(const double *pIn, uint16_t *pOut, uint64_t n)
+    {
+        for( uint64_t i = 0; i < n; i++ )
+        {
+            pOut[i] = doubleToHalfScalar(pIn[i]);
+        }
+    }
+
+    // one pass over a block of data that optionally works out the mask from the
+    // no data value and optionally replaces the masked out pixels with the no data
+    template <typename T>
+    static void applyMaskTyped(void *data, uint8_t *pMask, uint64_t nPixels, 
+        const void *pNoData, bool maskFromNoData, bool substituteNoData)
+    {
+        T *pData = static_cast<T*>(data);
+        T noData;
+        memcpy(&noData, pNoData, sizeof(T));
+        const bool noDataIsNaN = std::isnan(noData);
+        for( uint64_t i = 0; i < nPixels; i++ )
+        {
+            if( maskFromNoData )
+            {
+                const bool isNoData = (pData[i] == noData) || (noDataIsNaN && std::isnan(pData[i]));
+                pMask[i] = isNoData ? 0 : FILL_MASK_DATA;
+            }
+            else if( substituteNoData && (pMask[i] == 0) )
+            {
+                pData[i] = noData;
+            }
+        }
+    }
+    
+    void KEAImageIO::applyMask(KEADataType dataType, void *data, uint8_t *pMask, uint64_t nPixels, 
+        const void *pNoData, bool maskFromNoData, bool substituteNoData)
+    {
+        switch(dataType)
+        {
+            case kea_8int:
+                applyMaskTyped<int8_t>(data, pMask, nPixels, pNoData, maskFromNoData, substituteNoData);
+                break;
+            case kea_16int:
+                applyMaskTyped<int16_t>(data, pMask, nPixels, pNoData, maskFromNoData, substituteNoData);
+                break;
+            case kea_32int:
+                applyMaskTyped<int32_t>(data, pMask, nPixels, pNoData, maskFromNoData, substituteNoData);
+                break;
+            case kea_64int:
+                applyMaskTyped<int64_t>(data, pMask, nPixels, pNoData, maskFromNoData, substituteNoData);
+                break;
+            case kea_8uint:
+            case kea_1uint:
+            case kea_2uint:
+            case kea_4uint:
+                applyMaskTyped<uint8_t>(data, pMask, nPixels, pNoData, maskFromNoData, substituteNoData);
+                break;
+            case kea_16uint:
+                applyMaskTyped<uint16_t>(data, pMask, nPixels, pNoData, maskFromNoData, substituteNoData);
+                break;
+            case kea_32uint:
+                applyMaskTyped<uint32_t>(data, pMask, nPixels, pNoData, maskFromNoData, substituteNoData);
+                break;
+            case kea_64uint:
+                applyMaskTyped<uint64_t>(data, pMask, nPixels, pNoData, maskFromNoData, substituteNoData);
+                break;
+            case kea_32float:
+                applyMaskTyped<float>(data, pMask, nPixels, pNoData, maskFromNoData, substituteNoData);
+                break;
+            case kea_64float:
+                applyMaskTyped<double>(data, pMask, nPixels, pNoData, maskFromNoData, substituteNoData);
+                break;
+            case kea_16float:
+                // compares the bits. Fine apart from a NaN no data
+                applyMaskTyped<uint16_t>(data, pMask, nPixels, pNoData, maskFromNoData, substituteNoData);
+                break;
+            default:
+                throw KEAIOException("The specified data type was not recognised.");
+        }
+    }
+    
+    void KEAImageIO::getMaskFillValue(const HighFive::DataType &dataType, void *pFillValue)
+    {
+        // Fill with 255, converted to the requested type the way
+        // HDF5 would (ie 127 for kea_8int)
+        uint8_t convBuffer[KEA_MAX_PIXEL_SIZE];
+        memset(convBuffer, 0, sizeof(convBuffer));
+        int fill = FILL_MASK_DATA;
+        memcpy(convBuffer, &fill, sizeof(fill));
+        if( H5Tconvert(H5T_NATIVE_INT, dataType.getId(), 1, convBuffer, NULL, H5P_DEFAULT) < 0 )
+        {
+            H5Eprint(H5E_DEFAULT, stderr);
+            throw KEAIOException("Error in H5Tconvert");
+        }
+        memcpy(pFillValue, convBuffer, dataType.getSize());
+    }
+
+    void KEAImageIO::getEdgeFillValue(uint32_t band, KEADataType inDataType, bool ismask, void *pFillValue)
+    {
+        memset(pFillValue, 0, KEA_MAX_PIXEL_SIZE);
+        if(!ismask)
+        {
+            // Use the (cached) no data value. If no data isn't set for this band
+            // the fill stays 0 which is the default fill value for an image dataset
+            this->getCachedNoDataValue(band, pFillValue, inDataType);
+        }
+        else
+        {
+            // is a mask. Fill with 255
+            getMaskFillValue(convertDatatypeKeaToH5Native(inDataType), pFillValue);
+        }
+    }
+
     void KEAImageIO::readImageFromDataset(const HighFive::DataSet &dataset, 
         uint32_t band, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeIn,
         uint64_t ySizeIn, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType, 
         bool ismask)
     {
+        if( dataset.hasAttribute(KEA_ATTRIBUTENAME_NBITS) )
+        {
+            // 1, 2 or 4 bit band or a packed mask
+            uint8_t fillValue[KEA_MAX_PIXEL_SIZE];
+            this->getEdgeFillValue(band, inDataType, ismask, fillValue);
+            readPackedImageFromDataset(dataset, data, xPxlOff, yPxlOff, xSizeIn,
+                ySizeIn, xSizeBuf, ySizeBuf, inDataType, ismask, fillValue);
+            return;
+        }
+        
+        if( ((inDataType == kea_32float) || (inDataType == kea_64float)) && 
+                isHalfFloatType(dataset.getDataType()) )
+        {
+            // read the halves as they are and convert here which is much
+            // faster than letting HDF5 do it
+            std::vector<uint16_t> halfData(xSizeIn * ySizeIn);
+            readImageFromDataset(dataset, band, halfData.data(), xPxlOff, yPxlOff, xSizeIn,
+                ySizeIn, xSizeIn, ySizeIn, kea_16float, ismask);
+            std::vector<float> floatRow(xSizeIn);
+            for( uint64_t y = 0; y < ySizeIn; y++ )
+            {
+                if( inDataType == kea_32float )
+                {
+                    halfToFloat(&halfData[y * xSizeIn], static_cast<float*>(data) + (y * xSizeBuf), xSizeIn);
+                }
+                else
+                {
+                    halfToFloat(&halfData[y * xSizeIn], floatRow.data(), xSizeIn);
+                    std::copy(floatRow.begin(), floatRow.end(), static_cast<double*>(data) + (y * xSizeBuf));
+                }
+            }
+            if( (xSizeBuf != xSizeIn) || (ySizeBuf != ySizeIn) )
+            {
+                uint8_t fillValue[KEA_MAX_PIXEL_SIZE];
+                this->getEdgeFillValue(band, inDataType, ismask, fillValue);
+                fillImageEdges(data, fillValue, convertDatatypeKeaToH5Native(inDataType).getSize(),
+                    xSizeIn, ySizeIn, xSizeBuf, ySizeBuf);
+            }
+            return;
+        }
+        
         uint64_t endXPxl = xPxlOff + xSizeIn;
         uint64_t endYPxl = yPxlOff + ySizeIn;
         auto dims = dataset.getDimensions();
@@ -426,98 +1166,73 @@ namespace kealib{
                 // to the C API. This is a rough port of what happens in the old Kealib.
 				HighFive::DataSpace dataSpace = HighFive::DataSpace({static_cast<size_t>(ySizeBuf), static_cast<size_t>(xSizeBuf)});
 				
-				if(!ismask)
+				// Work out what the parts of the buffer that are off the edge of the
+				// image should be set to. Only these padding pixels are filled - the
+				// valid window is read straight into the buffer below.
+				uint8_t fillValue[KEA_MAX_PIXEL_SIZE];
+				this->getEdgeFillValue(band, inDataType, ismask, fillValue);
+				fillImageEdges(data, fillValue, imgBandDT.getSize(), xSizeIn, ySizeIn, xSizeBuf, ySizeBuf);
+					
+				if(xSizeBuf == xSizeIn)
+				{
+				    // only off the bottom edge so the image data is contiguous at the
+				    // start of the buffer and can be read directly
+				    std::vector<size_t> startOffset = {static_cast<size_t>(yPxlOff), static_cast<size_t>(xPxlOff)};
+				    std::vector<size_t> readSize = {static_cast<size_t>(ySizeIn), static_cast<size_t>(xSizeIn)};
+				    dataset.select(startOffset, readSize).read_raw(data, imgBandDT);
+				}
+				else
 				{
-    				// First, work out the ignore value (I don't think old kealib does this)
-    				void *pNoData = malloc(imgBandDT.getSize());
-    				try
+    				// So the main trick here is that you can "select" on a dataspace (the buffer)
+    				// with HDF5, but not HighFive (yet).
+    				// The below code selects the hyperslab on the dataspace
+    				hsize_t dataSelectMemDims[2]; // "count"
+    				dataSelectMemDims[0] = ySizeIn; // all the pixels in the y dimension 
+    				dataSelectMemDims[1] = 1;  // only 1 "element" in the "x" dimension - see dataSelectBlockSizeDims where the definition of a block is set
+
+    				hsize_t dataOffDims[2]; // start
+    				dataOffDims[0] = 0; // this is 0,0 because it is 
+    				dataOffDims[1] = 0;
+
+    				hsize_t dataSelectStrideDims[2];  // the stride.
+    				dataSelectStrideDims[0] = 1;      // 1 in the y dimension
+    				dataSelectStrideDims[1] = xSizeBuf - xSizeIn; // reading to the end of the image, so set the stride for
+    				                   // each write into the dataspace - just the number of pixels we are reading. The remainder
+    				                   // will stay the ignore
+
+    				hsize_t dataSelectBlockSizeDims[2]; // the definition of what a block is
+    				dataSelectBlockSizeDims[0] = 1;     // y dimension - 1 element
+    				dataSelectBlockSizeDims[1] = xSizeIn;  // x dimension - one block is one row of image data - see dataSelectMemDims above
+    				// now select the hyperslab for the dataspace
+    				if( H5Sselect_hyperslab(dataSpace.getId(), H5S_SELECT_SET, dataOffDims, 
+    				        dataSelectStrideDims, dataSelectMemDims, dataSelectBlockSizeDims) < 0 )
     				{
-    					this->getNoDataValue(band, pNoData, inDataType);
+    					H5Eprint(H5E_DEFAULT, stderr);
+    					throw KEAIOException("Error in H5Sselect_hyperslab 1");
     				}
-    				catch(const KEAIOException &e)
-    				{
-    				    // no nodata set
-    					free(pNoData);
-    					pNoData = NULL;  // H5Dfill defaults to 0 in this case which is the default fill value
-    					// for an image dataset
-    				}
-    				
-    				// fill the whole buffer with the no data value so parts that are not read in stay
-    				// set to this value.
-    				if( H5Dfill(pNoData, imgBandDT.getId(), data, imgBandDT.getId(), dataSpace.getId()) < 0 )
-    				{
+				
+    				// now set the hyperslab for the dataset 
+    				auto imgBandDataspace = dataset.getSpace();
+    				hsize_t dataOffset[2];  // the offset into the dataset
+                    dataOffset[0] = yPxlOff;
+                    dataOffset[1] = xPxlOff;
+                    hsize_t dataInDims[2];
+                    dataInDims[0] = ySizeIn;  // the size
+                    dataInDims[1] = xSizeIn;
+                    // set the hyperslab
+                    if( H5Sselect_hyperslab(imgBandDataspace.getId(), H5S_SELECT_SET, dataOffset, NULL, dataInDims, NULL) < 0 )
+                    {
     					H5Eprint(H5E_DEFAULT, stderr);
-    					throw KEAIOException("Error in H5Dfill");
-    				}
-    				free(pNoData);
-                }
-                else
-                {
-                    // is a mask. Fill with 255
-                    int fill = FILL_MASK_DATA;
-    				if( H5Dfill(&fill, H5T_NATIVE_INT, data, imgBandDT.getId(), dataSpace.getId()) < 0 )
-    				{
+    					throw KEAIOException("Error in H5Sselect_hyperslab 2");
+                    }
+				
+    				// now do the actual read
+                    if( H5Dread(dataset.getId(), imgBandDT.getId(), dataSpace.getId(), imgBandDataspace.getId(), H5P_DEFAULT, data) < 0 )
+                    {
     					H5Eprint(H5E_DEFAULT, stderr);
-    					throw KEAIOException("Error in H5Dfill");
-    				}
-                }
-					
-				// So the main trick here is that you can "select" on a dataspace (the buffer)
-				// with HDF5, but not HighFive (yet).
-				// The below code selects the hyperslab on the dataspace
-				hsize_t dataSelectMemDims[2]; // "count"
-				dataSelectMemDims[0] = ySizeIn; // all the pixels in the y dimension 
-				dataSelectMemDims[1] = 1;  // only 1 "element" in the "x" dimension - see dataSelectBlockSizeDims where the definition of a block is set
-
-				hsize_t dataOffDims[2]; // start
-				dataOffDims[0] = 0; // this is 0,0 because it is 
-				dataOffDims[1] = 0;
-
-				hsize_t dataSelectStrideDims[2];  // the stride.
-				dataSelectStrideDims[0] = 1;      // 1 in the y dimension
-				if(xSizeBuf == xSizeIn)
-				{
-					dataSelectStrideDims[1] = 1;  // we are reading all the way accross, so 1 in the x dimension
-				}
-				else
-				{
-					dataSelectStrideDims[1] = xSizeBuf - xSizeIn; // reading to the end of the image, so set the stride for
-					                   // each write into the dataspace - just the number of pixels we are reading. The remainder
-					                   // will stay the ignore
-				}
-
-				hsize_t dataSelectBlockSizeDims[2]; // the definition of what a block is
-				dataSelectBlockSizeDims[0] = 1;     // y dimension - 1 element
-				dataSelectBlockSizeDims[1] = xSizeIn;  // x dimension - one block is one row of image data - see dataSelectMemDims above
-				// now select the hyperslab for the dataspace
-				if( H5Sselect_hyperslab(dataSpace.getId(), H5S_SELECT_SET, dataOffDims, 
-				        dataSelectStrideDims, dataSelectMemDims, dataSelectBlockSizeDims) < 0 )
-				{
-					H5Eprint(H5E_DEFAULT, stderr);
-					throw KEAIOException("Error in H5Sselect_hyperslab 1");
+    					throw KEAIOException("Error in H5Dread");
+                    }
 				}
-				
-				// now set the hyperslab for the dataset 
-				auto imgBandDataspace = dataset.getSpace();
-				hsize_t dataOffset[2];  // the offset into the dataset
-                dataOffset[0] = yPxlOff;
-                dataOffset[1] = xPxlOff;
-                hsize_t dataInDims[2];
-                dataInDims[0] = ySizeIn;  // the size
-                dataInDims[1] = xSizeIn;
-                // set the hyperslab
-                if( H5Sselect_hyperslab(imgBandDataspace.getId(), H5S_SELECT_SET, dataOffset, NULL, dataInDims, NULL) < 0 )
-                {
-					H5Eprint(H5E_DEFAULT, stderr);
-					throw KEAIOException("Error in H5Sselect_hyperslab 2");
-                }
-				
-				// now do the actual read
-                if( H5Dread(dataset.getId(), imgBandDT.getId(), dataSpace.getId(), imgBandDataspace.getId(), H5P_DEFAULT, data) < 0 )
-                {
-					H5Eprint(H5E_DEFAULT, stderr);
-					throw KEAIOException("Error in H5Dread");
-                }
 			}
 			else
 			{
@@ -547,18 +1262,197 @@ namespace kealib{
         
     }
 
+    void KEAImageIO::readPackedImageFromDataset(const HighFive::DataSet &dataset, 
+        void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeIn,
+        uint64_t ySizeIn, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType,
+        bool ismask, const void *pFillValue)
+    {
+        uint8_t nBits = dataset.getAttribute(KEA_ATTRIBUTENAME_NBITS).read<uint8_t>();
+        uint64_t imgXSize = dataset.getAttribute(KEA_ATTRIBUTENAME_XSIZE).read<uint64_t>();
+        auto dims = dataset.getDimensions();
+
+        if (xPxlOff > imgXSize)
+        {
+            throw KEAIOException("Start X Pixel is not within image.");
+        }
+
+        if ((xPxlOff + xSizeIn) > imgXSize)
+        {
+            throw KEAIOException("End X Pixel is not within image.");
+        }
+
+        if (yPxlOff > dims[0])
+        {
+            throw KEAIOException("Start Y Pixel is not within image.");
+        }
+
+        if ((yPxlOff + ySizeIn) > dims[0])
+        {
+            throw KEAIOException("End Y Pixel is not within image.");
+        }
+        
+        auto imgBandDT = convertDatatypeKeaToH5Native(inDataType);
+        const size_t pixelSize = imgBandDT.getSize();
+        
+        if( (xSizeIn > 0) && (ySizeIn > 0) )
+        {
+            // read all the bytes that cover the window
+            uint64_t startByte = (xPxlOff * nBits) / 8;
+            uint64_t endByte = (((xPxlOff + xSizeIn) * nBits) + 7) / 8;
+            uint64_t nBytes = endByte - startByte;
+            std::vector<uint8_t> packed(nBytes * ySizeIn);
+            std::vector<size_t> startOffset = {static_cast<size_t>(yPxlOff), static_cast<size_t>(startByte)};
+            std::vector<size_t> readSize = {static_cast<size_t>(ySizeIn), static_cast<size_t>(nBytes)};
+            dataset.select(startOffset, readSize).read_raw(packed.data(), HighFive::AtomicType<uint8_t>());
+            
+            // unpack into one byte per pixel, leaving room to convert in place
+            uint64_t firstPixel = xPxlOff - ((startByte * 8) / nBits);
+            std::vector<uint8_t> unpacked(xSizeIn * ySizeIn * pixelSize);
+            for( uint64_t y = 0; y < ySizeIn; y++ )
+            {
+                unpackPixels(nBits, &packed[y * nBytes], firstPixel, xSizeIn, &unpacked[y * xSizeIn]);
+            }
+            if(ismask)
+            {
+                // a set bit means a valid pixel
+                for( uint64_t i = 0; i < (xSizeIn * ySizeIn); i++ )
+                {
+                    unpacked[i] = unpacked[i] ? FILL_MASK_DATA : 0;
+                }
+            }
+            
+            if( inDataType != kea_8uint )
+            {
+                if( H5Tconvert(H5T_NATIVE_UINT8, imgBandDT.getId(), xSizeIn * ySizeIn, unpacked.data(), NULL, H5P_DEFAULT) < 0 )
+                {
+                    H5Eprint(H5E_DEFAULT, stderr);
+                    throw KEAIOException("Error in H5Tconvert");
+                }
+            }
+            
+            // copy into the callers buffer
+            for( uint64_t y = 0; y < ySizeIn; y++ )
+            {
+                memcpy(static_cast<uint8_t*>(data) + (y * xSizeBuf * pixelSize), 
+                    &unpacked[y * xSizeIn * pixelSize], xSizeIn * pixelSize);
+            }
+        }
+        
+        if( (xSizeBuf != xSizeIn) || (ySizeBuf != ySizeIn) )
+        {
+            fillImageEdges(data, pFillValue, pixelSize, xSizeIn, ySizeIn, xSizeBuf, ySizeBuf);
+        }
+    }
+    
+    void KEAImageIO::writePackedImageToDataset(HighFive::DataSet &dataset, 
+        void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeOut,
+        uint64_t ySizeOut, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType,
+        bool ismask)
+    {
+        uint8_t nBits = dataset.getAttribute(KEA_ATTRIBUTENAME_NBITS).read<uint8_t>();
+        uint64_t imgXSize = dataset.getAttribute(KEA_ATTRIBUTENAME_XSIZE).read<uint64_t>();
+        auto dims = dataset.getDimensions();
+
+        if (xPxlOff > imgXSize)
+        {
+            throw KEAIOException("Start X Pixel is not within image.");
+        }
+
+        if ((xPxlOff + xSizeOut) > imgXSize)
+        {
+            throw KEAIOException("End X Pixel is not within image.");
+        }
+
+        if (yPxlOff > dims[0])
+        {
+            throw KEAIOException("Start Y Pixel is not within image.");
+        }
+
+        if ((yPxlOff + ySizeOut) > dims[0])
+        {
+            throw KEAIOException("End Y Pixel is not within image.");
+        }
+        
+        if( (xSizeOut == 0) || (ySizeOut == 0) )
+        {
+            return;
+        }
+        
+        auto imgBandDT = convertDatatypeKeaToH5Native(inDataType);
+        const size_t pixelSize = imgBandDT.getSize();
+        
+        // get the window as one byte per pixel
+        std::vector<uint8_t> unpacked(xSizeOut * ySizeOut * pixelSize);
+        for( uint64_t y = 0; y < ySizeOut; y++ )
+        {
+            memcpy(&unpacked[y * xSizeOut * pixelSize], 
+                static_cast<uint8_t*>(data) + (y * xSizeBuf * pixelSize), xSizeOut * pixelSize);
+        }
+        if( inDataType != kea_8uint )
+        {
+            if( H5Tconvert(imgBandDT.getId(), H5T_NATIVE_UINT8, xSizeOut * ySizeOut, unpacked.data(), NULL, H5P_DEFAULT) < 0 )
+            {
+                H5Eprint(H5E_DEFAULT, stderr);
+                throw KEAIOException("Error in H5Tconvert");
+            }
+        }
+        const uint8_t maxVal = (1 << nBits) - 1;
+        for( uint64_t i = 0; i < (xSizeOut * ySizeOut); i++ )
+        {
+            if( ismask )
+            {
+                // any non zero value is valid
+                unpacked[i] = unpacked[i] ? 1 : 0;
+            }
+            else if( unpacked[i] > maxVal )
+            {
+                unpacked[i] = maxVal;
+            }
+        }
+        
+        // the bytes covering the window. If the window doesn't start and end
+        // on a byte boundary the existing bits need to be preserved
+        uint64_t startByte = (xPxlOff * nBits) / 8;
+        uint64_t endByte = (((xPxlOff + xSizeOut) * nBits) + 7) / 8;
+        uint64_t nBytes = endByte - startByte;
+        uint64_t firstPixel = xPxlOff - ((startByte * 8) / nBits);
+        std::vector<uint8_t> packed(nBytes * ySizeOut);
+        std::vector<size_t> startOffset = {static_cast<size_t>(yPxlOff), static_cast<size_t>(startByte)};
+        std::vector<size_t> writeSize = {static_cast<size_t>(ySizeOut), static_cast<size_t>(nBytes)};
+        if( (firstPixel != 0) || ((((xPxlOff + xSizeOut) * nBits) % 8) != 0) )
+        {
+            dataset.select(startOffset, writeSize).read_raw(packed.data(), HighFive::AtomicType<uint8_t>());
+        }
+        for( uint64_t y = 0; y < ySizeOut; y++ )
+        {
+            packPixels(nBits, &unpacked[y * xSizeOut], firstPixel, xSizeOut, &packed[y * nBytes]);
+        }
+        dataset.select(startOffset, writeSize).write_raw(packed.data(), HighFive::AtomicType<uint8_t>(), this->pixelXferProps);
+    }
+    
     void KEAImageIO::readImageBlock2Band(
         uint32_t band, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeIn,
         uint64_t ySizeIn, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType
     )
     {
-        kealib::kea_lock lock(*this->m_mutex);
+        KEATraceScope trace("readImageBlock2Band");
+        trace.addArg("band", band);
+        trace.addArg("xoff", xPxlOff);
+        trace.addArg("yoff", yPxlOff);
+        trace.addArg("xsize", xSizeIn);
+        trace.addArg("ysize", ySizeIn);
+        KEATraceScope lockTrace("lock wait");
+        KEAIOTimer lockTimer;
+        kealib::kea_read_lock lock(*this->m_mutex);
         KEAStackPrintState printState;
         
         if (!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
+        kealib::kea_read_lock bandLock(*this->getBandMutex(band));
+        uint64_t lockNanos = lockTimer.elapsed();
+        lockTrace.end();
 
         try
         {
@@ -577,8 +1471,13 @@ namespace kealib{
             if (this->keaImgFile->exist(imageBandPath))
             {
                 auto imgBandDataset = this->keaImgFile->getDataSet(imageBandPath);
+                KEATraceScope ioTrace("HDF5 read", "hdf5");
+                KEAIOTimer ioTimer;
                 readImageFromDataset(imgBandDataset, band, data, xPxlOff, yPxlOff, xSizeIn,
                     ySizeIn, xSizeBuf, ySizeBuf, inDataType);            
+                this->countIO(band, false, xPxlOff, yPxlOff, xSizeIn, ySizeIn, 
+                    inDataType, ioTimer, lockNanos);
+                ioTrace.end();
             }
             else
             {
@@ -600,28 +1499,123 @@ namespace kealib{
     }
   
     
+    // the chunk shape for an xSize by ySize image. Square blocks are shrunk 
+    // to the smallest side of the image as they always have been, rectangular
+    // ones (blockYSize != 0) are limited to each side.
+    static void getChunkShape(uint64_t xSize, uint64_t ySize, uint32_t blockXSize, 
+        uint32_t blockYSize, uint32_t *chunkXSize, uint32_t *chunkYSize)
+    {
+        if( (blockYSize == 0) || (blockYSize == blockXSize) )
+        {
+            uint64_t minImgDim = xSize < ySize ? xSize : ySize;
+            *chunkXSize = blockXSize > minImgDim ? minImgDim : blockXSize;
+            *chunkYSize = *chunkXSize;
+        }
+        else
+        {
+            *chunkXSize = blockXSize > xSize ? xSize : blockXSize;
+            *chunkYSize = blockYSize > ySize ? ySize : blockYSize;
+        }
+    }
     
-    void KEAImageIO::createMask(uint32_t band, uint32_t deflate)
+    // chunking for an image dataset xSize2Use wide. For 1, 2 and 4 bit 
+    // types each chunk covers chunkXSize bytes of the packed rows so chunks
+    // are the same number of bytes as an unpacked 8 bit band.
+    static void addImageChunking(HighFive::DataSetCreateProps &props, uint64_t xSize2Use, 
+        uint32_t chunkXSize, uint32_t chunkYSize, bool packed)
     {
-        kealib::kea_lock lock(*this->m_mutex);
+        if( packed )
+        {
+            // Shuffle does nothing for bytes
+            uint64_t xChunk = chunkXSize < xSize2Use ? chunkXSize : xSize2Use;
+            props.add(HighFive::Chunking(chunkYSize, xChunk));
+        }
+        else
+        {
+            props.add(HighFive::Chunking(chunkYSize, chunkXSize));
+            props.add(HighFive::Shuffle());
+        }
+    }
+    
+    // growable datasets can be resized by extendImage()
+    static HighFive::DataSpace createImageDataSpace(uint64_t ySize, uint64_t xSize, bool growable)
+    {
+        std::vector<size_t> dims = {static_cast<size_t>(ySize), static_cast<size_t>(xSize)};
+        if( growable )
+        {
+            return HighFive::DataSpace(dims, {HighFive::DataSpace::UNLIMITED, HighFive::DataSpace::UNLIMITED});
+        }
+        return HighFive::DataSpace(dims);
+    }
+    
+    static bool isImageDataSetGrowable(const HighFive::DataSet &dataset)
+    {
+        for( size_t maxDim : dataset.getSpace().getMaxDimensions() )
+        {
+            if( maxDim != HighFive::DataSpace::UNLIMITED )
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    static void writeBlockSizeAttributes(HighFive::DataSet &dataset, uint32_t blockXSize, uint32_t blockYSize)
+    {
+        // BLOCK_SIZE is all older versions of the library know about
+        dataset.createAttribute<uint32_t>(KEA_ATTRIBUTENAME_BLOCK_SIZE, blockXSize);
+        dataset.createAttribute<uint32_t>(KEA_ATTRIBUTENAME_BLOCK_XSIZE, blockXSize);
+        dataset.createAttribute<uint32_t>(KEA_ATTRIBUTENAME_BLOCK_YSIZE, blockYSize);
+    }
+    
+    // leaves them as 0 if the dataset has no block size
+    static void readBlockSizeAttributes(const HighFive::DataSet &dataset, uint32_t *blockXSize, uint32_t *blockYSize)
+    {
+        if( dataset.hasAttribute(KEA_ATTRIBUTENAME_BLOCK_XSIZE) && 
+            dataset.hasAttribute(KEA_ATTRIBUTENAME_BLOCK_YSIZE) )
+        {
+            dataset.getAttribute(KEA_ATTRIBUTENAME_BLOCK_XSIZE).read(*blockXSize);
+            dataset.getAttribute(KEA_ATTRIBUTENAME_BLOCK_YSIZE).read(*blockYSize);
+        }
+        else if( dataset.hasAttribute(KEA_ATTRIBUTENAME_BLOCK_SIZE) )
+        {
+            // older files only have square blocks
+            dataset.getAttribute(KEA_ATTRIBUTENAME_BLOCK_SIZE).read(*blockXSize);
+            *blockYSize = *blockXSize;
+        }
+    }
+    
+    void KEAImageIO::createMask(uint32_t band, uint32_t deflate, bool bitPacked)
+    {
+        kealib::kea_read_lock lock(*this->m_mutex);
         KEAStackPrintState printState;
          
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
+        kealib::kea_lock bandLock(*this->getBandMutex(band));
         
         if(!this->maskCreated(band))
         {
-            uint32_t blockSize2Use = getImageBlockSize(band);
+            uint32_t blockXSize, blockYSize;
+            getImageBlockSize(band, &blockXSize, &blockYSize);
             try
             {
-                HighFive::DataSpace dataSpace = HighFive::DataSpace({static_cast<size_t>(spatialInfoFile->ySize), static_cast<size_t>(spatialInfoFile->xSize)});
-    
                 HighFive::DataSetCreateProps imgBandDataSetProps;
-                imgBandDataSetProps.add(HighFive::Chunking(blockSize2Use, blockSize2Use));
-                imgBandDataSetProps.add(HighFive::Shuffle());
+                uint64_t xSize2Use = spatialInfoFile->xSize;
+                if( bitPacked )
+                {
+                    // 8 pixels to a byte
+                    xSize2Use = (spatialInfoFile->xSize + 7) / 8;
+                }
+                addImageChunking(imgBandDataSetProps, xSize2Use, blockXSize, blockYSize, bitPacked);
                 imgBandDataSetProps.add(HighFive::Deflate(deflate));
+                // masks of growable bands are growable too
+                std::string imageDataPath = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_DATA;
+                bool growable = isImageDataSetGrowable(this->keaImgFile->getDataSet(imageDataPath));
+                HighFive::DataSpace dataSpace = createImageDataSpace(spatialInfoFile->ySize, xSize2Use, growable);
+                // all bits set for a packed mask
                 int initFillVal = FILL_MASK_DATA;
                 // HighFive doesn't appear to support this (yet)
                 if( H5Pset_fill_value(imgBandDataSetProps.getId(), H5T_NATIVE_INT, &initFillVal) < 0 )
@@ -652,7 +1646,14 @@ namespace kealib{
 					scalar_dataspace,
 					HighFive::FixedLengthStringType(4, HighFive::StringPadding::NullTerminated)).write("1.2");
                 
-                this->keaImgFile->flush();
+                if( bitPacked )
+                {
+                    // these flag the dataset as packed and give the real width
+                    imgBandDataSet.createAttribute<uint8_t>(KEA_ATTRIBUTENAME_NBITS, 1);
+                    imgBandDataSet.createAttribute<uint64_t>(KEA_ATTRIBUTENAME_XSIZE, spatialInfoFile->xSize);
+                }
+                
+                this->flushFile();
             }
             catch (const HighFive::DataSetException &e)
             {
@@ -683,13 +1684,16 @@ namespace kealib{
     
     void KEAImageIO::writeImageBlock2BandMask(uint32_t band, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeOut, uint64_t ySizeOut, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType)
     {
-        kealib::kea_lock lock(*this->m_mutex);
+        KEAIOTimer lockTimer;
+        kealib::kea_read_lock lock(*this->m_mutex);
         KEAStackPrintState printState;
 
         if (!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
+        kealib::kea_lock bandLock(*this->getBandMutex(band));
+        uint64_t lockNanos = lockTimer.elapsed();
 
         try
         {
@@ -710,10 +1714,17 @@ namespace kealib{
             {
                 auto imgBandDataset = this->keaImgFile->getDataSet(imageBandPath);
 
+                KEAIOTimer ioTimer;
                 writeImageToDataset(imgBandDataset, data, xPxlOff, yPxlOff, xSizeOut,
-                    ySizeOut, xSizeBuf, ySizeBuf, inDataType);
-                // Flushing the dataset
-                this->keaImgFile->flush();
+                    ySizeOut, xSizeBuf, ySizeBuf, inDataType, true);
+                this->countIO(band, true, imgBandDataset, xPxlOff, yPxlOff, xSizeOut, ySizeOut, 
+                    inDataType, ioTimer, lockNanos);
+                // Flushing the dataset (not with MPI as a flush is collective
+                // and ranks may be writing different numbers of blocks)
+                if( !this->parallelFile )
+                {
+                    this->flushFile();
+                }
             }
             else
             {
@@ -737,13 +1748,16 @@ namespace kealib{
     
     void KEAImageIO::readImageBlock2BandMask(uint32_t band, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeIn, uint64_t ySizeIn, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType)
     {
-        kealib::kea_lock lock(*this->m_mutex);
+        KEAIOTimer lockTimer;
+        kealib::kea_read_lock lock(*this->m_mutex);
         KEAStackPrintState printState;
         
         if (!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
+        kealib::kea_read_lock bandLock(*this->getBandMutex(band));
+        uint64_t lockNanos = lockTimer.elapsed();
 
         try
         {
@@ -762,8 +1776,11 @@ namespace kealib{
             if (this->keaImgFile->exist(imageMaskBandPath))
             {
                 auto imgBandDataset = this->keaImgFile->getDataSet(imageMaskBandPath);
+                KEAIOTimer ioTimer;
                 readImageFromDataset(imgBandDataset, band, data, xPxlOff, yPxlOff, xSizeIn,
                     ySizeIn, xSizeBuf, ySizeBuf, inDataType, true);            
+                this->countIO(band, false, imgBandDataset, xPxlOff, yPxlOff, xSizeIn, ySizeIn, 
+                    inDataType, ioTimer, lockNanos);
             }
             else
             {
@@ -784,75 +1801,307 @@ namespace kealib{
         }
     }
     
-    bool KEAImageIO::maskCreated(uint32_t band)
+    void KEAImageIO::readImageBlock2BandWithMask(uint32_t band, void *data, uint8_t *maskData, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeIn, uint64_t ySizeIn, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType, bool substituteNoData)
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        KEAIOTimer lockTimer;
+        kealib::kea_read_lock lock(*this->m_mutex);
         KEAStackPrintState printState;
-
-        if(!this->fileOpen)
-        {
-            throw KEAIOException("Image was not open.");
-        }
         
-        // CHECK PARAMETERS PROVIDED FIT WITHIN IMAGE
-        if(band == 0)
-        {
-            throw KEAIOException("KEA Image Bands start at 1.");
-        }
-        else if(band > this->numImgBands)
+        if (!this->fileOpen)
         {
-            throw KEAIOException("Band is not present within image.");
+            throw KEAIOException("Image was not open.");
         }
+        kealib::kea_read_lock bandLock(*this->getBandMutex(band));
+        uint64_t lockNanos = lockTimer.elapsed();
 
-        bool maskPresent = false;
         try
         {
-            std::string imageBandPath = KEA_DATASETNAME_BAND + uint2Str(band);
-            if (this->keaImgFile->exist(imageBandPath + KEA_BANDNAME_MASK))
+            // CHECK PARAMETERS PROVIDED FIT WITHIN IMAGE
+            if (band == 0)
             {
-                maskPresent = true;
+                throw KEAIOException("KEA Image Bands start at 1.");
             }
-                
-        }
-        catch (HighFive::Exception &e)
-        {
-            maskPresent = false;
-        }
-        
-        return maskPresent;
-    }
-    
-    
-    void KEAImageIO::setImageMetaData(const std::string &name, const std::string &value)
-    {
-        
-        kealib::kea_lock lock(*this->m_mutex); 
-        KEAStackPrintState printState;
-        if(!this->fileOpen)
-        {
-            throw KEAIOException("Image was not open.");
-        }
-        
-        // FORM META-DATA PATH WITHIN THE H5 FILE 
-        std::string metaDataH5Path = KEA_DATASETNAME_METADATA + std::string("/") + name;
-        
-        // WRITE IMAGE META DATA
-        try 
-        {
-            if(!this->keaImgFile->exist(metaDataH5Path))
+            else if (band > this->numImgBands)
             {
-          		// TODO: dataspace instead of scalar to be compatible with old KEA
-                HighFive::DataSpace dataSpace = HighFive::DataSpace({1});
-                keaImgFile->createDataSet(metaDataH5Path, dataSpace, HighFive::VariableLengthStringType());
-                //std::cout << "created dataset " << metaDataH5Path << std::endl;
+                throw KEAIOException("Band is not present within image.");
             }
-            auto dataset = this->keaImgFile->getDataSet(metaDataH5Path);
-            dataset.write(value);
-        
-            // Flushing the dataset
-            this->keaImgFile->flush();
-        }
-        catch (const HighFive::Exception &e) 
+            
+            if( (maskData == nullptr) && !substituteNoData )
+            {
+                throw KEAIOException("Either a mask buffer must be given or substituteNoData set.");
+            }
+
+            // READ THE IMAGE DATA
+            std::string imageBandPath = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_DATA;
+            if (!this->keaImgFile->exist(imageBandPath))
+            {
+                throw KEAIOException("Band image dataset does not exist.");
+            }
+            auto imgBandDataset = this->keaImgFile->getDataSet(imageBandPath);
+            KEAIOTimer ioTimer;
+            readImageFromDataset(imgBandDataset, band, data, xPxlOff, yPxlOff, xSizeIn,
+                ySizeIn, xSizeBuf, ySizeBuf, inDataType);
+            this->countIO(band, false, xPxlOff, yPxlOff, xSizeIn, ySizeIn, 
+                inDataType, ioTimer, lockNanos);
+            
+            // somewhere to put the mask if the caller doesn't want it
+            std::vector<uint8_t> localMask;
+            uint8_t *pMask = maskData;
+            if( pMask == nullptr )
+            {
+                localMask.resize(xSizeBuf * ySizeBuf);
+                pMask = localMask.data();
+            }
+            
+            // 0 if no data is not defined
+            uint8_t noDataValue[KEA_MAX_PIXEL_SIZE];
+            memset(noDataValue, 0, sizeof(noDataValue));
+            bool haveNoData = this->getCachedNoDataValue(band, noDataValue, inDataType);
+            
+            // WORK OUT THE MASK. A MASK BAND TAKES PRECEDENCE OVER THE NO DATA
+            bool maskFromNoData = false;
+            std::string imageMaskBandPath = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_MASK;
+            uint8_t invalid = 0;
+            if (this->keaImgFile->exist(imageMaskBandPath))
+            {
+                auto imgMaskDataset = this->keaImgFile->getDataSet(imageMaskBandPath);
+                KEAIOTimer maskTimer;
+                readImageFromDataset(imgMaskDataset, band, pMask, xPxlOff, yPxlOff, xSizeIn,
+                    ySizeIn, xSizeBuf, ySizeBuf, kea_8uint, true);
+                this->countIO(band, false, imgMaskDataset, xPxlOff, yPxlOff, xSizeIn, ySizeIn, 
+                    kea_8uint, maskTimer, 0);
+                // off the edge of the image is never valid
+                fillImageEdges(pMask, &invalid, 1, xSizeIn, ySizeIn, xSizeBuf, ySizeBuf);
+            }
+            else if( haveNoData )
+            {
+                // edges have already been filled with the no data
+                maskFromNoData = true;
+            }
+            else
+            {
+                memset(pMask, FILL_MASK_DATA, xSizeBuf * ySizeBuf);
+                fillImageEdges(pMask, &invalid, 1, xSizeIn, ySizeIn, xSizeBuf, ySizeBuf);
+            }
+            
+            if( maskFromNoData || substituteNoData )
+            {
+                applyMask(inDataType, data, pMask, xSizeBuf * ySizeBuf, noDataValue, 
+                    maskFromNoData, substituteNoData);
+            }
+        }
+        catch (const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch (const HighFive::Exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        catch (const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+    }
+    
+    bool KEAImageIO::maskCreated(uint32_t band)
+    {
+        kealib::kea_read_lock lock(*this->m_mutex);
+        KEAStackPrintState printState;
+
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        kealib::kea_read_lock bandLock(*this->getBandMutex(band));
+        
+        // CHECK PARAMETERS PROVIDED FIT WITHIN IMAGE
+        if(band == 0)
+        {
+            throw KEAIOException("KEA Image Bands start at 1.");
+        }
+        else if(band > this->numImgBands)
+        {
+            throw KEAIOException("Band is not present within image.");
+        }
+
+        bool maskPresent = false;
+        try
+        {
+            std::string imageBandPath = KEA_DATASETNAME_BAND + uint2Str(band);
+            if (this->keaImgFile->exist(imageBandPath + KEA_BANDNAME_MASK))
+            {
+                maskPresent = true;
+            }
+                
+        }
+        catch (HighFive::Exception &e)
+        {
+            maskPresent = false;
+        }
+        
+        return maskPresent;
+    }
+    
+    
+    std::vector< std::pair<std::string, std::string> > KEAImageIO::readMetaData(const std::string &basePath)
+    {
+        std::vector< std::pair<std::string, std::string> > metaData;
+
+        // compact form first, read in one go
+        std::string compactPath = basePath + KEA_DATASETNAME_METADATA_COMPACT;
+        if( this->keaImgFile->exist(compactPath) )
+        {
+            auto dataset = this->keaImgFile->getDataSet(compactPath);
+            std::vector<KEAMetaDataItem_HDF5> rows(dataset.getElementCount());
+            if( !rows.empty() )
+            {
+                dataset.read_raw(rows.data(), createMetaDataCompType());
+            }
+            for( auto &row : rows )
+            {
+                metaData.push_back(std::pair<std::string, std::string>(
+                    (row.pszName != nullptr) ? row.pszName : "",
+                    (row.pszValue != nullptr) ? row.pszValue : ""));
+            }
+            if( !rows.empty() )
+            {
+                // the strings were allocated by HDF5
+                H5Dvlen_reclaim(createMetaDataCompType().getId(), dataset.getSpace().getId(), H5P_DEFAULT, rows.data());
+            }
+        }
+
+        // then any separate datasets
+        auto group = this->keaImgFile->getGroup(basePath + KEA_DATASETNAME_METADATA);
+        for( const std::string &name : group.listObjectNames() )
+        {
+            std::string value;
+            group.getDataSet(name).read(value);
+            metaData.push_back(std::pair<std::string, std::string>(name, value));
+        }
+
+        return metaData;
+    }
+
+    bool KEAImageIO::readMetaDataItem(const std::string &basePath, const std::string &name, std::string *value)
+    {
+        std::string metaDataH5Path = basePath + KEA_DATASETNAME_METADATA + std::string("/") + name;
+        if( this->keaImgFile->exist(metaDataH5Path) )
+        {
+            this->keaImgFile->getDataSet(metaDataH5Path).read(*value);
+            return true;
+        }
+
+        if( this->keaImgFile->exist(basePath + KEA_DATASETNAME_METADATA_COMPACT) )
+        {
+            for( auto &item : this->readMetaData(basePath) )
+            {
+                if( item.first == name )
+                {
+                    *value = item.second;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void KEAImageIO::writeMetaDataCompact(const std::string &basePath, const std::vector< std::pair<std::string, std::string> > &items)
+    {
+        std::vector<KEAMetaDataItem_HDF5> rows(items.size());
+        for( size_t i = 0; i < items.size(); i++ )
+        {
+            rows[i].pszName = const_cast<char*>(items[i].first.c_str());
+            rows[i].pszValue = const_cast<char*>(items[i].second.c_str());
+        }
+
+        // only recreate it if the number of items has changed
+        std::string compactPath = basePath + KEA_DATASETNAME_METADATA_COMPACT;
+        if( this->keaImgFile->exist(compactPath) &&
+            (this->keaImgFile->getDataSet(compactPath).getElementCount() != items.size()) )
+        {
+            this->keaImgFile->unlink(compactPath);
+        }
+        if( !this->keaImgFile->exist(compactPath) )
+        {
+            this->keaImgFile->createDataSet(compactPath,
+                HighFive::DataSpace({items.size()}), createMetaDataCompType());
+        }
+        if( !rows.empty() )
+        {
+            this->keaImgFile->getDataSet(compactPath).write_raw(rows.data());
+        }
+    }
+
+    void KEAImageIO::writeMetaData(const std::string &basePath, const std::vector< std::pair<std::string, std::string> > &data)
+    {
+        if( this->keaImgFile->exist(basePath + KEA_DATASETNAME_METADATA_COMPACT) )
+        {
+            // merge into what is there and write it back once
+            std::vector< std::pair<std::string, std::string> > items = this->readMetaData(basePath);
+            std::map<std::string, size_t> index;
+            for( size_t i = 0; i < items.size(); i++ )
+            {
+                index[items[i].first] = i;
+            }
+            for( auto &item : data )
+            {
+                auto found = index.find(item.first);
+                if( found != index.end() )
+                {
+                    items[found->second].second = item.second;
+                }
+                else
+                {
+                    index[item.first] = items.size();
+                    items.push_back(item);
+                }
+            }
+
+            // any separate datasets are now in the compact form
+            auto group = this->keaImgFile->getGroup(basePath + KEA_DATASETNAME_METADATA);
+            for( const std::string &name : group.listObjectNames() )
+            {
+                group.unlink(name);
+            }
+            this->writeMetaDataCompact(basePath, items);
+        }
+        else
+        {
+            for( auto &item : data )
+            {
+                std::string metaDataH5Path = basePath + KEA_DATASETNAME_METADATA + std::string("/") + item.first;
+                if(!this->keaImgFile->exist(metaDataH5Path))
+                {
+                    // TODO: dataspace instead of scalar to be compatible with old KEA
+                    HighFive::DataSpace dataSpace = HighFive::DataSpace({1});
+                    keaImgFile->createDataSet(metaDataH5Path, dataSpace, HighFive::VariableLengthStringType());
+                }
+                auto dataset = this->keaImgFile->getDataSet(metaDataH5Path);
+                dataset.write(item.second);
+            }
+        }
+    }
+
+    void KEAImageIO::setImageMetaData(const std::string &name, const std::string &value)
+    {
+
+        kealib::kea_lock lock(*this->m_mutex);
+        KEAStackPrintState printState;
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+
+        // WRITE IMAGE META DATA
+        try
+        {
+            this->writeMetaData("", {std::pair<std::string, std::string>(name, value)});
+
+            // Flushing the dataset
+            this->flushFile();
+        }
+        catch (const HighFive::Exception &e)
         {
             throw KEAIOException("Could not set image meta-data.");
         }
@@ -865,25 +2114,26 @@ namespace kealib{
             throw KEAIOException(e.what());
         }
     }
-    
+
     std::string KEAImageIO::getImageMetaData(const std::string &name)
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex);
         KEAStackPrintState printState;
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
-        
-        std::string metaDataH5Path = KEA_DATASETNAME_METADATA + std::string("/") + name;
+
         std::string value = "";
         // READ IMAGE META-DATA
-        try 
+        try
         {
-            auto dataset = this->keaImgFile->getDataSet(metaDataH5Path);
-            dataset.read(value);
-        } 
-        catch ( const HighFive::Exception &e) 
+            if( !this->readMetaDataItem("", name, &value) )
+            {
+                throw KEAIOException("Meta-data variable was not accessable.");
+            }
+        }
+        catch ( const HighFive::Exception &e)
         {
             throw KEAIOException("Meta-data variable was not accessable.");
         }
@@ -895,24 +2145,27 @@ namespace kealib{
         {
             throw KEAIOException(e.what());
         }
-        
+
         return value;
     }
-    
+
     std::vector<std::string> KEAImageIO::getImageMetaDataNames()
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex);
         KEAStackPrintState printState;
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
-        
-        try 
+
+        try
         {
-            // Try to open dataset with matadata name
-            auto group = this->keaImgFile->getGroup(KEA_DATASETNAME_METADATA);
-            return group.listObjectNames();
+            std::vector<std::string> names;
+            for( auto &item : this->readMetaData("") )
+            {
+                names.push_back(item.first);
+            }
+            return names;
         }
         catch (const HighFive::Exception &e)
         {
@@ -923,27 +2176,19 @@ namespace kealib{
             throw KEAIOException(e.what());
         }
     }
-    
+
     std::vector< std::pair<std::string, std::string> > KEAImageIO::getImageMetaData()
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex);
         KEAStackPrintState printState;
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
-        
-        std::vector< std::pair<std::string, std::string> > metaData;
-        
-        try 
+
+        try
         {
-            auto group = this->keaImgFile->getGroup(KEA_DATASETNAME_METADATA);
-            for( size_t i = 0; i < group.getNumberObjects(); i++ )
-            {
-                std::string name = group.getObjectName(i);
-                std::string value = this->getImageMetaData(name);
-                metaData.push_back(std::pair<std::string, std::string>(name,value));
-            }
+            return this->readMetaData("");
         }
         catch (const HighFive::Exception &e)
         {
@@ -953,25 +2198,21 @@ namespace kealib{
         {
             throw KEAIOException(e.what());
         }
-        
-        return metaData;
     }
-    
+
     void KEAImageIO::setImageMetaData(const std::vector< std::pair<std::string, std::string> > &data)
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_lock lock(*this->m_mutex);
         KEAStackPrintState printState;
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
-        
-        try 
+
+        try
         {
-            for(auto iterMetaData = data.begin(); iterMetaData != data.end(); ++iterMetaData)
-            {
-                this->setImageMetaData(iterMetaData->first, iterMetaData->second);
-            }
+            this->writeMetaData("", data);
+            this->flushFile();
         }
         catch (const HighFive::Exception &e)
         {
@@ -986,35 +2227,27 @@ namespace kealib{
             throw KEAIOException(e.what());
         }
     }
-    
+
     void KEAImageIO::setImageBandMetaData(uint32_t band, const std::string &name, const std::string &value)
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex);
         KEAStackPrintState printState;
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
-        
-        // FORM META-DATA PATH WITHIN THE H5 FILE 
-        std::string metaDataH5Path = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_METADATA + std::string("/") + name;
+        kealib::kea_lock bandLock(*this->getBandMutex(band));
 
         // WRITE IMAGE META DATA
-        try 
+        try
         {
-            if(!this->keaImgFile->exist(metaDataH5Path))
-            {
-                HighFive::DataSpace dataSpace = HighFive::DataSpace({1});
-                keaImgFile->createDataSet(metaDataH5Path, dataSpace, HighFive::VariableLengthStringType());
-                //std::cout << "created dataset " << metaDataH5Path << std::endl;
-            }
-            auto dataset = this->keaImgFile->getDataSet(metaDataH5Path);
-            dataset.write(value);
-        
+            this->writeMetaData(KEA_DATASETNAME_BAND + uint2Str(band),
+                {std::pair<std::string, std::string>(name, value)});
+
             // Flushing the dataset
-            this->keaImgFile->flush();
+            this->flushFile();
         }
-        catch (const HighFive::Exception &e) 
+        catch (const HighFive::Exception &e)
         {
             throw KEAIOException("Could not set band meta-data.");
         }
@@ -1025,27 +2258,29 @@ namespace kealib{
         catch ( const std::exception &e)
         {
             throw KEAIOException(e.what());
-        }        
+        }
     }
-    
+
     std::string KEAImageIO::getImageBandMetaData(uint32_t band, const std::string &name)
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex);
         KEAStackPrintState printState;
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
-        
-        std::string metaDataH5Path = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_METADATA + std::string("/") + name;
+        kealib::kea_read_lock bandLock(*this->getBandMutex(band));
+
         std::string value = "";
         // READ IMAGE META-DATA
-        try 
+        try
         {
-            auto dataset = this->keaImgFile->getDataSet(metaDataH5Path);
-            dataset.read(value);
-        } 
-        catch ( const HighFive::Exception &e) 
+            if( !this->readMetaDataItem(KEA_DATASETNAME_BAND + uint2Str(band), name, &value) )
+            {
+                throw KEAIOException("Meta-data band variable was not accessable.");
+            }
+        }
+        catch ( const HighFive::Exception &e)
         {
             throw KEAIOException("Meta-data band variable was not accessable.");
         }
@@ -1059,23 +2294,25 @@ namespace kealib{
         }
         return value;
     }
-    
+
     std::vector<std::string> KEAImageIO::getImageBandMetaDataNames(uint32_t band)
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex);
         KEAStackPrintState printState;
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
-        
-        std::string metaDataGroupName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_METADATA;
-        
-        try 
+        kealib::kea_read_lock bandLock(*this->getBandMutex(band));
+
+        try
         {
-            // Try to open the group
-            auto group = this->keaImgFile->getGroup(metaDataGroupName);
-            return group.listObjectNames();
+            std::vector<std::string> names;
+            for( auto &item : this->readMetaData(KEA_DATASETNAME_BAND + uint2Str(band)) )
+            {
+                names.push_back(item.first);
+            }
+            return names;
         }
         catch (const HighFive::Exception &e)
         {
@@ -1086,28 +2323,20 @@ namespace kealib{
             throw KEAIOException(e.what());
         }
     }
-    
+
     std::vector< std::pair<std::string, std::string> > KEAImageIO::getImageBandMetaData(uint32_t band)
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex);
         KEAStackPrintState printState;
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
-        
-        std::vector< std::pair<std::string, std::string> > metaData;
-        
-        std::string metaDataGroupName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_METADATA;
-        try 
+        kealib::kea_read_lock bandLock(*this->getBandMutex(band));
+
+        try
         {
-            auto group = this->keaImgFile->getGroup(metaDataGroupName);
-            for( size_t i = 0; i < group.getNumberObjects(); i++ )
-            {
-                std::string name = group.getObjectName(i);
-                std::string value = this->getImageBandMetaData(band, name);
-                metaData.push_back(std::pair<std::string, std::string>(name,value));
-            }
+            return this->readMetaData(KEA_DATASETNAME_BAND + uint2Str(band));
         }
         catch (const HighFive::Exception &e)
         {
@@ -1117,25 +2346,22 @@ namespace kealib{
         {
             throw KEAIOException(e.what());
         }
-        
-        return metaData;
     }
-    
+
     void KEAImageIO::setImageBandMetaData(uint32_t band, const std::vector< std::pair<std::string, std::string> > &data)
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex);
         KEAStackPrintState printState;
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
-        
-        try 
+        kealib::kea_lock bandLock(*this->getBandMutex(band));
+
+        try
         {
-            for(auto iterMetaData = data.begin(); iterMetaData != data.end(); ++iterMetaData)
-            {
-                this->setImageBandMetaData(band, iterMetaData->first, iterMetaData->second);
-            }
+            this->writeMetaData(KEA_DATASETNAME_BAND + uint2Str(band), data);
+            this->flushFile();
         }
         catch (const HighFive::Exception &e)
         {
@@ -1150,6 +2376,70 @@ namespace kealib{
             throw KEAIOException(e.what());
         }
     }
+
+    void KEAImageIO::compactMetaData()
+    {
+        kealib::kea_lock lock(*this->m_mutex);
+        KEAStackPrintState printState;
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+
+        try
+        {
+            std::vector<std::string> basePaths = {""};
+            for( uint32_t band = 1; band <= this->numImgBands; band++ )
+            {
+                basePaths.push_back(KEA_DATASETNAME_BAND + uint2Str(band));
+            }
+            for( const std::string &basePath : basePaths )
+            {
+                if( this->keaImgFile->exist(basePath + KEA_DATASETNAME_METADATA_COMPACT) )
+                {
+                    continue;
+                }
+                std::vector< std::pair<std::string, std::string> > items = this->readMetaData(basePath);
+                this->writeMetaDataCompact(basePath, items);
+                auto group = this->keaImgFile->getGroup(basePath + KEA_DATASETNAME_METADATA);
+                for( const std::string &name : group.listObjectNames() )
+                {
+                    group.unlink(name);
+                }
+            }
+            this->flushFile();
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const HighFive::Exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+    }
+
+    bool KEAImageIO::hasCompactMetaData()
+    {
+        kealib::kea_read_lock lock(*this->m_mutex);
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+
+        try
+        {
+            return this->keaImgFile->exist(KEA_DATASETNAME_METADATA_COMPACT);
+        }
+        catch ( const HighFive::Exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+    }
     
     void KEAImageIO::setImageBandDescription(uint32_t band, const std::string &description)
     {
@@ -1172,9 +2462,14 @@ namespace kealib{
             }
             auto dataset = this->keaImgFile->getDataSet(descDataH5Path);
             dataset.write(description);
+            if( this->consolidatedHeader )
+            {
+                this->bandInfo.at(band - 1).description = description;
+                this->writeConsolidatedHeader();
+            }
         
             // Flushing the dataset
-            this->keaImgFile->flush();
+            this->flushFile();
         }
         catch ( const HighFive::Exception &e) 
         {
@@ -1192,7 +2487,7 @@ namespace kealib{
     
     std::string KEAImageIO::getImageBandDescription(uint32_t band)
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex); 
         KEAStackPrintState printState;
         if(!this->fileOpen)
         {
@@ -1205,6 +2500,14 @@ namespace kealib{
         
         try 
         {
+            if( this->consolidatedHeader )
+            {
+                if( (band == 0) || (band > this->bandInfo.size()) )
+                {
+                    throw KEAIOException("Band is not present within image.");
+                }
+                return this->bandInfo.at(band - 1).description;
+            }
             auto dataset = this->keaImgFile->getDataSet(descDataH5Path);
             dataset.read(description);
         } 
@@ -1253,10 +2556,22 @@ namespace kealib{
             //std::cout << "wrote value" << std::endl;
             // now set flag that says whether nodata set or not
             int8_t val = 1;
-            dataset.createAttribute(KEA_NODATA_DEFINED, val);
+            if( dataset.hasAttribute(KEA_NODATA_DEFINED) )
+            {
+                dataset.getAttribute(KEA_NODATA_DEFINED).write(val);
+            }
+            else
+            {
+                dataset.createAttribute(KEA_NODATA_DEFINED, val);
+            }
+            this->noDataCache.erase(band);
+            if( this->consolidatedHeader )
+            {
+                this->writeConsolidatedHeader();
+            }
             //std::cout << "wrote attr" << std::endl;
             // Flushing the dataset
-            this->keaImgFile->flush();
+            this->flushFile();
         }
         catch ( const HighFive::Exception &e) 
         {
@@ -1274,37 +2589,19 @@ namespace kealib{
     
     void KEAImageIO::getNoDataValue(uint32_t band, void *data, KEADataType inDataType)
     {
-        kealib::kea_lock lock(*this->m_mutex);
+        kealib::kea_read_lock lock(*this->m_mutex);
         KEAStackPrintState printState;
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
-        // READ IMAGE BAND NO DATA VALUE
-        std::string noDataValPath = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_NO_DATA_VAL;
-        
+        // READ IMAGE BAND NO DATA VALUE (FROM THE CACHE IF WE HAVE ALREADY SEEN IT)
         try
         {
-            auto hdfDataType = convertDatatypeKeaToH5Native(inDataType);
-            if (keaImgFile->exist(noDataValPath))
-            {
-                auto datasetBandDataType = keaImgFile->getDataSet(noDataValPath);
-                // check set/not set flag
-                auto setattrib = datasetBandDataType.getAttribute(KEA_NODATA_DEFINED);
-                int8_t val = setattrib.read<int8_t>();
-                if( val == 1 )
-                {
-                    datasetBandDataType.read_raw(data, hdfDataType);
-                }
-                else
-                {
-                    throw KEAIOException("The image band no data value was not defined.");
-                }
-            }
-            else
+            if( !this->getCachedNoDataValue(band, data, inDataType) )
             {
-                throw KEAIOException("The image band no data value was not set.");
+                throw KEAIOException("The image band no data value was not defined.");
             }
         } 
         catch ( const HighFive::Exception &e) 
@@ -1321,285 +2618,567 @@ namespace kealib{
         }
     }
     
-    void KEAImageIO::undefineNoDataValue(uint32_t band)
+    bool KEAImageIO::getCachedNoDataValue(uint32_t band, void *data, KEADataType inDataType)
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        // readers only hold the main lock shared
+        std::unique_lock<std::mutex> cacheLock(this->noDataCacheMutex);
+        auto itr = this->noDataCache.find(band);
+        if( itr == this->noDataCache.end() )
+        {
+            // first time we have been asked for this band - read it from the file
+            KEANoDataCacheItem item;
+            item.dataType = kea_undefined;
+            memset(item.value, 0, sizeof(item.value));
+            
+            std::string noDataValPath = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_NO_DATA_VAL;
+            if( this->keaImgFile->exist(noDataValPath) )
+            {
+                auto datasetNoData = this->keaImgFile->getDataSet(noDataValPath);
+                // check set/not set flag
+                if( datasetNoData.hasAttribute(KEA_NODATA_DEFINED) && 
+                    (datasetNoData.getAttribute(KEA_NODATA_DEFINED).read<int8_t>() == 1) )
+                {
+                    // keep it in the type of the band so no precision is lost
+                    item.dataType = this->getImageBandDataType(band);
+                    datasetNoData.read_raw(item.value, convertDatatypeKeaToH5Native(item.dataType));
+                }
+            }
+            itr = this->noDataCache.insert(std::pair<uint32_t, KEANoDataCacheItem>(band, item)).first;
+        }
+        
+        const KEANoDataCacheItem item = itr->second;
+        cacheLock.unlock();
+        if( item.dataType == kea_undefined )
+        {
+            return false;
+        }
+        
+        // convert to the type requested using the same rules HDF5 uses when reading
+        auto srcDT = convertDatatypeKeaToH5Native(item.dataType);
+        auto dstDT = convertDatatypeKeaToH5Native(inDataType);
+        uint8_t convBuffer[KEA_MAX_PIXEL_SIZE];
+        memcpy(convBuffer, item.value, sizeof(convBuffer));
+        if( H5Tconvert(srcDT.getId(), dstDT.getId(), 1, convBuffer, NULL, H5P_DEFAULT) < 0 )
+        {
+            H5Eprint(H5E_DEFAULT, stderr);
+            throw KEAIOException("Error in H5Tconvert");
+        }
+        memcpy(data, convBuffer, dstDT.getSize());
+        return true;
+    }
+    
+    void KEAImageIO::createConsolidatedHeader()
+    {
+        kealib::kea_lock lock(*this->m_mutex);
         KEAStackPrintState printState;
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
-        std::string noDataValPath = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_NO_DATA_VAL;
+        if( this->consolidatedHeader )
+        {
+            return;
+        }
         
-        // UNDEFINE THE NO DATA VALUE
         try
         {
-            auto datasetBandDataType = keaImgFile->getDataSet(noDataValPath);
-            int8_t val = 0;
-            if( datasetBandDataType.hasAttribute(KEA_NODATA_DEFINED))
-            {
-                auto attribset = datasetBandDataType.getAttribute(KEA_NODATA_DEFINED);
-                attribset.write(val);
-            }
-            else
-            {
-                datasetBandDataType.createAttribute(KEA_NODATA_DEFINED, &val);
-            }
-            // Flushing the dataset
-            this->keaImgFile->flush();
+            this->rebuildConsolidatedHeader();
+            this->flushFile();
         }
         catch ( const HighFive::Exception &e)
         {
-            throw KEAIOException("The image band no data value had not been created.");
+            this->consolidatedHeader = false;
+            throw KEAIOException(e.what());
         }
         catch ( const KEAIOException &e)
         {
+            this->consolidatedHeader = false;
             throw e;
         }
         catch ( const std::exception &e)
         {
+            this->consolidatedHeader = false;
             throw KEAIOException(e.what());
         }
     }
     
-    std::vector<KEAImageGCP*>* KEAImageIO::getGCPs()
+    bool KEAImageIO::hasConsolidatedHeader()
     {
-        kealib::kea_lock lock(*this->m_mutex); 
-        KEAStackPrintState printState;
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
-        std::vector<KEAImageGCP*> *gcps = new std::vector<KEAImageGCP*>();
-        
+        return this->consolidatedHeader;
+    }
+    
+    // whether the consolidated header was written with the columns we expect
+    static bool consolidatedLayoutMatches(const HighFive::DataSet &dataset)
+    {
+        return dataset.hasAttribute(KEA_CONSOLIDATED_LAYOUT) && 
+            (dataset.getAttribute(KEA_CONSOLIDATED_LAYOUT).read<uint32_t>() == KEA_CONSOLIDATED_LAYOUT_VERSION);
+    }
+    
+    bool KEAImageIO::readConsolidatedHeader()
+    {
         try
-        {            
-            uint32_t numGCPs = 0;
-            // Get the number of GCPs
-            try
+        {
+            auto dataset = this->keaImgFile->getDataSet(KEA_DATASETNAME_HEADER_CONSOLIDATED);
+            if( !consolidatedLayoutMatches(dataset) )
             {
-                auto numGCPsDataset = this->keaImgFile->getDataSet(KEA_GCPS_NUM);
-                numGCPsDataset.read(numGCPs);
+                return false;
             }
-            catch (const HighFive::Exception &e)
+            
+            std::string fileType = dataset.getAttribute(KEA_CONSOLIDATED_FILETYPE).read<std::string>();
+            if (fileType != "KEA")
             {
-                throw KEAIOException("Could not read the number of GCPs.");
+                throw KEAIOException("The input file cannot be identified as a KEA file.");
             }
-            catch ( const KEAIOException &e)
+            
+            // catches bands added or removed by an older version of the library.
+            // Other changes it makes (spatial info, descriptions, no data etc)
+            // can't be detected without reading the separate datasets, which is
+            // what the consolidated header avoids, so aren't seen. See
+            // createConsolidatedHeader().
+            uint32_t numBands = dataset.getAttribute(KEA_CONSOLIDATED_NUMBANDS).read<uint32_t>();
+            uint32_t numBandsFile;
+            this->keaImgFile->getDataSet(KEA_DATASETNAME_HEADER_NUMBANDS).read(numBandsFile);
+            if( (numBands != numBandsFile) || (dataset.getElementCount() != numBands) )
             {
-                throw e;
+                return false;
             }
-            catch ( const std::exception &e)
+            
+            this->keaVersion = dataset.getAttribute(KEA_CONSOLIDATED_VERSION).read<std::string>();
+            this->numImgBands = numBands;
+            
+            auto tl = dataset.getAttribute(KEA_CONSOLIDATED_TL).read<std::vector<double>>();
+            auto res = dataset.getAttribute(KEA_CONSOLIDATED_RES).read<std::vector<double>>();
+            auto rot = dataset.getAttribute(KEA_CONSOLIDATED_ROT).read<std::vector<double>>();
+            auto size = dataset.getAttribute(KEA_CONSOLIDATED_SIZE).read<std::vector<uint64_t>>();
+            if( (tl.size() != 2) || (res.size() != 2) || (rot.size() != 2) || (size.size() != 2) )
             {
-                throw KEAIOException(e.what());
+                return false;
             }
-
-            KEAImageGCP_HDF5 *gcpsHDF = new KEAImageGCP_HDF5[numGCPs];
+            this->spatialInfoFile->tlX = tl[0];
+            this->spatialInfoFile->tlY = tl[1];
+            this->spatialInfoFile->xRes = res[0];
+            this->spatialInfoFile->yRes = res[1];
+            this->spatialInfoFile->xRot = rot[0];
+            this->spatialInfoFile->yRot = rot[1];
+            this->spatialInfoFile->xSize = size[0];
+            this->spatialInfoFile->ySize = size[1];
+            this->spatialInfoFile->wktString = dataset.getAttribute(KEA_CONSOLIDATED_WKT).read<std::string>();
             
-            try
+            std::vector<KEABandInfo_HDF5> rows(numBands);
+            if( numBands > 0 )
             {
-                // Open the GCPs dataset 
-                if( this->keaImgFile->exist(KEA_GCPS_DATA))
-                {
-                    auto gcpsDataset = this->keaImgFile->getDataSet(KEA_GCPS_DATA);
-                    gcpsDataset.read_raw(gcpsHDF);
-                }
-                else
-                {
-                    throw KEAIOException("Unable to read GCPs");
-                }
+                dataset.read_raw(rows.data(), createBandInfoCompType());
             }
-            catch( const HighFive::Exception &e )
+            for( uint32_t i = 0; i < numBands; i++ )
             {
-                throw KEAIOException(e.what());
+                KEABandInfo info;
+                info.description = (rows[i].pszDescription != nullptr) ? rows[i].pszDescription : "";
+                info.dataType = (KEADataType)rows[i].dataType;
+                info.layerType = (KEALayerType)rows[i].layerType;
+                info.clrInterp = (KEABandClrInterp)rows[i].layerUsage;
+                info.blockXSize = rows[i].blockSize;
+                info.blockYSize = rows[i].blockYSize;
+                this->bandInfo.push_back(info);
+                
+                KEANoDataCacheItem item;
+                item.dataType = rows[i].noDataDefined ? info.dataType : kea_undefined;
+                memcpy(item.value, &rows[i].noDataValue, sizeof(item.value));
+                this->noDataCache[i + 1] = item;
             }
-            
-            KEAImageGCP *tmpGCP = nullptr;
-            for(uint32_t i = 0; i < numGCPs; ++i)
+            if( numBands > 0 )
             {
-                tmpGCP = new KEAImageGCP();
-                tmpGCP->pszId = std::string(gcpsHDF[i].pszId);
-                free(gcpsHDF[i].pszId);
-                tmpGCP->pszInfo = std::string(gcpsHDF[i].pszInfo);
-                free(gcpsHDF[i].pszInfo);
-                tmpGCP->dfGCPLine = gcpsHDF[i].dfGCPLine;
-                tmpGCP->dfGCPPixel = gcpsHDF[i].dfGCPPixel;
-                tmpGCP->dfGCPX = gcpsHDF[i].dfGCPX;
-                tmpGCP->dfGCPY = gcpsHDF[i].dfGCPY;
-                tmpGCP->dfGCPZ = gcpsHDF[i].dfGCPZ;
-                gcps->push_back(tmpGCP);
+                // the descriptions were allocated by HDF5
+                H5Dvlen_reclaim(createBandInfoCompType().getId(), dataset.getSpace().getId(), H5P_DEFAULT, rows.data());
             }
+        }
+        catch ( const HighFive::Exception &e)
+        {
+            // use the separate datasets instead
+            this->bandInfo.clear();
+            this->noDataCache.clear();
+            return false;
+        }
+        
+        this->consolidatedHeader = true;
+        return true;
+    }
+    
+    // write value to the attribute name of dataset, creating it if needed
+    template <typename T>
+    static void writeConsolidatedAttribute(HighFive::DataSet &dataset, const std::string &name, const T &value)
+    {
+        if( dataset.hasAttribute(name) )
+        {
+            dataset.deleteAttribute(name);
+        }
+        dataset.createAttribute(name, value);
+    }
+    
+    void KEAImageIO::writeConsolidatedHeader()
+    {
+        std::vector<KEABandInfo_HDF5> rows(this->numImgBands);
+        for( uint32_t i = 0; i < this->numImgBands; i++ )
+        {
+            const KEABandInfo &info = this->bandInfo.at(i);
+            rows[i].pszDescription = const_cast<char*>(info.description.c_str());
+            rows[i].dataType = (uint32_t)info.dataType;
+            rows[i].layerType = (uint32_t)info.layerType;
+            rows[i].layerUsage = (uint32_t)info.clrInterp;
+            rows[i].blockSize = info.blockXSize;
+            rows[i].blockYSize = info.blockYSize;
             
-            delete[] gcpsHDF;
+            // makes sure the band is in the cache
+            double noData;
+            rows[i].noDataDefined = this->getCachedNoDataValue(i + 1, &noData, kea_64float) ? 1 : 0;
+            memcpy(&rows[i].noDataValue, this->noDataCache[i + 1].value, sizeof(rows[i].noDataValue));
         }
-        catch (const HighFive::Exception &e)
+        
+        // only recreate it if the number of bands or the layout has changed
+        if( this->keaImgFile->exist(KEA_DATASETNAME_HEADER_CONSOLIDATED) )
         {
-            throw KEAIOException(e.what());
+            auto existing = this->keaImgFile->getDataSet(KEA_DATASETNAME_HEADER_CONSOLIDATED);
+            if( (existing.getElementCount() != this->numImgBands) || !consolidatedLayoutMatches(existing) )
+            {
+                this->keaImgFile->unlink(KEA_DATASETNAME_HEADER_CONSOLIDATED);
+            }
         }
-        catch ( const KEAIOException &e)
+        if( !this->keaImgFile->exist(KEA_DATASETNAME_HEADER_CONSOLIDATED) )
         {
-            throw e;
+            this->keaImgFile->createDataSet(KEA_DATASETNAME_HEADER_CONSOLIDATED, 
+                HighFive::DataSpace({this->numImgBands}), createBandInfoCompType());
         }
-        catch ( const std::exception &e)
+        auto dataset = this->keaImgFile->getDataSet(KEA_DATASETNAME_HEADER_CONSOLIDATED);
+        if( this->numImgBands > 0 )
         {
-            throw KEAIOException(e.what());
+            dataset.write_raw(rows.data());
         }
         
-        return gcps;
+        writeConsolidatedAttribute(dataset, KEA_CONSOLIDATED_LAYOUT, KEA_CONSOLIDATED_LAYOUT_VERSION);
+        writeConsolidatedAttribute(dataset, KEA_CONSOLIDATED_FILETYPE, std::string("KEA"));
+        writeConsolidatedAttribute(dataset, KEA_CONSOLIDATED_VERSION, this->keaVersion);
+        writeConsolidatedAttribute(dataset, KEA_CONSOLIDATED_NUMBANDS, this->numImgBands);
+        writeConsolidatedAttribute(dataset, KEA_CONSOLIDATED_TL, 
+            std::vector<double>{this->spatialInfoFile->tlX, this->spatialInfoFile->tlY});
+        writeConsolidatedAttribute(dataset, KEA_CONSOLIDATED_RES, 
+            std::vector<double>{this->spatialInfoFile->xRes, this->spatialInfoFile->yRes});
+        writeConsolidatedAttribute(dataset, KEA_CONSOLIDATED_ROT, 
+            std::vector<double>{this->spatialInfoFile->xRot, this->spatialInfoFile->yRot});
+        writeConsolidatedAttribute(dataset, KEA_CONSOLIDATED_SIZE, 
+            std::vector<uint64_t>{this->spatialInfoFile->xSize, this->spatialInfoFile->ySize});
+        writeConsolidatedAttribute(dataset, KEA_CONSOLIDATED_WKT, this->spatialInfoFile->wktString);
     }
     
-    void KEAImageIO::setGCPs(std::vector<KEAImageGCP*> *gcps, const std::string &projWKT)
+    void KEAImageIO::rebuildConsolidatedHeader()
     {
-        kealib::kea_lock lock(*this->m_mutex); 
-        KEAStackPrintState printState;
-        if(!this->fileOpen)
+        // read everything from the separate datasets
+        this->consolidatedHeader = false;
+        this->bandInfo.clear();
+        for( uint32_t band = 1; band <= this->numImgBands; band++ )
+        {
+            // the published band info may be stale while bands are being changed
+            KEAImmutableBandInfo immutableInfo = KEAImageIO::readImmutableBandInfo(this->keaImgFile, band);
+            KEABandInfo info;
+            info.description = this->getImageBandDescription(band);
+            info.dataType = immutableInfo.dataType;
+            info.blockXSize = immutableInfo.blockXSize;
+            info.blockYSize = immutableInfo.blockYSize;
+            info.layerType = this->getImageBandLayerType(band);
+            info.clrInterp = this->getImageBandClrInterp(band);
+            this->bandInfo.push_back(info);
+        }
+        this->consolidatedHeader = true;
+        this->writeConsolidatedHeader();
+    }
+    
+    // the chunks of an image dataset (0 if it isn't chunked) and whether it is bit packed
+    static void readChunkLayout(const HighFive::DataSet &dataset, KEAImmutableBandInfo *info)
+    {
+        info->chunkXSize = 0;
+        info->chunkYSize = 0;
+        hsize_t chunkDims[2];
+        auto createProps = dataset.getCreatePropertyList();
+        if( (H5Pget_layout(createProps.getId()) == H5D_CHUNKED) && 
+            (H5Pget_chunk(createProps.getId(), 2, chunkDims) == 2) )
         {
-            throw KEAIOException("Image was not open.");
+            info->chunkXSize = static_cast<uint32_t>(chunkDims[1]);
+            info->chunkYSize = static_cast<uint32_t>(chunkDims[0]);
         }
+        info->nBits = 0;
+        if( dataset.hasAttribute(KEA_ATTRIBUTENAME_NBITS) )
+        {
+            info->nBits = dataset.getAttribute(KEA_ATTRIBUTENAME_NBITS).read<uint8_t>();
+        }
+    }
+    
+    KEAImmutableBandInfo KEAImageIO::readImmutableBandInfo(HighFive::File *keaImgH5File, uint32_t band)
+    {
+        KEAImmutableBandInfo info;
+        info.dataType = kea_undefined;
+        info.blockXSize = 0;
+        info.blockYSize = 0;
+        info.chunkXSize = 0;
+        info.chunkYSize = 0;
+        info.nBits = 0;
         
-        uint32_t numGCPs = gcps->size();
-        
-        KEAImageGCP_HDF5 *gcpsHDF = new KEAImageGCP_HDF5[numGCPs];
-        uint32_t i = 0;
-        for(auto iterGCP = gcps->begin(); iterGCP != gcps->end(); ++iterGCP)
+        std::string bandName = KEA_DATASETNAME_BAND + uint2Str(band);
+        try
         {
-            // Copy the char from one to the other for PSZ ID.
-            const size_t lenPSZId = strlen((*iterGCP)->pszId.c_str());
-            gcpsHDF[i].pszId = new char[lenPSZId + 1];
-            strncpy(gcpsHDF[i].pszId, (*iterGCP)->pszId.c_str(), lenPSZId);
-            gcpsHDF[i].pszId[lenPSZId] = '\0';
-            
-            // Copy the char from one to the other for PSZ INFO.
-            const size_t lenPSZInfo = strlen((*iterGCP)->pszInfo.c_str());
-            gcpsHDF[i].pszInfo = new char[lenPSZInfo + 1];
-            strncpy(gcpsHDF[i].pszInfo, (*iterGCP)->pszInfo.c_str(), lenPSZInfo);
-            gcpsHDF[i].pszInfo[lenPSZInfo] = '\0';
-            
-            gcpsHDF[i].dfGCPPixel = (*iterGCP)->dfGCPPixel;
-            gcpsHDF[i].dfGCPLine = (*iterGCP)->dfGCPLine;
-            gcpsHDF[i].dfGCPX = (*iterGCP)->dfGCPX;
-            gcpsHDF[i].dfGCPY = (*iterGCP)->dfGCPY;
-            gcpsHDF[i].dfGCPZ = (*iterGCP)->dfGCPZ;            
-            
-            ++i;
+            auto datasetBandDataType = keaImgH5File->getDataSet(bandName + KEA_BANDNAME_DT);
+            uint32_t value = 0;
+            datasetBandDataType.read(value);
+            info.dataType = (KEADataType)value;
+        }
+        catch ( const HighFive::Exception &e)
+        {
+            // leave undefined, the getter will complain
         }
         
         try
         {
-            // Open or create the GCPs dataset 
-            auto fieldDtMem = this->createGCPCompType();
-            if( this->keaImgFile->exist(KEA_GCPS_DATA))
-            {
-                auto gcpsDataset = this->keaImgFile->getDataSet(KEA_GCPS_DATA);
-                auto gcpsDataDims = gcpsDataset.getDimensions();
-                
-                if(numGCPs > gcpsDataDims[0])
-                {
-                    std::vector<size_t> dims;
-                    dims.push_back(numGCPs);
-                    gcpsDataset.resize(dims);
-                }
-                
-                gcpsDataset.write(gcpsHDF);
-            }
-            else
-            {
-                // https://github.com/highfive-devs/highfive/blob/main/src/examples/create_datatype.cpp
-                // allow the number of GCPs to grow
-                std::vector<size_t> dims = {numGCPs};
-                std::vector<size_t> maxdims = {HighFive::DataSpace::UNLIMITED};
-                HighFive::DataSpace gcpsDataSpace = HighFive::DataSpace(dims, maxdims);
-                
-                HighFive::DataSetCreateProps creationGCPsDSPList;
-                creationGCPsDSPList.add(HighFive::Chunking(numGCPs));
-                creationGCPsDSPList.add(HighFive::Shuffle());
-                creationGCPsDSPList.add(HighFive::Deflate(KEA_DEFLATE));
-                
-                // don't commit data type - HDF5 will put data type in file right here
-
-                auto gcpsDataset = this->keaImgFile->createDataSet(KEA_GCPS_DATA, gcpsDataSpace, fieldDtMem, creationGCPsDSPList);
-                gcpsDataset.write(gcpsHDF);
-            }
-            
-            
-            if( !this->keaImgFile->exist(KEA_GCPS_NUM))
+            auto imgBandDataset = keaImgH5File->getDataSet(bandName + KEA_BANDNAME_DATA);
+            readBlockSizeAttributes(imgBandDataset, &info.blockXSize, &info.blockYSize);
+            readChunkLayout(imgBandDataset, &info);
+        }
+        catch ( const HighFive::Exception &e)
+        {
+            // leave as 0, the getter will complain
+        }
+        
+        return info;
+    }
+    
+    void KEAImageIO::publishImmutableBandInfo()
+    {
+        auto bandInfoList = std::make_shared<std::vector<KEAImmutableBandInfo> >(this->numImgBands);
+        for( uint32_t band = 1; band <= this->numImgBands; band++ )
+        {
+            KEAImmutableBandInfo &info = (*bandInfoList)[band - 1];
+            if( this->consolidatedHeader && (this->bandInfo.at(band - 1).blockXSize != 0) )
             {
-        		// TODO: dataspace instead of scalar to be compatible with old KEA
-				HighFive::DataSpace dataSpace = HighFive::DataSpace({1});
-                this->keaImgFile->createDataSet<uint32_t>(KEA_GCPS_NUM, dataSpace).write(numGCPs);
+                info.dataType = this->bandInfo.at(band - 1).dataType;
+                info.blockXSize = this->bandInfo.at(band - 1).blockXSize;
+                info.blockYSize = this->bandInfo.at(band - 1).blockYSize;
+                info.chunkXSize = 0;
+                info.chunkYSize = 0;
+                info.nBits = 0;
+#ifdef LIBKEA_WITH_IO_STATISTICS
+                // only needed for counting chunks so not in the consolidated header
+                readChunkLayout(this->keaImgFile->getDataSet(KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_DATA), &info);
+#endif
             }
             else
             {
-                auto numGCPsDataset = this->keaImgFile->getDataSet(KEA_GCPS_NUM);
-                numGCPsDataset.write(numGCPs);
+                info = KEAImageIO::readImmutableBandInfo(this->keaImgFile, band);
             }
-            
-            // Flushing the dataset
-            this->keaImgFile->flush();
         }
-        catch (const HighFive::Exception &e)
+        std::shared_ptr<const std::vector<KEAImmutableBandInfo> > published = bandInfoList;
+        std::atomic_store(&this->immutableBandInfo, published);
+    }
+    
+    std::shared_ptr<const std::vector<KEAImmutableBandInfo> > KEAImageIO::getImmutableBandInfo()
+    {
+        auto bandInfoList = std::atomic_load(&this->immutableBandInfo);
+        if( !bandInfoList )
         {
-            throw KEAIOException(e.what());
+            throw KEAIOException("Image was not open.");
         }
-        catch ( const KEAIOException &e)
+        return bandInfoList;
+    }
+    
+    std::shared_ptr<kea_mutex> KEAImageIO::getBandMutex(uint32_t band)
+    {
+        if (band == 0)
         {
-            throw e;
+            throw KEAIOException("KEA Image Bands start at 1.");
         }
-        catch ( const std::exception &e)
+        else if (band > this->bandMutexes.size())
         {
-            throw KEAIOException(e.what());
+            throw KEAIOException("Band is not present within image.");
         }
-        
-        for(uint32_t j = 0; j < i; j++)
+#ifdef H5_HAVE_THREADSAFE
+        return this->bandMutexes[band - 1];
+#else
+        // calls into HDF5 can't overlap anyway
+        return this->m_mutex;
+#endif
+    }
+    
+    void KEAImageIO::updateBandMutexes()
+    {
+        // keep the existing ones, attribute tables may hold them
+        while (this->bandMutexes.size() < this->numImgBands)
         {
-            delete[] gcpsHDF[j].pszId;
-            delete[] gcpsHDF[j].pszInfo;
+            this->bandMutexes.push_back(std::make_shared<kea_mutex>());
         }
-        
-        delete[] gcpsHDF;
-                
-        // Set the projection string
-        try
+        this->bandMutexes.resize(this->numImgBands);
+#ifdef LIBKEA_WITH_IO_STATISTICS
+        while (this->bandIOCounters.size() < this->numImgBands)
         {
-            this->setGCPProjection(projWKT);
+            this->bandIOCounters.push_back(std::unique_ptr<KEAIOCounters>(new KEAIOCounters()));
         }
-        catch ( const KEAIOException &e)
+        this->bandIOCounters.resize(this->numImgBands);
+#endif
+    }
+    
+#ifdef LIBKEA_WITH_IO_STATISTICS
+    KEAIOCounters KEAImageIO::globalIOCounters;
+
+    // the number of chunks a window of pixels touches. For bit
+    // packed datasets the chunks are in bytes rather than pixels.
+    static uint64_t countChunks(const KEAImmutableBandInfo &chunkLayout, uint64_t xPxlOff, uint64_t yPxlOff, 
+        uint64_t xSize, uint64_t ySize)
+    {
+        if( (xSize == 0) || (ySize == 0) || (chunkLayout.chunkXSize == 0) || (chunkLayout.chunkYSize == 0) )
         {
-            throw e;
+            // nothing read, or contiguous, compact or virtual
+            return 0;
         }
-        catch ( const std::exception &e)
+        uint64_t xStart = xPxlOff;
+        uint64_t xEnd = xPxlOff + xSize - 1;
+        if( chunkLayout.nBits > 0 )
         {
-            throw KEAIOException(e.what());
+            xStart = (xStart * chunkLayout.nBits) / 8;
+            xEnd = (xEnd * chunkLayout.nBits) / 8;
         }
+        uint64_t yEnd = yPxlOff + ySize - 1;
+        return ((xEnd / chunkLayout.chunkXSize) - (xStart / chunkLayout.chunkXSize) + 1) * 
+            ((yEnd / chunkLayout.chunkYSize) - (yPxlOff / chunkLayout.chunkYSize) + 1);
     }
     
-    uint32_t KEAImageIO::getGCPCount()
+    void KEAImageIO::countIO(uint32_t band, bool write, uint64_t xPxlOff, uint64_t yPxlOff, 
+        uint64_t xSize, uint64_t ySize, KEADataType inDataType, const KEAIOTimer &ioTimer, uint64_t lockNanos)
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        auto bandInfoList = this->getImmutableBandInfo();
+        this->addIOCounts(band, write, bandInfoList->at(band - 1), xPxlOff, yPxlOff, xSize, ySize, 
+            inDataType, ioTimer, lockNanos);
+    }
+    
+    void KEAImageIO::countIO(uint32_t band, bool write, const HighFive::DataSet &dataset, uint64_t xPxlOff, 
+        uint64_t yPxlOff, uint64_t xSize, uint64_t ySize, KEADataType inDataType, const KEAIOTimer &ioTimer, 
+        uint64_t lockNanos)
+    {
+        KEAImmutableBandInfo chunkLayout;
+        readChunkLayout(dataset, &chunkLayout);
+        this->addIOCounts(band, write, chunkLayout, xPxlOff, yPxlOff, xSize, ySize, 
+            inDataType, ioTimer, lockNanos);
+    }
+    
+    void KEAImageIO::addIOCounts(uint32_t band, bool write, const KEAImmutableBandInfo &chunkLayout, uint64_t xPxlOff, 
+        uint64_t yPxlOff, uint64_t xSize, uint64_t ySize, KEADataType inDataType, const KEAIOTimer &ioTimer, 
+        uint64_t lockNanos)
+    {
+        uint64_t ioNanos = ioTimer.elapsed();
+        uint64_t bytes = xSize * ySize * convertDatatypeKeaToH5Native(inDataType).getSize();
+        uint64_t chunks = countChunks(chunkLayout, xPxlOff, yPxlOff, xSize, ySize);
+        KEAIOCounters *counters[] = {&this->ioCounters, this->bandIOCounters[band - 1].get(), 
+            &KEAImageIO::globalIOCounters};
+        for( KEAIOCounters *pCounters : counters )
+        {
+            if( write )
+            {
+                pCounters->addWrite(bytes, chunks, ioNanos, lockNanos);
+            }
+            else
+            {
+                pCounters->addRead(bytes, chunks, ioNanos, lockNanos);
+            }
+        }
+    }
+    
+    void KEAImageIO::flushFile()
+    {
+        KEATraceScope trace("flush");
+        KEAIOTimer timer;
+        this->keaImgFile->flush();
+        uint64_t nanos = timer.elapsed();
+        this->ioCounters.addFlush(nanos);
+        KEAImageIO::globalIOCounters.addFlush(nanos);
+    }
+#else
+    void KEAImageIO::countIO(uint32_t, bool, uint64_t, uint64_t, 
+        uint64_t, uint64_t, KEADataType, const KEAIOTimer&, uint64_t)
+    {
+    }
+    
+    void KEAImageIO::countIO(uint32_t, bool, const HighFive::DataSet&, uint64_t, uint64_t, 
+        uint64_t, uint64_t, KEADataType, const KEAIOTimer&, uint64_t)
+    {
+    }
+    
+    void KEAImageIO::flushFile()
+    {
+        KEATraceScope trace("flush");
+        this->keaImgFile->flush();
+    }
+#endif
+
+    KEAIOStatistics KEAImageIO::getIOStatistics(uint32_t band)
+    {
+        kealib::kea_read_lock lock(*this->m_mutex);
         KEAStackPrintState printState;
-        if(!this->fileOpen)
+        KEAIOStatistics stats;
+        memset(&stats, 0, sizeof(stats));
+        stats.metadataCacheHitRate = -1;
+        // the object's counters are still there after it is closed
+        if( (band > 0) && (!this->fileOpen || (band > this->numImgBands)) )
         {
-            throw KEAIOException("Image was not open.");
+            throw KEAIOException("Band is not present within image.");
         }
-        
-        // READ NUMBER OF GCPs
-        uint32_t numGCPs = 0;
-        try
+#ifdef LIBKEA_WITH_IO_STATISTICS
+        if( band == 0 )
         {
-            auto numGCPsDataset = this->keaImgFile->getDataSet(KEA_GCPS_NUM);
-            numGCPsDataset.read(numGCPs);
+            this->ioCounters.get(&stats);
         }
-        catch ( const HighFive::Exception &e)
+        else
         {
-            throw KEAIOException("Unable to read number of GCPs");
+            this->bandIOCounters[band - 1]->get(&stats);
         }
-        
-        return numGCPs;
+        double hitRate = 0;
+        if( this->fileOpen && (H5Fget_mdc_hit_rate(this->keaImgFile->getId(), &hitRate) >= 0) )
+        {
+            stats.metadataCacheHitRate = hitRate;
+        }
+#endif
+        return stats;
     }
     
-    std::string KEAImageIO::getGCPProjection()
+    void KEAImageIO::resetIOStatistics()
+    {
+        kealib::kea_read_lock lock(*this->m_mutex);
+#ifdef LIBKEA_WITH_IO_STATISTICS
+        this->ioCounters.reset();
+        for( auto &counters : this->bandIOCounters )
+        {
+            counters->reset();
+        }
+#endif
+    }
+    
+    KEAIOStatistics KEAImageIO::getGlobalIOStatistics()
+    {
+        KEAIOStatistics stats;
+        memset(&stats, 0, sizeof(stats));
+        stats.metadataCacheHitRate = -1;
+#ifdef LIBKEA_WITH_IO_STATISTICS
+        KEAImageIO::globalIOCounters.get(&stats);
+#endif
+        return stats;
+    }
+    
+    void KEAImageIO::resetGlobalIOStatistics()
+    {
+#ifdef LIBKEA_WITH_IO_STATISTICS
+        KEAImageIO::globalIOCounters.reset();
+#endif
+    }
+    
+    void KEAImageIO::undefineNoDataValue(uint32_t band)
     {
         kealib::kea_lock lock(*this->m_mutex); 
         KEAStackPrintState printState;
@@ -1608,46 +3187,114 @@ namespace kealib{
             throw KEAIOException("Image was not open.");
         }
         
-        // READ WKT STRING
-        std::string gcpProj = "";
+        std::string noDataValPath = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_NO_DATA_VAL;
+        
+        // UNDEFINE THE NO DATA VALUE
         try
         {
-            auto datasetGCPSpatialReference = this->keaImgFile->getDataSet( KEA_GCPS_PROJ );
-            datasetGCPSpatialReference.read(gcpProj);
+            auto datasetBandDataType = keaImgFile->getDataSet(noDataValPath);
+            int8_t val = 0;
+            if( datasetBandDataType.hasAttribute(KEA_NODATA_DEFINED))
+            {
+                auto attribset = datasetBandDataType.getAttribute(KEA_NODATA_DEFINED);
+                attribset.write(val);
+            }
+            else
+            {
+                datasetBandDataType.createAttribute(KEA_NODATA_DEFINED, &val);
+            }
+            this->noDataCache.erase(band);
+            if( this->consolidatedHeader )
+            {
+                this->writeConsolidatedHeader();
+            }
+            // Flushing the dataset
+            this->flushFile();
         }
         catch ( const HighFive::Exception &e)
         {
-            throw KEAIOException("The spatial reference was not specified.");
+            throw KEAIOException("The image band no data value had not been created.");
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
         }
-        
-        return gcpProj;
     }
     
-    void KEAImageIO::setGCPProjection(const std::string &projWKT)
+    std::vector<KEAImageGCP*>* KEAImageIO::getGCPs()
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex); 
         KEAStackPrintState printState;
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
-        // SET THE WKT STRING SPATIAL REFERENCE IN GLOBAL HEADER
+        std::vector<KEAImageGCP*> *gcps = new std::vector<KEAImageGCP*>();
+        
         try
-        {
-            if( this->keaImgFile->exist(KEA_GCPS_PROJ))
+        {            
+            uint32_t numGCPs = 0;
+            // Get the number of GCPs
+            try
             {
-                auto datasetSpatialReference = this->keaImgFile->getDataSet(KEA_GCPS_PROJ);
-                datasetSpatialReference.write(projWKT);
+                auto numGCPsDataset = this->keaImgFile->getDataSet(KEA_GCPS_NUM);
+                numGCPsDataset.read(numGCPs);
             }
-            else
+            catch (const HighFive::Exception &e)
             {
-        		// TODO: dataspace instead of scalar to be compatible with old KEA
-                HighFive::DataSpace dataSpace = HighFive::DataSpace({1});
-                auto datasetSpatialReference = this->keaImgFile->createDataSet(KEA_GCPS_PROJ, dataSpace, HighFive::VariableLengthStringType());
-                datasetSpatialReference.write(projWKT);
+                throw KEAIOException("Could not read the number of GCPs.");
+            }
+            catch ( const KEAIOException &e)
+            {
+                throw e;
+            }
+            catch ( const std::exception &e)
+            {
+                throw KEAIOException(e.what());
+            }
+
+            KEAImageGCP_HDF5 *gcpsHDF = new KEAImageGCP_HDF5[numGCPs];
+            
+            try
+            {
+                // Open the GCPs dataset 
+                if( this->keaImgFile->exist(KEA_GCPS_DATA))
+                {
+                    auto gcpsDataset = this->keaImgFile->getDataSet(KEA_GCPS_DATA);
+                    gcpsDataset.read_raw(gcpsHDF);
+                }
+                else
+                {
+                    throw KEAIOException("Unable to read GCPs");
+                }
+            }
+            catch( const HighFive::Exception &e )
+            {
+                throw KEAIOException(e.what());
             }
-            this->keaImgFile->flush();
+            
+            KEAImageGCP *tmpGCP = nullptr;
+            for(uint32_t i = 0; i < numGCPs; ++i)
+            {
+                tmpGCP = new KEAImageGCP();
+                tmpGCP->pszId = std::string(gcpsHDF[i].pszId);
+                free(gcpsHDF[i].pszId);
+                tmpGCP->pszInfo = std::string(gcpsHDF[i].pszInfo);
+                free(gcpsHDF[i].pszInfo);
+                tmpGCP->dfGCPLine = gcpsHDF[i].dfGCPLine;
+                tmpGCP->dfGCPPixel = gcpsHDF[i].dfGCPPixel;
+                tmpGCP->dfGCPX = gcpsHDF[i].dfGCPX;
+                tmpGCP->dfGCPY = gcpsHDF[i].dfGCPY;
+                tmpGCP->dfGCPZ = gcpsHDF[i].dfGCPZ;
+                gcps->push_back(tmpGCP);
+            }
+            
+            delete[] gcpsHDF;
         }
         catch (const HighFive::Exception &e)
         {
@@ -1661,9 +3308,11 @@ namespace kealib{
         {
             throw KEAIOException(e.what());
         }
+        
+        return gcps;
     }
     
-    void KEAImageIO::setSpatialInfo(KEAImageSpatialInfo *inSpatialInfo)
+    void KEAImageIO::setGCPs(std::vector<KEAImageGCP*> *gcps, const std::string &projWKT)
     {
         kealib::kea_lock lock(*this->m_mutex); 
         KEAStackPrintState printState;
@@ -1672,12 +3321,225 @@ namespace kealib{
             throw KEAIOException("Image was not open.");
         }
         
-        try 
+        uint32_t numGCPs = gcps->size();
+        
+        KEAImageGCP_HDF5 *gcpsHDF = new KEAImageGCP_HDF5[numGCPs];
+        uint32_t i = 0;
+        for(auto iterGCP = gcps->begin(); iterGCP != gcps->end(); ++iterGCP)
         {
-            // SET X AND Y TL IN GLOBAL HEADER
-            std::vector<double> tlCoordsSpatial(2);
-            tlCoordsSpatial[0] = double(inSpatialInfo->tlX);
-            tlCoordsSpatial[1] = double(inSpatialInfo->tlY);
+            // Copy the char from one to the other for PSZ ID.
+            const size_t lenPSZId = strlen((*iterGCP)->pszId.c_str());
+            gcpsHDF[i].pszId = new char[lenPSZId + 1];
+            strncpy(gcpsHDF[i].pszId, (*iterGCP)->pszId.c_str(), lenPSZId);
+            gcpsHDF[i].pszId[lenPSZId] = '\0';
+            
+            // Copy the char from one to the other for PSZ INFO.
+            const size_t lenPSZInfo = strlen((*iterGCP)->pszInfo.c_str());
+            gcpsHDF[i].pszInfo = new char[lenPSZInfo + 1];
+            strncpy(gcpsHDF[i].pszInfo, (*iterGCP)->pszInfo.c_str(), lenPSZInfo);
+            gcpsHDF[i].pszInfo[lenPSZInfo] = '\0';
+            
+            gcpsHDF[i].dfGCPPixel = (*iterGCP)->dfGCPPixel;
+            gcpsHDF[i].dfGCPLine = (*iterGCP)->dfGCPLine;
+            gcpsHDF[i].dfGCPX = (*iterGCP)->dfGCPX;
+            gcpsHDF[i].dfGCPY = (*iterGCP)->dfGCPY;
+            gcpsHDF[i].dfGCPZ = (*iterGCP)->dfGCPZ;            
+            
+            ++i;
+        }
+        
+        try
+        {
+            // Open or create the GCPs dataset 
+            auto fieldDtMem = this->createGCPCompType();
+            if( this->keaImgFile->exist(KEA_GCPS_DATA))
+            {
+                auto gcpsDataset = this->keaImgFile->getDataSet(KEA_GCPS_DATA);
+                auto gcpsDataDims = gcpsDataset.getDimensions();
+                
+                if(numGCPs > gcpsDataDims[0])
+                {
+                    std::vector<size_t> dims;
+                    dims.push_back(numGCPs);
+                    gcpsDataset.resize(dims);
+                }
+                
+                gcpsDataset.write(gcpsHDF);
+            }
+            else
+            {
+                // https://github.com/highfive-devs/highfive/blob/main/src/examples/create_datatype.cpp
+                // allow the number of GCPs to grow
+                std::vector<size_t> dims = {numGCPs};
+                std::vector<size_t> maxdims = {HighFive::DataSpace::UNLIMITED};
+                HighFive::DataSpace gcpsDataSpace = HighFive::DataSpace(dims, maxdims);
+                
+                HighFive::DataSetCreateProps creationGCPsDSPList;
+                creationGCPsDSPList.add(HighFive::Chunking(numGCPs));
+                creationGCPsDSPList.add(HighFive::Shuffle());
+                creationGCPsDSPList.add(HighFive::Deflate(KEA_DEFLATE));
+                
+                // don't commit data type - HDF5 will put data type in file right here
+
+                auto gcpsDataset = this->keaImgFile->createDataSet(KEA_GCPS_DATA, gcpsDataSpace, fieldDtMem, creationGCPsDSPList);
+                gcpsDataset.write(gcpsHDF);
+            }
+            
+            
+            if( !this->keaImgFile->exist(KEA_GCPS_NUM))
+            {
+        		// TODO: dataspace instead of scalar to be compatible with old KEA
+				HighFive::DataSpace dataSpace = HighFive::DataSpace({1});
+                this->keaImgFile->createDataSet<uint32_t>(KEA_GCPS_NUM, dataSpace).write(numGCPs);
+            }
+            else
+            {
+                auto numGCPsDataset = this->keaImgFile->getDataSet(KEA_GCPS_NUM);
+                numGCPsDataset.write(numGCPs);
+            }
+            
+            // Flushing the dataset
+            this->flushFile();
+        }
+        catch (const HighFive::Exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        
+        for(uint32_t j = 0; j < i; j++)
+        {
+            delete[] gcpsHDF[j].pszId;
+            delete[] gcpsHDF[j].pszInfo;
+        }
+        
+        delete[] gcpsHDF;
+                
+        // Set the projection string
+        try
+        {
+            this->setGCPProjection(projWKT);
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+    }
+    
+    uint32_t KEAImageIO::getGCPCount()
+    {
+        kealib::kea_read_lock lock(*this->m_mutex); 
+        KEAStackPrintState printState;
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        // READ NUMBER OF GCPs
+        uint32_t numGCPs = 0;
+        try
+        {
+            auto numGCPsDataset = this->keaImgFile->getDataSet(KEA_GCPS_NUM);
+            numGCPsDataset.read(numGCPs);
+        }
+        catch ( const HighFive::Exception &e)
+        {
+            throw KEAIOException("Unable to read number of GCPs");
+        }
+        
+        return numGCPs;
+    }
+    
+    std::string KEAImageIO::getGCPProjection()
+    {
+        kealib::kea_read_lock lock(*this->m_mutex); 
+        KEAStackPrintState printState;
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        // READ WKT STRING
+        std::string gcpProj = "";
+        try
+        {
+            auto datasetGCPSpatialReference = this->keaImgFile->getDataSet( KEA_GCPS_PROJ );
+            datasetGCPSpatialReference.read(gcpProj);
+        }
+        catch ( const HighFive::Exception &e)
+        {
+            throw KEAIOException("The spatial reference was not specified.");
+        }
+        
+        return gcpProj;
+    }
+    
+    void KEAImageIO::setGCPProjection(const std::string &projWKT)
+    {
+        kealib::kea_lock lock(*this->m_mutex); 
+        KEAStackPrintState printState;
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        // SET THE WKT STRING SPATIAL REFERENCE IN GLOBAL HEADER
+        try
+        {
+            if( this->keaImgFile->exist(KEA_GCPS_PROJ))
+            {
+                auto datasetSpatialReference = this->keaImgFile->getDataSet(KEA_GCPS_PROJ);
+                datasetSpatialReference.write(projWKT);
+            }
+            else
+            {
+        		// TODO: dataspace instead of scalar to be compatible with old KEA
+                HighFive::DataSpace dataSpace = HighFive::DataSpace({1});
+                auto datasetSpatialReference = this->keaImgFile->createDataSet(KEA_GCPS_PROJ, dataSpace, HighFive::VariableLengthStringType());
+                datasetSpatialReference.write(projWKT);
+            }
+            this->flushFile();
+        }
+        catch (const HighFive::Exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+    }
+    
+    void KEAImageIO::setSpatialInfo(KEAImageSpatialInfo *inSpatialInfo)
+    {
+        kealib::kea_lock lock(*this->m_mutex); 
+        KEAStackPrintState printState;
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        try 
+        {
+            // SET X AND Y TL IN GLOBAL HEADER
+            std::vector<double> tlCoordsSpatial(2);
+            tlCoordsSpatial[0] = double(inSpatialInfo->tlX);
+            tlCoordsSpatial[1] = double(inSpatialInfo->tlY);
             auto spatialTLDataset = keaImgFile->getDataSet(
                 KEA_DATASETNAME_HEADER_TL
             ); // Explicit datatype: IEEE_F64LE
@@ -1706,7 +3568,22 @@ namespace kealib{
                 KEA_DATASETNAME_HEADER_WKT
             );
             datasetSpatialReference.write(inSpatialInfo->wktString);
-            this->keaImgFile->flush();
+            
+            if( inSpatialInfo != this->spatialInfoFile )
+            {
+                this->spatialInfoFile->tlX = inSpatialInfo->tlX;
+                this->spatialInfoFile->tlY = inSpatialInfo->tlY;
+                this->spatialInfoFile->xRes = inSpatialInfo->xRes;
+                this->spatialInfoFile->yRes = inSpatialInfo->yRes;
+                this->spatialInfoFile->xRot = inSpatialInfo->xRot;
+                this->spatialInfoFile->yRot = inSpatialInfo->yRot;
+                this->spatialInfoFile->wktString = inSpatialInfo->wktString;
+            }
+            if( this->consolidatedHeader )
+            {
+                this->writeConsolidatedHeader();
+            }
+            this->flushFile();
         } 
         catch (const HighFive::Exception &e)
         {
@@ -1739,84 +3616,81 @@ namespace kealib{
             throw KEAIOException("Image was not open.");
         }
         
-        return this->numImgBands;
+        return this->getImmutableBandInfo()->size();
     }
 
     uint32_t KEAImageIO::getImageBlockSize(uint32_t band)
     {
-        kealib::kea_lock lock(*this->m_mutex);
-        KEAStackPrintState printState;
+        // no lock needed
         if (!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
+        auto bandInfo = this->getImmutableBandInfo();
         // CHECK PARAMETERS PROVIDED FIT WITHIN IMAGE
         if (band == 0)
         {
             throw KEAIOException("KEA Image Bands start at 1.");
         }
-        else if (band > this->numImgBands)
+        else if (band > bandInfo->size())
         {
             throw KEAIOException("Band is not present within image.");
         }
 
-        uint32_t imgBlockSize = 0;
-
-        // READ IMAGE BLOCK SIZE
-        std::string imageBandPath = KEA_DATASETNAME_BAND + uint2Str(band);
-        if (keaImgFile->exist(imageBandPath + KEA_BANDNAME_DATA))
-        {
-            try
-            {
-                auto imgBandDataset = keaImgFile->getDataSet(imageBandPath + KEA_BANDNAME_DATA);
-
-                if (imgBandDataset.hasAttribute(KEA_ATTRIBUTENAME_BLOCK_SIZE))
-                {
-                    auto imgBandBlockSizeAttribute = imgBandDataset.getAttribute(
-                        KEA_ATTRIBUTENAME_BLOCK_SIZE
-                    );
-                    imgBandBlockSizeAttribute.read(imgBlockSize);
-                }
-                else
-                {
-                    throw KEAIOException(
-                        "The attribute 'BLOCK_SIZE' does not exist for the specified band."
-                    );
-                }
-            }
-            catch (const KEAIOException &e)
-            {
-                throw e;
-            }
-            catch (const HighFive::Exception &e)
-            {
-                throw KEAIOException(e.what());
-            }
-            catch (const std::exception &e)
-            {
-                throw KEAIOException(e.what());
-            }
-        }
-        else
+        uint32_t imgBlockSize = (*bandInfo)[band - 1].blockXSize;
+        if (imgBlockSize == 0)
         {
-            throw KEAIOException("The number of image bands was not specified.");
+            throw KEAIOException(
+                "The attribute 'BLOCK_SIZE' does not exist for the specified band."
+            );
         }
 
         return imgBlockSize;
     }
 
-    uint32_t KEAImageIO::getAttributeTableChunkSize(uint32_t band)
+    void KEAImageIO::getImageBlockSize(uint32_t band, uint32_t *blockXSize, uint32_t *blockYSize)
     {
-        kealib::kea_lock lock(*this->m_mutex); 
-        KEAStackPrintState printState;
-        if(!this->fileOpen)
+        // no lock needed
+        if (!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
-        
-        uint32_t attChunkSize = 0;
-        
-        try 
+        auto bandInfo = this->getImmutableBandInfo();
+        // CHECK PARAMETERS PROVIDED FIT WITHIN IMAGE
+        if (band == 0)
+        {
+            throw KEAIOException("KEA Image Bands start at 1.");
+        }
+        else if (band > bandInfo->size())
+        {
+            throw KEAIOException("Band is not present within image.");
+        }
+
+        const KEAImmutableBandInfo &info = (*bandInfo)[band - 1];
+        if (info.blockXSize == 0)
+        {
+            throw KEAIOException(
+                "The attribute 'BLOCK_SIZE' does not exist for the specified band."
+            );
+        }
+
+        *blockXSize = info.blockXSize;
+        *blockYSize = info.blockYSize;
+    }
+
+    uint32_t KEAImageIO::getAttributeTableChunkSize(uint32_t band)
+    {
+        kealib::kea_read_lock lock(*this->m_mutex);
+        KEAStackPrintState printState;
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        kealib::kea_read_lock bandLock(*this->getBandMutex(band));
+        
+        uint32_t attChunkSize = 0;
+        
+        try 
         {
             // CHECK PARAMETERS PROVIDED FIT WITHIN IMAGE
             if(band == 0)
@@ -1858,50 +3732,24 @@ namespace kealib{
 
     KEADataType KEAImageIO::getImageBandDataType(uint32_t band)
     {
-        kealib::kea_lock lock(*this->m_mutex);
-        KEAStackPrintState printState;
+        // no lock needed
         if (!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
+        auto bandInfo = this->getImmutableBandInfo();
         // CHECK PARAMETERS PROVIDED FIT WITHIN IMAGE
         if (band == 0)
         {
             throw KEAIOException("KEA Image Bands start at 1.");
         }
-        else if (band > this->numImgBands)
+        else if (band > bandInfo->size())
         {
             throw KEAIOException("Band is not present within image.");
         }
 
-        KEADataType imgDataType = kealib::kea_undefined;
-
-        // READ IMAGE DATA TYPE
-        if (keaImgFile->exist(KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_DT))
-        {
-            try
-            {
-                auto datasetBandDataType = keaImgFile->getDataSet(
-                    KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_DT
-                );
-                uint32_t dtValue;
-                datasetBandDataType.read(dtValue);
-                imgDataType = (KEADataType) dtValue;
-            }
-            catch (const KEAIOException &e)
-            {
-                throw e;
-            }
-            catch (const HighFive::Exception &e)
-            {
-                throw KEAIOException(e.what());
-            }
-            catch (const std::exception &e)
-            {
-                throw KEAIOException(e.what());
-            }
-        }
-        else
+        KEADataType imgDataType = (*bandInfo)[band - 1].dataType;
+        if (imgDataType == kea_undefined)
         {
             throw KEAIOException("The number of image bands was not specified.");
         }
@@ -1934,7 +3782,12 @@ namespace kealib{
             uint32_t value = (uint32_t)imgLayerType;
             auto datasetImgLT = this->keaImgFile->getDataSet( KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_TYPE );
             datasetImgLT.write(value);
-            this->keaImgFile->flush();
+            if( this->consolidatedHeader )
+            {
+                this->bandInfo.at(band - 1).layerType = imgLayerType;
+                this->writeConsolidatedHeader();
+            }
+            this->flushFile();
         } 
         catch ( const HighFive::Exception &e) 
         {
@@ -1952,7 +3805,7 @@ namespace kealib{
     
     KEALayerType KEAImageIO::getImageBandLayerType(uint32_t band)
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex); 
         KEAStackPrintState printState;
         if(!this->fileOpen)
         {
@@ -1963,6 +3816,14 @@ namespace kealib{
         uint32_t value;
         try 
         {
+            if( this->consolidatedHeader )
+            {
+                if( (band == 0) || (band > this->bandInfo.size()) )
+                {
+                    throw KEAIOException("Band is not present within image.");
+                }
+                return this->bandInfo.at(band - 1).layerType;
+            }
             auto datasetImgLT = this->keaImgFile->getDataSet( KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_TYPE );
             datasetImgLT.read(value);
         } 
@@ -2005,6 +3866,11 @@ namespace kealib{
                 auto dataset = keaImgFile->getDataSet(datasetName);
                 dataset.write(value);
             }
+            if( this->consolidatedHeader )
+            {
+                this->bandInfo.at(band - 1).clrInterp = imgLayerClrInterp;
+                this->writeConsolidatedHeader();
+            }
         } 
         catch ( const HighFive::Exception &e) 
         {
@@ -2022,7 +3888,7 @@ namespace kealib{
     
     KEABandClrInterp KEAImageIO::getImageBandClrInterp(uint32_t band)
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex); 
         KEAStackPrintState printState;
         if(!this->fileOpen)
         {
@@ -2035,6 +3901,14 @@ namespace kealib{
         std::string datasetName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_USAGE;
         try 
         {
+            if( this->consolidatedHeader )
+            {
+                if( (band == 0) || (band > this->bandInfo.size()) )
+                {
+                    throw KEAIOException("Band is not present within image.");
+                }
+                return this->bandInfo.at(band - 1).clrInterp;
+            }
             auto dataset = keaImgFile->getDataSet(datasetName);
             uint32_t value;
             dataset.read(value);
@@ -2059,12 +3933,13 @@ namespace kealib{
     
     void KEAImageIO::createOverview(uint32_t band, uint32_t overview, uint64_t xSize, uint64_t ySize)
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex);
         KEAStackPrintState printState;
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
+        kealib::kea_lock bandLock(*this->getBandMutex(band));
         
         std::string overviewName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_OVERVIEWSNAME_OVERVIEW + uint2Str(overview);
                 
@@ -2073,22 +3948,28 @@ namespace kealib{
             this->keaImgFile->unlink(overviewName);
         }
 
-        // Find the smallest axis of the image.
-        uint32_t imageBlockSize = this->getImageBlockSize(band);
-        uint64_t minImgDim = xSize < ySize ? xSize : ySize;
-        uint32_t blockSize2Use =
-                imageBlockSize > minImgDim ? minImgDim : imageBlockSize;
+        // same shape blocks as the band, limited to the size of the overview
+        uint32_t imageBlockXSize, imageBlockYSize;
+        this->getImageBlockSize(band, &imageBlockXSize, &imageBlockYSize);
+        uint32_t blockXSize2Use, blockYSize2Use;
+        getChunkShape(xSize, ySize, imageBlockXSize, imageBlockYSize, &blockXSize2Use, &blockYSize2Use);
         
         try 
         {
             KEADataType imgDataType = this->getImageBandDataType(band);
 
-            HighFive::DataSpace dataSpace = HighFive::DataSpace({static_cast<size_t>(ySize), static_cast<size_t>(xSize)});
+            // overviews of 1, 2 and 4 bit bands are packed the same way
+            uint8_t nBits = getDataTypeNBits(imgDataType);
+            uint64_t xSize2Use = xSize;
+            if( nBits > 0 )
+            {
+                xSize2Use = ((xSize * nBits) + 7) / 8;
+            }
+            HighFive::DataSpace dataSpace = HighFive::DataSpace({static_cast<size_t>(ySize), static_cast<size_t>(xSize2Use)});
             HighFive::DataType dataTypeH5 = convertDatatypeKeaToH5STD(imgDataType);
 
             HighFive::DataSetCreateProps imgBandDataSetProps;
-            imgBandDataSetProps.add(HighFive::Chunking(blockSize2Use, blockSize2Use));
-            imgBandDataSetProps.add(HighFive::Shuffle());
+            addImageChunking(imgBandDataSetProps, xSize2Use, blockXSize2Use, blockYSize2Use, nBits > 0);
             imgBandDataSetProps.add(HighFive::Deflate(KEA_DEFLATE));
             int initFillVal = FILL_IMAGE_DATA;
             // HighFive doesn't appear to support this (yet)
@@ -2120,12 +4001,15 @@ namespace kealib{
 			imgBandDataSet.createAttribute(KEA_ATTRIBUTENAME_IMAGE_VERSION,
 				scalar_dataspace,
 				HighFive::FixedLengthStringType(4, HighFive::StringPadding::NullTerminated)).write("1.2");
-            imgBandDataSet.createAttribute<uint16_t>(
-                KEA_ATTRIBUTENAME_BLOCK_SIZE,
-                blockSize2Use
-            );
+            writeBlockSizeAttributes(imgBandDataSet, blockXSize2Use, blockYSize2Use);
             
-            this->keaImgFile->flush();
+            if( nBits > 0 )
+            {
+                imgBandDataSet.createAttribute<uint8_t>(KEA_ATTRIBUTENAME_NBITS, nBits);
+                imgBandDataSet.createAttribute<uint64_t>(KEA_ATTRIBUTENAME_XSIZE, xSize);
+            }
+            
+            this->flushFile();
         }
         catch (const HighFive::Exception &e)
         {
@@ -2143,12 +4027,13 @@ namespace kealib{
     
     void KEAImageIO::removeOverview(uint32_t band, uint32_t overview)
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex);
         KEAStackPrintState printState;
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
+        kealib::kea_lock bandLock(*this->getBandMutex(band));
         
         std::string overviewName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_OVERVIEWSNAME_OVERVIEW + uint2Str(overview);
         
@@ -2157,7 +4042,7 @@ namespace kealib{
             // Try to open dataset with overviewName
             auto imgBandDataset = this->keaImgFile->getDataSet( overviewName );
             this->keaImgFile->unlink(overviewName);
-            this->keaImgFile->flush();
+            this->flushFile();
         }
         catch (const HighFive::Exception &e)
         {
@@ -2175,14 +4060,23 @@ namespace kealib{
     
     uint32_t KEAImageIO::getOverviewBlockSize(uint32_t band, uint32_t overview)
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        uint32_t ovBlockXSize, ovBlockYSize;
+        this->getOverviewBlockSize(band, overview, &ovBlockXSize, &ovBlockYSize);
+        return ovBlockXSize;
+    }
+    
+    void KEAImageIO::getOverviewBlockSize(uint32_t band, uint32_t overview, uint32_t *blockXSize, uint32_t *blockYSize)
+    {
+        kealib::kea_read_lock lock(*this->m_mutex);
         KEAStackPrintState printState;
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
+        kealib::kea_read_lock bandLock(*this->getBandMutex(band));
         
-        uint32_t ovBlockSize = 0;
+        uint32_t ovBlockXSize = 0;
+        uint32_t ovBlockYSize = 0;
         
         try 
         {
@@ -2201,16 +4095,16 @@ namespace kealib{
             {
                 std::string overviewName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_OVERVIEWSNAME_OVERVIEW + uint2Str(overview);
                 auto imgBandDataset = this->keaImgFile->getDataSet( overviewName );
-                
-                auto imgBandBlockSizeAttribute = imgBandDataset.getAttribute(
-                      KEA_ATTRIBUTENAME_BLOCK_SIZE
-                );
-                imgBandBlockSizeAttribute.read(ovBlockSize);
+                readBlockSizeAttributes(imgBandDataset, &ovBlockXSize, &ovBlockYSize);
             } 
             catch ( const HighFive::Exception &e) 
             {
                 throw KEAIOException("Could not retrieve the overview block size.");
             }            
+            if( ovBlockXSize == 0 )
+            {
+                throw KEAIOException("Could not retrieve the overview block size.");
+            }
         }
         catch(const KEAIOException &e)
         {
@@ -2221,17 +4115,21 @@ namespace kealib{
 			throw KEAIOException(e.what());
 		}
         
-        return ovBlockSize;
+        *blockXSize = ovBlockXSize;
+        *blockYSize = ovBlockYSize;
     }
     
     void KEAImageIO::writeToOverview(uint32_t band, uint32_t overview, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeOut, uint64_t ySizeOut, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType)
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        KEAIOTimer lockTimer;
+        kealib::kea_read_lock lock(*this->m_mutex);
         KEAStackPrintState printState;
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
+        kealib::kea_lock bandLock(*this->getBandMutex(band));
+        uint64_t lockNanos = lockTimer.elapsed();
         
         try 
         {
@@ -2252,11 +4150,18 @@ namespace kealib{
             if (this->keaImgFile->exist(overviewName))
             {
                 auto imgBandDataset = this->keaImgFile->getDataSet(overviewName);
+                KEAIOTimer ioTimer;
                 writeImageToDataset(imgBandDataset, data, xPxlOff, yPxlOff, xSizeOut,
                     ySizeOut, xSizeBuf, ySizeBuf, inDataType);
+                this->countIO(band, true, imgBandDataset, xPxlOff, yPxlOff, xSizeOut, ySizeOut, 
+                    inDataType, ioTimer, lockNanos);
                 
-                // Flushing the dataset
-                this->keaImgFile->flush();
+                // Flushing the dataset (not with MPI as a flush is collective
+                // and ranks may be writing different numbers of blocks)
+                if( !this->parallelFile )
+                {
+                    this->flushFile();
+                }
             }
             else
             { 
@@ -2279,12 +4184,15 @@ namespace kealib{
     
     void KEAImageIO::readFromOverview(uint32_t band, uint32_t overview, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeIn, uint64_t ySizeIn, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType)
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        KEAIOTimer lockTimer;
+        kealib::kea_read_lock lock(*this->m_mutex);
         KEAStackPrintState printState;
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
+        kealib::kea_read_lock bandLock(*this->getBandMutex(band));
+        uint64_t lockNanos = lockTimer.elapsed();
 
         try 
         {
@@ -2305,8 +4213,11 @@ namespace kealib{
             if (this->keaImgFile->exist(overviewName))
             {
                 auto imgBandDataset = this->keaImgFile->getDataSet(overviewName);
+                KEAIOTimer ioTimer;
                 readImageFromDataset(imgBandDataset, band, data, xPxlOff, yPxlOff, xSizeIn,
                     ySizeIn, xSizeBuf, ySizeBuf, inDataType);            
+                this->countIO(band, false, imgBandDataset, xPxlOff, yPxlOff, xSizeIn, ySizeIn, 
+                    inDataType, ioTimer, lockNanos);
             }
             else
             {
@@ -2329,12 +4240,13 @@ namespace kealib{
     
     uint32_t KEAImageIO::getNumOfOverviews(uint32_t band)
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex);
         KEAStackPrintState printState;
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
+        kealib::kea_read_lock bandLock(*this->getBandMutex(band));
         
         std::string overviewGroupName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_OVERVIEWS;
         uint32_t numOverviews = 0;
@@ -2361,12 +4273,13 @@ namespace kealib{
     
     void KEAImageIO::getOverviewSize(uint32_t band, uint32_t overview, uint64_t *xSize, uint64_t *ySize)
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex);
         KEAStackPrintState printState;
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
+        kealib::kea_read_lock bandLock(*this->getBandMutex(band));
         
         try 
         {
@@ -2395,6 +4308,11 @@ namespace kealib{
                 
                 *xSize = dims[1];
                 *ySize = dims[0];
+                if( imgBandDataset.hasAttribute(KEA_ATTRIBUTENAME_XSIZE) )
+                {
+                    // bit packed - dims[1] is in bytes
+                    *xSize = imgBandDataset.getAttribute(KEA_ATTRIBUTENAME_XSIZE).read<uint64_t>();
+                }
             } 
             catch(const KEAIOException &e)
             {
@@ -2419,136 +4337,722 @@ namespace kealib{
         }
     }
     
-    KEAAttributeTable* KEAImageIO::getAttributeTable(KEAATTType type, uint32_t band)
+    // an area of a band in pixels, end exclusive
+    struct KEADirtyRegion
     {
-        kealib::kea_lock lock(*this->m_mutex); 
-        KEAStackPrintState printState;
-        KEAAttributeTable *att = nullptr;
-        try 
+        uint64_t x0, y0, x1, y1;
+    };
+
+    // more than this are replaced by their bounding box
+    static const size_t KEA_MAX_DIRTY_REGIONS = 256;
+
+    static void createDirtyRegionsDataSet(HighFive::File *keaImgH5File, const std::string &path)
+    {
+        HighFive::DataSpace dataSpace({0, 4}, {HighFive::DataSpace::UNLIMITED, 4});
+        HighFive::DataSetCreateProps props;
+        props.add(HighFive::Chunking(std::vector<hsize_t>{64, 4}));
+        keaImgH5File->createDataSet<uint64_t>(path, dataSpace, props);
+    }
+
+    static std::vector<KEADirtyRegion> readDirtyRegions(HighFive::File *keaImgH5File, const std::string &path)
+    {
+        auto dataset = keaImgH5File->getDataSet(path);
+        std::vector<uint64_t> values(dataset.getElementCount());
+        if( !values.empty() )
         {
-            if(type == kea_att_mem)
+            dataset.read_raw(values.data());
+        }
+        std::vector<KEADirtyRegion> regions;
+        for( size_t i = 0; (i + 3) < values.size(); i += 4 )
+        {
+            regions.push_back({values[i], values[i + 1], values[i] + values[i + 2], values[i + 1] + values[i + 3]});
+        }
+        return regions;
+    }
+
+    static void writeDirtyRegions(HighFive::File *keaImgH5File, const std::string &path, const std::vector<KEADirtyRegion> &regions)
+    {
+        std::vector<uint64_t> values;
+        for( const KEADirtyRegion &region : regions )
+        {
+            values.push_back(region.x0);
+            values.push_back(region.y0);
+            values.push_back(region.x1 - region.x0);
+            values.push_back(region.y1 - region.y0);
+        }
+        auto dataset = keaImgH5File->getDataSet(path);
+        dataset.resize({regions.size(), 4});
+        if( !values.empty() )
+        {
+            dataset.write_raw(values.data());
+        }
+    }
+
+    // adds region to regions, merging it with any it lines up with so a band
+    // written block by block ends up as one region. Returns false if it was
+    // already covered.
+    static bool addToDirtyRegions(std::vector<KEADirtyRegion> &regions, KEADirtyRegion region)
+    {
+        for( const KEADirtyRegion &existing : regions )
+        {
+            if( (existing.x0 <= region.x0) && (existing.y0 <= region.y0) &&
+                (existing.x1 >= region.x1) && (existing.y1 >= region.y1) )
             {
-                att = kealib::KEAAttributeTableInMem::createKeaAtt(this->keaImgFile, this->m_mutex, band);
+                return false;
             }
-            else if(type == kea_att_file)
+        }
+
+        bool merged = true;
+        while( merged )
+        {
+            merged = false;
+            for( auto itr = regions.begin(); itr != regions.end(); ++itr )
             {
-                att = kealib::KEAAttributeTableFile::createKeaAtt(this->keaImgFile, this->m_mutex, band);
+                bool inside = (region.x0 <= itr->x0) && (region.y0 <= itr->y0) &&
+                    (region.x1 >= itr->x1) && (region.y1 >= itr->y1);
+                bool sameColumns = (itr->x0 == region.x0) && (itr->x1 == region.x1) &&
+                    (itr->y0 <= region.y1) && (region.y0 <= itr->y1);
+                bool sameRows = (itr->y0 == region.y0) && (itr->y1 == region.y1) &&
+                    (itr->x0 <= region.x1) && (region.x0 <= itr->x1);
+                if( inside || sameColumns || sameRows )
+                {
+                    region.x0 = std::min(region.x0, itr->x0);
+                    region.y0 = std::min(region.y0, itr->y0);
+                    region.x1 = std::max(region.x1, itr->x1);
+                    region.y1 = std::max(region.y1, itr->y1);
+                    regions.erase(itr);
+                    merged = true;
+                    break;
+                }
             }
-            else
+        }
+        regions.push_back(region);
+
+        if( regions.size() > KEA_MAX_DIRTY_REGIONS )
+        {
+            KEADirtyRegion bounds = regions[0];
+            for( const KEADirtyRegion &existing : regions )
             {
-                throw KEAATTException("The attribute table type was not recognised.");
+                bounds.x0 = std::min(bounds.x0, existing.x0);
+                bounds.y0 = std::min(bounds.y0, existing.y0);
+                bounds.x1 = std::max(bounds.x1, existing.x1);
+                bounds.y1 = std::max(bounds.y1, existing.y1);
             }
+            regions.assign(1, bounds);
         }
-        catch(const KEAATTException &e)
+        return true;
+    }
+
+    void KEAImageIO::addDirtyRegion(uint32_t band, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSize, uint64_t ySize)
+    {
+        std::string bandPath = KEA_DATASETNAME_BAND + uint2Str(band);
+        if( (xSize == 0) || (ySize == 0) || this->parallelFile ||
+            !this->keaImgFile->exist(bandPath + KEA_BANDNAME_DIRTY) )
         {
-            throw e;
+            return;
         }
-        catch ( const KEAIOException &e)
+
+        // round out to whole blocks
+        uint32_t blockXSize, blockYSize;
+        this->getImageBlockSize(band, &blockXSize, &blockYSize);
+        KEADirtyRegion region;
+        region.x0 = (xPxlOff / blockXSize) * blockXSize;
+        region.y0 = (yPxlOff / blockYSize) * blockYSize;
+        region.x1 = std::min(((xPxlOff + xSize + blockXSize - 1) / blockXSize) * blockXSize, this->spatialInfoFile->xSize);
+        region.y1 = std::min(((yPxlOff + ySize + blockYSize - 1) / blockYSize) * blockYSize, this->spatialInfoFile->ySize);
+
+        for( const std::string &path : {bandPath + KEA_BANDNAME_DIRTY_OVERVIEWS, bandPath + KEA_BANDNAME_DIRTY_STATISTICS} )
         {
-            throw e;
+            std::vector<KEADirtyRegion> regions = readDirtyRegions(this->keaImgFile, path);
+            if( addToDirtyRegions(regions, region) )
+            {
+                writeDirtyRegions(this->keaImgFile, path, regions);
+            }
         }
-        catch ( const std::exception &e)
+    }
+
+    void KEAImageIO::markBandChanged(uint32_t band)
+    {
+        std::string blockStatsPath = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_BLOCK_STATISTICS;
+        if( this->keaImgFile->exist(blockStatsPath) )
         {
-            throw KEAIOException(e.what());
+            this->keaImgFile->unlink(blockStatsPath);
         }
-        
-        return att;
+        this->addDirtyRegion(band, 0, 0, this->spatialInfoFile->xSize, this->spatialInfoFile->ySize);
     }
-    
-    void KEAImageIO::setAttributeTable(KEAAttributeTable* att, uint32_t band, uint32_t chunkSize, uint32_t deflate)
+
+    void KEAImageIO::trackDirtyRegions(uint32_t band, bool track)
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex);
         KEAStackPrintState printState;
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
-        
-        try 
+        if( (band == 0) || (band > this->numImgBands) )
         {
-            auto rat_to = kealib::KEAAttributeTableFile::createKeaAtt(this->keaImgFile, this->m_mutex, band, chunkSize, deflate);
-            kealib::KEAAttributeTable::copyRAT(att, rat_to);
-            delete rat_to;
+            throw KEAIOException("Band is not present within image.");
         }
-        catch(const KEAATTException &e)
+        kealib::kea_lock bandLock(*this->getBandMutex(band));
+
+        try
         {
-            throw e;
+            std::string bandPath = KEA_DATASETNAME_BAND + uint2Str(band);
+            bool tracking = this->keaImgFile->exist(bandPath + KEA_BANDNAME_DIRTY);
+            if( track && !tracking )
+            {
+                this->keaImgFile->createGroup(bandPath + KEA_BANDNAME_DIRTY);
+                // everything is dirty to start with so the first update does the whole band
+                std::vector<KEADirtyRegion> regions = {{0, 0, this->spatialInfoFile->xSize, this->spatialInfoFile->ySize}};
+                for( const std::string &path : {bandPath + KEA_BANDNAME_DIRTY_OVERVIEWS, bandPath + KEA_BANDNAME_DIRTY_STATISTICS} )
+                {
+                    createDirtyRegionsDataSet(this->keaImgFile, path);
+                    writeDirtyRegions(this->keaImgFile, path, regions);
+                }
+            }
+            else if( !track && tracking )
+            {
+                this->keaImgFile->unlink(bandPath + KEA_BANDNAME_DIRTY);
+            }
+            this->flushFile();
         }
-        catch ( const KEAIOException &e)
+        catch (const KEAIOException &e)
         {
             throw e;
         }
-        catch ( const std::exception &e)
+        catch (const HighFive::Exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        catch (const std::exception &e)
         {
             throw KEAIOException(e.what());
         }
     }
-    
-    bool KEAImageIO::attributeTablePresent(uint32_t band)
+
+    bool KEAImageIO::isTrackingDirtyRegions(uint32_t band)
     {
-        kealib::kea_lock lock(*this->m_mutex); 
+        kealib::kea_read_lock lock(*this->m_mutex);
         KEAStackPrintState printState;
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
-        
-        bool attPresent = false;
-        try 
+        if( (band == 0) || (band > this->numImgBands) )
         {
-            std::string bandPathBase = KEA_DATASETNAME_BAND + uint2Str(band);
-            
-            // Read header size.
-            std::vector<uint64_t> attSize;
-            try
+            throw KEAIOException("Band is not present within image.");
+        }
+        kealib::kea_read_lock bandLock(*this->getBandMutex(band));
+
+        try
+        {
+            return this->keaImgFile->exist(KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_DIRTY);
+        }
+        catch (const HighFive::Exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+    }
+
+    static bool isFloatDataType(KEADataType dataType)
+    {
+        return (dataType == kea_16float) || (dataType == kea_32float) || (dataType == kea_64float);
+    }
+
+    void KEAImageIO::updateOverviews(uint32_t band, KEAOverviewResampling resampling)
+    {
+        kealib::kea_read_lock lock(*this->m_mutex);
+        KEAStackPrintState printState;
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        if( (band == 0) || (band > this->numImgBands) )
+        {
+            throw KEAIOException("Band is not present within image.");
+        }
+        kealib::kea_lock bandLock(*this->getBandMutex(band));
+
+        // how much of the band is read at once
+        const uint64_t maxSrcXSize = 4096;
+        const uint64_t maxSrcYSize = 1024;
+
+        try
+        {
+            std::string bandPath = KEA_DATASETNAME_BAND + uint2Str(band);
+            const uint64_t xSize = this->spatialInfoFile->xSize;
+            const uint64_t ySize = this->spatialInfoFile->ySize;
+
+            // everything if we don't know what has changed
+            bool tracking = this->keaImgFile->exist(bandPath + KEA_BANDNAME_DIRTY_OVERVIEWS);
+            std::vector<KEADirtyRegion> regions;
+            if( tracking )
             {
-                auto datasetAttSize = this->keaImgFile->getDataSet( bandPathBase + KEA_ATT_SIZE_HEADER );
-                datasetAttSize.read(attSize);
+                regions = readDirtyRegions(this->keaImgFile, bandPath + KEA_BANDNAME_DIRTY_OVERVIEWS);
             }
-            catch (const HighFive::Exception &e)
+            else
             {
-                throw KEAIOException("The attribute table size field is not present.");
+                regions.push_back({0, 0, xSize, ySize});
             }
-            
-            if(attSize[0] > 0)
+
+            KEADataType dataType = this->getImageBandDataType(band);
+            bool roundValues = !isFloatDataType(dataType);
+            double noData = 0;
+            bool haveNoData = this->getCachedNoDataValue(band, &noData, kea_64float);
+            auto imgBandDataset = this->keaImgFile->getDataSet(bandPath + KEA_BANDNAME_DATA);
+
+            auto overviewGroup = this->keaImgFile->getGroup(bandPath + KEA_BANDNAME_OVERVIEWS);
+            std::vector<double> srcData;
+            std::vector<double> ovData;
+            for( const std::string &overviewName : overviewGroup.listObjectNames() )
             {
-                attPresent = true;
+                auto ovDataset = overviewGroup.getDataSet(overviewName);
+                auto dims = ovDataset.getDimensions();
+                uint64_t ovXSize = dims[1];
+                uint64_t ovYSize = dims[0];
+                if( ovDataset.hasAttribute(KEA_ATTRIBUTENAME_XSIZE) )
+                {
+                    // bit packed - dims[1] is in bytes
+                    ovXSize = ovDataset.getAttribute(KEA_ATTRIBUTENAME_XSIZE).read<uint64_t>();
+                }
+                if( (ovXSize == 0) || (ovYSize == 0) )
+                {
+                    continue;
+                }
+                double xScale = double(xSize) / double(ovXSize);
+                double yScale = double(ySize) / double(ovYSize);
+                // overview pixels per read of the band
+                uint64_t tileXSize = std::max<uint64_t>(1, uint64_t(maxSrcXSize / xScale));
+                uint64_t tileYSize = std::max<uint64_t>(1, uint64_t(maxSrcYSize / yScale));
+
+                for( const KEADirtyRegion &region : regions )
+                {
+                    // the overview pixels that use any of the region
+                    uint64_t ovX0 = uint64_t(std::floor(region.x0 / xScale));
+                    uint64_t ovY0 = uint64_t(std::floor(region.y0 / yScale));
+                    uint64_t ovX1 = std::min(ovXSize, uint64_t(std::ceil(region.x1 / xScale)));
+                    uint64_t ovY1 = std::min(ovYSize, uint64_t(std::ceil(region.y1 / yScale)));
+
+                    for( uint64_t tileY0 = ovY0; tileY0 < ovY1; tileY0 += tileYSize )
+                    {
+                        uint64_t tileY1 = std::min(ovY1, tileY0 + tileYSize);
+                        uint64_t srcY0 = uint64_t(std::floor(tileY0 * yScale));
+                        uint64_t srcY1 = std::min(ySize, uint64_t(std::ceil(tileY1 * yScale)));
+                        for( uint64_t tileX0 = ovX0; tileX0 < ovX1; tileX0 += tileXSize )
+                        {
+                            uint64_t tileX1 = std::min(ovX1, tileX0 + tileXSize);
+                            uint64_t srcX0 = uint64_t(std::floor(tileX0 * xScale));
+                            uint64_t srcX1 = std::min(xSize, uint64_t(std::ceil(tileX1 * xScale)));
+                            uint64_t srcXSize = srcX1 - srcX0;
+                            uint64_t srcYSize = srcY1 - srcY0;
+                            srcData.resize(srcXSize * srcYSize);
+                            this->readImageFromDataset(imgBandDataset, band, srcData.data(), srcX0, srcY0,
+                                srcXSize, srcYSize, srcXSize, srcYSize, kea_64float);
+
+                            uint64_t tileXSizeOut = tileX1 - tileX0;
+                            uint64_t tileYSizeOut = tileY1 - tileY0;
+                            ovData.resize(tileXSizeOut * tileYSizeOut);
+                            for( uint64_t oy = tileY0; oy < tileY1; oy++ )
+                            {
+                                uint64_t sy0 = std::min(srcY1 - 1, uint64_t(std::floor(oy * yScale)));
+                                uint64_t sy1 = std::min(srcY1, std::max(sy0 + 1, uint64_t(std::floor((oy + 1) * yScale))));
+                                for( uint64_t ox = tileX0; ox < tileX1; ox++ )
+                                {
+                                    double value;
+                                    if( resampling == kea_resample_average )
+                                    {
+                                        uint64_t sx0 = std::min(srcX1 - 1, uint64_t(std::floor(ox * xScale)));
+                                        uint64_t sx1 = std::min(srcX1, std::max(sx0 + 1, uint64_t(std::floor((ox + 1) * xScale))));
+                                        double sum = 0;
+                                        uint64_t count = 0;
+                                        for( uint64_t sy = sy0; sy < sy1; sy++ )
+                                        {
+                                            const double *pRow = &srcData[(sy - srcY0) * srcXSize];
+                                            for( uint64_t sx = sx0; sx < sx1; sx++ )
+                                            {
+                                                double srcValue = pRow[sx - srcX0];
+                                                if( !std::isnan(srcValue) && !(haveNoData && (srcValue == noData)) )
+                                                {
+                                                    sum += srcValue;
+                                                    count++;
+                                                }
+                                            }
+                                        }
+                                        if( count > 0 )
+                                        {
+                                            value = sum / count;
+                                            if( roundValues )
+                                            {
+                                                value = std::round(value);
+                                            }
+                                        }
+                                        else
+                                        {
+                                            value = haveNoData ? noData : 0;
+                                        }
+                                    }
+                                    else
+                                    {
+                                        // the pixel under the centre of the overview pixel
+                                        uint64_t sx = std::min(srcX1 - 1, uint64_t(std::floor((ox + 0.5) * xScale)));
+                                        uint64_t sy = std::min(srcY1 - 1, uint64_t(std::floor((oy + 0.5) * yScale)));
+                                        value = srcData[((sy - srcY0) * srcXSize) + (sx - srcX0)];
+                                    }
+                                    ovData[((oy - tileY0) * tileXSizeOut) + (ox - tileX0)] = value;
+                                }
+                            }
+                            this->writeImageToDataset(ovDataset, ovData.data(), tileX0, tileY0,
+                                tileXSizeOut, tileYSizeOut, tileXSizeOut, tileYSizeOut, kea_64float);
+                        }
+                    }
+                }
+            }
+
+            if( tracking )
+            {
+                writeDirtyRegions(this->keaImgFile, bandPath + KEA_BANDNAME_DIRTY_OVERVIEWS, std::vector<KEADirtyRegion>());
             }
+            this->flushFile();
         }
-        catch(const KEAIOException &e)
+        catch (const KEAIOException &e)
         {
             throw e;
         }
-        catch(const KEAATTException &e)
+        catch (const HighFive::Exception &e)
         {
-            throw e;
+            throw KEAIOException(e.what());
         }
-        catch ( const std::exception &e)
+        catch (const std::exception &e)
         {
             throw KEAIOException(e.what());
         }
-        return attPresent;
     }
 
-    /**
-     * Closes the KEA image file and releases associated resources.
-     *
-     * This method ensures that any open KEA image file is properly closed,
-     * releasing memory and file locks, and committing any unsaved changes
-     * to the file. If the file is not open, no action is performed.
-     *
-     * The method handles exceptions from the KEA library, HighFive, or
-     * standard exceptions, wrapping and rethrowing them as KEAIOException
-     * to provide uniform error reporting.
-     *
-     * This function operates under a thread-safe lock to prevent concurrent
-     * access issues when modifying shared resources.
-     *
+    void KEAImageIO::updateStatistics(uint32_t band)
+    {
+        kealib::kea_read_lock lock(*this->m_mutex);
+        KEAStackPrintState printState;
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        if( (band == 0) || (band > this->numImgBands) )
+        {
+            throw KEAIOException("Band is not present within image.");
+        }
+        kealib::kea_lock bandLock(*this->getBandMutex(band));
+
+        // columns of the block statistics
+        const int statCount = 0;
+        const int statSum = 1;
+        const int statSumSq = 2;
+        const int statMin = 3;
+        const int statMax = 4;
+        const size_t numStats = 5;
+
+        try
+        {
+            std::string bandPath = KEA_DATASETNAME_BAND + uint2Str(band);
+            const uint64_t xSize = this->spatialInfoFile->xSize;
+            const uint64_t ySize = this->spatialInfoFile->ySize;
+            uint32_t blockXSize, blockYSize;
+            this->getImageBlockSize(band, &blockXSize, &blockYSize);
+            uint64_t xBlocks = (xSize + blockXSize - 1) / blockXSize;
+            uint64_t yBlocks = (ySize + blockYSize - 1) / blockYSize;
+            size_t numBlocks = xBlocks * yBlocks;
+
+            // only the changed blocks if we know which they are and
+            // have the totals for the others
+            std::string blockStatsPath = bandPath + KEA_BANDNAME_BLOCK_STATISTICS;
+            bool tracking = this->keaImgFile->exist(bandPath + KEA_BANDNAME_DIRTY_STATISTICS);
+            std::vector<double> blockStats(numBlocks * numStats, 0);
+            std::vector<uint64_t> blockGrid = {xSize, ySize, blockXSize, blockYSize};
+            std::vector<KEADirtyRegion> regions;
+            if( this->keaImgFile->exist(blockStatsPath) )
+            {
+                auto blockStatsDataset = this->keaImgFile->getDataSet(blockStatsPath);
+                if( (blockStatsDataset.getElementCount() != blockStats.size()) ||
+                    !blockStatsDataset.hasAttribute(KEA_ATTRIBUTENAME_BLOCK_GRID) ||
+                    (blockStatsDataset.getAttribute(KEA_ATTRIBUTENAME_BLOCK_GRID).read<std::vector<uint64_t>>() != blockGrid) )
+                {
+                    // the image or its blocks have changed size
+                    this->keaImgFile->unlink(blockStatsPath);
+                }
+            }
+            if( tracking && this->keaImgFile->exist(blockStatsPath) )
+            {
+                this->keaImgFile->getDataSet(blockStatsPath).read_raw(blockStats.data());
+                regions = readDirtyRegions(this->keaImgFile, bandPath + KEA_BANDNAME_DIRTY_STATISTICS);
+            }
+            else
+            {
+                regions.push_back({0, 0, xSize, ySize});
+            }
+
+            double noData = 0;
+            bool haveNoData = this->getCachedNoDataValue(band, &noData, kea_64float);
+            auto imgBandDataset = this->keaImgFile->getDataSet(bandPath + KEA_BANDNAME_DATA);
+
+            // regions are aligned to blocks so read a row of blocks at a time
+            std::vector<double> data;
+            for( const KEADirtyRegion &region : regions )
+            {
+                uint64_t regionXSize = region.x1 - region.x0;
+                for( uint64_t by = region.y0 / blockYSize; (by * blockYSize) < region.y1; by++ )
+                {
+                    uint64_t rowY0 = by * blockYSize;
+                    uint64_t rowYSize = std::min<uint64_t>(blockYSize, ySize - rowY0);
+                    data.resize(regionXSize * rowYSize);
+                    this->readImageFromDataset(imgBandDataset, band, data.data(), region.x0, rowY0,
+                        regionXSize, rowYSize, regionXSize, rowYSize, kea_64float);
+                    for( uint64_t bx = region.x0 / blockXSize; (bx * blockXSize) < region.x1; bx++ )
+                    {
+                        double *pStats = &blockStats[((by * xBlocks) + bx) * numStats];
+                        std::fill(pStats, pStats + numStats, 0);
+                        uint64_t colX0 = (bx * blockXSize) - region.x0;
+                        uint64_t colX1 = std::min<uint64_t>(colX0 + blockXSize, regionXSize);
+                        for( uint64_t y = 0; y < rowYSize; y++ )
+                        {
+                            const double *pRow = &data[y * regionXSize];
+                            for( uint64_t x = colX0; x < colX1; x++ )
+                            {
+                                double value = pRow[x];
+                                if( std::isnan(value) || (haveNoData && (value == noData)) )
+                                {
+                                    continue;
+                                }
+                                if( pStats[statCount] == 0 )
+                                {
+                                    pStats[statMin] = value;
+                                    pStats[statMax] = value;
+                                }
+                                else
+                                {
+                                    pStats[statMin] = std::min(pStats[statMin], value);
+                                    pStats[statMax] = std::max(pStats[statMax], value);
+                                }
+                                pStats[statCount] += 1;
+                                pStats[statSum] += value;
+                                pStats[statSumSq] += value * value;
+                            }
+                        }
+                    }
+                }
+            }
+
+            if( !this->keaImgFile->exist(blockStatsPath) )
+            {
+                this->keaImgFile->createDataSet<double>(blockStatsPath, HighFive::DataSpace({numBlocks, numStats}))
+                    .createAttribute(KEA_ATTRIBUTENAME_BLOCK_GRID, blockGrid);
+            }
+            if( numBlocks > 0 )
+            {
+                this->keaImgFile->getDataSet(blockStatsPath).write_raw(blockStats.data());
+            }
+            if( tracking )
+            {
+                writeDirtyRegions(this->keaImgFile, bandPath + KEA_BANDNAME_DIRTY_STATISTICS, std::vector<KEADirtyRegion>());
+            }
+
+            // totals for the whole band
+            double count = 0, sum = 0, sumSq = 0, minVal = 0, maxVal = 0;
+            for( size_t block = 0; block < numBlocks; block++ )
+            {
+                const double *pStats = &blockStats[block * numStats];
+                if( pStats[statCount] == 0 )
+                {
+                    continue;
+                }
+                if( count == 0 )
+                {
+                    minVal = pStats[statMin];
+                    maxVal = pStats[statMax];
+                }
+                else
+                {
+                    minVal = std::min(minVal, pStats[statMin]);
+                    maxVal = std::max(maxVal, pStats[statMax]);
+                }
+                count += pStats[statCount];
+                sum += pStats[statSum];
+                sumSq += pStats[statSumSq];
+            }
+
+            if( count > 0 )
+            {
+                double mean = sum / count;
+                double stdDev = std::sqrt(std::max(0.0, (sumSq / count) - (mean * mean)));
+                // the names without the /METADATA/
+                size_t nameStart = KEA_BANDNAME_METADATA.size() + 1;
+                std::vector< std::pair<std::string, std::string> > items;
+                for( auto &stat : std::vector< std::pair<std::string, double> >{
+                        {KEA_BANDNAME_METADATA_MIN.substr(nameStart), minVal},
+                        {KEA_BANDNAME_METADATA_MAX.substr(nameStart), maxVal},
+                        {KEA_BANDNAME_METADATA_MEAN.substr(nameStart), mean},
+                        {KEA_BANDNAME_METADATA_STDDEV.substr(nameStart), stdDev}} )
+                {
+                    std::ostringstream value;
+                    value.precision(15);
+                    value << stat.second;
+                    items.push_back(std::pair<std::string, std::string>(stat.first, value.str()));
+                }
+                this->writeMetaData(bandPath, items);
+            }
+            this->flushFile();
+        }
+        catch (const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch (const HighFive::Exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        catch (const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+    }
+
+    KEAAttributeTable* KEAImageIO::getAttributeTable(KEAATTType type, uint32_t band)
+    {
+        kealib::kea_read_lock lock(*this->m_mutex);
+        KEAStackPrintState printState;
+        kealib::kea_read_lock bandLock(*this->getBandMutex(band));
+        KEAAttributeTable *att = nullptr;
+        try 
+        {
+            if(type == kea_att_mem)
+            {
+                att = kealib::KEAAttributeTableInMem::createKeaAtt(this->keaImgFile, this->getBandMutex(band), band);
+            }
+            else if(type == kea_att_file)
+            {
+                att = kealib::KEAAttributeTableFile::createKeaAtt(this->keaImgFile, this->getBandMutex(band), band);
+            }
+            else
+            {
+                throw KEAATTException("The attribute table type was not recognised.");
+            }
+        }
+        catch(const KEAATTException &e)
+        {
+            throw e;
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        
+        return att;
+    }
+    
+    void KEAImageIO::setAttributeTable(KEAAttributeTable* att, uint32_t band, uint32_t chunkSize, uint32_t deflate)
+    {
+        kealib::kea_read_lock lock(*this->m_mutex);
+        KEAStackPrintState printState;
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        try 
+        {
+            // don't hold the band lock while copying as att may be 
+            // from another band that is doing the same to this one
+            kealib::KEAAttributeTable *rat_to = nullptr;
+            {
+                kealib::kea_lock bandLock(*this->getBandMutex(band));
+                rat_to = kealib::KEAAttributeTableFile::createKeaAtt(this->keaImgFile, this->getBandMutex(band), band, chunkSize, deflate);
+            }
+            kealib::KEAAttributeTable::copyRAT(att, rat_to);
+            delete rat_to;
+        }
+        catch(const KEAATTException &e)
+        {
+            throw e;
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+    }
+    
+    bool KEAImageIO::attributeTablePresent(uint32_t band)
+    {
+        kealib::kea_read_lock lock(*this->m_mutex);
+        KEAStackPrintState printState;
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        kealib::kea_read_lock bandLock(*this->getBandMutex(band));
+        
+        bool attPresent = false;
+        try 
+        {
+            std::string bandPathBase = KEA_DATASETNAME_BAND + uint2Str(band);
+            
+            // Read header size.
+            std::vector<uint64_t> attSize;
+            try
+            {
+                auto datasetAttSize = this->keaImgFile->getDataSet( bandPathBase + KEA_ATT_SIZE_HEADER );
+                datasetAttSize.read(attSize);
+            }
+            catch (const HighFive::Exception &e)
+            {
+                throw KEAIOException("The attribute table size field is not present.");
+            }
+            
+            if(attSize[0] > 0)
+            {
+                attPresent = true;
+            }
+        }
+        catch(const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch(const KEAATTException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        return attPresent;
+    }
+
+    /**
+     * Closes the KEA image file and releases associated resources.
+     *
+     * This method ensures that any open KEA image file is properly closed,
+     * releasing memory and file locks, and committing any unsaved changes
+     * to the file. If the file is not open, no action is performed.
+     *
+     * The method handles exceptions from the KEA library, HighFive, or
+     * standard exceptions, wrapping and rethrowing them as KEAIOException
+     * to provide uniform error reporting.
+     *
+     * This function operates under a thread-safe lock to prevent concurrent
+     * access issues when modifying shared resources.
+     *
      * @throws KEAIOException If an error occurs while flushing the file,
      *                        deleting resources, or any internal operation.
      */
     void KEAImageIO::close()
     {
+        KEATraceScope trace("close");
         kealib::kea_lock lock(*this->m_mutex); 
         KEAStackPrintState printState;
         if (this->fileOpen)
@@ -2556,10 +5060,20 @@ namespace kealib{
             try
             {
                 delete this->spatialInfoFile;
-                this->keaImgFile->flush();
+                this->noDataCache.clear();
+                this->consolidatedHeader = false;
+                this->bandInfo.clear();
+                std::atomic_store(&this->immutableBandInfo, std::shared_ptr<const std::vector<KEAImmutableBandInfo> >());
+                this->bandMutexes.clear();
+#ifdef LIBKEA_WITH_IO_STATISTICS
+                this->bandIOCounters.clear();
+#endif
+                this->flushFile();
                 delete this->keaImgFile;
                 this->keaImgFile = nullptr;
                 this->fileOpen = false;
+                // if it was shared and this was the last user let it close
+                KEAImageIO::releaseSharedKeaH5Files();
             }
             catch(const KEAIOException &e)
             {
@@ -2576,61 +5090,263 @@ namespace kealib{
         }
     }
 
-    HighFive::File *KEAImageIO::createKEAImage(
-        const std::string &fileName, KEADataType dataType, uint32_t xSize,
-        uint32_t ySize, uint32_t numImgBands, std::vector<std::string> *bandDescrips,
-        KEAImageSpatialInfo *spatialInfo, uint32_t imageBlockSize,
-        uint32_t attBlockSize, int mdcElmts, hsize_t rdccNElmts, hsize_t rdccNBytes,
-        double rdccW0, hsize_t sieveBuf, hsize_t metaBlockSize, uint32_t deflate
-    )
+    void KEAImageIO::setCollectiveIO(bool collective)
     {
-        HighFive::File *keaImgH5File = nullptr;
+        kealib::kea_lock lock(*this->m_mutex);
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+#ifdef H5_HAVE_PARALLEL
+        HighFive::DataTransferProps xferProps;
+        xferProps.add(HighFive::UseCollectiveIO(collective));
+        this->pixelXferProps = xferProps;
+#else
+        (void)collective;
+        throw KEAIOException("kealib was not built with parallel HDF5.");
+#endif
+    }
 
-        // Define dataspaces for writing string data
-        auto scalar_dataspace = HighFive::DataSpace(
-            HighFive::DataSpace::dataspace_scalar
-        );
-        auto var_stringtype = HighFive::VariableLengthStringType();
-		// TODO: dataspace instead of scalar to be compatible with old KEA
-        auto oldKeaDataSpace = HighFive::DataSpace({1});
+    void KEAImageIO::startSWMRWrite()
+    {
+        kealib::kea_lock lock(*this->m_mutex);
+        KEAStackPrintState printState;
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
         try
         {
-            auto keaFileAccessProps = HighFive::FileAccessProps::Default();
-            keaFileAccessProps.add(HighFive::MetadataBlockSize(metaBlockSize));
-            // HighFive doesn't seem to support these ones now
-            if( H5Pset_sieve_buf_size(keaFileAccessProps.getId(), sieveBuf) < 0 )
+            this->flushFile();
+            if( H5Fstart_swmr_write(this->keaImgFile->getId()) < 0 )
             {
                 H5Eprint(H5E_DEFAULT, stderr);
-				throw KEAIOException("Error in H5Pset_sieve_buf_size");
+                throw KEAIOException("Error in H5Fstart_swmr_write. Was the file created with swmr=true?");
             }
-            if( H5Pset_cache(keaFileAccessProps.getId(), mdcElmts, rdccNElmts, rdccNBytes, rdccW0) < 0 )
+        }
+        catch ( const HighFive::Exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+    }
+    
+    // refresh everything in group (a group first, then its contents) 
+    // so HDF5 reads them again
+    static void refreshH5GroupContents(const HighFive::Group &group)
+    {
+        for( const std::string &name : group.listObjectNames() )
+        {
+            HighFive::ObjectType objType = group.getObjectType(name);
+            if( objType == HighFive::ObjectType::Group )
             {
-                H5Eprint(H5E_DEFAULT, stderr);
-				throw KEAIOException("Error in H5Pset_cache");
+                auto subGroup = group.getGroup(name);
+                if( H5Orefresh(subGroup.getId()) < 0 )
+                {
+                    throw KEAIOException("Error in H5Orefresh");
+                }
+                refreshH5GroupContents(subGroup);
             }
-
-            keaImgH5File = new HighFive::File(
-                fileName,
-                HighFive::File::Truncate | HighFive::File::Create |
-                HighFive::File::ReadWrite,
-                keaFileAccessProps
-            );
-
-            //////////// CREATE GLOBAL HEADER ////////////////
-            keaImgH5File->createGroup(KEA_DATASETNAME_HEADER);
-
-            bool deleteSpatialInfo = false;
-            if (spatialInfo == nullptr)
+            else if( objType == HighFive::ObjectType::Dataset )
             {
-                spatialInfo = new KEAImageSpatialInfo();
-                spatialInfo->tlX = 0.0;
-                spatialInfo->tlY = 0.0;
-                spatialInfo->xRes = 1.0;
-                spatialInfo->yRes = -1.0;
-                spatialInfo->xRot = 0.0;
-                spatialInfo->yRot = 0.0;
-                spatialInfo->wktString = "";
-                deleteSpatialInfo = true;
+                auto dataset = group.getDataSet(name);
+                if( H5Orefresh(dataset.getId()) < 0 )
+                {
+                    throw KEAIOException("Error in H5Orefresh");
+                }
+            }
+        }
+    }
+    
+    void KEAImageIO::refresh()
+    {
+        kealib::kea_lock lock(*this->m_mutex);
+        KEAStackPrintState printState;
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        try
+        {
+            refreshH5GroupContents(this->keaImgFile->getGroup("/"));
+            
+            // read the header again, keeping the pointer 
+            // getSpatialInfo() handed out valid
+            KEAImageSpatialInfo *spatialInfo = this->spatialInfoFile;
+            this->openKEAImageHeader(this->keaImgFile);
+            *spatialInfo = *this->spatialInfoFile;
+            delete this->spatialInfoFile;
+            this->spatialInfoFile = spatialInfo;
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const HighFive::Exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+    }
+
+    // HighFive doesn't have a wrapper for H5Pset_link_phase_change
+    class KEALinkPhaseChange
+    {
+    public:
+        KEALinkPhaseChange(unsigned maxCompact, unsigned minDense)
+            : m_maxCompact(maxCompact), m_minDense(minDense)
+        {
+        }
+        void apply(hid_t hid) const
+        {
+            if( H5Pset_link_phase_change(hid, m_maxCompact, m_minDense) < 0 )
+            {
+                H5Eprint(H5E_DEFAULT, stderr);
+                throw KEAIOException("Error in H5Pset_link_phase_change");
+            }
+        }
+    private:
+        unsigned m_maxCompact;
+        unsigned m_minDense;
+    };
+
+    // The small per-band datasets (description, data type etc.) are stored
+    // in the object header rather than a separate block elsewhere in the file.
+    // Fewer allocations when creating bands and fewer reads when opening.
+    class KEACompactLayout
+    {
+    public:
+        void apply(hid_t hid) const
+        {
+            if( H5Pset_layout(hid, H5D_COMPACT) < 0 )
+            {
+                H5Eprint(H5E_DEFAULT, stderr);
+                throw KEAIOException("Error in H5Pset_layout");
+            }
+        }
+    };
+
+    // For paged (cloud) files keep the links of the larger groups (HEADER, 
+    // BANDn, METADATA) in the group's object header so opening the file 
+    // doesn't need to chase a separate heap and B-tree for each one. Other
+    // files keep the default so they are still readable by old HDF5.
+    static HighFive::GroupCreateProps getGroupCreateProps(HighFive::File *keaImgH5File)
+    {
+        HighFive::GroupCreateProps groupCreateProps;
+        bool paged = false;
+        hid_t fileCreateProps = H5Fget_create_plist(keaImgH5File->getId());
+        if( fileCreateProps >= 0 )
+        {
+            H5F_fspace_strategy_t strategy;
+            hbool_t persist;
+            hsize_t threshold;
+            paged = (H5Pget_file_space_strategy(fileCreateProps, &strategy, &persist, &threshold) >= 0) &&
+                        (strategy == H5F_FSPACE_STRATEGY_PAGE);
+            H5Pclose(fileCreateProps);
+        }
+        if( paged )
+        {
+            groupCreateProps.add(KEALinkPhaseChange(64, 48));
+        }
+        return groupCreateProps;
+    }
+
+    HighFive::File *KEAImageIO::createKEAImage(
+        const std::string &fileName, KEADataType dataType, uint64_t xSize,
+        uint64_t ySize, uint32_t numImgBands, std::vector<std::string> *bandDescrips,
+        KEAImageSpatialInfo *spatialInfo, uint32_t imageBlockSize,
+        uint32_t attBlockSize, int mdcElmts, hsize_t rdccNElmts, hsize_t rdccNBytes,
+        double rdccW0, hsize_t sieveBuf, hsize_t metaBlockSize, uint32_t deflate,
+        bool persistFreeSpace, hsize_t pageSize, bool swmr, uint32_t imageBlockYSize,
+        bool growable
+#ifdef H5_HAVE_PARALLEL
+        , MPI_Comm comm, MPI_Info info
+#endif
+    )
+    {
+        KEATraceScope trace("createKEAImage");
+        trace.addArg("file", fileName);
+        HighFive::File *keaImgH5File = nullptr;
+
+        // Define dataspaces for writing string data
+        auto scalar_dataspace = HighFive::DataSpace(
+            HighFive::DataSpace::dataspace_scalar
+        );
+        auto var_stringtype = HighFive::VariableLengthStringType();
+		// TODO: dataspace instead of scalar to be compatible with old KEA
+        auto oldKeaDataSpace = HighFive::DataSpace({1});
+        try
+        {
+            auto keaFileAccessProps = HighFive::FileAccessProps::Default();
+            keaFileAccessProps.add(HighFive::MetadataBlockSize(metaBlockSize));
+            // HighFive doesn't seem to support these ones now
+            if( H5Pset_sieve_buf_size(keaFileAccessProps.getId(), sieveBuf) < 0 )
+            {
+                H5Eprint(H5E_DEFAULT, stderr);
+				throw KEAIOException("Error in H5Pset_sieve_buf_size");
+            }
+            if( H5Pset_cache(keaFileAccessProps.getId(), mdcElmts, rdccNElmts, rdccNBytes, rdccW0) < 0 )
+            {
+                H5Eprint(H5E_DEFAULT, stderr);
+				throw KEAIOException("Error in H5Pset_cache");
+            }
+
+            HighFive::FileCreateProps keaFileCreateProps;
+            if( pageSize > 0 )
+            {
+                // paged aggregation keeps the metadata together in whole pages
+                // so it can be fetched from cloud storage in a few requests
+                keaFileCreateProps.add(HighFive::FileSpaceStrategy(H5F_FSPACE_STRATEGY_PAGE, persistFreeSpace, 1));
+                keaFileCreateProps.add(HighFive::FileSpacePageSize(pageSize));
+                keaFileAccessProps.add(HighFive::FileVersionBounds(H5F_LIBVER_V110, H5F_LIBVER_LATEST));
+            }
+            else if( persistFreeSpace )
+            {
+                // track free space between sessions so it is reused
+                keaFileCreateProps.add(HighFive::FileSpaceStrategy(H5F_FSPACE_STRATEGY_FSM_AGGR, true, 1));
+            }
+            if( swmr )
+            {
+                // SWMR needs the 1.10 superblock and chunk indexes
+                keaFileAccessProps.add(HighFive::FileVersionBounds(H5F_LIBVER_V110, H5F_LIBVER_LATEST));
+            }
+#ifdef H5_HAVE_PARALLEL
+            if( comm != MPI_COMM_NULL )
+            {
+                // all ranks open the file together. Metadata reads and
+                // writes are then done collectively which scales much better
+                keaFileAccessProps.add(HighFive::MPIOFileAccess(comm, info));
+                keaFileAccessProps.add(HighFive::MPIOCollectiveMetadata(true));
+            }
+#endif
+
+            keaImgH5File = new HighFive::File(
+                fileName,
+                HighFive::File::Truncate | HighFive::File::Create |
+                HighFive::File::ReadWrite,
+                keaFileCreateProps,
+                keaFileAccessProps
+            );
+
+            //////////// CREATE GLOBAL HEADER ////////////////
+            keaImgH5File->createGroup(KEA_DATASETNAME_HEADER, getGroupCreateProps(keaImgH5File));
+
+            bool deleteSpatialInfo = false;
+            if (spatialInfo == nullptr)
+            {
+                spatialInfo = new KEAImageSpatialInfo();
+                spatialInfo->tlX = 0.0;
+                spatialInfo->tlY = 0.0;
+                spatialInfo->xRes = 1.0;
+                spatialInfo->yRes = -1.0;
+                spatialInfo->xRot = 0.0;
+                spatialInfo->yRot = 0.0;
+                spatialInfo->wktString = "";
+                deleteSpatialInfo = true;
                 //std::cout << "Creating new spatial info object." << std::endl;
             }
 
@@ -2719,7 +5435,7 @@ namespace kealib{
             //////////// CREATED GLOBAL HEADER ////////////////
 
             //////////// CREATE GLOBAL META-DATA ////////////////
-            keaImgH5File->createGroup(KEA_DATASETNAME_METADATA);
+            keaImgH5File->createGroup(KEA_DATASETNAME_METADATA, getGroupCreateProps(keaImgH5File));
             //////////// CREATED GLOBAL META-DATA ////////////////
 
             //////////// CREATE GCPS ////////////////
@@ -2744,7 +5460,9 @@ namespace kealib{
                     bandDescription,
                     imageBlockSize,
                     attBlockSize,
-                    deflate
+                    deflate,
+                    imageBlockYSize,
+                    growable
                 );
             }
             //////////// CREATED IMAGE BANDS ////////////////
@@ -2763,211 +5481,1380 @@ namespace kealib{
         {
             throw KEAIOException(e.what());
         }
-
-        return keaImgH5File;
+
+        return keaImgH5File;
+    }
+
+    void KEAImageIO::releaseSharedKeaH5Files()
+    {
+        std::lock_guard<std::mutex> lock(sharedKeaH5FilesMutex);
+        for( auto itr = getSharedKeaH5Files().begin(); itr != getSharedKeaH5Files().end(); )
+        {
+            if( H5Iget_ref(itr->second.file.getId()) <= 1 )
+            {
+                itr = getSharedKeaH5Files().erase(itr);
+            }
+            else
+            {
+                ++itr;
+            }
+        }
+    }
+
+    // HighFive::File only has a protected constructor from an id. Takes 
+    // ownership of fileId.
+    class KEAH5FileFromId : public HighFive::File
+    {
+    public:
+        explicit KEAH5FileFromId(hid_t fileId)
+            : HighFive::File(fileId)
+        {
+        }
+    };
+
+    HighFive::File *KEAImageIO::openKeaH5RW(
+        const std::string &fileName, int mdcElmts, hsize_t rdccNElmts,
+        hsize_t rdccNBytes, double rdccW0, hsize_t sieveBuf, hsize_t metaBlockSize,
+        bool swmr
+#ifdef H5_HAVE_PARALLEL
+        , MPI_Comm comm, MPI_Info info
+#endif
+    )
+    {
+        KEATraceScope trace("openKeaH5RW");
+        trace.addArg("file", fileName);
+        HighFive::File *keaImgH5File = nullptr;
+        try
+        {
+            auto keaFileAccessProps = HighFive::FileAccessProps::Default();
+            //keaAccessPlist.setCache(mdcElmts, rdccNElmts, rdccNBytes, rdccW0);
+            //keaAccessPlist.setSieveBufSize(sieveBuf);
+            //keaAccessPlist.setMetaBlockSize(metaBlockSize);
+            if( swmr )
+            {
+                // H5Fstart_swmr_write fails unless the library version
+                // bounds allow the 1.10 format
+                keaFileAccessProps.add(HighFive::FileVersionBounds(H5F_LIBVER_V110, H5F_LIBVER_LATEST));
+            }
+#ifdef H5_HAVE_PARALLEL
+            if( comm != MPI_COMM_NULL )
+            {
+                // all ranks open the file together. Metadata reads and
+                // writes are then done collectively which scales much better
+                keaFileAccessProps.add(HighFive::MPIOFileAccess(comm, info));
+                keaFileAccessProps.add(HighFive::MPIOCollectiveMetadata(true));
+            }
+#endif
+
+            keaImgH5File = new HighFive::File(
+                fileName,
+                HighFive::File::ReadWrite,
+                keaFileAccessProps
+            );
+            if( swmr && (H5Fstart_swmr_write(keaImgH5File->getId()) < 0) )
+            {
+                H5Eprint(H5E_DEFAULT, stderr);
+                delete keaImgH5File;
+                throw KEAIOException("Error in H5Fstart_swmr_write. Was the file created with swmr=true?");
+            }
+        }
+        catch (const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch (HighFive::Exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        catch (const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+
+        return keaImgH5File;
+    }
+
+    HighFive::File *KEAImageIO::openKeaH5RDOnly(
+        const std::string &fileName, int mdcElmts, hsize_t rdccNElmts,
+        hsize_t rdccNBytes, double rdccW0, hsize_t sieveBuf, hsize_t metaBlockSize,
+       	hid_t driver_id, const void* driver_info, hsize_t pageBufferSize, bool shared,
+        bool swmr
+    )
+    {
+        KEATraceScope trace("openKeaH5RDOnly");
+        trace.addArg("file", fileName);
+        HighFive::File *keaImgH5File = nullptr;
+        // held while opening so two threads don't both open it
+        std::unique_lock<std::mutex> sharedLock(sharedKeaH5FilesMutex, std::defer_lock);
+        std::string sharedKey;
+        if( shared )
+        {
+            sharedKey = getSharedKeaH5Key(fileName, swmr ? "r-swmr" : "r");
+            sharedLock.lock();
+            keaImgH5File = findSharedKeaH5File(sharedKey);
+            if( keaImgH5File != nullptr )
+            {
+                return keaImgH5File;
+            }
+        }
+
+        try
+        {
+            auto keaFileAccessProps = HighFive::FileAccessProps::Default();
+            keaFileAccessProps.add(HighFive::MetadataBlockSize(metaBlockSize));
+            // HighFive doesn't seem to support these ones now
+            if( H5Pset_sieve_buf_size(keaFileAccessProps.getId(), sieveBuf) < 0 )
+            {
+                H5Eprint(H5E_DEFAULT, stderr);
+				throw KEAIOException("Error in H5Pset_sieve_buf_size");
+            }
+            if( H5Pset_cache(keaFileAccessProps.getId(), mdcElmts, rdccNElmts, rdccNBytes, rdccW0) < 0 )
+            {
+                H5Eprint(H5E_DEFAULT, stderr);
+				throw KEAIOException("Error in H5Pset_cache");
+            }
+            if( driver_id != 0 )
+            {
+                if( H5Pset_driver(keaFileAccessProps.getId(), driver_id, driver_info) < 0 )
+                {
+                    H5Eprint(H5E_DEFAULT, stderr);
+    				throw kealib::KEAIOException("Error in H5Pset_driver");
+                }
+            }
+
+            if( swmr )
+            {
+                // HighFive has no flag for SWMR reading. No page buffer 
+                // either, HDF5 doesn't allow it with SWMR.
+                hid_t fileId = H5Fopen(fileName.c_str(), H5F_ACC_RDONLY | H5F_ACC_SWMR_READ, keaFileAccessProps.getId());
+                if( fileId < 0 )
+                {
+                    H5Eprint(H5E_DEFAULT, stderr);
+                    throw KEAIOException("Error in H5Fopen for SWMR reading. Was the file created with swmr=true?");
+                }
+                keaImgH5File = new HighFive::File(KEAH5FileFromId(fileId));
+            }
+            else if( pageBufferSize > 0 )
+            {
+                // HDF5 refuses page buffering on files that aren't paged (or have
+                // a bigger page size) so try again without in that case
+                keaFileAccessProps.add(HighFive::PageBufferSize(pageBufferSize));
+                try
+                {
+                    KEAStackPrintState printState;
+                    keaImgH5File = new HighFive::File(
+                        fileName,
+                        HighFive::File::ReadOnly,
+                        keaFileAccessProps
+                    );
+                }
+                catch (const HighFive::FileException &)
+                {
+                    keaFileAccessProps.add(HighFive::PageBufferSize(0));
+                    keaImgH5File = nullptr;
+                }
+            }
+
+            if( keaImgH5File == nullptr )
+            {
+                keaImgH5File = new HighFive::File(
+                    fileName,
+                    HighFive::File::ReadOnly,
+                    keaFileAccessProps
+                );
+            }
+            if( shared )
+            {
+                getSharedKeaH5Files().emplace(sharedKey, 
+                    KEASharedKeaH5File{*keaImgH5File, std::make_shared<kea_mutex>()});
+            }
+        }
+        catch (const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch (HighFive::Exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        catch (const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+
+        return keaImgH5File;
+    }
+
+    // whether fileName has the HDF5 signature where a superblock can be -
+    // at 0, 512, 1024, 2048... (after a user block). Just a few small reads.
+    static bool hasHDF5Signature(const std::string &fileName)
+    {
+        static const char achSignature[] = "\211HDF\r\n\032\n";
+        
+        std::ifstream file(fileName, std::ios::in | std::ios::binary);
+        if( !file )
+        {
+            return false;
+        }
+        file.seekg(0, std::ios::end);
+        std::streamoff fileSize = file.tellg();
+        
+        char achHeader[8];
+        for( std::streamoff offset = 0; (offset + 8) <= fileSize; offset = (offset == 0) ? 512 : offset * 2 )
+        {
+            file.seekg(offset);
+            if( !file.read(achHeader, sizeof(achHeader)) )
+            {
+                return false;
+            }
+            if( memcmp(achHeader, achSignature, sizeof(achHeader)) == 0 )
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    // read the single string in the dataset at path. Uses the C API
+    // so a missing dataset is just a false return rather than an exception.
+    static bool readHeaderString(hid_t fileId, const std::string &path, std::string &value)
+    {
+        if( H5Lexists(fileId, KEA_DATASETNAME_HEADER.c_str(), H5P_DEFAULT) <= 0 ||
+            H5Lexists(fileId, path.c_str(), H5P_DEFAULT) <= 0 )
+        {
+            return false;
+        }
+        
+        bool ok = false;
+        hid_t datasetId = H5Dopen2(fileId, path.c_str(), H5P_DEFAULT);
+        if( datasetId < 0 )
+        {
+            return false;
+        }
+        hid_t typeId = H5Dget_type(datasetId);
+        hid_t spaceId = H5Dget_space(datasetId);
+        if( (typeId >= 0) && (spaceId >= 0) && (H5Tget_class(typeId) == H5T_STRING) &&
+            (H5Sget_simple_extent_npoints(spaceId) == 1) )
+        {
+            hid_t memTypeId = H5Tcopy(H5T_C_S1);
+            if( H5Tis_variable_str(typeId) > 0 )
+            {
+                char *pszValue = nullptr;
+                H5Tset_size(memTypeId, H5T_VARIABLE);
+                if( H5Dread(datasetId, memTypeId, H5S_ALL, H5S_ALL, H5P_DEFAULT, &pszValue) >= 0 )
+                {
+                    value = (pszValue != nullptr) ? pszValue : "";
+                    H5free_memory(pszValue);
+                    ok = true;
+                }
+            }
+            else
+            {
+                size_t size = H5Tget_size(typeId);
+                std::vector<char> buffer(size + 1, '\0');
+                H5Tset_size(memTypeId, size + 1);
+                if( H5Dread(datasetId, memTypeId, H5S_ALL, H5S_ALL, H5P_DEFAULT, buffer.data()) >= 0 )
+                {
+                    value = buffer.data();
+                    ok = true;
+                }
+            }
+            H5Tclose(memTypeId);
+        }
+        if( spaceId >= 0 )
+        {
+            H5Sclose(spaceId);
+        }
+        if( typeId >= 0 )
+        {
+            H5Tclose(typeId);
+        }
+        H5Dclose(datasetId);
+        return ok;
+    }
+
+    // the HDF5 part of isKEAImage(). Checks the FILETYPE and VERSION.
+    static bool hasKEAHeader(const std::string &fileName)
+    {
+        KEAStackPrintState printState;
+        bool keaImageFound = false;
+        
+        // nothing but the header is read so no caches needed
+        hid_t faplId = H5Pcreate(H5P_FILE_ACCESS);
+        if( faplId < 0 )
+        {
+            throw KEAIOException("Error in H5Pcreate");
+        }
+        H5Pset_cache(faplId, 0, 0, 0, KEA_RDCC_W0);
+        hid_t fileId = H5Fopen(fileName.c_str(), H5F_ACC_RDONLY, faplId);
+        H5Pclose(faplId);
+        if( fileId >= 0 )
+        {
+            std::string fileType;
+            std::string fileVersion;
+            if( readHeaderString(fileId, KEA_DATASETNAME_HEADER_FILETYPE, fileType) && (fileType == "KEA") &&
+                readHeaderString(fileId, KEA_DATASETNAME_HEADER_VERSION, fileVersion) )
+            {
+                keaImageFound = (fileVersion == "1.0") || (fileVersion == "1.1") || (fileVersion == "2.0");
+            }
+            H5Fclose(fileId);
+        }
+
+        return keaImageFound;
+    }
+
+    bool KEAImageIO::isKEAImage(const std::string &fileName)
+    {
+        // most files that aren't KEA aren't HDF5 either. Find out 
+        // without going near the HDF5 library.
+        return hasHDF5Signature(fileName) && hasKEAHeader(fileName);
+    }
+
+    std::vector<bool> KEAImageIO::identifyMany(const std::vector<std::string> &fileNames, unsigned int numThreads)
+    {
+        if( numThreads == 0 )
+        {
+            numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+        numThreads = std::min(numThreads, static_cast<unsigned int>(fileNames.size()));
+        
+        // not a std::vector<bool> as the threads write to it
+        std::vector<uint8_t> results(fileNames.size(), 0);
+        std::atomic<size_t> nextFile(0);
+#ifndef H5_HAVE_THREADSAFE
+        // can only check the signatures in parallel
+        std::mutex hdf5Mutex;
+#endif
+        auto worker = [&]()
+        {
+            size_t idx;
+            while( (idx = nextFile++) < fileNames.size() )
+            {
+                try
+                {
+                    if( hasHDF5Signature(fileNames[idx]) )
+                    {
+#ifndef H5_HAVE_THREADSAFE
+                        std::lock_guard<std::mutex> hdf5Lock(hdf5Mutex);
+#endif
+                        results[idx] = hasKEAHeader(fileNames[idx]) ? 1 : 0;
+                    }
+                }
+                catch (const std::exception &)
+                {
+                    results[idx] = 0;
+                }
+            }
+        };
+        
+        std::vector<std::thread> threads;
+        for( unsigned int i = 1; i < numThreads; i++ )
+        {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for( auto &thread : threads )
+        {
+            thread.join();
+        }
+        
+        return std::vector<bool>(results.begin(), results.end());
+    }
+
+    KEAImageIO::~KEAImageIO()
+    {
+        
+    }
+
+    void KEAImageIO::addImageBand(
+        const KEADataType dataType, const std::string &bandDescrip,
+        const uint32_t imageBlockSize, const uint32_t attBlockSize,
+        const uint32_t deflate, const uint32_t imageBlockYSize, const bool growable
+    )
+    {
+        kealib::kea_lock lock(*this->m_mutex);
+        KEAStackPrintState printState;
+
+        if (!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+
+        const uint64_t xSize = this->spatialInfoFile->xSize;
+        const uint64_t ySize = this->spatialInfoFile->ySize;
+
+        // add a new image band to the file
+        KEAImageIO::addImageBandToFile(
+            this->keaImgFile,
+            dataType,
+            xSize,
+            ySize,
+            this->numImgBands + 1,
+            bandDescrip,
+            imageBlockSize,
+            attBlockSize,
+            deflate,
+            imageBlockYSize,
+            growable
+        );
+        ++this->numImgBands;
+
+        // update the band counter in the file metadata
+        KEAImageIO::setNumImgBandsInFileMetadata(this->keaImgFile, this->numImgBands);
+        if( this->consolidatedHeader )
+        {
+            this->rebuildConsolidatedHeader();
+        }
+        this->publishImmutableBandInfo();
+        this->updateBandMutexes();
+
+        this->flushFile();
+    }
+
+    void KEAImageIO::addImageBands(
+        const uint32_t numBands, const std::vector<KEADataType> &dataTypes,
+        const std::vector<std::string> *bandDescrips, const uint32_t imageBlockSize, 
+        const uint32_t attBlockSize, const uint32_t deflate, const uint32_t imageBlockYSize, 
+        const bool growable
+    )
+    {
+        kealib::kea_lock lock(*this->m_mutex);
+        KEAStackPrintState printState;
+
+        if (!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        if( (dataTypes.size() != 1) && (dataTypes.size() != numBands) )
+        {
+            throw KEAIOException("Need either one data type or one for each band.");
+        }
+
+        const uint64_t xSize = this->spatialInfoFile->xSize;
+        const uint64_t ySize = this->spatialInfoFile->ySize;
+
+        // if one fails still record the ones already created 
+        // so the file stays consistent
+        std::string errorMsg;
+        try
+        {
+            for( uint32_t i = 0; i < numBands; i++ )
+            {
+                std::string bandDescription = "";
+                if (bandDescrips != nullptr && i < bandDescrips->size())
+                {
+                    bandDescription = bandDescrips->at(i);
+                }
+                KEADataType dataType = (dataTypes.size() == 1) ? dataTypes[0] : dataTypes[i];
+
+                KEAImageIO::addImageBandToFile(
+                    this->keaImgFile,
+                    dataType,
+                    xSize,
+                    ySize,
+                    this->numImgBands + 1,
+                    bandDescription,
+                    imageBlockSize,
+                    attBlockSize,
+                    deflate,
+                    imageBlockYSize,
+                    growable
+                );
+                ++this->numImgBands;
+            }
+        }
+        catch (const KEAIOException &e)
+        {
+            errorMsg = e.what();
+        }
+
+        // update the band counter in the file metadata, once for all the bands
+        KEAImageIO::setNumImgBandsInFileMetadata(this->keaImgFile, this->numImgBands);
+        if( this->consolidatedHeader )
+        {
+            this->rebuildConsolidatedHeader();
+        }
+        this->publishImmutableBandInfo();
+        this->updateBandMutexes();
+
+        if( !errorMsg.empty() )
+        {
+            throw KEAIOException(errorMsg);
+        }
+
+        this->flushFile();
+    }
+
+    // whether two datasets have the same type, dimensions, chunking and
+    // filters so their chunks could be copied without decompressing
+    static bool datasetStorageMatches(const HighFive::DataSet &dataset1, const HighFive::DataSet &dataset2)
+    {
+        if( !(dataset1.getDataType() == dataset2.getDataType()) ||
+            (dataset1.getDimensions() != dataset2.getDimensions()) )
+        {
+            return false;
+        }
+        
+        hid_t plist1 = H5Dget_create_plist(dataset1.getId());
+        hid_t plist2 = H5Dget_create_plist(dataset2.getId());
+        bool matches = (plist1 >= 0) && (plist2 >= 0);
+        if( matches )
+        {
+            hsize_t chunk1[2] = {0, 0};
+            hsize_t chunk2[2] = {0, 0};
+            int nFilters = H5Pget_nfilters(plist1);
+            matches = (H5Pget_chunk(plist1, 2, chunk1) == 2) && (H5Pget_chunk(plist2, 2, chunk2) == 2) &&
+                (chunk1[0] == chunk2[0]) && (chunk1[1] == chunk2[1]) &&
+                (nFilters == H5Pget_nfilters(plist2));
+            for( int i = 0; matches && (i < nFilters); i++ )
+            {
+                unsigned int flags1, flags2, config1, config2;
+                unsigned int cdValues1[8], cdValues2[8];
+                size_t nCdValues1 = 8, nCdValues2 = 8;
+                H5Z_filter_t filter1 = H5Pget_filter2(plist1, i, &flags1, &nCdValues1, cdValues1, 0, NULL, &config1);
+                H5Z_filter_t filter2 = H5Pget_filter2(plist2, i, &flags2, &nCdValues2, cdValues2, 0, NULL, &config2);
+                matches = (filter1 == filter2) && (nCdValues1 == nCdValues2) &&
+                    std::equal(cdValues1, cdValues1 + std::min(nCdValues1, size_t(8)), cdValues2);
+            }
+        }
+        if( plist1 >= 0 )
+        {
+            H5Pclose(plist1);
+        }
+        if( plist2 >= 0 )
+        {
+            H5Pclose(plist2);
+        }
+        return matches;
+    }
+    
+    bool KEAImageIO::bandStorageMatches(KEAImageIO &otherIO, uint32_t srcBand, uint32_t dstBand)
+    {
+        kea_read_lock lock(*this->m_mutex, std::defer_lock);
+        kea_read_lock otherLock(*otherIO.m_mutex, std::defer_lock);
+        std::lock(lock, otherLock);
+        KEAStackPrintState printState;
+        
+        if (!this->fileOpen || !otherIO.fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        if ((srcBand == 0) || (srcBand > otherIO.numImgBands) || 
+            (dstBand == 0) || (dstBand > this->numImgBands))
+        {
+            throw KEAIOException("Band is not present within image.");
+        }
+        kea_read_lock bandLock(*this->getBandMutex(dstBand), std::defer_lock);
+        kea_read_lock otherBandLock(*otherIO.getBandMutex(srcBand), std::defer_lock);
+        std::lock(bandLock, otherBandLock);
+
+        try
+        {
+            auto srcDataset = otherIO.keaImgFile->getDataSet(KEA_DATASETNAME_BAND + uint2Str(srcBand) + KEA_BANDNAME_DATA);
+            auto dstDataset = this->keaImgFile->getDataSet(KEA_DATASETNAME_BAND + uint2Str(dstBand) + KEA_BANDNAME_DATA);
+            return datasetStorageMatches(srcDataset, dstDataset);
+        }
+        catch (const HighFive::Exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+    }
+    
+    void KEAImageIO::copyBandFrom(KEAImageIO &otherIO, uint32_t srcBand, uint32_t dstBand)
+    {
+        // lock both. std::lock avoids a deadlock if another thread is copying the other way
+        std::unique_lock<kea_mutex> lock(*this->m_mutex, std::defer_lock);
+        kea_read_lock otherLock(*otherIO.m_mutex, std::defer_lock);
+        std::lock(lock, otherLock);
+        KEAStackPrintState printState;
+        
+        if (!this->fileOpen || !otherIO.fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        if ((srcBand == 0) || (srcBand > otherIO.numImgBands))
+        {
+            throw KEAIOException("Source band is not present within image.");
+        }
+        
+        if ((dstBand == 0) || (dstBand > (this->numImgBands + 1)))
+        {
+            throw KEAIOException("Destination band must be an existing band or the next band.");
+        }
+        
+        if ((this->spatialInfoFile->xSize != otherIO.spatialInfoFile->xSize) ||
+            (this->spatialInfoFile->ySize != otherIO.spatialInfoFile->ySize))
+        {
+            throw KEAIOException("Images must be the same size to copy a band.");
+        }
+        
+        // attribute tables of either band only hold the band's lock
+        std::unique_lock<kea_mutex> bandLock;
+        if (dstBand <= this->numImgBands)
+        {
+            bandLock = std::unique_lock<kea_mutex>(*this->getBandMutex(dstBand), std::defer_lock);
+        }
+        kea_read_lock otherBandLock(*otherIO.getBandMutex(srcBand), std::defer_lock);
+        if (bandLock.mutex() != nullptr)
+        {
+            std::lock(bandLock, otherBandLock);
+        }
+        else
+        {
+            otherBandLock.lock();
+        }
+        
+        if ((this->keaImgFile->getId() == otherIO.keaImgFile->getId()) && (srcBand == dstBand))
+        {
+            // nothing to do
+            return;
+        }
+
+        try
+        {
+            // make sure everything the source has written is in the file
+            otherIO.keaImgFile->flush();
+            
+            std::string srcBandName = KEA_DATASETNAME_BAND + uint2Str(srcBand);
+            std::string dstBandName = KEA_DATASETNAME_BAND + uint2Str(dstBand);
+            // copied to a temporary name first so the existing band is
+            // still there if the copy fails
+            std::string copyBandName = dstBandName + "_COPY";
+            if (this->keaImgFile->exist(copyBandName))
+            {
+                this->keaImgFile->unlink(copyBandName);
+            }
+
+            // copies the whole group (data, mask, overviews, metadata, RAT etc). Chunks
+            // are copied as they are, without being decompressed.
+            if( H5Ocopy(otherIO.keaImgFile->getId(), srcBandName.c_str(), this->keaImgFile->getId(),
+                    copyBandName.c_str(), H5P_DEFAULT, H5P_DEFAULT) < 0 )
+            {
+                H5Eprint(H5E_DEFAULT, stderr);
+                if (this->keaImgFile->exist(copyBandName))
+                {
+                    this->keaImgFile->unlink(copyBandName);
+                }
+                throw KEAIOException("Error in H5Ocopy");
+            }
+
+            if (dstBand <= this->numImgBands)
+            {
+                this->keaImgFile->unlink(dstBandName);
+            }
+            if (!this->keaImgFile->rename(copyBandName, dstBandName))
+            {
+                throw KEAIOException("Failed to rename the copied band");
+            }
+
+            if (dstBand > this->numImgBands)
+            {
+                ++this->numImgBands;
+                KEAImageIO::setNumImgBandsInFileMetadata(this->keaImgFile, this->numImgBands);
+            }
+            this->noDataCache.erase(dstBand);
+            if (this->consolidatedHeader)
+            {
+                this->rebuildConsolidatedHeader();
+            }
+            this->publishImmutableBandInfo();
+            this->updateBandMutexes();
+            // the copy brought the source's statistics and dirty regions with it
+            this->markBandChanged(dstBand);
+            
+            this->flushFile();
+        }
+        catch (const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch (const HighFive::Exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        catch (const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+    }
+
+    // H5Ocopy srcName in srcFile to the same name in dstFile
+    static void copyObject(HighFive::File *srcFile, HighFive::File &dstFile, const std::string &name)
+    {
+        if( H5Ocopy(srcFile->getId(), name.c_str(), dstFile.getId(), name.c_str(), H5P_DEFAULT, H5P_DEFAULT) < 0 )
+        {
+            H5Eprint(H5E_DEFAULT, stderr);
+            throw KEAIOException("Error in H5Ocopy");
+        }
+    }
+
+    // copies the attributes of the group at path in srcFile to the (already
+    // created) group at path in dstFile
+    static void copyGroupAttributes(HighFive::File *srcFile, HighFive::File &dstFile, const std::string &path)
+    {
+        auto srcGroup = srcFile->getGroup(path);
+        auto dstGroup = dstFile.getGroup(path);
+        for( const std::string &name : srcGroup.listAttributeNames() )
+        {
+            auto srcAttr = srcGroup.getAttribute(name);
+            auto dataType = srcAttr.getDataType();
+            auto dataSpace = srcAttr.getSpace();
+            auto dstAttr = dstGroup.createAttribute(name, dataSpace, dataType);
+            // read and written in the file type so nothing is converted
+            std::vector<uint8_t> buffer(std::max<size_t>(dataSpace.getElementCount(), 1) * dataType.getSize());
+            if( H5Aread(srcAttr.getId(), dataType.getId(), buffer.data()) < 0 )
+            {
+                H5Eprint(H5E_DEFAULT, stderr);
+                throw KEAIOException("Error in H5Aread");
+            }
+            herr_t status = H5Awrite(dstAttr.getId(), dataType.getId(), buffer.data());
+            if( (H5Tdetect_class(dataType.getId(), H5T_VLEN) > 0) || (H5Tis_variable_str(dataType.getId()) > 0) )
+            {
+                H5Dvlen_reclaim(dataType.getId(), dataSpace.getId(), H5P_DEFAULT, buffer.data());
+            }
+            if( status < 0 )
+            {
+                H5Eprint(H5E_DEFAULT, stderr);
+                throw KEAIOException("Error in H5Awrite");
+            }
+        }
+    }
+
+    void KEAImageIO::repack(const std::string &dstPath)
+    {
+        // exclusive as pixel, metadata and attribute table writes only 
+        // take the band lock and the copy mustn't see half of one
+        kealib::kea_lock lock(*this->m_mutex);
+        KEAStackPrintState printState;
+
+        if (!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+
+        try
+        {
+            this->flushFile();
+            
+            // keep the free space (and paging) settings of this file
+            HighFive::FileCreateProps dstCreateProps;
+            auto dstAccessProps = HighFive::FileAccessProps::Default();
+            dstAccessProps.add(HighFive::MetadataBlockSize(KEA_META_BLOCKSIZE));
+            hid_t srcCreateProps = H5Fget_create_plist(this->keaImgFile->getId());
+            if( srcCreateProps >= 0 )
+            {
+                H5F_fspace_strategy_t strategy;
+                hbool_t persist;
+                hsize_t threshold;
+                if( (H5Pget_file_space_strategy(srcCreateProps, &strategy, &persist, &threshold) >= 0) &&
+                    ((strategy != H5F_FSPACE_STRATEGY_FSM_AGGR) || persist) )
+                {
+                    dstCreateProps.add(HighFive::FileSpaceStrategy(strategy, persist, threshold));
+                    hsize_t pageSize;
+                    if( (strategy == H5F_FSPACE_STRATEGY_PAGE) && 
+                        (H5Pget_file_space_page_size(srcCreateProps, &pageSize) >= 0) )
+                    {
+                        dstCreateProps.add(HighFive::FileSpacePageSize(pageSize));
+                        dstAccessProps.add(HighFive::FileVersionBounds(H5F_LIBVER_V110, H5F_LIBVER_LATEST));
+                    }
+                }
+                H5Pclose(srcCreateProps);
+            }
+            HighFive::File dstFile(dstPath, 
+                HighFive::File::Truncate | HighFive::File::Create | HighFive::File::ReadWrite,
+                dstCreateProps, dstAccessProps);
+            
+            // HEADER, METADATA, GCPS etc
+            std::vector<std::string> bandNames;
+            for( const std::string &name : this->keaImgFile->listObjectNames() )
+            {
+                if( name.compare(0, KEA_DATASETNAME_BAND.size() - 1, KEA_DATASETNAME_BAND.substr(1)) == 0 )
+                {
+                    bandNames.push_back(name);
+                }
+                else
+                {
+                    copyObject(this->keaImgFile, dstFile, "/" + name);
+                }
+            }
+            
+            copyGroupAttributes(this->keaImgFile, dstFile, "/");
+            
+            // then everything for each band apart from the image data
+            for( const std::string &bandName : bandNames )
+            {
+                std::string bandPath = "/" + bandName;
+                dstFile.createGroup(bandPath, getGroupCreateProps(&dstFile));
+                copyGroupAttributes(this->keaImgFile, dstFile, bandPath);
+                auto bandGroup = this->keaImgFile->getGroup(bandPath);
+                for( const std::string &name : bandGroup.listObjectNames() )
+                {
+                    std::string path = bandPath + "/" + name;
+                    if( path == (bandPath + KEA_BANDNAME_OVERVIEWS) )
+                    {
+                        dstFile.createGroup(path);
+                        copyGroupAttributes(this->keaImgFile, dstFile, path);
+                    }
+                    else if( (path != (bandPath + KEA_BANDNAME_DATA)) && (path != (bandPath + KEA_BANDNAME_MASK)) )
+                    {
+                        copyObject(this->keaImgFile, dstFile, path);
+                    }
+                }
+            }
+            
+            // now the image data, mask and overviews. H5Ocopy walks the 
+            // chunk index so the chunks go in row major order.
+            for( const std::string &bandName : bandNames )
+            {
+                std::string bandPath = "/" + bandName;
+                copyObject(this->keaImgFile, dstFile, bandPath + KEA_BANDNAME_DATA);
+                if( this->keaImgFile->exist(bandPath + KEA_BANDNAME_MASK) )
+                {
+                    copyObject(this->keaImgFile, dstFile, bandPath + KEA_BANDNAME_MASK);
+                }
+                if( this->keaImgFile->exist(bandPath + KEA_BANDNAME_OVERVIEWS) )
+                {
+                    auto overviewGroup = this->keaImgFile->getGroup(bandPath + KEA_BANDNAME_OVERVIEWS);
+                    for( const std::string &name : overviewGroup.listObjectNames() )
+                    {
+                        copyObject(this->keaImgFile, dstFile, bandPath + KEA_BANDNAME_OVERVIEWS + "/" + name);
+                    }
+                }
+            }
+            
+            dstFile.flush();
+        }
+        catch (const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch (const HighFive::Exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        catch (const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+    }
+
+    // HDF5 treats % in virtual dataset source names as a format character
+    static std::string escapeVirtualSourceName(const std::string &name)
+    {
+        std::string escaped;
+        for( char c : name )
+        {
+            escaped += c;
+            if( c == '%' )
+            {
+                escaped += '%';
+            }
+        }
+        return escaped;
+    }
+
+    void KEAImageIO::setVirtualImageBand(uint32_t band, const std::vector<KEAVirtualSource> &sources)
+    {
+        kealib::kea_lock lock(*this->m_mutex);
+        KEAStackPrintState printState;
+
+        if (!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        if (band == 0)
+        {
+            throw KEAIOException("KEA Image Bands start at 1.");
+        }
+        else if (band > this->numImgBands)
+        {
+            throw KEAIOException("Band is not present within image.");
+        }
+
+        KEADataType dataType = this->getImageBandDataType(band);
+        if( getDataTypeNBits(dataType) > 0 )
+        {
+            throw KEAIOException("1, 2 and 4 bit bands can't be virtual.");
+        }
+        uint32_t blockXSize, blockYSize;
+        this->getImageBlockSize(band, &blockXSize, &blockYSize);
+        uint64_t xSize = this->spatialInfoFile->xSize;
+        uint64_t ySize = this->spatialInfoFile->ySize;
+        for( const KEAVirtualSource &source : sources )
+        {
+            if( ((source.xDstOff + source.xSize) > xSize) || ((source.yDstOff + source.ySize) > ySize) )
+            {
+                throw KEAIOException("Virtual source " + source.fileName + " is not within the image.");
+            }
+        }
+
+        hid_t virtualSpace = -1;
+        hid_t createProps = -1;
+        try
+        {
+            hsize_t dims[2] = {ySize, xSize};
+            virtualSpace = H5Screate_simple(2, dims, NULL);
+            createProps = H5Pcreate(H5P_DATASET_CREATE);
+            if( (virtualSpace < 0) || (createProps < 0) )
+            {
+                H5Eprint(H5E_DEFAULT, stderr);
+                throw KEAIOException("Error creating virtual dataset properties");
+            }
+            
+            // uncovered pixels read as the no data
+            uint8_t fillValue[KEA_MAX_PIXEL_SIZE];
+            herr_t fillStatus;
+            if( this->getCachedNoDataValue(band, fillValue, dataType) )
+            {
+                fillStatus = H5Pset_fill_value(createProps, convertDatatypeKeaToH5Native(dataType).getId(), fillValue);
+            }
+            else
+            {
+                int initFillVal = FILL_IMAGE_DATA;
+                fillStatus = H5Pset_fill_value(createProps, H5T_NATIVE_INT, &initFillVal);
+            }
+            if( fillStatus < 0 )
+            {
+                H5Eprint(H5E_DEFAULT, stderr);
+                throw KEAIOException("Error in H5Pset_fill_value");
+            }
+
+            for( const KEAVirtualSource &source : sources )
+            {
+                hsize_t dstOffset[2] = {source.yDstOff, source.xDstOff};
+                hsize_t srcOffset[2] = {source.ySrcOff, source.xSrcOff};
+                hsize_t count[2] = {source.ySize, source.xSize};
+                // only needs to be big enough for the selection
+                hsize_t srcDims[2] = {source.ySrcOff + source.ySize, source.xSrcOff + source.xSize};
+                hid_t srcSpace = H5Screate_simple(2, srcDims, NULL);
+                std::string srcDataset = KEA_DATASETNAME_BAND + uint2Str(source.band) + KEA_BANDNAME_DATA;
+                bool ok = (srcSpace >= 0) &&
+                    (H5Sselect_hyperslab(virtualSpace, H5S_SELECT_SET, dstOffset, NULL, count, NULL) >= 0) &&
+                    (H5Sselect_hyperslab(srcSpace, H5S_SELECT_SET, srcOffset, NULL, count, NULL) >= 0) &&
+                    (H5Pset_virtual(createProps, virtualSpace, escapeVirtualSourceName(source.fileName).c_str(), 
+                        escapeVirtualSourceName(srcDataset).c_str(), srcSpace) >= 0);
+                if( srcSpace >= 0 )
+                {
+                    H5Sclose(srcSpace);
+                }
+                if( !ok )
+                {
+                    H5Eprint(H5E_DEFAULT, stderr);
+                    throw KEAIOException("Error adding virtual source " + source.fileName);
+                }
+            }
+            H5Sselect_all(virtualSpace);
+            
+            // replace the image data
+            std::string imageBandPath = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_DATA;
+            if( this->keaImgFile->exist(imageBandPath) )
+            {
+                this->keaImgFile->unlink(imageBandPath);
+            }
+            hid_t datasetId = H5Dcreate2(this->keaImgFile->getId(), imageBandPath.c_str(), 
+                convertDatatypeKeaToH5STD(dataType).getId(), virtualSpace, H5P_DEFAULT, createProps, H5P_DEFAULT);
+            if( datasetId < 0 )
+            {
+                H5Eprint(H5E_DEFAULT, stderr);
+                throw KEAIOException("Error in H5Dcreate2");
+            }
+            H5Dclose(datasetId);
+            H5Pclose(createProps);
+            createProps = -1;
+            H5Sclose(virtualSpace);
+            virtualSpace = -1;
+            
+            auto imgBandDataSet = this->keaImgFile->getDataSet(imageBandPath);
+            auto scalar_dataspace = HighFive::DataSpace(
+                HighFive::DataSpace::dataspace_scalar
+            );
+            imgBandDataSet.createAttribute(KEA_ATTRIBUTENAME_CLASS, 
+                scalar_dataspace,
+                HighFive::FixedLengthStringType(6, HighFive::StringPadding::NullTerminated)).write("IMAGE");
+            imgBandDataSet.createAttribute(KEA_ATTRIBUTENAME_IMAGE_VERSION,
+                scalar_dataspace,
+                HighFive::FixedLengthStringType(4, HighFive::StringPadding::NullTerminated)).write("1.2");
+            // a hint for readers - the sources have their own chunking
+            writeBlockSizeAttributes(imgBandDataSet, blockXSize, blockYSize);
+            this->markBandChanged(band);
+            // no longer chunked
+            this->publishImmutableBandInfo();
+            
+            this->flushFile();
+        }
+        catch (const KEAIOException &e)
+        {
+            if( createProps >= 0 )
+            {
+                H5Pclose(createProps);
+            }
+            if( virtualSpace >= 0 )
+            {
+                H5Sclose(virtualSpace);
+            }
+            throw e;
+        }
+        catch (const HighFive::Exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        catch (const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
     }
 
-    HighFive::File *KEAImageIO::openKeaH5RW(
-        const std::string &fileName, int mdcElmts, hsize_t rdccNElmts,
-        hsize_t rdccNBytes, double rdccW0, hsize_t sieveBuf, hsize_t metaBlockSize
-    )
+    bool KEAImageIO::isImageBandVirtual(uint32_t band)
     {
-        HighFive::File *keaImgH5File = nullptr;
-        try
-        {
-            auto keaFileAccessProps = HighFive::FileAccessProps::Default();
-            //keaAccessPlist.setCache(mdcElmts, rdccNElmts, rdccNBytes, rdccW0);
-            //keaAccessPlist.setSieveBufSize(sieveBuf);
-            //keaAccessPlist.setMetaBlockSize(metaBlockSize);
+        kealib::kea_read_lock lock(*this->m_mutex);
+        KEAStackPrintState printState;
 
-            keaImgH5File = new HighFive::File(
-                fileName,
-                HighFive::File::ReadWrite,
-                keaFileAccessProps
-            );
+        if (!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
         }
-        catch (const KEAIOException &e)
+        if (band == 0)
         {
-            throw e;
+            throw KEAIOException("KEA Image Bands start at 1.");
         }
-        catch (HighFive::Exception &e)
+        else if (band > this->numImgBands)
         {
-            throw KEAIOException(e.what());
+            throw KEAIOException("Band is not present within image.");
         }
-        catch (const std::exception &e)
+
+        bool isVirtual = false;
+        try
+        {
+            auto imgBandDataset = this->keaImgFile->getDataSet(KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_DATA);
+            hid_t createProps = H5Dget_create_plist(imgBandDataset.getId());
+            if( createProps >= 0 )
+            {
+                isVirtual = (H5Pget_layout(createProps) == H5D_VIRTUAL);
+                H5Pclose(createProps);
+            }
+        }
+        catch (const HighFive::Exception &e)
         {
             throw KEAIOException(e.what());
         }
+        return isVirtual;
+    }
 
-        return keaImgH5File;
+    // HDF5 looks for a relative source name in the directory of the virtual 
+    // dataset's file, not the current directory. So inputs in (or below) the
+    // mosaic's directory are stored relative to it and the rest as absolute paths.
+    static std::string getMosaicSourceName(const std::string &input, const std::string &mosaicDir)
+    {
+        std::string path = getAbsolutePath(input);
+        if( (path.size() > mosaicDir.size()) && (path.compare(0, mosaicDir.size(), mosaicDir) == 0) &&
+            ((path[mosaicDir.size()] == '/') || (path[mosaicDir.size()] == '\\')) )
+        {
+            return path.substr(mosaicDir.size() + 1);
+        }
+        return path;
     }
 
-    HighFive::File *KEAImageIO::openKeaH5RDOnly(
-        const std::string &fileName, int mdcElmts, hsize_t rdccNElmts,
-        hsize_t rdccNBytes, double rdccW0, hsize_t sieveBuf, hsize_t metaBlockSize,
-       	hid_t driver_id, const void* driver_info
-    )
+    HighFive::File* KEAImageIO::createMosaic(const std::string &fileName, const std::vector<std::string> &inputs)
     {
-        HighFive::File *keaImgH5File = nullptr;
+        KEAStackPrintState printState;
+        if( inputs.empty() )
+        {
+            throw KEAIOException("No inputs given for the mosaic.");
+        }
 
-        try
+        // what we need from each input
+        struct MosaicInput
         {
-            auto keaFileAccessProps = HighFive::FileAccessProps::Default();
-            keaFileAccessProps.add(HighFive::MetadataBlockSize(metaBlockSize));
-            // HighFive doesn't seem to support these ones now
-            if( H5Pset_sieve_buf_size(keaFileAccessProps.getId(), sieveBuf) < 0 )
+            KEAImageSpatialInfo spatialInfo;
+            std::vector<KEADataType> dataTypes;
+        };
+        std::vector<MosaicInput> mosaicInputs;
+        std::vector<std::string> descriptions;
+        std::vector<std::vector<uint8_t> > noData;  // empty if not set
+        uint32_t blockXSize = 0, blockYSize = 0;
+        for( const std::string &input : inputs )
+        {
+            KEAImageIO io;
+            io.openKEAImageHeader(KEAImageIO::openKeaH5RDOnly(input));
+            MosaicInput mosaicInput;
+            mosaicInput.spatialInfo = *io.getSpatialInfo();
+            for( uint32_t band = 1; band <= io.getNumOfImageBands(); band++ )
             {
-                H5Eprint(H5E_DEFAULT, stderr);
-				throw KEAIOException("Error in H5Pset_sieve_buf_size");
+                mosaicInput.dataTypes.push_back(io.getImageBandDataType(band));
+                if( mosaicInputs.empty() )
+                {
+                    descriptions.push_back(io.getImageBandDescription(band));
+                    std::vector<uint8_t> value(KEA_MAX_PIXEL_SIZE);
+                    if( !io.getCachedNoDataValue(band, value.data(), mosaicInput.dataTypes.back()) )
+                    {
+                        value.clear();
+                    }
+                    noData.push_back(value);
+                }
             }
-            if( H5Pset_cache(keaFileAccessProps.getId(), mdcElmts, rdccNElmts, rdccNBytes, rdccW0) < 0 )
+            if( mosaicInputs.empty() && !mosaicInput.dataTypes.empty() )
             {
-                H5Eprint(H5E_DEFAULT, stderr);
-				throw KEAIOException("Error in H5Pset_cache");
+                io.getImageBlockSize(1, &blockXSize, &blockYSize);
             }
-            if( driver_id != 0 )
+            io.close();
+            
+            const MosaicInput &first = mosaicInputs.empty() ? mosaicInput : mosaicInputs.front();
+            if( mosaicInput.dataTypes.empty() || (mosaicInput.dataTypes != first.dataTypes) )
             {
-                if( H5Pset_driver(keaFileAccessProps.getId(), driver_id, driver_info) < 0 )
+                throw KEAIOException(input + " does not have the same bands as " + inputs.front());
+            }
+            if( (mosaicInput.spatialInfo.xRot != 0) || (mosaicInput.spatialInfo.yRot != 0) )
+            {
+                throw KEAIOException(input + " is rotated which isn't supported.");
+            }
+            if( (mosaicInput.spatialInfo.xRes != first.spatialInfo.xRes) || 
+                (mosaicInput.spatialInfo.yRes != first.spatialInfo.yRes) ||
+                (mosaicInput.spatialInfo.wktString != first.spatialInfo.wktString) )
+            {
+                throw KEAIOException(input + " does not have the same resolution and projection as " + inputs.front());
+            }
+            for( KEADataType dataType : mosaicInput.dataTypes )
+            {
+                if( getDataTypeNBits(dataType) > 0 )
                 {
-                    H5Eprint(H5E_DEFAULT, stderr);
-    				throw kealib::KEAIOException("Error in H5Pset_driver");
+                    throw KEAIOException("1, 2 and 4 bit bands can't be mosaiced.");
                 }
             }
+            mosaicInputs.push_back(mosaicInput);
+        }
+        
+        // place them on the pixel grid of the first
+        const KEAImageSpatialInfo &firstInfo = mosaicInputs.front().spatialInfo;
+        std::vector<int64_t> xOffsets, yOffsets;
+        int64_t minX = 0, minY = 0, maxX = 0, maxY = 0;
+        for( size_t i = 0; i < mosaicInputs.size(); i++ )
+        {
+            const KEAImageSpatialInfo &info = mosaicInputs[i].spatialInfo;
+            double xPix = (info.tlX - firstInfo.tlX) / firstInfo.xRes;
+            double yPix = (info.tlY - firstInfo.tlY) / firstInfo.yRes;
+            int64_t xOff = static_cast<int64_t>(std::llround(xPix));
+            int64_t yOff = static_cast<int64_t>(std::llround(yPix));
+            if( (std::fabs(xPix - xOff) > 1e-6) || (std::fabs(yPix - yOff) > 1e-6) )
+            {
+                throw KEAIOException(inputs[i] + " is not on the same pixel grid as " + inputs.front());
+            }
+            xOffsets.push_back(xOff);
+            yOffsets.push_back(yOff);
+            minX = std::min(minX, xOff);
+            minY = std::min(minY, yOff);
+            maxX = std::max(maxX, xOff + static_cast<int64_t>(info.xSize));
+            maxY = std::max(maxY, yOff + static_cast<int64_t>(info.ySize));
+        }
+        
+        KEAImageSpatialInfo mosaicInfo = firstInfo;
+        mosaicInfo.tlX = firstInfo.tlX + (minX * firstInfo.xRes);
+        mosaicInfo.tlY = firstInfo.tlY + (minY * firstInfo.yRes);
+        mosaicInfo.xSize = maxX - minX;
+        mosaicInfo.ySize = maxY - minY;
+        
+        HighFive::File *keaImgH5File = KEAImageIO::createKEAImage(fileName, mosaicInputs.front().dataTypes.front(),
+                mosaicInfo.xSize, mosaicInfo.ySize, 0, nullptr, &mosaicInfo);
+        size_t sepPos = fileName.find_last_of("/\\");
+        std::string mosaicDir = getAbsolutePath((sepPos == std::string::npos) ? "." : fileName.substr(0, sepPos + 1));
+        KEAImageIO io;
+        io.openKEAImageHeader(keaImgH5File);
+        for( uint32_t band = 1; band <= mosaicInputs.front().dataTypes.size(); band++ )
+        {
+            io.addImageBand(mosaicInputs.front().dataTypes[band - 1], descriptions[band - 1], 
+                blockXSize, KEA_ATT_CHUNK_SIZE, KEA_DEFLATE, blockYSize);
+            if( !noData[band - 1].empty() )
+            {
+                io.setNoDataValue(band, noData[band - 1].data(), mosaicInputs.front().dataTypes[band - 1]);
+            }
+            
+            std::vector<KEAVirtualSource> sources;
+            for( size_t i = 0; i < mosaicInputs.size(); i++ )
+            {
+                KEAVirtualSource source;
+                source.fileName = getMosaicSourceName(inputs[i], mosaicDir);
+                source.band = band;
+                source.xSrcOff = 0;
+                source.ySrcOff = 0;
+                source.xSize = mosaicInputs[i].spatialInfo.xSize;
+                source.ySize = mosaicInputs[i].spatialInfo.ySize;
+                source.xDstOff = xOffsets[i] - minX;
+                source.yDstOff = yOffsets[i] - minY;
+                sources.push_back(source);
+            }
+            io.setVirtualImageBand(band, sources);
+        }
+        io.close();
+        
+        return KEAImageIO::openKeaH5RW(fileName);
+    }
 
-            keaImgH5File = new HighFive::File(
-                fileName,
-                HighFive::File::ReadOnly,
-                keaFileAccessProps
-            );
+    void KEAImageIO::extendImageDataset(HighFive::DataSet &dataset, uint32_t band, KEADataType dataType,
+        uint64_t oldXSize, uint64_t oldYSize, uint64_t newXSize, uint64_t newYSize,
+        uint64_t xShift, uint64_t yShift, bool ismask)
+    {
+        uint64_t newXSize2Use = newXSize;
+        if( dataset.hasAttribute(KEA_ATTRIBUTENAME_NBITS) )
+        {
+            // packed. The real width is in an attribute
+            uint8_t nBits = dataset.getAttribute(KEA_ATTRIBUTENAME_NBITS).read<uint8_t>();
+            newXSize2Use = ((newXSize * nBits) + 7) / 8;
+            dataset.getAttribute(KEA_ATTRIBUTENAME_XSIZE).write(newXSize);
         }
-        catch (const KEAIOException &e)
+        dataset.resize({static_cast<size_t>(newYSize), static_cast<size_t>(newXSize2Use)});
+        
+        if( (xShift == 0) && (yShift == 0) )
         {
-            throw e;
+            return;
         }
-        catch (HighFive::Exception &e)
+        
+        // read and write through a type that loses nothing. Packed bands 
+        // are unpacked to bytes and half floats converted to float
+        KEADataType bufDataType = dataType;
+        if( ismask || (getDataTypeNBits(dataType) > 0) )
         {
-            throw KEAIOException(e.what());
+            bufDataType = kea_8uint;
         }
-        catch (const std::exception &e)
+        else if( dataType == kea_16float )
         {
-            throw KEAIOException(e.what());
+            bufDataType = kea_32float;
+        }
+        size_t pixelSize = convertDatatypeKeaToH5Native(bufDataType).getSize();
+        
+        // a block of rows at a time, starting at the bottom so rows
+        // aren't overwritten before they have been moved
+        uint32_t blockXSize, blockYSize;
+        this->getImageBlockSize(band, &blockXSize, &blockYSize);
+        uint64_t stripRows = blockYSize;
+        std::vector<uint8_t> strip(oldXSize * stripRows * pixelSize);
+        uint64_t row = oldYSize;
+        while( row > 0 )
+        {
+            uint64_t nRows = std::min(stripRows, row);
+            row -= nRows;
+            this->readImageFromDataset(dataset, band, strip.data(), 0, row, oldXSize, nRows, 
+                oldXSize, nRows, bufDataType, ismask);
+            this->writeImageToDataset(dataset, strip.data(), xShift, row + yShift, oldXSize, nRows, 
+                oldXSize, nRows, bufDataType, ismask);
+        }
+        
+        // fill what was uncovered. The rest of the new area is already the fill value.
+        int fillVal = ismask ? FILL_MASK_DATA : FILL_IMAGE_DATA;
+        uint64_t fillRows = std::min(yShift, oldYSize);
+        if( fillRows > 0 )
+        {
+            std::vector<uint8_t> fill(oldXSize * fillRows * pixelSize, static_cast<uint8_t>(fillVal));
+            this->writeImageToDataset(dataset, fill.data(), 0, 0, oldXSize, fillRows, 
+                oldXSize, fillRows, bufDataType, ismask);
+        }
+        uint64_t fillCols = std::min(xShift, oldXSize);
+        if( (fillCols > 0) && (oldYSize > yShift) )
+        {
+            uint64_t nRows = oldYSize - yShift;
+            std::vector<uint8_t> fill(fillCols * nRows * pixelSize, static_cast<uint8_t>(fillVal));
+            this->writeImageToDataset(dataset, fill.data(), 0, yShift, fillCols, nRows, 
+                fillCols, nRows, bufDataType, ismask);
         }
-
-        return keaImgH5File;
     }
 
-    bool KEAImageIO::isKEAImage(const std::string &fileName)
+    void KEAImageIO::extendImage(uint64_t newXSize, uint64_t newYSize, KEAImageAnchor anchor)
     {
-        bool keaImageFound = false;
+        kealib::kea_lock lock(*this->m_mutex);
+        KEAStackPrintState printState;
 
-        try
+        if (!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        uint64_t oldXSize = this->spatialInfoFile->xSize;
+        uint64_t oldYSize = this->spatialInfoFile->ySize;
+        if( (newXSize < oldXSize) || (newYSize < oldYSize) )
         {
-            auto keaImgH5File = HighFive::File(fileName, HighFive::File::ReadOnly);
+            throw KEAIOException("The image can only be made bigger.");
+        }
+        if( (newXSize == oldXSize) && (newYSize == oldYSize) )
+        {
+            return;
+        }
+        uint64_t xShift = 0;
+        if( (anchor == kea_anchor_topright) || (anchor == kea_anchor_bottomright) )
+        {
+            xShift = newXSize - oldXSize;
+        }
+        uint64_t yShift = 0;
+        if( (anchor == kea_anchor_bottomleft) || (anchor == kea_anchor_bottomright) )
+        {
+            yShift = newYSize - oldYSize;
+        }
 
-            try
+        try
+        {
+            // check first so nothing is changed if one can't be
+            for( uint32_t band = 1; band <= this->numImgBands; band++ )
             {
-                std::string fileType = "";
-                if (keaImgH5File.exist(KEA_DATASETNAME_HEADER_FILETYPE))
-                {
-                    auto datasetFileType = keaImgH5File.getDataSet(
-                        KEA_DATASETNAME_HEADER_FILETYPE
-                    );
-                    datasetFileType.read(fileType);
-                }
-
-                try
+                std::string bandPath = KEA_DATASETNAME_BAND + uint2Str(band);
+                if( !isImageDataSetGrowable(this->keaImgFile->getDataSet(bandPath + KEA_BANDNAME_DATA)) ||
+                    (this->keaImgFile->exist(bandPath + KEA_BANDNAME_MASK) && 
+                     !isImageDataSetGrowable(this->keaImgFile->getDataSet(bandPath + KEA_BANDNAME_MASK))) )
                 {
-                    if (fileType == "KEA")
-                    {
-                        std::string fileVersion = "";
-                        if (keaImgH5File.exist(KEA_DATASETNAME_HEADER_VERSION))
-                        {
-                            auto datasetFileVersion = keaImgH5File.getDataSet(
-                                KEA_DATASETNAME_HEADER_VERSION
-                            );
-                            datasetFileVersion.read(fileVersion);
-                        }
-
-                        if ((fileVersion == "1.0") || (fileVersion == "1.1") || (fileVersion == "2.0"))
-                        {
-                            keaImageFound = true;
-                        }
-                        else
-                        {
-                            keaImageFound = false;
-                        }
-                    }
-                    else
-                    {
-                        keaImageFound = false;
-                    }
+                    throw KEAIOException("Band " + uint2Str(band) + " was not created growable.");
                 }
-                catch (HighFive::Exception &e)
+            }
+            
+            for( uint32_t band = 1; band <= this->numImgBands; band++ )
+            {
+                std::string bandPath = KEA_DATASETNAME_BAND + uint2Str(band);
+                auto imgBandDataset = this->keaImgFile->getDataSet(bandPath + KEA_BANDNAME_DATA);
+                this->extendImageDataset(imgBandDataset, band, this->getImageBandDataType(band), 
+                    oldXSize, oldYSize, newXSize, newYSize, xShift, yShift, false);
+                if( this->keaImgFile->exist(bandPath + KEA_BANDNAME_MASK) )
                 {
-                    keaImageFound = false;
+                    auto maskDataset = this->keaImgFile->getDataSet(bandPath + KEA_BANDNAME_MASK);
+                    this->extendImageDataset(maskDataset, band, kea_8uint, 
+                        oldXSize, oldYSize, newXSize, newYSize, xShift, yShift, true);
                 }
             }
-            catch (HighFive::Exception &e)
+            
+            std::vector<uint64_t> imgSizeSpatial = {newXSize, newYSize};
+            this->keaImgFile->getDataSet(KEA_DATASETNAME_HEADER_SIZE).write(imgSizeSpatial);
+            this->spatialInfoFile->xSize = newXSize;
+            this->spatialInfoFile->ySize = newYSize;
+            for( uint32_t band = 1; band <= this->numImgBands; band++ )
             {
-                keaImageFound = false;
+                // overviews can't be resized so are recreated at the same
+                // scale, covering the new size. Empty until updateOverviews().
+                uint32_t numOverviews = ((oldXSize > 0) && (oldYSize > 0)) ? this->getNumOfOverviews(band) : 0;
+                for( uint32_t overview = 1; overview <= numOverviews; overview++ )
+                {
+                    uint64_t ovXSize, ovYSize;
+                    this->getOverviewSize(band, overview, &ovXSize, &ovYSize);
+                    uint64_t newOvXSize = ((newXSize * ovXSize) + oldXSize - 1) / oldXSize;
+                    uint64_t newOvYSize = ((newYSize * ovYSize) + oldYSize - 1) / oldYSize;
+                    this->createOverview(band, overview, newOvXSize, newOvYSize);
+                }
+                // the pixels may have moved so everything needs recalculating
+                this->markBandChanged(band);
             }
-        }
-        catch (HighFive::Exception &e)
-        {
-            keaImageFound = false;
+            // the old top left pixel is now at (xShift, yShift)
+            this->spatialInfoFile->tlX -= (xShift * this->spatialInfoFile->xRes) + (yShift * this->spatialInfoFile->xRot);
+            this->spatialInfoFile->tlY -= (xShift * this->spatialInfoFile->yRot) + (yShift * this->spatialInfoFile->yRes);
+            // writes the top left (and the consolidated header) and flushes
+            this->setSpatialInfo(this->spatialInfoFile);
         }
         catch (const KEAIOException &e)
         {
             throw e;
         }
-        catch (const std::exception &e)
+        catch (const HighFive::Exception &e)
         {
             throw KEAIOException(e.what());
         }
-
-        return keaImageFound;
-    }
-
-    KEAImageIO::~KEAImageIO()
-    {
-        
-    }
-
-    void KEAImageIO::addImageBand(
-        const KEADataType dataType, const std::string &bandDescrip,
-        const uint32_t imageBlockSize, const uint32_t attBlockSize,
-        const uint32_t deflate
-    )
-    {
-        kealib::kea_lock lock(*this->m_mutex);
-        KEAStackPrintState printState;
-
-        if (!this->fileOpen)
+        catch (const std::exception &e)
         {
-            throw KEAIOException("Image was not open.");
+            throw KEAIOException(e.what());
         }
-
-        const uint32_t xSize = this->spatialInfoFile->xSize;
-        const uint32_t ySize = this->spatialInfoFile->ySize;
-
-        // add a new image band to the file
-        KEAImageIO::addImageBandToFile(
-            this->keaImgFile,
-            dataType,
-            xSize,
-            ySize,
-            this->numImgBands + 1,
-            bandDescrip,
-            imageBlockSize,
-            attBlockSize,
-            deflate
-        );
-        ++this->numImgBands;
-
-        // update the band counter in the file metadata
-        KEAImageIO::setNumImgBandsInFileMetadata(this->keaImgFile, this->numImgBands);
-
-        this->keaImgFile->flush();
     }
 
     void KEAImageIO::removeImageBand(const uint32_t bandIndex)
@@ -2979,6 +6866,19 @@ namespace kealib{
         {
             throw KEAIOException("Image was not open.");
         }
+        
+        // bands from bandIndex up are moved. Attribute tables only hold
+        // their band's lock so take those too.
+        std::vector<std::shared_ptr<kea_mutex> > movedBandMutexes;
+        for (uint32_t band = std::max(bandIndex, 1u); band <= this->numImgBands; band++)
+        {
+            movedBandMutexes.push_back(this->getBandMutex(band));
+        }
+        std::vector<std::unique_lock<kea_mutex> > bandLocks;
+        for (auto &bandMutex : movedBandMutexes)
+        {
+            bandLocks.emplace_back(*bandMutex);
+        }
 
         KEAImageIO::removeImageBandFromFile(
             this->keaImgFile,
@@ -2987,11 +6887,23 @@ namespace kealib{
         );
 
         --this->numImgBands;
+        // band numbers have shifted
+        this->noDataCache.clear();
+        this->bandMutexes.erase(this->bandMutexes.begin() + (bandIndex - 1));
+#ifdef LIBKEA_WITH_IO_STATISTICS
+        this->bandIOCounters.erase(this->bandIOCounters.begin() + (bandIndex - 1));
+#endif
 
         // update the band counter in the file metadata
         KEAImageIO::setNumImgBandsInFileMetadata(this->keaImgFile, this->numImgBands);
+        if( this->consolidatedHeader )
+        {
+            this->rebuildConsolidatedHeader();
+        }
+        this->publishImmutableBandInfo();
+        this->updateBandMutexes();
 
-        this->keaImgFile->flush();
+        this->flushFile();
     }
 
     HighFive::DataType KEAImageIO::convertDatatypeKeaToH5STD(const KEADataType dataType)
@@ -3018,6 +6930,13 @@ namespace kealib{
                 return HighFive::AtomicType<float>();
             case kea_64float:
                 return HighFive::AtomicType<double>();
+            case kea_1uint:
+            case kea_2uint:
+            case kea_4uint:
+                // stored packed into bytes
+                return HighFive::AtomicType<uint8_t>();
+            case kea_16float:
+                return KEAHalfFloatType();
             default:
                 throw KEAIOException("The specified data type was not recognised.");
         }
@@ -3049,6 +6968,13 @@ namespace kealib{
                 return HighFive::AtomicType<float>();
             case kea_64float:
                 return HighFive::AtomicType<double>();
+            case kea_1uint:
+            case kea_2uint:
+            case kea_4uint:
+                // stored packed into bytes
+                return HighFive::AtomicType<uint8_t>();
+            case kea_16float:
+                return KEAHalfFloatType();
             default:
                 throw KEAIOException("The specified data type was not recognised.");
         }
@@ -3080,16 +7006,23 @@ namespace kealib{
                 return "float";
             case kea_64float:
                 return "double";
+            case kea_1uint:
+            case kea_2uint:
+            case kea_4uint:
+                return "uint8_t";
+            case kea_16float:
+                return "float16";
             default:
                 throw KEAIOException("The specified data type was not recognised.");
         }
     }
 
     void KEAImageIO::addImageBandToFile(
-        HighFive::File *keaImgH5File, const KEADataType dataType, const uint32_t xSize,
-        const uint32_t ySize, const uint32_t bandIndex,
+        HighFive::File *keaImgH5File, const KEADataType dataType, const uint64_t xSize,
+        const uint64_t ySize, const uint32_t bandIndex,
         const std::string &bandDescripIn, const uint32_t imageBlockSize,
-        const uint32_t attBlockSize, const uint32_t deflate
+        const uint32_t attBlockSize, const uint32_t deflate, const uint32_t imageBlockYSize,
+        const bool growable
     )
     {
         // Define dataspaces for writing string data
@@ -3104,19 +7037,23 @@ namespace kealib{
         int initFillVal = FILL_IMAGE_DATA;
         std::string bandDescrip = bandDescripIn; // may be updated below
 
-        // Find the smallest axis of the image.
-        uint64_t minImgDim = xSize < ySize ? xSize : ySize;
-        uint32_t blockSize2Use =
-                imageBlockSize > minImgDim ? minImgDim : imageBlockSize;
+        uint32_t blockXSize2Use, blockYSize2Use;
+        getChunkShape(xSize, ySize, imageBlockSize, imageBlockYSize, &blockXSize2Use, &blockYSize2Use);
 
         try
         {
-            HighFive::DataSpace dataSpace = HighFive::DataSpace({ySize, xSize});
+            // 1, 2 and 4 bit types are packed into bytes along each row
+            uint8_t nBits = getDataTypeNBits(dataType);
+            uint64_t xSize2Use = xSize;
+            if( nBits > 0 )
+            {
+                xSize2Use = ((xSize * nBits) + 7) / 8;
+            }
+            HighFive::DataSpace dataSpace = createImageDataSpace(ySize, xSize2Use, growable);
             HighFive::DataType dataTypeH5 = convertDatatypeKeaToH5STD(dataType);
 
             HighFive::DataSetCreateProps imgBandDataSetProps;
-            imgBandDataSetProps.add(HighFive::Chunking(blockSize2Use, blockSize2Use));
-            imgBandDataSetProps.add(HighFive::Shuffle());
+            addImageChunking(imgBandDataSetProps, xSize2Use, blockXSize2Use, blockYSize2Use, nBits > 0);
             imgBandDataSetProps.add(HighFive::Deflate(deflate));
             // HighFive doesn't appear to support this (yet)
             if( H5Pset_fill_value(imgBandDataSetProps.getId(), H5T_NATIVE_INT, &initFillVal) < 0 )
@@ -3127,13 +7064,15 @@ namespace kealib{
 
             HighFive::DataSetAccessProps imgBandAccessProps =
                     HighFive::DataSetAccessProps::Default();
+            HighFive::DataSetCreateProps smallDataSetProps;
+            smallDataSetProps.add(KEACompactLayout());
 
             uint8_t bandType = kea_continuous;
             uint8_t bandUsage = kea_generic;
 
             // CREATE IMAGE BAND HDF5 GROUP
             std::string bandName = KEA_DATASETNAME_BAND + uint2Str(bandIndex);
-            keaImgH5File->createGroup(bandName);
+            keaImgH5File->createGroup(bandName, getGroupCreateProps(keaImgH5File));
 
             // CREATE THE IMAGE DATA ARRAY
             HighFive::DataSet imgBandDataSet = keaImgH5File->createDataSet(
@@ -3151,10 +7090,13 @@ namespace kealib{
             	scalar_dataspace,
 				HighFive::FixedLengthStringType(4, HighFive::StringPadding::NullTerminated)).write("1.2");
             
-            imgBandDataSet.createAttribute<uint16_t>(
-                KEA_ATTRIBUTENAME_BLOCK_SIZE,
-                blockSize2Use
-            );
+            writeBlockSizeAttributes(imgBandDataSet, blockXSize2Use, blockYSize2Use);
+            
+            if( nBits > 0 )
+            {
+                imgBandDataSet.createAttribute<uint8_t>(KEA_ATTRIBUTENAME_NBITS, nBits);
+                imgBandDataSet.createAttribute<uint64_t>(KEA_ATTRIBUTENAME_XSIZE, xSize);
+            }
 
             // SET BAND NAME / DESCRIPTION
             if (bandDescrip.empty())
@@ -3164,7 +7106,8 @@ namespace kealib{
             auto datasetBandDescript = keaImgH5File->createDataSet(
                 (bandName + KEA_BANDNAME_DESCRIP),
                 oldKeaDataSpace,
-                var_stringtype
+                var_stringtype,
+                smallDataSetProps
             );
             datasetBandDescript.write(bandDescrip);
 
@@ -3172,7 +7115,8 @@ namespace kealib{
             // TODO: dataspace instead of scalar to be compatible with old KEA
             auto dtDataset = keaImgH5File->createDataSet<uint16_t>(
                 (bandName + KEA_BANDNAME_DT),
-                oldKeaDataSpace
+                oldKeaDataSpace,
+                smallDataSetProps
             );
             dtDataset.write(uint16_t(dataType));
 
@@ -3181,7 +7125,8 @@ namespace kealib{
             // TODO: dataspace instead of scalar to be compatible with old KEA
             auto typeDataset = keaImgH5File->createDataSet<uint8_t>(
                 (bandName + KEA_BANDNAME_TYPE),
-                oldKeaDataSpace
+                oldKeaDataSpace,
+                smallDataSetProps
             );
             typeDataset.write(bandType);
 
@@ -3189,12 +7134,13 @@ namespace kealib{
             // TODO: dataspace instead of scalar to be compatible with old KEA
             auto usageDataset = keaImgH5File->createDataSet<uint8_t>(
                 (bandName + KEA_BANDNAME_USAGE),
-                oldKeaDataSpace
+                oldKeaDataSpace,
+                smallDataSetProps
             );
             usageDataset.write(bandUsage);
 
             // CREATE META-DATA
-            keaImgH5File->createGroup(bandName + KEA_BANDNAME_METADATA);
+            keaImgH5File->createGroup(bandName + KEA_BANDNAME_METADATA, getGroupCreateProps(keaImgH5File));
 
             // CREATE OVERVIEWS GROUP
             keaImgH5File->createGroup(bandName + KEA_BANDNAME_OVERVIEWS);
@@ -3211,7 +7157,8 @@ namespace kealib{
             auto attChunkSizeDataSpace = HighFive::DataSpace({1});
             auto attChunkSizeDataset = keaImgH5File->createDataSet<uint64_t>(
                 (bandName + KEA_ATT_CHUNKSIZE_HEADER),
-                attChunkSizeDataSpace
+                attChunkSizeDataSpace,
+                smallDataSetProps
             );
             attChunkSizeDataset.write(attBlockSize);
 
@@ -3220,7 +7167,8 @@ namespace kealib{
             std::vector<uint64_t> attSize = {0, 0, 0, 0, 0};
             auto attSizeDataset = keaImgH5File->createDataSet<uint64_t>(
                 (bandName + KEA_ATT_SIZE_HEADER),
-                HighFive::DataSpace::From(attSize)
+                HighFive::DataSpace::From(attSize),
+                smallDataSetProps
             );
             attSizeDataset.write(attSize);
         }
@@ -3343,6 +7291,40 @@ namespace kealib{
             throw kealib::KEAIOException(e.what());
         }
     }
+    HighFive::CompoundType KEAImageIO::createBandInfoCompType()
+    {
+        try
+        {
+            std::vector<HighFive::CompoundType::member_def> members;
+            members.push_back(HighFive::CompoundType::member_def(KEA_CONSOLIDATED_DESCRIP, HighFive::VariableLengthStringType()));
+            members.push_back(HighFive::CompoundType::member_def(KEA_CONSOLIDATED_DT, HighFive::AtomicType<uint32_t>()));
+            members.push_back(HighFive::CompoundType::member_def(KEA_CONSOLIDATED_TYPE, HighFive::AtomicType<uint32_t>()));
+            members.push_back(HighFive::CompoundType::member_def(KEA_CONSOLIDATED_USAGE, HighFive::AtomicType<uint32_t>()));
+            members.push_back(HighFive::CompoundType::member_def(KEA_CONSOLIDATED_BLOCK_SIZE, HighFive::AtomicType<uint32_t>()));
+            members.push_back(HighFive::CompoundType::member_def(KEA_CONSOLIDATED_BLOCK_YSIZE, HighFive::AtomicType<uint32_t>()));
+            members.push_back(HighFive::CompoundType::member_def(KEA_CONSOLIDATED_NO_DATA_DEFINED, HighFive::AtomicType<int32_t>()));
+            members.push_back(HighFive::CompoundType::member_def(KEA_CONSOLIDATED_NO_DATA_VAL, HighFive::AtomicType<uint64_t>()));
+            return HighFive::CompoundType(members);
+        }
+        catch( const HighFive::Exception &e)
+        {
+            throw kealib::KEAIOException(e.what());
+        }
+    }
+    HighFive::CompoundType KEAImageIO::createMetaDataCompType()
+    {
+        try
+        {
+            std::vector<HighFive::CompoundType::member_def> members;
+            members.push_back(HighFive::CompoundType::member_def(KEA_METADATA_COMPACT_NAME, HighFive::VariableLengthStringType()));
+            members.push_back(HighFive::CompoundType::member_def(KEA_METADATA_COMPACT_VALUE, HighFive::VariableLengthStringType()));
+            return HighFive::CompoundType(members);
+        }
+        catch( const HighFive::Exception &e)
+        {
+            throw kealib::KEAIOException(e.what());
+        }
+    }
 } // namespace libkea
 
 #include "libkea/kea-config.h"
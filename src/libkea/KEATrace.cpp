@@ -0,0 +1,269 @@
+/*
+ *  KEATrace.cpp
+ *  LibKEA
+ *
+ *  Copyright 2012 LibKEA. All rights reserved.
+ *
+ *  This file is part of LibKEA.
+ *
+ *  Permission is hereby granted, free of charge, to any person
+ *  obtaining a copy of this software and associated documentation
+ *  files (the "Software"), to deal in the Software without restriction,
+ *  including without limitation the rights to use, copy, modify,
+ *  merge, publish, distribute, sublicense, and/or sell copies of the
+ *  Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be
+ *  included in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ *  ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ *  WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "libkea/KEATrace.h"
+#include "libkea/KEAException.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace kealib{
+
+    struct KEATraceEvent
+    {
+        const char *name;
+        const char *category;
+        double start;       // microseconds
+        double duration;
+        std::string args;
+    };
+
+    // events recorded by each thread before the rest are dropped, so
+    // a long running process doesn't use ever more memory
+    static const size_t KEA_TRACE_MAX_EVENTS_PER_THREAD( 1000000 );
+
+    // only added to by the thread it belongs to, but start() and stop()
+    // clear and write it from another thread, so the mutex (uncontended
+    // otherwise) is held for both
+    struct KEATraceBuffer
+    {
+        std::mutex mutex;
+        uint32_t tid;
+        std::vector<KEATraceEvent> events;
+        uint64_t dropped;   // events not recorded as the buffer was full
+    };
+
+    // never destroyed so it is still there for the atexit handler
+    // however the other statics are destroyed
+    struct KEATraceState
+    {
+        std::mutex mutex;
+        // buffers of all the threads that have recorded something. They are
+        // kept after the thread exits so its events are still written.
+        std::vector<std::shared_ptr<KEATraceBuffer> > buffers;
+        std::string fileName;
+        // steady_clock nanoseconds when recording started. now() reads it without the mutex
+        std::atomic<int64_t> epochNanos{0};
+    };
+
+    std::atomic<bool> KEATrace::s_enabled(false);
+
+    static KEATraceState &getTraceState()
+    {
+        static KEATraceState *state = new KEATraceState();
+        return *state;
+    }
+
+    static KEATraceBuffer *getThreadTraceBuffer()
+    {
+        thread_local std::shared_ptr<KEATraceBuffer> buffer;
+        if( !buffer )
+        {
+            // once per thread
+            KEATraceState &state = getTraceState();
+            std::lock_guard<std::mutex> lock(state.mutex);
+            buffer = std::make_shared<KEATraceBuffer>();
+            buffer->tid = static_cast<uint32_t>(state.buffers.size() + 1);
+            buffer->dropped = 0;
+            state.buffers.push_back(buffer);
+        }
+        return buffer.get();
+    }
+
+    static void appendJSONString(std::string *out, const std::string &value)
+    {
+        out->push_back('"');
+        for( char c : value )
+        {
+            if( (c == '"') || (c == '\\') )
+            {
+                out->push_back('\\');
+                out->push_back(c);
+            }
+            else if( static_cast<unsigned char>(c) < 0x20 )
+            {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned int>(c));
+                out->append(escaped);
+            }
+            else
+            {
+                out->push_back(c);
+            }
+        }
+        out->push_back('"');
+    }
+
+    void KEATrace::start(const std::string &fileName)
+    {
+        KEATraceState &state = getTraceState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        for( auto &buffer : state.buffers )
+        {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            buffer->events.clear();
+            buffer->dropped = 0;
+        }
+        state.fileName = fileName;
+        state.epochNanos.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+        s_enabled.store(true);
+    }
+
+    void KEATrace::stop()
+    {
+        s_enabled.store(false);
+        KEATraceState &state = getTraceState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+
+        std::ofstream traceFile(state.fileName.c_str());
+        if( !traceFile )
+        {
+            throw KEAIOException("Could not open the trace file " + state.fileName);
+        }
+        // "X" events have a start and duration so nesting works out
+        // from the times without needing begin and end events
+        traceFile << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        uint64_t dropped = 0;
+        std::string line;
+        for( auto &buffer : state.buffers )
+        {
+            // a scope that was open when recording stopped may still be adding its event
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            for( const KEATraceEvent &event : buffer->events )
+            {
+                line = first ? "\n" : ",\n";
+                line += "{\"name\":";
+                appendJSONString(&line, event.name);
+                line += ",\"cat\":";
+                appendJSONString(&line, event.category);
+                char times[128];
+                snprintf(times, sizeof(times), ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u",
+                    event.start, event.duration, buffer->tid);
+                line += times;
+                line += ",\"args\":{" + event.args + "}}";
+                traceFile << line;
+                first = false;
+            }
+            dropped += buffer->dropped;
+            buffer->events.clear();
+            buffer->dropped = 0;
+        }
+        traceFile << "\n],\"otherData\":{\"droppedEvents\":" << dropped << "}}\n";
+        if( !traceFile )
+        {
+            throw KEAIOException("Could not write the trace file " + state.fileName);
+        }
+    }
+
+    double KEATrace::now()
+    {
+        std::chrono::steady_clock::time_point epoch(std::chrono::nanoseconds(getTraceState().epochNanos.load()));
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    void KEATrace::addEvent(const char *name, const char *category, double start, double duration,
+        const std::string &args)
+    {
+        KEATraceBuffer *buffer = getThreadTraceBuffer();
+        std::lock_guard<std::mutex> lock(buffer->mutex);
+        if( !KEATrace::isEnabled() )
+        {
+            // ended after stop()
+            return;
+        }
+        if( buffer->events.size() >= KEA_TRACE_MAX_EVENTS_PER_THREAD )
+        {
+            buffer->dropped++;
+            return;
+        }
+        buffer->events.push_back(KEATraceEvent{name, category, start, duration, args});
+    }
+
+    void KEATraceScope::appendArg(const char *name, uint64_t value)
+    {
+        if( !m_args.empty() )
+        {
+            m_args.push_back(',');
+        }
+        appendJSONString(&m_args, name);
+        m_args += ":" + std::to_string(value);
+    }
+
+    void KEATraceScope::appendArg(const char *name, const std::string &value)
+    {
+        if( !m_args.empty() )
+        {
+            m_args.push_back(',');
+        }
+        appendJSONString(&m_args, name);
+        m_args.push_back(':');
+        appendJSONString(&m_args, value);
+    }
+
+    // writes the trace started from KEA_TRACE when the process exits
+    static void stopTraceAtExit()
+    {
+        if( KEATrace::isEnabled() )
+        {
+            try
+            {
+                KEATrace::stop();
+            }
+            catch(const KEAIOException &e)
+            {
+                fprintf(stderr, "%s\n", e.what());
+            }
+        }
+    }
+
+    // starts recording when the library is loaded if KEA_TRACE is set
+    class KEATraceFromEnvironment
+    {
+    public:
+        KEATraceFromEnvironment()
+        {
+            const char *pszFileName = getenv("KEA_TRACE");
+            if( (pszFileName != nullptr) && (*pszFileName != '\0') )
+            {
+                KEATrace::start(pszFileName);
+                // rather than a destructor here, which would depend on
+                // the order the statics of the process are destroyed in
+                atexit(stopTraceAtExit);
+            }
+        }
+    };
+    static KEATraceFromEnvironment traceFromEnvironment;
+}
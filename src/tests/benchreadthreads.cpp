@@ -0,0 +1,158 @@
+/*
+ *  benchreadthreads.cpp
+ *  LibKEA
+ *
+ *  Copyright 2012 LibKEA. All rights reserved.
+ *
+ *  This file is part of LibKEA.
+ *
+ *  Permission is hereby granted, free of charge, to any person
+ *  obtaining a copy of this software and associated documentation
+ *  files (the "Software"), to deal in the Software without restriction,
+ *  including without limitation the rights to use, copy, modify,
+ *  merge, publish, distribute, sublicense, and/or sell copies of the
+ *  Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be
+ *  included in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ *  ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ *  WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+// Reads every block of an image from 1, 2, 4... threads sharing one
+// KEAImageIO and prints the throughput for each. Like a tile server
+// each read also asks for the band's data type and block size.
+// Usage: benchreadthreads [maxthreads] [passes]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "libkea/KEAImageIO.h"
+#include "testsupport.h"
+
+#define BENCH_XSIZE 4096
+#define BENCH_YSIZE 4096
+#define BENCH_BANDS 2
+
+static void readBlocks(kealib::KEAImageIO *io, std::atomic<uint64_t> *nextBlock, uint64_t numBlocks, std::atomic<uint64_t> *bytesRead)
+{
+    uint64_t blockSize = io->getImageBlockSize(1);
+    uint64_t xBlocks = (BENCH_XSIZE + blockSize - 1) / blockSize;
+    uint64_t yBlocks = (BENCH_YSIZE + blockSize - 1) / blockSize;
+    std::vector<uint8_t> buffer(blockSize * blockSize);
+    uint64_t bytes = 0;
+
+    uint64_t idx;
+    while( (idx = nextBlock->fetch_add(1)) < numBlocks )
+    {
+        uint32_t band = (idx / (xBlocks * yBlocks)) % io->getNumOfImageBands() + 1;
+        uint64_t block = idx % (xBlocks * yBlocks);
+        uint64_t xOff = (block % xBlocks) * blockSize;
+        uint64_t yOff = (block / xBlocks) * blockSize;
+        uint64_t xSize = std::min(blockSize, BENCH_XSIZE - xOff);
+        uint64_t ySize = std::min(blockSize, BENCH_YSIZE - yOff);
+
+        kealib::KEADataType dataType = io->getImageBandDataType(band);
+        uint64_t bandBlockSize = io->getImageBlockSize(band);
+        io->readImageBlock2Band(band, buffer.data(), xOff, yOff, xSize, ySize, bandBlockSize, bandBlockSize, dataType);
+        bytes += xSize * ySize;
+    }
+    *bytesRead += bytes;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int maxThreads = std::thread::hardware_concurrency();
+    unsigned int passes = 4;
+    if( argc > 1 )
+    {
+        maxThreads = atoi(argv[1]);
+    }
+    if( argc > 2 )
+    {
+        passes = atoi(argv[2]);
+    }
+    if( maxThreads == 0 )
+    {
+        maxThreads = 1;
+    }
+
+    try
+    {
+        std::string bench_kea_file = "bench_readthreads.kea";
+        auto spatialInfo = getSpatialInfo(0);
+
+        std::cout << "Creating file" << std::endl;
+        HighFive::File *h5file = kealib::KEAImageIO::createKEAImage(bench_kea_file,
+                        kealib::kea_8uint, BENCH_XSIZE, BENCH_YSIZE, BENCH_BANDS,
+                        nullptr, &spatialInfo);
+        kealib::KEAImageIO io;
+        io.openKEAImageHeader(h5file);
+        uint8_t *pData = createDataForType<uint8_t>(BENCH_XSIZE, BENCH_YSIZE);
+        for( uint32_t band = 1; band <= BENCH_BANDS; band++ )
+        {
+            io.writeImageBlock2Band(band, pData, 0, 0, BENCH_XSIZE, BENCH_YSIZE,
+                        BENCH_XSIZE, BENCH_YSIZE, kealib::kea_8uint);
+        }
+        free(pData);
+        io.close();
+
+        h5file = kealib::KEAImageIO::openKeaH5RDOnly(bench_kea_file);
+        io.openKEAImageHeader(h5file);
+
+        uint64_t blockSize = io.getImageBlockSize(1);
+        uint64_t numBlocks = ((BENCH_XSIZE + blockSize - 1) / blockSize) *
+                ((BENCH_YSIZE + blockSize - 1) / blockSize) * BENCH_BANDS * passes;
+
+        std::cout << std::setw(8) << "threads" << std::setw(12) << "seconds"
+                << std::setw(12) << "MB/s" << std::setw(12) << "speedup" << std::endl;
+        double singleSecs = 0;
+        for( unsigned int numThreads = 1; numThreads <= maxThreads; numThreads *= 2 )
+        {
+            std::atomic<uint64_t> nextBlock(0);
+            std::atomic<uint64_t> bytesRead(0);
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> threads;
+            for( unsigned int n = 0; n < numThreads; n++ )
+            {
+                threads.push_back(std::thread(readBlocks, &io, &nextBlock, numBlocks, &bytesRead));
+            }
+            for( auto &thread : threads )
+            {
+                thread.join();
+            }
+            double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if( numThreads == 1 )
+            {
+                singleSecs = secs;
+            }
+
+            std::cout << std::setw(8) << numThreads << std::setw(12) << std::fixed << std::setprecision(3) << secs
+                << std::setw(12) << std::setprecision(1) << (bytesRead / (1024.0 * 1024.0)) / secs
+                << std::setw(12) << std::setprecision(2) << singleSecs / secs << std::endl;
+        }
+
+        io.close();
+        remove(bench_kea_file.c_str());
+    }
+    catch(const kealib::KEAException &e)
+    {
+        fprintf(stderr, "Exception raised: %s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,587 @@
+/*
+ *  keabench.cpp
+ *  LibKEA
+ *
+ *  Copyright 2012 LibKEA. All rights reserved.
+ *
+ *  This file is part of LibKEA.
+ *
+ *  Permission is hereby granted, free of charge, to any person
+ *  obtaining a copy of this software and associated documentation
+ *  files (the "Software"), to deal in the Software without restriction,
+ *  including without limitation the rights to use, copy, modify,
+ *  merge, publish, distribute, sublicense, and/or sell copies of the
+ *  Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be
+ *  included in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ *  ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ *  WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+// Times writing and reading a single band image of generated data for
+// every combination of data type, block size and deflate level asked for
+// and prints the results as JSON. For each combination the band is written
+// a block at a time (with a mask and an overview) then read:
+//   read_sequential    every block in order
+//   read_random_tiles  whole blocks in a random order
+//   read_edge_tiles    the part blocks along the right and bottom edges
+//                      into block sized buffers
+//   read_unaligned     windows 1.5 blocks across at random offsets
+//   read_threads       random blocks from 1, 2, 4... threads sharing one KEAImageIO
+//   read_overview      every block of the overview
+//   read_mask          every block of the mask
+// Each read test opens the file again so the HDF5 caches start empty (the
+// operating system's cache will still have it).
+//
+// Usage: keabench [--size pixels] [--types kea_8uint,kea_32float,...]
+//                 [--blocks 64,256,...] [--deflates 0,1,...] [--threads max]
+//                 [--reads n] [--output file.json]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <exception>
+#include "libkea/KEAImageIO.h"
+#include "testsupport.h"
+
+static const kealib::KEADataType BENCH_TYPES[] = {
+    kealib::kea_8int, kealib::kea_16int, kealib::kea_32int, kealib::kea_64int,
+    kealib::kea_8uint, kealib::kea_16uint, kealib::kea_32uint, kealib::kea_64uint,
+    kealib::kea_32float, kealib::kea_64float, kealib::kea_1uint, kealib::kea_2uint,
+    kealib::kea_4uint, kealib::kea_16float
+};
+
+static const char *BENCH_TYPE_NAMES[] = {
+    "kea_8int", "kea_16int", "kea_32int", "kea_64int",
+    "kea_8uint", "kea_16uint", "kea_32uint", "kea_64uint",
+    "kea_32float", "kea_64float", "kea_1uint", "kea_2uint",
+    "kea_4uint", "kea_16float"
+};
+
+static const size_t BENCH_NUM_TYPES = sizeof(BENCH_TYPES) / sizeof(BENCH_TYPES[0]);
+
+struct BenchWindow
+{
+    uint64_t xOff;
+    uint64_t yOff;
+    uint64_t xSize;
+    uint64_t ySize;
+    uint64_t xSizeBuf;
+    uint64_t ySizeBuf;
+};
+
+enum BenchTarget
+{
+    bench_image,
+    bench_overview,
+    bench_mask
+};
+
+struct BenchResult
+{
+    std::string test;
+    unsigned int threads;
+    uint64_t bytes;
+    double seconds;
+    std::vector<double> latencies;  // microseconds for each call
+};
+
+static const char *getTypeName(kealib::KEADataType dataType)
+{
+    for( size_t n = 0; n < BENCH_NUM_TYPES; n++ )
+    {
+        if( BENCH_TYPES[n] == dataType )
+        {
+            return BENCH_TYPE_NAMES[n];
+        }
+    }
+    return "kea_undefined";
+}
+
+// the type of the buffers used to read and write a band of dataType
+static kealib::KEADataType getBufferType(kealib::KEADataType dataType)
+{
+    if( kealib::getDataTypeNBits(dataType) != 0 )
+    {
+        return kealib::kea_8uint;
+    }
+    else if( dataType == kealib::kea_16float )
+    {
+        return kealib::kea_32float;
+    }
+    return dataType;
+}
+
+static size_t getPixelSize(kealib::KEADataType bufType)
+{
+    switch( bufType )
+    {
+        case kealib::kea_8int:
+        case kealib::kea_8uint:
+            return 1;
+        case kealib::kea_16int:
+        case kealib::kea_16uint:
+            return 2;
+        case kealib::kea_32int:
+        case kealib::kea_32uint:
+        case kealib::kea_32float:
+            return 4;
+        default:
+            return 8;
+    }
+}
+
+// smooth with a little noise so it compresses like an image
+template <typename T>
+static void fillWindowTyped(void *pData, const BenchWindow &window, uint64_t maxValue)
+{
+    T *pTyped = static_cast<T*>(pData);
+    for( uint64_t y = 0; y < window.ySize; y++ )
+    {
+        for( uint64_t x = 0; x < window.xSize; x++ )
+        {
+            uint64_t xPxl = window.xOff + x;
+            uint64_t yPxl = window.yOff + y;
+            uint64_t value = ((xPxl + yPxl) / 4 + ((xPxl * 7 + yPxl * 13) % 5)) % maxValue;
+            pTyped[(y * window.xSizeBuf) + x] = static_cast<T>(value);
+        }
+    }
+}
+
+static std::vector<uint8_t> createWindowData(kealib::KEADataType dataType, const BenchWindow &window)
+{
+    kealib::KEADataType bufType = getBufferType(dataType);
+    std::vector<uint8_t> data(window.xSizeBuf * window.ySizeBuf * getPixelSize(bufType));
+    uint8_t nBits = kealib::getDataTypeNBits(dataType);
+    uint64_t maxValue = (nBits != 0) ? (uint64_t(1) << nBits) : 100;
+    switch( bufType )
+    {
+        case kealib::kea_8int: fillWindowTyped<int8_t>(data.data(), window, maxValue); break;
+        case kealib::kea_16int: fillWindowTyped<int16_t>(data.data(), window, maxValue); break;
+        case kealib::kea_32int: fillWindowTyped<int32_t>(data.data(), window, maxValue); break;
+        case kealib::kea_64int: fillWindowTyped<int64_t>(data.data(), window, maxValue); break;
+        case kealib::kea_8uint: fillWindowTyped<uint8_t>(data.data(), window, maxValue); break;
+        case kealib::kea_16uint: fillWindowTyped<uint16_t>(data.data(), window, maxValue); break;
+        case kealib::kea_32uint: fillWindowTyped<uint32_t>(data.data(), window, maxValue); break;
+        case kealib::kea_64uint: fillWindowTyped<uint64_t>(data.data(), window, maxValue); break;
+        case kealib::kea_32float: fillWindowTyped<float>(data.data(), window, maxValue); break;
+        default: fillWindowTyped<double>(data.data(), window, maxValue); break;
+    }
+    return data;
+}
+
+static BenchWindow makeWindow(uint64_t xOff, uint64_t yOff, uint64_t xSize, uint64_t ySize)
+{
+    BenchWindow window = {xOff, yOff, xSize, ySize, xSize, ySize};
+    return window;
+}
+
+// every block of an xSize by ySize image, row by row
+static std::vector<BenchWindow> getAllBlocks(uint64_t xSize, uint64_t ySize, uint64_t blockSize)
+{
+    std::vector<BenchWindow> windows;
+    for( uint64_t yOff = 0; yOff < ySize; yOff += blockSize )
+    {
+        for( uint64_t xOff = 0; xOff < xSize; xOff += blockSize )
+        {
+            windows.push_back(makeWindow(xOff, yOff, std::min(blockSize, xSize - xOff),
+                std::min(blockSize, ySize - yOff)));
+        }
+    }
+    return windows;
+}
+
+static std::vector<BenchWindow> getRandomBlocks(uint64_t size, uint64_t blockSize, unsigned int numReads, std::mt19937_64 &rng)
+{
+    std::vector<BenchWindow> allBlocks = getAllBlocks(size, size, blockSize);
+    std::vector<BenchWindow> windows;
+    std::uniform_int_distribution<size_t> pick(0, allBlocks.size() - 1);
+    for( unsigned int n = 0; n < numReads; n++ )
+    {
+        windows.push_back(allBlocks[pick(rng)]);
+    }
+    return windows;
+}
+
+static std::vector<BenchWindow> getEdgeBlocks(uint64_t size, uint64_t blockSize)
+{
+    std::vector<BenchWindow> windows;
+    for( const BenchWindow &block : getAllBlocks(size, size, blockSize) )
+    {
+        if( ((block.xOff + blockSize) >= size) || ((block.yOff + blockSize) >= size) )
+        {
+            BenchWindow window = block;
+            window.xSizeBuf = blockSize;
+            window.ySizeBuf = blockSize;
+            windows.push_back(window);
+        }
+    }
+    return windows;
+}
+
+static std::vector<BenchWindow> getUnalignedWindows(uint64_t size, uint64_t blockSize, unsigned int numReads, std::mt19937_64 &rng)
+{
+    uint64_t windowSize = std::min(size, (blockSize * 3) / 2);
+    std::uniform_int_distribution<uint64_t> offset(0, size - windowSize);
+    std::vector<BenchWindow> windows;
+    for( unsigned int n = 0; n < numReads; n++ )
+    {
+        uint64_t xOff = offset(rng);
+        uint64_t yOff = offset(rng);
+        windows.push_back(makeWindow(xOff, yOff, windowSize, windowSize));
+    }
+    return windows;
+}
+
+static void readWindow(kealib::KEAImageIO *io, BenchTarget target, const BenchWindow &window,
+    void *pData, kealib::KEADataType bufType)
+{
+    switch( target )
+    {
+        case bench_image:
+            io->readImageBlock2Band(1, pData, window.xOff, window.yOff, window.xSize, window.ySize,
+                window.xSizeBuf, window.ySizeBuf, bufType);
+            break;
+        case bench_overview:
+            io->readFromOverview(1, 1, pData, window.xOff, window.yOff, window.xSize, window.ySize,
+                window.xSizeBuf, window.ySizeBuf, bufType);
+            break;
+        case bench_mask:
+            io->readImageBlock2BandMask(1, pData, window.xOff, window.yOff, window.xSize, window.ySize,
+                window.xSizeBuf, window.ySizeBuf, kealib::kea_8uint);
+            break;
+    }
+}
+
+// reads the windows, shared out between numThreads threads
+static BenchResult timeReads(const std::string &test, kealib::KEAImageIO *io, BenchTarget target,
+    const std::vector<BenchWindow> &windows, kealib::KEADataType bufType, unsigned int numThreads)
+{
+    if( target == bench_mask )
+    {
+        bufType = kealib::kea_8uint;
+    }
+    size_t pixelSize = getPixelSize(bufType);
+    std::atomic<size_t> nextWindow(0);
+    std::vector<std::vector<double> > threadLatencies(numThreads);
+    std::vector<std::exception_ptr> threadErrors(numThreads);
+
+    auto readWindows = [&](unsigned int thread)
+    {
+        try
+        {
+            std::vector<uint8_t> buffer;
+            size_t idx;
+            while( (idx = nextWindow.fetch_add(1)) < windows.size() )
+            {
+                const BenchWindow &window = windows[idx];
+                buffer.resize(window.xSizeBuf * window.ySizeBuf * pixelSize);
+                auto start = std::chrono::steady_clock::now();
+                readWindow(io, target, window, buffer.data(), bufType);
+                threadLatencies[thread].push_back(std::chrono::duration<double, std::micro>(
+                    std::chrono::steady_clock::now() - start).count());
+            }
+        }
+        catch(...)
+        {
+            threadErrors[thread] = std::current_exception();
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for( unsigned int n = 0; n < numThreads; n++ )
+    {
+        threads.push_back(std::thread(readWindows, n));
+    }
+    for( auto &thread : threads )
+    {
+        thread.join();
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for( auto &error : threadErrors )
+    {
+        if( error )
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    BenchResult result;
+    result.test = test;
+    result.threads = numThreads;
+    result.seconds = secs;
+    result.bytes = 0;
+    for( const BenchWindow &window : windows )
+    {
+        result.bytes += window.xSize * window.ySize * pixelSize;
+    }
+    for( auto &latencies : threadLatencies )
+    {
+        result.latencies.insert(result.latencies.end(), latencies.begin(), latencies.end());
+    }
+    return result;
+}
+
+static void writeResultJSON(std::ostream &out, const kealib::KEADataType dataType, uint32_t blockSize,
+    uint32_t deflate, BenchResult &result, bool first)
+{
+    double mbPerSec = (result.seconds > 0) ? (result.bytes / (1024.0 * 1024.0)) / result.seconds : 0;
+
+    out << (first ? "\n" : ",\n") << std::fixed << std::setprecision(3)
+        << "    {\"datatype\": \"" << getTypeName(dataType) << "\", \"block_size\": " << blockSize
+        << ", \"deflate\": " << deflate << ", \"test\": \"" << result.test << "\", \"threads\": " << result.threads
+        << ", \"calls\": " << result.latencies.size() << ", \"bytes\": " << result.bytes
+        << ", \"seconds\": " << std::setprecision(6) << result.seconds << std::setprecision(3)
+        << ", \"mb_per_s\": " << mbPerSec
+        << ", ";
+    writeLatencyJSON(out, result.latencies);
+    out << "}";
+}
+
+static void printUsage()
+{
+    std::cerr << "Usage: keabench [--size pixels] [--types kea_8uint,kea_32float,...] [--blocks 64,256,...]" << std::endl;
+    std::cerr << "                [--deflates 0,1,...] [--threads max] [--reads n] [--output file.json]" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t size = 1000;   // not a multiple of the block sizes so there are edges
+    std::vector<kealib::KEADataType> dataTypes(BENCH_TYPES, BENCH_TYPES + BENCH_NUM_TYPES);
+    std::vector<uint32_t> blockSizes = {64, 256, 512};
+    std::vector<uint32_t> deflates = {0, 1, 6};
+    unsigned int maxThreads = std::min(std::thread::hardware_concurrency(), 8u);
+    unsigned int numReads = 200;
+    std::string outputFile;
+
+    for( int n = 1; n < argc; n++ )
+    {
+        std::string arg = argv[n];
+        if( (n + 1) >= argc )
+        {
+            printUsage();
+            return 1;
+        }
+        std::string value = argv[++n];
+        if( arg == "--size" )
+        {
+            size = strtoull(value.c_str(), nullptr, 10);
+        }
+        else if( arg == "--types" )
+        {
+            dataTypes.clear();
+            for( const std::string &name : splitList(value) )
+            {
+                const char **pEnd = BENCH_TYPE_NAMES + BENCH_NUM_TYPES;
+                const char **pFound = std::find_if(BENCH_TYPE_NAMES, pEnd,
+                    [&name](const char *typeName) { return name == typeName; });
+                if( pFound == pEnd )
+                {
+                    std::cerr << "Unknown data type " << name << std::endl;
+                    return 1;
+                }
+                dataTypes.push_back(BENCH_TYPES[pFound - BENCH_TYPE_NAMES]);
+            }
+        }
+        else if( arg == "--blocks" )
+        {
+            blockSizes.clear();
+            for( const std::string &item : splitList(value) )
+            {
+                blockSizes.push_back(atoi(item.c_str()));
+            }
+        }
+        else if( arg == "--deflates" )
+        {
+            deflates.clear();
+            for( const std::string &item : splitList(value) )
+            {
+                deflates.push_back(atoi(item.c_str()));
+            }
+        }
+        else if( arg == "--threads" )
+        {
+            maxThreads = atoi(value.c_str());
+        }
+        else if( arg == "--reads" )
+        {
+            numReads = atoi(value.c_str());
+        }
+        else if( arg == "--output" )
+        {
+            outputFile = value;
+        }
+        else
+        {
+            printUsage();
+            return 1;
+        }
+    }
+    if( maxThreads == 0 )
+    {
+        maxThreads = 1;
+    }
+    if( (size == 0) || dataTypes.empty() || blockSizes.empty() || deflates.empty() )
+    {
+        printUsage();
+        return 1;
+    }
+
+    std::ofstream outFile;
+    if( !outputFile.empty() )
+    {
+        outFile.open(outputFile.c_str());
+        if( !outFile )
+        {
+            std::cerr << "Could not open " << outputFile << std::endl;
+            return 1;
+        }
+    }
+    std::ostream &out = outputFile.empty() ? std::cout : outFile;
+
+    unsigned int h5Major, h5Minor, h5Release;
+    H5get_libversion(&h5Major, &h5Minor, &h5Release);
+    out << "{\n  \"libkea_version\": " << get_kealibversion() << ",\n  \"hdf5_version\": \""
+        << h5Major << "." << h5Minor << "." << h5Release << "\",\n  \"image_size\": " << size
+        << ",\n  \"results\": [";
+
+    try
+    {
+        std::string bench_kea_file = "bench_keabench.kea";
+        auto spatialInfo = getSpatialInfo(0);
+        uint64_t ovSize = std::max(size / 4, uint64_t(1));
+        bool first = true;
+
+        for( kealib::KEADataType dataType : dataTypes )
+        {
+            kealib::KEADataType bufType = getBufferType(dataType);
+            for( uint32_t blockSize : blockSizes )
+            {
+                // the blocks written, and so the data, only depend on the block size
+                std::vector<BenchWindow> blocks = getAllBlocks(size, size, blockSize);
+                std::vector<std::vector<uint8_t> > blockData;
+                std::vector<std::vector<uint8_t> > maskData;
+                for( const BenchWindow &block : blocks )
+                {
+                    blockData.push_back(createWindowData(dataType, block));
+                    // every 16th pixel invalid
+                    std::vector<uint8_t> mask(block.xSize * block.ySize, 255);
+                    for( size_t idx = 0; idx < mask.size(); idx += 16 )
+                    {
+                        mask[idx] = 0;
+                    }
+                    maskData.push_back(mask);
+                }
+
+                for( uint32_t deflate : deflates )
+                {
+                    std::cerr << getTypeName(dataType) << " block " << blockSize << " deflate "
+                        << deflate << std::endl;
+                    std::vector<BenchResult> results;
+                    // same windows for every combination
+                    std::mt19937_64 rng(42);
+
+                    // WRITE
+                    kealib::KEAImageIO io;
+                    io.openKEAImageHeader(kealib::KEAImageIO::createKEAImage(bench_kea_file, dataType,
+                        size, size, 1, nullptr, &spatialInfo, blockSize, kealib::KEA_ATT_CHUNK_SIZE,
+                        kealib::KEA_MDC_NELMTS, kealib::KEA_RDCC_NELMTS, kealib::KEA_RDCC_NBYTES,
+                        kealib::KEA_RDCC_W0, kealib::KEA_SIEVE_BUF, kealib::KEA_META_BLOCKSIZE, deflate));
+                    BenchResult writeResult;
+                    writeResult.test = "write_sequential";
+                    writeResult.threads = 1;
+                    writeResult.bytes = 0;
+                    auto writeStart = std::chrono::steady_clock::now();
+                    for( size_t idx = 0; idx < blocks.size(); idx++ )
+                    {
+                        const BenchWindow &block = blocks[idx];
+                        auto start = std::chrono::steady_clock::now();
+                        io.writeImageBlock2Band(1, blockData[idx].data(), block.xOff, block.yOff,
+                            block.xSize, block.ySize, block.xSizeBuf, block.ySizeBuf, bufType);
+                        writeResult.latencies.push_back(std::chrono::duration<double, std::micro>(
+                            std::chrono::steady_clock::now() - start).count());
+                        writeResult.bytes += blockData[idx].size();
+                    }
+                    writeResult.seconds = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - writeStart).count();
+                    results.push_back(writeResult);
+
+                    io.createMask(1, deflate);
+                    for( size_t idx = 0; idx < blocks.size(); idx++ )
+                    {
+                        const BenchWindow &block = blocks[idx];
+                        io.writeImageBlock2BandMask(1, maskData[idx].data(), block.xOff, block.yOff,
+                            block.xSize, block.ySize, block.xSizeBuf, block.ySizeBuf, kealib::kea_8uint);
+                    }
+                    io.createOverview(1, 1, ovSize, ovSize);
+                    io.updateOverviews(1);
+                    io.close();
+
+                    // READ
+                    std::vector<BenchWindow> randomBlocks = getRandomBlocks(size, blockSize, numReads, rng);
+                    struct ReadTest
+                    {
+                        std::string name;
+                        BenchTarget target;
+                        std::vector<BenchWindow> windows;
+                    };
+                    std::vector<ReadTest> readTests = {
+                        {"read_sequential", bench_image, blocks},
+                        {"read_random_tiles", bench_image, randomBlocks},
+                        {"read_edge_tiles", bench_image, getEdgeBlocks(size, blockSize)},
+                        {"read_unaligned", bench_image, getUnalignedWindows(size, blockSize, numReads, rng)},
+                        {"read_overview", bench_overview, getAllBlocks(ovSize, ovSize, blockSize)},
+                        {"read_mask", bench_mask, blocks}
+                    };
+                    for( const ReadTest &readTest : readTests )
+                    {
+                        io.openKEAImageHeader(kealib::KEAImageIO::openKeaH5RDOnly(bench_kea_file));
+                        results.push_back(timeReads(readTest.name, &io, readTest.target, readTest.windows, bufType, 1));
+                        io.close();
+                    }
+                    for( unsigned int numThreads = 1; numThreads <= maxThreads; numThreads *= 2 )
+                    {
+                        io.openKEAImageHeader(kealib::KEAImageIO::openKeaH5RDOnly(bench_kea_file));
+                        results.push_back(timeReads("read_threads", &io, bench_image, randomBlocks, bufType, numThreads));
+                        io.close();
+                    }
+
+                    for( BenchResult &result : results )
+                    {
+                        writeResultJSON(out, dataType, blockSize, deflate, result, first);
+                        first = false;
+                    }
+                    out.flush();
+                    remove(bench_kea_file.c_str());
+                }
+            }
+        }
+    }
+    catch(const kealib::KEAException &e)
+    {
+        fprintf(stderr, "Exception raised: %s\n", e.what());
+        return 1;
+    }
+
+    out << "\n  ]\n}" << std::endl;
+    return 0;
+}
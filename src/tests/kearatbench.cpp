@@ -0,0 +1,447 @@
+/*
+ *  kearatbench.cpp
+ *  LibKEA
+ *
+ *  Copyright 2012 LibKEA. All rights reserved.
+ *
+ *  This file is part of LibKEA.
+ *
+ *  Permission is hereby granted, free of charge, to any person
+ *  obtaining a copy of this software and associated documentation
+ *  files (the "Software"), to deal in the Software without restriction,
+ *  including without limitation the rights to use, copy, modify,
+ *  merge, publish, distribute, sublicense, and/or sell copies of the
+ *  Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be
+ *  included in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ *  ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ *  WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+// Times attribute table operations on generated tables of each number of
+// rows, chunk size and deflate level asked for and prints the results as
+// JSON. For each combination a file table (KEAAttributeTableFile) is grown
+// with addRows(), given bool, int, float and string columns and neighbours,
+// then:
+//   add_rows              addRows() in 10 steps up to the number of rows
+//   add_<type>_column     addAttBoolField() etc on the full table
+//   write_<type>/read_<type>  set/get*Fields() a batch of rows at a time
+//   write_single/read_single  setFloatField()/getIntField() of random rows
+//   write_neighbours/read_neighbours  a batch of rows at a time
+//   copy_rat              KEAAttributeTable::copyRAT() to another band
+//   load_in_mem           KEAAttributeTableInMem::createKeaAtt()
+// and the column and single field reads and writes again on the in memory
+// table. The peak memory use of the process so far is given with each result.
+//
+// Usage: kearatbench [--rows 100000,1000000,...] [--chunks 1000,10000,...]
+//                    [--deflates 0,1,...] [--batch rows] [--singles n]
+//                    [--output file.json]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <memory>
+#include "libkea/KEAImageIO.h"
+#include "libkea/KEAAttributeTableFile.h"
+#include "libkea/KEAAttributeTableInMem.h"
+#include "testsupport.h"
+
+#ifdef _WIN32
+    #define NOMINMAX
+    #include <windows.h>
+    #include <psapi.h>
+    #pragma comment(lib, "psapi.lib")
+#else
+    #include <sys/resource.h>
+#endif
+
+// every row has this many neighbours
+#define BENCH_NEIGHBOURS 4
+
+struct BenchResult
+{
+    std::string table;      // "file" or "mem"
+    std::string test;
+    uint64_t rows;          // rows (or fields) read or written
+    double seconds;
+    std::vector<double> latencies;  // microseconds for each call
+    double peakMB;
+};
+
+static double getPeakMemoryMB()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if( GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) )
+    {
+        return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+    }
+    return 0;
+#else
+    struct rusage usage;
+    if( getrusage(RUSAGE_SELF, &usage) != 0 )
+    {
+        return 0;
+    }
+#ifdef __APPLE__
+    // bytes
+    return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+    // kilobytes
+    return usage.ru_maxrss / 1024.0;
+#endif
+#endif
+}
+
+static BenchResult startResult(const std::string &table, const std::string &test)
+{
+    BenchResult result;
+    result.table = table;
+    result.test = test;
+    result.rows = 0;
+    result.seconds = 0;
+    result.peakMB = 0;
+    return result;
+}
+
+// times one call of func and adds it to result
+template <typename F>
+static void timeCall(BenchResult *result, uint64_t rows, F func)
+{
+    auto start = std::chrono::steady_clock::now();
+    func();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result->latencies.push_back(secs * 1e6);
+    result->seconds += secs;
+    result->rows += rows;
+}
+
+static void finishResult(std::vector<BenchResult> *results, BenchResult &result)
+{
+    result.peakMB = getPeakMemoryMB();
+    results->push_back(result);
+}
+
+static void createNeighboursForRows(size_t startfid, size_t len, size_t numRows, std::vector<std::vector<size_t>* > *neighbours)
+{
+    // like a segmentation on a grid 1000 segments across
+    const size_t width = 1000;
+    for( size_t fid = startfid; fid < (startfid + len); fid++ )
+    {
+        std::vector<size_t> *pRow = new std::vector<size_t>();
+        size_t candidates[BENCH_NEIGHBOURS] = {fid - 1, fid + 1, fid - width, fid + width};
+        for( size_t candidate : candidates )
+        {
+            // the ones below 0 have wrapped round
+            if( candidate < numRows )
+            {
+                pRow->push_back(candidate);
+            }
+        }
+        neighbours->push_back(pRow);
+    }
+}
+
+// writes then reads every column a batch of rows at a time, then single fields
+static void benchColumns(kealib::KEAAttributeTable *rat, const std::string &table, size_t batch,
+    unsigned int numSingles, std::vector<BenchResult> *results)
+{
+    size_t numRows = rat->getSize();
+    std::unique_ptr<bool[]> boolStore(new bool[batch]);
+    bool *boolBuffer = boolStore.get();
+    std::vector<int64_t> intBuffer(batch);
+    std::vector<double> floatBuffer(batch);
+    std::vector<std::string> stringBuffer(batch);
+
+    BenchResult writeBool = startResult(table, "write_bool");
+    BenchResult writeInt = startResult(table, "write_int");
+    BenchResult writeFloat = startResult(table, "write_float");
+    BenchResult writeString = startResult(table, "write_string");
+    for( size_t startfid = 0; startfid < numRows; startfid += batch )
+    {
+        size_t len = std::min(batch, numRows - startfid);
+        // must be the same length as the rows written
+        stringBuffer.resize(len);
+        for( size_t n = 0; n < len; n++ )
+        {
+            size_t fid = startfid + n;
+            boolBuffer[n] = (fid % 3) == 0;
+            intBuffer[n] = static_cast<int64_t>(fid % 1000);
+            floatBuffer[n] = fid * 0.5;
+            stringBuffer[n] = "seg_" + std::to_string(fid);
+        }
+        timeCall(&writeBool, len, [&]() { rat->setBoolFields(startfid, len, 0, boolBuffer); });
+        timeCall(&writeInt, len, [&]() { rat->setIntFields(startfid, len, 0, intBuffer.data()); });
+        timeCall(&writeFloat, len, [&]() { rat->setFloatFields(startfid, len, 0, floatBuffer.data()); });
+        timeCall(&writeString, len, [&]() { rat->setStringFields(startfid, len, 0, &stringBuffer); });
+    }
+    finishResult(results, writeBool);
+    finishResult(results, writeInt);
+    finishResult(results, writeFloat);
+    finishResult(results, writeString);
+
+    BenchResult readBool = startResult(table, "read_bool");
+    BenchResult readInt = startResult(table, "read_int");
+    BenchResult readFloat = startResult(table, "read_float");
+    BenchResult readString = startResult(table, "read_string");
+    for( size_t startfid = 0; startfid < numRows; startfid += batch )
+    {
+        size_t len = std::min(batch, numRows - startfid);
+        timeCall(&readBool, len, [&]() { rat->getBoolFields(startfid, len, 0, boolBuffer); });
+        timeCall(&readInt, len, [&]() { rat->getIntFields(startfid, len, 0, intBuffer.data()); });
+        timeCall(&readFloat, len, [&]() { rat->getFloatFields(startfid, len, 0, floatBuffer.data()); });
+        timeCall(&readString, len, [&]() { rat->getStringFields(startfid, len, 0, &stringBuffer); });
+    }
+    finishResult(results, readBool);
+    finishResult(results, readInt);
+    finishResult(results, readFloat);
+    finishResult(results, readString);
+
+    // same rows every time
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<size_t> pick(0, numRows - 1);
+    std::vector<size_t> fids(numSingles);
+    for( size_t &fid : fids )
+    {
+        fid = pick(rng);
+    }
+    BenchResult writeSingle = startResult(table, "write_single");
+    for( size_t fid : fids )
+    {
+        timeCall(&writeSingle, 1, [&]() { rat->setFloatField(fid, 0, fid * 0.25); });
+    }
+    finishResult(results, writeSingle);
+    BenchResult readSingle = startResult(table, "read_single");
+    int64_t total = 0;
+    for( size_t fid : fids )
+    {
+        timeCall(&readSingle, 1, [&]() { total += rat->getIntField(fid, 0); });
+    }
+    finishResult(results, readSingle);
+}
+
+static void writeResultJSON(std::ostream &out, uint64_t numRows, uint32_t chunkSize, uint32_t deflate,
+    BenchResult &result, bool first)
+{
+    double rowsPerSec = (result.seconds > 0) ? result.rows / result.seconds : 0;
+
+    out << (first ? "\n" : ",\n") << std::fixed << std::setprecision(3)
+        << "    {\"num_rows\": " << numRows << ", \"chunk_size\": " << chunkSize
+        << ", \"deflate\": " << deflate << ", \"table\": \"" << result.table << "\", \"test\": \"" << result.test
+        << "\", \"calls\": " << result.latencies.size() << ", \"rows\": " << result.rows
+        << ", \"seconds\": " << std::setprecision(6) << result.seconds << std::setprecision(3)
+        << ", \"rows_per_s\": " << rowsPerSec
+        << ", ";
+    writeLatencyJSON(out, result.latencies);
+    out << ", \"peak_memory_mb\": " << result.peakMB << "}";
+}
+
+// numbers from a comma separated list. Allows 1e6 etc
+static std::vector<uint64_t> splitNumberList(const std::string &list)
+{
+    std::vector<uint64_t> numbers;
+    for( const std::string &item : splitList(list) )
+    {
+        numbers.push_back(static_cast<uint64_t>(atof(item.c_str())));
+    }
+    return numbers;
+}
+
+static void printUsage()
+{
+    std::cerr << "Usage: kearatbench [--rows 100000,1000000,...] [--chunks 1000,10000,...]" << std::endl;
+    std::cerr << "                   [--deflates 0,1,...] [--batch rows] [--singles n] [--output file.json]" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<uint64_t> rowCounts = {100000, 1000000};
+    std::vector<uint64_t> chunkSizes = {1000, 10000, 100000};
+    std::vector<uint64_t> deflates = {0, 1, 6};
+    size_t batch = 65536;
+    unsigned int numSingles = 1000;
+    std::string outputFile;
+
+    for( int n = 1; n < argc; n++ )
+    {
+        std::string arg = argv[n];
+        if( (n + 1) >= argc )
+        {
+            printUsage();
+            return 1;
+        }
+        std::string value = argv[++n];
+        if( arg == "--rows" )
+        {
+            rowCounts = splitNumberList(value);
+        }
+        else if( arg == "--chunks" )
+        {
+            chunkSizes = splitNumberList(value);
+        }
+        else if( arg == "--deflates" )
+        {
+            deflates = splitNumberList(value);
+        }
+        else if( arg == "--batch" )
+        {
+            batch = static_cast<size_t>(atof(value.c_str()));
+        }
+        else if( arg == "--singles" )
+        {
+            numSingles = atoi(value.c_str());
+        }
+        else if( arg == "--output" )
+        {
+            outputFile = value;
+        }
+        else
+        {
+            printUsage();
+            return 1;
+        }
+    }
+    if( rowCounts.empty() || chunkSizes.empty() || deflates.empty() || (batch == 0) ||
+        (std::find(rowCounts.begin(), rowCounts.end(), 0) != rowCounts.end()) )
+    {
+        printUsage();
+        return 1;
+    }
+
+    std::ofstream outFile;
+    if( !outputFile.empty() )
+    {
+        outFile.open(outputFile.c_str());
+        if( !outFile )
+        {
+            std::cerr << "Could not open " << outputFile << std::endl;
+            return 1;
+        }
+    }
+    std::ostream &out = outputFile.empty() ? std::cout : outFile;
+
+    unsigned int h5Major, h5Minor, h5Release;
+    H5get_libversion(&h5Major, &h5Minor, &h5Release);
+    out << "{\n  \"libkea_version\": " << get_kealibversion() << ",\n  \"hdf5_version\": \""
+        << h5Major << "." << h5Minor << "." << h5Release << "\",\n  \"results\": [";
+
+    try
+    {
+        std::string bench_kea_file = "bench_kearatbench.kea";
+        auto spatialInfo = getSpatialInfo(0);
+        bool first = true;
+
+        for( uint64_t numRows : rowCounts )
+        {
+            for( uint64_t chunkSize : chunkSizes )
+            {
+                for( uint64_t deflate : deflates )
+                {
+                    std::cerr << numRows << " rows chunk " << chunkSize << " deflate " << deflate << std::endl;
+                    std::vector<BenchResult> results;
+                    auto mutex = std::make_shared<kealib::kea_mutex>();
+
+                    // 2 bands so there is somewhere to copy the table to
+                    HighFive::File *h5file = kealib::KEAImageIO::createKEAImage(bench_kea_file, kealib::kea_32uint,
+                        64, 64, 2, nullptr, &spatialInfo, kealib::KEA_IMAGE_CHUNK_SIZE, chunkSize,
+                        kealib::KEA_MDC_NELMTS, kealib::KEA_RDCC_NELMTS, kealib::KEA_RDCC_NBYTES,
+                        kealib::KEA_RDCC_W0, kealib::KEA_SIEVE_BUF, kealib::KEA_META_BLOCKSIZE, deflate);
+                    kealib::KEAAttributeTable *rat = kealib::KEAAttributeTableFile::createKeaAtt(h5file, mutex,
+                        1, chunkSize, deflate);
+
+                    BenchResult addRows = startResult("file", "add_rows");
+                    uint64_t step = std::max(numRows / 10, uint64_t(1));
+                    for( uint64_t rows = 0; rows < numRows; rows += step )
+                    {
+                        uint64_t newRows = std::min(step, numRows - rows);
+                        timeCall(&addRows, newRows, [&]() { rat->addRows(newRows); });
+                    }
+                    finishResult(&results, addRows);
+
+                    BenchResult addBool = startResult("file", "add_bool_column");
+                    timeCall(&addBool, numRows, [&]() { rat->addAttBoolField("Bool", false); });
+                    finishResult(&results, addBool);
+                    BenchResult addInt = startResult("file", "add_int_column");
+                    timeCall(&addInt, numRows, [&]() { rat->addAttIntField("Int", 0); });
+                    finishResult(&results, addInt);
+                    BenchResult addFloat = startResult("file", "add_float_column");
+                    timeCall(&addFloat, numRows, [&]() { rat->addAttFloatField("Float", 0); });
+                    finishResult(&results, addFloat);
+                    BenchResult addString = startResult("file", "add_string_column");
+                    timeCall(&addString, numRows, [&]() { rat->addAttStringField("String", ""); });
+                    finishResult(&results, addString);
+
+                    benchColumns(rat, "file", batch, numSingles, &results);
+
+                    std::vector<std::vector<size_t>* > neighbours;
+                    BenchResult writeNeighbours = startResult("file", "write_neighbours");
+                    for( size_t startfid = 0; startfid < numRows; startfid += batch )
+                    {
+                        size_t len = std::min<size_t>(batch, numRows - startfid);
+                        createNeighboursForRows(startfid, len, numRows, &neighbours);
+                        timeCall(&writeNeighbours, len, [&]() { rat->setNeighbours(startfid, len, &neighbours); });
+                        clearNeighbours(&neighbours);
+                    }
+                    finishResult(&results, writeNeighbours);
+                    BenchResult readNeighbours = startResult("file", "read_neighbours");
+                    for( size_t startfid = 0; startfid < numRows; startfid += batch )
+                    {
+                        size_t len = std::min<size_t>(batch, numRows - startfid);
+                        timeCall(&readNeighbours, len, [&]() { rat->getNeighbours(startfid, len, &neighbours); });
+                        clearNeighbours(&neighbours);
+                    }
+                    finishResult(&results, readNeighbours);
+
+                    kealib::KEAAttributeTable *copyTo = kealib::KEAAttributeTableFile::createKeaAtt(h5file, mutex,
+                        2, chunkSize, deflate);
+                    BenchResult copyRAT = startResult("file", "copy_rat");
+                    timeCall(&copyRAT, numRows, [&]() { kealib::KEAAttributeTable::copyRAT(rat, copyTo); });
+                    finishResult(&results, copyRAT);
+                    kealib::KEAAttributeTable::destroyAttributeTable(copyTo);
+                    kealib::KEAAttributeTable::destroyAttributeTable(rat);
+
+                    kealib::KEAAttributeTable *memRat = nullptr;
+                    BenchResult loadInMem = startResult("mem", "load_in_mem");
+                    timeCall(&loadInMem, numRows, [&]() { memRat = kealib::KEAAttributeTableInMem::createKeaAtt(h5file, mutex, 1); });
+                    finishResult(&results, loadInMem);
+                    benchColumns(memRat, "mem", batch, numSingles, &results);
+                    kealib::KEAAttributeTable::destroyAttributeTable(memRat);
+
+                    h5file->flush();
+                    delete h5file;
+
+                    for( BenchResult &result : results )
+                    {
+                        writeResultJSON(out, numRows, chunkSize, deflate, result, first);
+                        first = false;
+                    }
+                    out.flush();
+                    remove(bench_kea_file.c_str());
+                }
+            }
+        }
+    }
+    catch(const kealib::KEAException &e)
+    {
+        fprintf(stderr, "Exception raised: %s\n", e.what());
+        return 1;
+    }
+
+    out << "\n  ]\n}" << std::endl;
+    return 0;
+}
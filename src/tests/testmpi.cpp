@@ -0,0 +1,130 @@
+/*
+ *  testmpi.cpp
+ *  LibKEA
+ *
+ *  Copyright 2012 LibKEA. All rights reserved.
+ *
+ *  This file is part of LibKEA.
+ *
+ *  Permission is hereby granted, free of charge, to any person
+ *  obtaining a copy of this software and associated documentation
+ *  files (the "Software"), to deal in the Software without restriction,
+ *  including without limitation the rights to use, copy, modify,
+ *  merge, publish, distribute, sublicense, and/or sell copies of the
+ *  Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be
+ *  included in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ *  ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ *  WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+// Run with mpiexec. Every rank writes its own rows of an image, band 1
+// independently and band 2 collectively, then rank 0 checks them.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <algorithm>
+#include <mpi.h>
+#include "libkea/KEAImageIO.h"
+#include "testsupport.h"
+
+#define MPI_XSIZE 600
+#define MPI_YSIZE 701
+#define MPI_STRIP 64
+
+static int runTest(int rank, int nRanks)
+{
+    std::string test_kea_file = "test_mpi.kea";
+    auto spatialInfo = getSpatialInfo(0);
+    // the same data on every rank, each only writes its part
+    uint16_t *pData = createDataForType<uint16_t>(MPI_XSIZE, MPI_YSIZE);
+    uint64_t rowsPerRank = (MPI_YSIZE + nRanks - 1) / nRanks;
+    uint64_t startRow = std::min<uint64_t>(rank * rowsPerRank, MPI_YSIZE);
+    uint64_t endRow = std::min<uint64_t>(startRow + rowsPerRank, MPI_YSIZE);
+
+    // independent writes need an uncompressed band
+    HighFive::File *h5file = kealib::KEAImageIO::createKEAImage(test_kea_file,
+                    kealib::kea_16uint, MPI_XSIZE, MPI_YSIZE, 1,
+                    nullptr, &spatialInfo, kealib::KEA_IMAGE_CHUNK_SIZE, kealib::KEA_ATT_CHUNK_SIZE,
+                    kealib::KEA_MDC_NELMTS, kealib::KEA_RDCC_NELMTS, kealib::KEA_RDCC_NBYTES, 
+                    kealib::KEA_RDCC_W0, kealib::KEA_SIEVE_BUF, kealib::KEA_META_BLOCKSIZE, 0,
+                    false, kealib::KEA_PAGE_SIZE, false, MPI_COMM_WORLD, MPI_INFO_NULL);
+    kealib::KEAImageIO io;
+    io.openKEAImageHeader(h5file);
+    // everyone adds the band
+    io.addImageBand(kealib::kea_16uint, "collective");
+
+    for( uint64_t row = startRow; row < endRow; row += MPI_STRIP )
+    {
+        uint64_t nRows = std::min<uint64_t>(MPI_STRIP, endRow - row);
+        io.writeImageBlock2Band(1, &pData[row * MPI_XSIZE], 0, row, MPI_XSIZE, nRows, 
+                    MPI_XSIZE, nRows, kealib::kea_16uint);
+    }
+
+    // collectively - every rank makes the same number of calls
+    io.setCollectiveIO(true);
+    for( uint64_t offset = 0; offset < rowsPerRank; offset += MPI_STRIP )
+    {
+        uint64_t row = std::min<uint64_t>(startRow + offset, endRow);
+        uint64_t nRows = std::min<uint64_t>(MPI_STRIP, endRow - row);
+        io.writeImageBlock2Band(2, (nRows > 0) ? &pData[row * MPI_XSIZE] : pData, 0, row, MPI_XSIZE, nRows, 
+                    MPI_XSIZE, nRows, kealib::kea_16uint);
+    }
+    io.close();
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    int ret = 0;
+    if( rank == 0 )
+    {
+        h5file = kealib::KEAImageIO::openKeaH5RDOnly(test_kea_file);
+        io.openKEAImageHeader(h5file);
+        uint16_t *pReadData = (uint16_t*)calloc(MPI_XSIZE * MPI_YSIZE, sizeof(uint16_t));
+        for( uint32_t band = 1; band <= 2; band++ )
+        {
+            io.readImageBlock2Band(band, pReadData, 0, 0, MPI_XSIZE, MPI_YSIZE, 
+                    MPI_XSIZE, MPI_YSIZE, kealib::kea_16uint);
+            if( !compareData(pData, pReadData, MPI_XSIZE, MPI_YSIZE) )
+            {
+                std::cout << "Data mismatch for band " << band << std::endl;
+                ret = 1;
+            }
+        }
+        free(pReadData);
+        io.close();
+        remove(test_kea_file.c_str());
+    }
+    free(pData);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    MPI_Init(&argc, &argv);
+    int rank, nRanks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nRanks);
+
+    int ret = 0;
+    try
+    {
+        ret = runTest(rank, nRanks);
+    }
+    catch(const kealib::KEAException &e)
+    {
+        fprintf(stderr, "Exception raised: %s\n", e.what());
+        ret = 1;
+    }
+
+    MPI_Finalize();
+    return ret;
+}
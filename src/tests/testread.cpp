@@ -50,6 +50,51 @@ int main()
         io.openKEAImageHeader(h5file);
         std::cout << "Opened file" << std::endl;
         
+        // identify a few files at once
+        std::string not_kea_file = "test_notkea_" STRINGIFY(KEA_DTYPE) ".txt";
+        FILE *fh = fopen(not_kea_file.c_str(), "w");
+        fprintf(fh, "not a KEA file\n");
+        fclose(fh);
+        std::vector<std::string> identifyFiles = {test_kea_file, not_kea_file, "doesnotexist.kea", test_kea_file};
+        std::vector<bool> identified = kealib::KEAImageIO::identifyMany(identifyFiles, 2);
+        if( (identified.size() != 4) || !identified[0] || identified[1] || identified[2] || !identified[3] ||
+            !kealib::KEAImageIO::isKEAImage(test_kea_file) || kealib::KEAImageIO::isKEAImage(not_kea_file) )
+        {
+            std::cout << "Files not identified correctly" << std::endl;
+            return 1;
+        }
+        remove(not_kea_file.c_str());
+        std::cout << "Identified files" << std::endl;
+        
+        // two shared opens should give the same HDF5 file
+        {
+            HighFive::File *sharedh5 = kealib::KEAImageIO::openKeaH5RDOnly(test_kea_file, kealib::KEA_MDC_NELMTS,
+                            kealib::KEA_RDCC_NELMTS, kealib::KEA_RDCC_NBYTES, kealib::KEA_RDCC_W0,
+                            kealib::KEA_SIEVE_BUF, kealib::KEA_META_BLOCKSIZE, 0, nullptr, 
+                            kealib::KEA_PAGE_BUFFER_SIZE, true);
+            HighFive::File *sharedh5_2 = kealib::KEAImageIO::openKeaH5RDOnly(test_kea_file, kealib::KEA_MDC_NELMTS,
+                            kealib::KEA_RDCC_NELMTS, kealib::KEA_RDCC_NBYTES, kealib::KEA_RDCC_W0,
+                            kealib::KEA_SIEVE_BUF, kealib::KEA_META_BLOCKSIZE, 0, nullptr, 
+                            kealib::KEA_PAGE_BUFFER_SIZE, true);
+            if( sharedh5->getId() != sharedh5_2->getId() )
+            {
+                std::cout << "Shared opens did not share the file" << std::endl;
+                return 1;
+            }
+            kealib::KEAImageIO sharedIO;
+            sharedIO.openKEAImageHeader(sharedh5);
+            kealib::KEAImageIO sharedIO2;
+            sharedIO2.openKEAImageHeader(sharedh5_2);
+            sharedIO.close();
+            if( sharedIO2.getImageBandDescription(1) != io.getImageBandDescription(1) )
+            {
+                std::cout << "Shared file closed too early" << std::endl;
+                return 1;
+            }
+            sharedIO2.close();
+        }
+        std::cout << "Checked shared file handles" << std::endl;
+        
         auto spatialInfo2 = getSpatialInfo(10);
         auto readinfo2 = io.getSpatialInfo();
         if( !compareSpatialInfo(&spatialInfo2, readinfo2))
@@ -184,6 +229,77 @@ int main()
         }
         
         std::cout << "Mask compared" << std::endl;
+        
+        // band 2 has a bit packed mask. Any non zero value comes back as 255
+        uint8_t *pPackedCheck = (uint8_t*)calloc(readinfo2->xSize * readinfo2->ySize, sizeof(uint8_t));
+        for( uint64_t y = 0; y < readinfo2->ySize; y++ )
+        {
+            for( uint64_t x = 0; x < readinfo2->xSize; x++ )
+            {
+                uint64_t idx = (y * readinfo2->xSize) + x;
+                uint8_t val = pMaskData[idx];
+                if( (x >= 3) && (x < 24) && (y >= 5) && (y < 22) )
+                {
+                    val = pMaskData[((y - 5) * readinfo2->xSize) + (x - 3)];
+                }
+                pPackedCheck[idx] = val ? 255 : 0;
+            }
+        }
+        io.readImageBlock2BandMask(2, pReadMask, 0, 0, readinfo2->xSize, readinfo2->ySize, readinfo2->xSize, readinfo2->ySize, kealib::kea_8uint);
+        if( !compareData<uint8_t>(pReadMask, pPackedCheck, readinfo2->xSize, readinfo2->ySize))
+        {
+            return 1;
+        }
+        std::cout << "Reading right edge packed mask" << std::endl;
+        io.readImageBlock2BandMask(2, pReadMask, readinfo2->xSize - 50, 0, 50, 100, 100, 100, kealib::kea_8uint);
+        if( !compareDataSubsetEdge<uint8_t>(pPackedCheck, pReadMask, readinfo2->xSize - 50, 0, readinfo2->xSize, readinfo2->ySize, 100, 100, 50, 100, 255))
+        {
+            return 1;
+        }
+        free(pPackedCheck);
+        std::cout << "Packed mask compared" << std::endl;
+        
+        // data and mask in one go. Off the edge is never valid
+        KEA_DTYPE *pCheckData2 = createDataForType<KEA_DTYPE>(readinfo2->xSize, readinfo2->ySize);
+        KEA_DTYPE *pWithMaskData = (KEA_DTYPE*)calloc(100 * 100, sizeof(KEA_DTYPE));
+        io.readImageBlock2BandWithMask(1, pWithMaskData, pReadMask, readinfo2->xSize - 50, 0, 50, 100, 100, 100, keatype);
+        if( !compareDataSubsetEdge<uint8_t>(pMaskData, pReadMask, readinfo2->xSize - 50, 0, readinfo2->xSize, readinfo2->ySize, 100, 100, 50, 100, 0))
+        {
+            return 1;
+        }
+        // band 1 has a mask band so the data is left as is, with the no data off the edge
+        if( !compareDataSubsetEdge<KEA_DTYPE>(pCheckData2, pWithMaskData, readinfo2->xSize - 50, 0, readinfo2->xSize, readinfo2->ySize, 100, 100, 50, 100, 99))
+        {
+            return 1;
+        }
+        
+        // now with the masked out pixels set to the no data
+        for( uint64_t idx = 0; idx < (readinfo2->xSize * readinfo2->ySize); idx++ )
+        {
+            if( pMaskData[idx] == 0 )
+            {
+                pCheckData2[idx] = 99;
+            }
+        }
+        io.readImageBlock2BandWithMask(1, pWithMaskData, pReadMask, readinfo2->xSize - 50, 0, 50, 100, 100, 100, keatype, true);
+        if( !compareDataSubsetEdge<uint8_t>(pMaskData, pReadMask, readinfo2->xSize - 50, 0, readinfo2->xSize, readinfo2->ySize, 100, 100, 50, 100, 0))
+        {
+            return 1;
+        }
+        if( !compareDataSubsetEdge<KEA_DTYPE>(pCheckData2, pWithMaskData, readinfo2->xSize - 50, 0, readinfo2->xSize, readinfo2->ySize, 100, 100, 50, 100, 99))
+        {
+            return 1;
+        }
+        
+        // and without a mask buffer
+        io.readImageBlock2BandWithMask(1, pWithMaskData, nullptr, readinfo2->xSize - 50, 0, 50, 100, 100, 100, keatype, true);
+        if( !compareDataSubsetEdge<KEA_DTYPE>(pCheckData2, pWithMaskData, readinfo2->xSize - 50, 0, readinfo2->xSize, readinfo2->ySize, 100, 100, 50, 100, 99))
+        {
+            return 1;
+        }
+        free(pWithMaskData);
+        free(pCheckData2);
+        std::cout << "Data with mask compared" << std::endl;
 
         if( io.getImageMetaData("Test1") != "Value1" )
         {
@@ -0,0 +1,332 @@
+/*
+ *  teststress.cpp
+ *  LibKEA
+ *
+ *  Copyright 2012 LibKEA. All rights reserved.
+ *
+ *  This file is part of LibKEA.
+ *
+ *  Permission is hereby granted, free of charge, to any person
+ *  obtaining a copy of this software and associated documentation
+ *  files (the "Software"), to deal in the Software without restriction,
+ *  including without limitation the rights to use, copy, modify,
+ *  merge, publish, distribute, sublicense, and/or sell copies of the
+ *  Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be
+ *  included in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ *  ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ *  WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+// Runs 1, 2, 4... threads against one KEAImageIO, each doing a mix of
+//   reads of random blocks of bands 3 and 4 (checked against what was written)
+//   writes to blocks of bands 1 and 2 that only that thread writes
+//   image metadata updates
+//   attribute table int column writes and reads of rows only that thread uses
+// then checks the blocks and metadata hold the last thing each thread wrote
+// and prints the operations per second for each number of threads.
+// Fails if anything read back is wrong or an exception is raised.
+// Usage: teststress [maxthreads] [operations]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <mutex>
+#include <map>
+#include "libkea/KEAImageIO.h"
+#include "testsupport.h"
+
+#define STRESS_SIZE 1024
+#define STRESS_BLOCK 64
+#define STRESS_BLOCKS_ACROSS (STRESS_SIZE / STRESS_BLOCK)
+#define STRESS_NUM_BLOCKS (STRESS_BLOCKS_ACROSS * STRESS_BLOCKS_ACROSS)
+#define STRESS_RAT_ROWS 65536
+
+// what bands 3 and 4 hold
+static uint32_t getReadValue(uint32_t band, uint64_t x, uint64_t y)
+{
+    return (band * 1000003) + static_cast<uint32_t>((y * STRESS_SIZE) + x);
+}
+
+// what a thread writes to a block of bands 1 and 2 for an operation
+static uint32_t getWriteValue(uint64_t op, uint64_t x, uint64_t y)
+{
+    return static_cast<uint32_t>((op * STRESS_BLOCK * STRESS_BLOCK) + ((y % STRESS_BLOCK) * STRESS_BLOCK) + (x % STRESS_BLOCK));
+}
+
+struct StressState
+{
+    kealib::KEAImageIO *io;
+    kealib::KEAAttributeTable *rat;
+    unsigned int numThreads;
+    uint64_t numOps;
+    std::atomic<uint64_t> nextOp;
+    std::atomic<bool> failed;
+    std::mutex messageMutex;
+    std::string message;
+    // the last operation written to each block of bands 1 and 2
+    std::vector<uint64_t> lastWrite[2];
+};
+
+static void stressFailed(StressState *state, const std::string &message)
+{
+    std::lock_guard<std::mutex> lock(state->messageMutex);
+    if( !state->failed.exchange(true) )
+    {
+        state->message = message;
+    }
+}
+
+static void runStress(StressState *state, unsigned int thread)
+{
+    try
+    {
+        std::mt19937_64 rng(thread + 1);
+        std::vector<uint32_t> buffer(STRESS_BLOCK * STRESS_BLOCK);
+        // each thread has its own blocks and attribute table rows
+        std::vector<uint64_t> myBlocks;
+        for( uint64_t block = thread; block < STRESS_NUM_BLOCKS; block += state->numThreads )
+        {
+            myBlocks.push_back(block);
+        }
+        uint64_t ratRows = STRESS_RAT_ROWS / state->numThreads;
+        uint64_t ratStart = thread * ratRows;
+        std::vector<int64_t> ratBuffer(ratRows);
+        std::string metaName = "Stress_" + std::to_string(state->numThreads) + "_" + std::to_string(thread);
+
+        uint64_t op;
+        while( !state->failed && ((op = state->nextOp.fetch_add(1)) < state->numOps) )
+        {
+            unsigned int kind = rng() % 20;
+            if( kind < 10 )
+            {
+                uint32_t band = 3 + (rng() % 2);
+                uint64_t block = rng() % STRESS_NUM_BLOCKS;
+                uint64_t xOff = (block % STRESS_BLOCKS_ACROSS) * STRESS_BLOCK;
+                uint64_t yOff = (block / STRESS_BLOCKS_ACROSS) * STRESS_BLOCK;
+                state->io->readImageBlock2Band(band, buffer.data(), xOff, yOff, STRESS_BLOCK, STRESS_BLOCK,
+                    STRESS_BLOCK, STRESS_BLOCK, kealib::kea_32uint);
+                for( uint64_t idx = 0; idx < buffer.size(); idx++ )
+                {
+                    if( buffer[idx] != getReadValue(band, xOff + (idx % STRESS_BLOCK), yOff + (idx / STRESS_BLOCK)) )
+                    {
+                        stressFailed(state, "Wrong value read from band " + std::to_string(band));
+                        return;
+                    }
+                }
+            }
+            else if( kind < 15 )
+            {
+                uint32_t band = 1 + (rng() % 2);
+                uint64_t block = myBlocks[rng() % myBlocks.size()];
+                uint64_t xOff = (block % STRESS_BLOCKS_ACROSS) * STRESS_BLOCK;
+                uint64_t yOff = (block / STRESS_BLOCKS_ACROSS) * STRESS_BLOCK;
+                for( uint64_t idx = 0; idx < buffer.size(); idx++ )
+                {
+                    buffer[idx] = getWriteValue(op, xOff + (idx % STRESS_BLOCK), yOff + (idx / STRESS_BLOCK));
+                }
+                state->io->writeImageBlock2Band(band, buffer.data(), xOff, yOff, STRESS_BLOCK, STRESS_BLOCK,
+                    STRESS_BLOCK, STRESS_BLOCK, kealib::kea_32uint);
+                // only this thread writes this element
+                state->lastWrite[band - 1][block] = op;
+            }
+            else if( kind < 17 )
+            {
+                state->io->setImageMetaData(metaName, std::to_string(op));
+                if( state->io->getImageMetaData(metaName) != std::to_string(op) )
+                {
+                    stressFailed(state, "Wrong metadata read for " + metaName);
+                    return;
+                }
+            }
+            else if( ratRows > 0 )
+            {
+                for( uint64_t n = 0; n < ratRows; n++ )
+                {
+                    ratBuffer[n] = static_cast<int64_t>((op * STRESS_RAT_ROWS) + n);
+                }
+                state->rat->setIntFields(ratStart, ratRows, 0, ratBuffer.data());
+                std::fill(ratBuffer.begin(), ratBuffer.end(), -1);
+                state->rat->getIntFields(ratStart, ratRows, 0, ratBuffer.data());
+                for( uint64_t n = 0; n < ratRows; n++ )
+                {
+                    if( ratBuffer[n] != static_cast<int64_t>((op * STRESS_RAT_ROWS) + n) )
+                    {
+                        stressFailed(state, "Wrong value read from the attribute table");
+                        return;
+                    }
+                }
+            }
+        }
+    }
+    catch(const kealib::KEAException &e)
+    {
+        stressFailed(state, std::string("Exception raised: ") + e.what());
+    }
+}
+
+// the blocks of bands 1 and 2 hold the last thing written to them
+static bool checkWrites(StressState *state)
+{
+    std::vector<uint32_t> buffer(STRESS_BLOCK * STRESS_BLOCK);
+    for( uint32_t band = 1; band <= 2; band++ )
+    {
+        for( uint64_t block = 0; block < STRESS_NUM_BLOCKS; block++ )
+        {
+            uint64_t op = state->lastWrite[band - 1][block];
+            if( op == UINT64_MAX )
+            {
+                continue;
+            }
+            uint64_t xOff = (block % STRESS_BLOCKS_ACROSS) * STRESS_BLOCK;
+            uint64_t yOff = (block / STRESS_BLOCKS_ACROSS) * STRESS_BLOCK;
+            state->io->readImageBlock2Band(band, buffer.data(), xOff, yOff, STRESS_BLOCK, STRESS_BLOCK,
+                STRESS_BLOCK, STRESS_BLOCK, kealib::kea_32uint);
+            for( uint64_t idx = 0; idx < buffer.size(); idx++ )
+            {
+                if( buffer[idx] != getWriteValue(op, xOff + (idx % STRESS_BLOCK), yOff + (idx / STRESS_BLOCK)) )
+                {
+                    std::cout << "Block " << block << " of band " << band << " does not hold the last write" << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int maxThreads = std::thread::hardware_concurrency();
+    uint64_t numOps = 2000;
+    if( argc > 1 )
+    {
+        maxThreads = atoi(argv[1]);
+    }
+    if( argc > 2 )
+    {
+        numOps = strtoull(argv[2], nullptr, 10);
+    }
+    if( maxThreads == 0 )
+    {
+        maxThreads = 1;
+    }
+
+    try
+    {
+        std::string stress_kea_file = "test_stress.kea";
+        auto spatialInfo = getSpatialInfo(0);
+
+        HighFive::File *h5file = kealib::KEAImageIO::createKEAImage(stress_kea_file,
+                        kealib::kea_32uint, STRESS_SIZE, STRESS_SIZE, 4, nullptr, &spatialInfo, STRESS_BLOCK);
+        kealib::KEAImageIO io;
+        io.openKEAImageHeader(h5file);
+        std::vector<uint32_t> data(STRESS_SIZE * STRESS_SIZE);
+        for( uint32_t band = 3; band <= 4; band++ )
+        {
+            for( uint64_t y = 0; y < STRESS_SIZE; y++ )
+            {
+                for( uint64_t x = 0; x < STRESS_SIZE; x++ )
+                {
+                    data[(y * STRESS_SIZE) + x] = getReadValue(band, x, y);
+                }
+            }
+            io.writeImageBlock2Band(band, data.data(), 0, 0, STRESS_SIZE, STRESS_SIZE,
+                        STRESS_SIZE, STRESS_SIZE, kealib::kea_32uint);
+        }
+        kealib::KEAAttributeTable *rat = io.getAttributeTable(kealib::kea_att_file, 1);
+        rat->addRows(STRESS_RAT_ROWS);
+        rat->addAttIntField("Stress", 0);
+
+        std::cout << std::setw(8) << "threads" << std::setw(12) << "seconds"
+                << std::setw(12) << "ops/s" << std::setw(12) << "speedup" << std::endl;
+        double singleSecs = 0;
+        bool ok = true;
+        for( unsigned int numThreads = 1; numThreads <= maxThreads; numThreads *= 2 )
+        {
+            StressState state;
+            state.io = &io;
+            state.rat = rat;
+            state.numThreads = numThreads;
+            state.numOps = numOps;
+            state.nextOp = 0;
+            state.failed = false;
+            state.lastWrite[0].assign(STRESS_NUM_BLOCKS, UINT64_MAX);
+            state.lastWrite[1].assign(STRESS_NUM_BLOCKS, UINT64_MAX);
+
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> threads;
+            for( unsigned int n = 0; n < numThreads; n++ )
+            {
+                threads.push_back(std::thread(runStress, &state, n));
+            }
+            for( auto &thread : threads )
+            {
+                thread.join();
+            }
+            double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            if( state.failed )
+            {
+                std::cout << numThreads << " threads: " << state.message << std::endl;
+                ok = false;
+                break;
+            }
+            if( !checkWrites(&state) )
+            {
+                ok = false;
+                break;
+            }
+            for( unsigned int n = 0; n < numThreads; n++ )
+            {
+                // each thread's metadata item is there (if it wrote one)
+                std::string metaName = "Stress_" + std::to_string(numThreads) + "_" + std::to_string(n);
+                std::vector<std::string> names = io.getImageMetaDataNames();
+                if( (std::find(names.begin(), names.end(), metaName) != names.end()) &&
+                    io.getImageMetaData(metaName).empty() )
+                {
+                    std::cout << "Metadata " << metaName << " is empty" << std::endl;
+                    ok = false;
+                }
+            }
+
+            if( numThreads == 1 )
+            {
+                singleSecs = secs;
+            }
+            std::cout << std::setw(8) << numThreads << std::setw(12) << std::fixed << std::setprecision(3) << secs
+                << std::setw(12) << std::setprecision(1) << numOps / secs
+                << std::setw(12) << std::setprecision(2) << singleSecs / secs << std::endl;
+        }
+
+        kealib::KEAAttributeTable::destroyAttributeTable(rat);
+        io.close();
+        remove(stress_kea_file.c_str());
+        if( !ok )
+        {
+            return 1;
+        }
+    }
+    catch(const kealib::KEAException &e)
+    {
+        fprintf(stderr, "Exception raised: %s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -31,6 +31,8 @@
 #include <stdlib.h>
 #include <limits>
 #include <iostream>
+#include <sstream>
+#include <algorithm>
 #include "libkea/KEAImageIO.h"
 
 bool compareSpatialInfo(kealib::KEAImageSpatialInfo *p1, kealib::KEAImageSpatialInfo *p2)
@@ -361,3 +363,48 @@ void dumpAttField(const kealib::KEAATTField &field)
     std::cout << "name: " << field.name << " dataType: " << field.dataType << " idx: " << field.idx
         << " usage: " << field.usage << " colNum: " << field.colNum << std::endl; 
 }
+
+double getPercentile(const std::vector<double> &sorted, double percent)
+{
+    if( sorted.empty() )
+    {
+        return 0;
+    }
+    size_t idx = static_cast<size_t>((percent / 100.0) * (sorted.size() - 1) + 0.5);
+    return sorted[idx];
+}
+
+// sorts the latencies and writes the "latency_us" object
+void writeLatencyJSON(std::ostream &out, std::vector<double> &latencies)
+{
+    std::sort(latencies.begin(), latencies.end());
+    double mean = 0;
+    for( double latency : latencies )
+    {
+        mean += latency;
+    }
+    if( !latencies.empty() )
+    {
+        mean /= latencies.size();
+    }
+    out << "\"latency_us\": {\"mean\": " << mean
+        << ", \"p50\": " << getPercentile(latencies, 50)
+        << ", \"p95\": " << getPercentile(latencies, 95)
+        << ", \"p99\": " << getPercentile(latencies, 99)
+        << ", \"max\": " << (latencies.empty() ? 0 : latencies.back()) << "}";
+}
+
+std::vector<std::string> splitList(const std::string &list)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while( std::getline(stream, item, ',') )
+    {
+        if( !item.empty() )
+        {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
@@ -46,6 +46,10 @@ void createNeighbours(size_t len, std::vector<std::vector<size_t>* > *neighbours
 bool compareNeighbours(std::vector<std::vector<size_t>* > *neighbours1, std::vector<std::vector<size_t>* > *neighbours2);
 bool compareNeighboursSubset(std::vector<std::vector<size_t>* > *neighbours1, size_t offset, std::vector<std::vector<size_t>* > *neighbours2);
 void dumpAttField(const kealib::KEAATTField &field);
+// for the benchmarks
+double getPercentile(const std::vector<double> &sorted, double percent);
+void writeLatencyJSON(std::ostream &out, std::vector<double> &latencies);
+std::vector<std::string> splitList(const std::string &list);
 
 template <typename T>
 T* createDataForType(uint64_t xSize, uint64_t ySize)
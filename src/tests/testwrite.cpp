@@ -32,7 +32,13 @@
 #include <stdlib.h>
 #include <cstring>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <fstream>
+#include <iterator>
 #include "libkea/KEAImageIO.h"
+#include "libkea/KEATrace.h"
 #include "testsupport.h"
 
 int main()
@@ -139,8 +145,22 @@ int main()
         uint8_t *pMaskData = createDataForType<uint8_t>(subXSize, subYSize);
         io.writeImageBlock2BandMask(1, pMaskData, subXOff, subYOff, subXSize, subYSize,
                     subXSize, subYSize, kealib::kea_8uint);
-        free(pMaskData);
         std::cout << "Wrote mask" << std::endl;
+        
+        // bit packed mask on band 2
+        io.createMask(2, 1, true);
+        io.readImageBlock2BandMask(2, pUnsetData, 0, 0, 100, 100, 100, 100, keatype);
+        if(!compareDataConstant<KEA_DTYPE>(pUnsetData, expected, 100, 100))
+        {
+            return 1;
+        }
+        // first the whole lot, then rewrite a window that doesn't start on a byte boundary
+        io.writeImageBlock2BandMask(2, pMaskData, subXOff, subYOff, subXSize, subYSize,
+                    subXSize, subYSize, kealib::kea_8uint);
+        io.writeImageBlock2BandMask(2, pMaskData, 3, 5, 21, 17,
+                    subXSize, subYSize, kealib::kea_8uint);
+        free(pMaskData);
+        std::cout << "Wrote packed mask" << std::endl;
                     
         // dataset metadata
         io.setImageMetaData("Test1", "Value1");
@@ -476,6 +496,712 @@ int main()
             }
         }
         
+        // 2 bit packed band. Written as bytes, read back as KEA_DTYPE
+        io.addImageBand(kealib::kea_2uint, "Packed");
+        if( io.getImageBandDataType(3) != kealib::kea_2uint )
+        {
+            std::cout << "Wrong data type read for packed band" << std::endl;
+            return 1;
+        }
+        uint8_t *pPackedData = (uint8_t*)calloc(IMG_XSIZE * IMG_YSIZE, sizeof(uint8_t));
+        KEA_DTYPE *pPackedCheck = (KEA_DTYPE*)calloc(IMG_XSIZE * IMG_YSIZE, sizeof(KEA_DTYPE));
+        for( uint64_t y = 0; y < IMG_YSIZE; y++ )
+        {
+            for( uint64_t x = 0; x < IMG_XSIZE; x++ )
+            {
+                pPackedData[(y * IMG_XSIZE) + x] = (x + y) % 4;
+                pPackedCheck[(y * IMG_XSIZE) + x] = (x + y) % 4;
+            }
+        }
+        io.writeImageBlock2Band(3, pPackedData, 0, 0, IMG_XSIZE, IMG_YSIZE, IMG_XSIZE, IMG_YSIZE, kealib::kea_8uint);
+        KEA_DTYPE *pPackedRead = (KEA_DTYPE*)calloc(IMG_XSIZE * IMG_YSIZE, sizeof(KEA_DTYPE));
+        io.readImageBlock2Band(3, pPackedRead, 0, 0, IMG_XSIZE, IMG_YSIZE, IMG_XSIZE, IMG_YSIZE, keatype);
+        if( !compareData<KEA_DTYPE>(pPackedRead, pPackedCheck, IMG_XSIZE, IMG_YSIZE))
+        {
+            return 1;
+        }
+        // a window that doesn't start on a byte boundary and hangs off the edge
+        io.readImageBlock2Band(3, pPackedRead, IMG_XSIZE - 49, 3, 49, 100, 100, 100, keatype);
+        if( !compareDataSubsetEdge<KEA_DTYPE>(pPackedCheck, pPackedRead, IMG_XSIZE - 49, 3, IMG_XSIZE, IMG_YSIZE, 100, 100, 49, 100, 0))
+        {
+            return 1;
+        }
+        free(pPackedData);
+        free(pPackedCheck);
+        free(pPackedRead);
+        io.removeImageBand(3);
+        std::cout << "Checked packed band" << std::endl;
+        
+        // half float band. Values chosen to be exact in a half
+        io.addImageBand(kealib::kea_16float, "Half");
+        float *pHalfData = (float*)calloc(IMG_XSIZE * IMG_YSIZE, sizeof(float));
+        double *pHalfCheck = (double*)calloc(IMG_XSIZE * IMG_YSIZE, sizeof(double));
+        for( uint64_t y = 0; y < IMG_YSIZE; y++ )
+        {
+            for( uint64_t x = 0; x < IMG_XSIZE; x++ )
+            {
+                pHalfData[(y * IMG_XSIZE) + x] = (float(x) - float(y)) * 0.25f;
+                pHalfCheck[(y * IMG_XSIZE) + x] = (double(x) - double(y)) * 0.25;
+            }
+        }
+        io.writeImageBlock2Band(3, pHalfData, 0, 0, IMG_XSIZE, IMG_YSIZE, IMG_XSIZE, IMG_YSIZE, kealib::kea_32float);
+        double *pHalfRead = (double*)calloc(IMG_XSIZE * IMG_YSIZE, sizeof(double));
+        io.readImageBlock2Band(3, pHalfRead, 0, 0, IMG_XSIZE, IMG_YSIZE, IMG_XSIZE, IMG_YSIZE, kealib::kea_64float);
+        if( !compareData<double>(pHalfRead, pHalfCheck, IMG_XSIZE, IMG_YSIZE))
+        {
+            return 1;
+        }
+        io.readImageBlock2Band(3, pHalfRead, IMG_XSIZE - 50, 0, 50, 100, 100, 100, kealib::kea_64float);
+        if( !compareDataSubsetEdge<double>(pHalfCheck, pHalfRead, IMG_XSIZE - 50, 0, IMG_XSIZE, IMG_YSIZE, 100, 100, 50, 100, 0))
+        {
+            return 1;
+        }
+        // just over half way between two halfs as a double but exactly half way 
+        // as a float, so must be rounded up rather than to even
+        double dHalfUp = 1.0 + std::ldexp(1.0, -11) + std::ldexp(1.0, -40);
+        io.writeImageBlock2Band(3, &dHalfUp, 0, 0, 1, 1, 1, 1, kealib::kea_64float);
+        io.readImageBlock2Band(3, pHalfRead, 0, 0, 1, 1, 1, 1, kealib::kea_64float);
+        if( pHalfRead[0] != (1.0 + std::ldexp(1.0, -10)) )
+        {
+            std::cout << "Double not rounded to half correctly " << pHalfRead[0] << std::endl;
+            return 1;
+        }
+        free(pHalfData);
+        free(pHalfCheck);
+        free(pHalfRead);
+        io.removeImageBand(3);
+        std::cout << "Checked half float band" << std::endl;
+        
+        // rectangular blocks
+        io.addImageBand(keatype, "Strips", 128, kealib::KEA_ATT_CHUNK_SIZE, kealib::KEA_DEFLATE, 16);
+        uint32_t blockXSize, blockYSize;
+        io.getImageBlockSize(3, &blockXSize, &blockYSize);
+        if( (blockXSize != 128) || (blockYSize != 16) || (io.getImageBlockSize(3) != 128) )
+        {
+            std::cout << "Wrong block size " << blockXSize << "x" << blockYSize << std::endl;
+            return 1;
+        }
+        KEA_DTYPE *pStripData = createDataForType<KEA_DTYPE>(IMG_XSIZE, IMG_YSIZE);
+        io.writeImageBlock2Band(3, pStripData, 0, 0, IMG_XSIZE, IMG_YSIZE, IMG_XSIZE, IMG_YSIZE, keatype);
+        KEA_DTYPE *pStripRead = (KEA_DTYPE*)calloc(IMG_XSIZE * IMG_YSIZE, sizeof(KEA_DTYPE));
+        io.readImageBlock2Band(3, pStripRead, 0, 0, IMG_XSIZE, IMG_YSIZE, IMG_XSIZE, IMG_YSIZE, keatype);
+        if( !compareData<KEA_DTYPE>(pStripData, pStripRead, IMG_XSIZE, IMG_YSIZE))
+        {
+            return 1;
+        }
+        free(pStripData);
+        free(pStripRead);
+        // overview blocks are the same shape, limited to its size
+        io.createOverview(3, 1, 100, 10);
+        io.getOverviewBlockSize(3, 1, &blockXSize, &blockYSize);
+        if( (blockXSize != 100) || (blockYSize != 10) )
+        {
+            std::cout << "Wrong overview block size " << blockXSize << "x" << blockYSize << std::endl;
+            return 1;
+        }
+        io.removeImageBand(3);
+        std::cout << "Checked rectangular blocks" << std::endl;
+        
+        // wider than a uint32_t. Only the chunks written take up space.
+        {
+            std::string wide_kea_file = "test_wide_" STRINGIFY(KEA_DTYPE) ".kea";
+            const uint64_t wideXSize = 5000000000ULL;
+            HighFive::File *wideh5 = kealib::KEAImageIO::createKEAImage(wide_kea_file,
+                        keatype, wideXSize, 64, 1, nullptr, nullptr, 1024);
+            kealib::KEAImageIO wideIO;
+            wideIO.openKEAImageHeader(wideh5);
+            wideIO.getImageBlockSize(1, &blockXSize, &blockYSize);
+            if( (wideIO.getSpatialInfo()->xSize != wideXSize) || (blockXSize != 64) || (blockYSize != 64) )
+            {
+                std::cout << "Wide image not created correctly" << std::endl;
+                return 1;
+            }
+            KEA_DTYPE *pWideData = createDataForType<KEA_DTYPE>(100, 64);
+            wideIO.writeImageBlock2Band(1, pWideData, wideXSize - 100, 0, 100, 64, 100, 64, keatype);
+            KEA_DTYPE *pWideRead = (KEA_DTYPE*)calloc(100 * 64, sizeof(KEA_DTYPE));
+            wideIO.readImageBlock2Band(1, pWideRead, wideXSize - 100, 0, 100, 64, 100, 64, keatype);
+            if( !compareData<KEA_DTYPE>(pWideData, pWideRead, 100, 64))
+            {
+                return 1;
+            }
+            free(pWideData);
+            free(pWideRead);
+            wideIO.close();
+            remove(wide_kea_file.c_str());
+        }
+        std::cout << "Checked wide image" << std::endl;
+        
+        // mosaic of two tiles, B is right of A and 20 rows down
+        {
+            std::string tileA_kea_file = "test_tileA_" STRINGIFY(KEA_DTYPE) ".kea";
+            std::string tileB_kea_file = "test_tileB_" STRINGIFY(KEA_DTYPE) ".kea";
+            std::string mosaic_kea_file = "test_mosaic_" STRINGIFY(KEA_DTYPE) ".kea";
+            kealib::KEAImageSpatialInfo tileInfo = getSpatialInfo(0);
+            tileInfo.xRot = 0;
+            tileInfo.yRot = 0;
+            KEA_DTYPE *pTileAData = createDataForType<KEA_DTYPE>(100, 80);
+            KEA_DTYPE *pTileBData = createDataForType<KEA_DTYPE>(80, 100);
+            kealib::KEAImageIO tileIO;
+            tileIO.openKEAImageHeader(kealib::KEAImageIO::createKEAImage(tileA_kea_file,
+                        keatype, 100, 80, 1, nullptr, &tileInfo));
+            tileIO.writeImageBlock2Band(1, pTileAData, 0, 0, 100, 80, 100, 80, keatype);
+            tileIO.close();
+            tileInfo.tlX += 100 * tileInfo.xRes;
+            tileInfo.tlY += 20 * tileInfo.yRes;
+            tileIO.openKEAImageHeader(kealib::KEAImageIO::createKEAImage(tileB_kea_file,
+                        keatype, 80, 100, 1, nullptr, &tileInfo));
+            tileIO.writeImageBlock2Band(1, pTileBData, 0, 0, 80, 100, 80, 100, keatype);
+            tileIO.close();
+            
+            kealib::KEAImageIO mosaicIO;
+            mosaicIO.openKEAImageHeader(kealib::KEAImageIO::createMosaic(mosaic_kea_file, {tileA_kea_file, tileB_kea_file}));
+            kealib::KEAImageSpatialInfo *pMosaicInfo = mosaicIO.getSpatialInfo();
+            if( (pMosaicInfo->xSize != 180) || (pMosaicInfo->ySize != 120) || 
+                (pMosaicInfo->tlX != getSpatialInfo(0).tlX) || !mosaicIO.isImageBandVirtual(1) )
+            {
+                std::cout << "Mosaic not created correctly" << std::endl;
+                return 1;
+            }
+            KEA_DTYPE *pMosaicRead = (KEA_DTYPE*)calloc(180 * 120, sizeof(KEA_DTYPE));
+            mosaicIO.readImageBlock2Band(1, pMosaicRead, 0, 0, 180, 120, 180, 120, keatype);
+            if( !compareDataSubset<KEA_DTYPE>(pMosaicRead, pTileAData, 0, 0, 180, 120, 100, 80) ||
+                !compareDataSubset<KEA_DTYPE>(pMosaicRead, pTileBData, 100, 20, 180, 120, 80, 100) ||
+                (pMosaicRead[(100 * 180) + 10] != 0) )
+            {
+                std::cout << "Mosaic data not read correctly" << std::endl;
+                return 1;
+            }
+            free(pMosaicRead);
+            free(pTileAData);
+            free(pTileBData);
+            mosaicIO.close();
+            remove(mosaic_kea_file.c_str());
+            remove(tileA_kea_file.c_str());
+            remove(tileB_kea_file.c_str());
+        }
+        std::cout << "Checked mosaic" << std::endl;
+        
+        // grow an image, first to the right and down then up and left
+        {
+            std::string grow_kea_file = "test_grow_" STRINGIFY(KEA_DTYPE) ".kea";
+            kealib::KEAImageSpatialInfo growInfo = getSpatialInfo(0);
+            kealib::KEAImageIO growIO;
+            growIO.openKEAImageHeader(kealib::KEAImageIO::createKEAImage(grow_kea_file,
+                        keatype, 100, 80, 0, nullptr, &growInfo));
+            growIO.addImageBand(keatype, "Growable", 64, kealib::KEA_ATT_CHUNK_SIZE, kealib::KEA_DEFLATE, 0, true);
+            growIO.createMask(1);
+            KEA_DTYPE *pGrowData = createDataForType<KEA_DTYPE>(100, 80);
+            growIO.writeImageBlock2Band(1, pGrowData, 0, 0, 100, 80, 100, 80, keatype);
+            growIO.createOverview(1, 1, 50, 40);
+            
+            growIO.extendImage(150, 90);
+            KEA_DTYPE *pGrowRead = (KEA_DTYPE*)calloc(240 * 128, sizeof(KEA_DTYPE));
+            growIO.readImageBlock2Band(1, pGrowRead, 0, 0, 150, 90, 150, 90, keatype);
+            if( (growIO.getSpatialInfo()->xSize != 150) || (growIO.getSpatialInfo()->ySize != 90) ||
+                (growIO.getSpatialInfo()->tlX != growInfo.tlX) ||
+                !compareDataSubset<KEA_DTYPE>(pGrowRead, pGrowData, 0, 0, 150, 90, 100, 80) ||
+                (pGrowRead[(85 * 150) + 120] != 0) )
+            {
+                std::cout << "Image not extended correctly" << std::endl;
+                return 1;
+            }
+            
+            growIO.extendImage(200, 120, kealib::kea_anchor_bottomright);
+            growIO.readImageBlock2Band(1, pGrowRead, 0, 0, 200, 120, 200, 120, keatype);
+            double expectedTLX = growInfo.tlX - (50 * growInfo.xRes) - (30 * growInfo.xRot);
+            if( (growIO.getSpatialInfo()->xSize != 200) || (growIO.getSpatialInfo()->ySize != 120) ||
+                (growIO.getSpatialInfo()->tlX != expectedTLX) ||
+                !compareDataSubset<KEA_DTYPE>(pGrowRead, pGrowData, 50, 30, 200, 120, 100, 80) ||
+                (pGrowRead[(10 * 200) + 60] != 0) || (pGrowRead[(40 * 200) + 10] != 0) )
+            {
+                std::cout << "Image not extended from the bottom right correctly" << std::endl;
+                return 1;
+            }
+            uint8_t *pGrowMask = (uint8_t*)calloc(200 * 120, sizeof(uint8_t));
+            growIO.readImageBlock2BandMask(1, pGrowMask, 0, 0, 200, 120, 200, 120, kealib::kea_8uint);
+            if( (pGrowMask[(10 * 200) + 60] != 255) || (pGrowMask[(40 * 200) + 10] != 255) )
+            {
+                std::cout << "Mask not extended correctly" << std::endl;
+                return 1;
+            }
+            
+            // the statistics follow the pixels, even when the 
+            // number of blocks (4 x 2) stays the same
+            growIO.trackDirtyRegions(1);
+            growIO.updateStatistics(1);
+            growIO.extendImage(240, 128, kealib::kea_anchor_bottomright);
+            growIO.updateStatistics(1);
+            growIO.readImageBlock2Band(1, pGrowRead, 0, 0, 240, 128, 240, 128, keatype);
+            double growMin = pGrowRead[0];
+            double growMax = pGrowRead[0];
+            double growSum = 0;
+            for( uint64_t n = 0; n < (240 * 128); n++ )
+            {
+                growMin = std::min(growMin, (double)pGrowRead[n]);
+                growMax = std::max(growMax, (double)pGrowRead[n]);
+                growSum += pGrowRead[n];
+            }
+            double growMean = growSum / (240 * 128);
+            double growStatMin = std::stod(growIO.getImageBandMetaData(1, "STATISTICS_MINIMUM"));
+            double growStatMax = std::stod(growIO.getImageBandMetaData(1, "STATISTICS_MAXIMUM"));
+            double growStatMean = std::stod(growIO.getImageBandMetaData(1, "STATISTICS_MEAN"));
+            if( (std::abs(growStatMin - growMin) > (std::abs(growMin) * 1e-6)) ||
+                (std::abs(growStatMax - growMax) > (std::abs(growMax) * 1e-6)) ||
+                (std::abs(growStatMean - growMean) > (std::max(std::abs(growMean), 1.0) * 1e-6)) )
+            {
+                std::cout << "Statistics not updated after extending image" << std::endl;
+                return 1;
+            }
+            
+            // the overview keeps its scale of 2 through all three extends
+            uint64_t growOvXSize, growOvYSize;
+            growIO.getOverviewSize(1, 1, &growOvXSize, &growOvYSize);
+            growIO.updateOverviews(1);
+            KEA_DTYPE growOvValues[2];
+            growIO.readFromOverview(1, 1, &growOvValues[0], 0, 0, 1, 1, 1, 1, keatype);
+            growIO.readFromOverview(1, 1, &growOvValues[1], 60, 30, 1, 1, 1, 1, keatype);
+            if( (growOvXSize != 120) || (growOvYSize != 64) || 
+                (growOvValues[0] != 0) || (growOvValues[1] == 0) )
+            {
+                std::cout << "Overviews not extended correctly" << std::endl;
+                return 1;
+            }
+            free(pGrowMask);
+            free(pGrowRead);
+            free(pGrowData);
+            growIO.close();
+            remove(grow_kea_file.c_str());
+        }
+        std::cout << "Checked growing image" << std::endl;
+        
+        // lots of metadata, set at once then in compact form
+        {
+            std::string meta_kea_file = "test_metadata_" STRINGIFY(KEA_DTYPE) ".kea";
+            kealib::KEAImageSpatialInfo metaInfo = getSpatialInfo(0);
+            kealib::KEAImageIO metaIO;
+            metaIO.openKEAImageHeader(kealib::KEAImageIO::createKEAImage(meta_kea_file,
+                        keatype, 100, 80, 1, nullptr, &metaInfo));
+            std::vector< std::pair<std::string, std::string> > manyMetaData;
+            for( uint32_t n = 0; n < 1000; n++ )
+            {
+                manyMetaData.push_back(std::pair<std::string, std::string>("Item" + kealib::uint2Str(n), "Value" + kealib::uint2Str(n)));
+            }
+            metaIO.setImageMetaData(manyMetaData);
+            metaIO.setImageBandMetaData(1, manyMetaData);
+            metaIO.compactMetaData();
+            metaIO.setImageMetaData("Item10", "Changed");
+            metaIO.setImageBandMetaData(1, {std::pair<std::string, std::string>("Extra", "ExtraValue")});
+            if( !metaIO.hasCompactMetaData() || (metaIO.getImageMetaData().size() != 1000) ||
+                (metaIO.getImageMetaData("Item999") != "Value999") || (metaIO.getImageMetaData("Item10") != "Changed") ||
+                (metaIO.getImageBandMetaDataNames(1).size() != 1001) ||
+                (metaIO.getImageBandMetaData(1, "Extra") != "ExtraValue") )
+            {
+                std::cout << "Metadata not compacted correctly" << std::endl;
+                return 1;
+            }
+            metaIO.close();
+            remove(meta_kea_file.c_str());
+        }
+        std::cout << "Checked compact metadata" << std::endl;
+        
+        // overviews and statistics only recalculated where the band has changed
+        {
+            std::string dirty_kea_file = "test_dirty_" STRINGIFY(KEA_DTYPE) ".kea";
+            kealib::KEAImageSpatialInfo dirtyInfo = getSpatialInfo(0);
+            kealib::KEAImageIO dirtyIO;
+            dirtyIO.openKEAImageHeader(kealib::KEAImageIO::createKEAImage(dirty_kea_file,
+                        keatype, 256, 256, 1, nullptr, &dirtyInfo, 64));
+            dirtyIO.createOverview(1, 1, 128, 128);
+            KEA_DTYPE *pDirtyData = createDataForType<KEA_DTYPE>(256, 256);
+            dirtyIO.writeImageBlock2Band(1, pDirtyData, 0, 0, 256, 256, 256, 256, keatype);
+            dirtyIO.trackDirtyRegions(1);
+            dirtyIO.updateOverviews(1);
+            dirtyIO.updateStatistics(1);
+            
+            // patch one block
+            KEA_DTYPE *pPatch = (KEA_DTYPE*)calloc(64 * 64, sizeof(KEA_DTYPE));
+            for( uint64_t n = 0; n < (64 * 64); n++ )
+            {
+                pPatch[n] = (KEA_DTYPE)7;
+                pDirtyData[((128 + (n / 64)) * 256) + 64 + (n % 64)] = (KEA_DTYPE)7;
+            }
+            dirtyIO.writeImageBlock2Band(1, pPatch, 64, 128, 64, 64, 64, 64, keatype);
+            dirtyIO.updateOverviews(1);
+            dirtyIO.updateStatistics(1);
+            
+            KEA_DTYPE ovValues[2];
+            dirtyIO.readFromOverview(1, 1, &ovValues[0], 10, 10, 1, 1, 1, 1, keatype);
+            dirtyIO.readFromOverview(1, 1, &ovValues[1], 40, 70, 1, 1, 1, 1, keatype);
+            double minVal = pDirtyData[0];
+            double maxVal = pDirtyData[0];
+            for( uint64_t n = 0; n < (256 * 256); n++ )
+            {
+                minVal = std::min(minVal, (double)pDirtyData[n]);
+                maxVal = std::max(maxVal, (double)pDirtyData[n]);
+            }
+            double statMin = std::stod(dirtyIO.getImageBandMetaData(1, "STATISTICS_MINIMUM"));
+            double statMax = std::stod(dirtyIO.getImageBandMetaData(1, "STATISTICS_MAXIMUM"));
+            if( (ovValues[0] != pDirtyData[(21 * 256) + 21]) || (ovValues[1] != (KEA_DTYPE)7) ||
+                (std::abs(statMin - minVal) > (std::abs(minVal) * 1e-6)) ||
+                (std::abs(statMax - maxVal) > (std::abs(maxVal) * 1e-6)) )
+            {
+                std::cout << "Overviews or statistics not updated correctly" << std::endl;
+                return 1;
+            }
+            free(pPatch);
+            free(pDirtyData);
+            dirtyIO.close();
+            remove(dirty_kea_file.c_str());
+        }
+        std::cout << "Checked updating overviews and statistics" << std::endl;
+        
+#ifdef LIBKEA_WITH_IO_STATISTICS
+        // IO counters
+        {
+            std::string stats_kea_file = "test_iostats_" STRINGIFY(KEA_DTYPE) ".kea";
+            kealib::KEAImageSpatialInfo statsInfo = getSpatialInfo(0);
+            kealib::KEAImageIO statsIO;
+            statsIO.openKEAImageHeader(kealib::KEAImageIO::createKEAImage(stats_kea_file,
+                        keatype, 256, 256, 1, nullptr, &statsInfo, 64));
+            statsIO.resetIOStatistics();
+            KEA_DTYPE *pStatsData = createDataForType<KEA_DTYPE>(256, 256);
+            statsIO.writeImageBlock2Band(1, pStatsData, 0, 0, 256, 256, 256, 256, keatype);
+            statsIO.readImageBlock2Band(1, pStatsData, 32, 32, 64, 64, 64, 64, keatype);
+            kealib::KEAIOStatistics stats = statsIO.getIOStatistics();
+            kealib::KEAIOStatistics bandStats = statsIO.getIOStatistics(1);
+            kealib::KEAIOStatistics globalStats = kealib::KEAImageIO::getGlobalIOStatistics();
+            if( (stats.writeCalls != 1) || (stats.readCalls != 1) ||
+                (stats.bytesWritten != (256 * 256 * sizeof(KEA_DTYPE))) ||
+                (stats.bytesRead != (64 * 64 * sizeof(KEA_DTYPE))) ||
+                (stats.chunksWritten != 16) || (stats.chunksRead != 4) || (stats.flushes == 0) ||
+                (bandStats.bytesRead != stats.bytesRead) || (globalStats.readCalls < stats.readCalls) )
+            {
+                std::cout << "IO statistics not counted correctly" << std::endl;
+                return 1;
+            }
+            statsIO.resetIOStatistics();
+            if( statsIO.getIOStatistics().readCalls != 0 )
+            {
+                std::cout << "IO statistics not reset" << std::endl;
+                return 1;
+            }
+            free(pStatsData);
+            statsIO.close();
+            remove(stats_kea_file.c_str());
+        }
+        std::cout << "Checked IO statistics" << std::endl;
+#endif
+        
+        // trace of a read and a write
+        {
+            std::string trace_file = "test_trace_" STRINGIFY(KEA_DTYPE) ".json";
+            KEA_DTYPE *pTraceData = (KEA_DTYPE*)calloc(64 * 64, sizeof(KEA_DTYPE));
+            kealib::KEATrace::start(trace_file);
+            io.readImageBlock2Band(1, pTraceData, 0, 0, 64, 64, 64, 64, keatype);
+            io.writeImageBlock2Band(1, pTraceData, 0, 0, 64, 64, 64, 64, keatype);
+            kealib::KEATrace::stop();
+            std::ifstream traceIn(trace_file.c_str());
+            std::string traceText((std::istreambuf_iterator<char>(traceIn)), std::istreambuf_iterator<char>());
+            traceIn.close();
+            if( (traceText.find("\"traceEvents\"") == std::string::npos) || 
+                (traceText.find("\"name\":\"readImageBlock2Band\"") == std::string::npos) ||
+                (traceText.find("\"name\":\"writeImageBlock2Band\"") == std::string::npos) ||
+                (traceText.find("\"name\":\"flush\"") == std::string::npos) ||
+                (traceText.find("\"droppedEvents\":0") == std::string::npos) ||
+                (traceText.back() != '\n') )
+            {
+                std::cout << "Trace not written correctly" << std::endl;
+                return 1;
+            }
+            free(pTraceData);
+            remove(trace_file.c_str());
+        }
+        std::cout << "Checked trace" << std::endl;
+        
+        // raw copy of band 1 to a new band
+        io.copyBandFrom(io, 1, 3);
+        if( !io.bandStorageMatches(io, 1, 3) || !io.maskCreated(3) || 
+            (io.getImageBandDescription(3) != io.getImageBandDescription(1)) ||
+            (io.getImageBandMetaData(3, "BandTest1") != "Value1") )
+        {
+            std::cout << "Band not copied correctly" << std::endl;
+            return 1;
+        }
+        KEA_DTYPE *pBand1Data = (KEA_DTYPE*)calloc(IMG_XSIZE * IMG_YSIZE, sizeof(KEA_DTYPE));
+        KEA_DTYPE *pBand3Data = (KEA_DTYPE*)calloc(IMG_XSIZE * IMG_YSIZE, sizeof(KEA_DTYPE));
+        io.readImageBlock2Band(1, pBand1Data, 0, 0, IMG_XSIZE, IMG_YSIZE, IMG_XSIZE, IMG_YSIZE, keatype);
+        io.readImageBlock2Band(3, pBand3Data, 0, 0, IMG_XSIZE, IMG_YSIZE, IMG_XSIZE, IMG_YSIZE, keatype);
+        if( !compareData<KEA_DTYPE>(pBand1Data, pBand3Data, IMG_XSIZE, IMG_YSIZE))
+        {
+            return 1;
+        }
+        free(pBand1Data);
+        free(pBand3Data);
+        io.removeImageBand(3);
+        std::cout << "Checked band copy" << std::endl;
+        
+        // several bands at once
+        {
+            uint32_t numBandsBefore = io.getNumOfImageBands();
+            std::vector<std::string> batchDescrips = {"Batch1", "Batch2"};
+            io.addImageBands(3, {keatype, kealib::kea_8uint, kealib::kea_32float}, &batchDescrips);
+            if( (io.getNumOfImageBands() != numBandsBefore + 3) ||
+                (io.getImageBandDataType(numBandsBefore + 2) != kealib::kea_8uint) ||
+                (io.getImageBandDescription(numBandsBefore + 1) != "Batch1") ||
+                (io.getImageBandDescription(numBandsBefore + 3) != "Band " + kealib::uint2Str(numBandsBefore + 3)) )
+            {
+                std::cout << "Bands not added correctly" << std::endl;
+                return 1;
+            }
+            for( uint32_t n = 0; n < 3; n++ )
+            {
+                io.removeImageBand(numBandsBefore + 1);
+            }
+        }
+        std::cout << "Checked adding several bands" << std::endl;
+        
+        // compacted copy of the whole file
+        std::string repack_kea_file = "test_repack_" STRINGIFY(KEA_DTYPE) ".kea";
+        h5file->getGroup("/BAND1").createAttribute<uint32_t>("REPACK_TEST", 42);
+        io.repack(repack_kea_file);
+        {
+            HighFive::File *repackh5 = kealib::KEAImageIO::openKeaH5RDOnly(repack_kea_file);
+            auto repackGroup = repackh5->getGroup("/BAND1");
+            if( !repackGroup.hasAttribute("REPACK_TEST") ||
+                (repackGroup.getAttribute("REPACK_TEST").read<uint32_t>() != 42) )
+            {
+                std::cout << "Band group attributes not repacked" << std::endl;
+                return 1;
+            }
+            kealib::KEAImageIO repackIO;
+            repackIO.openKEAImageHeader(repackh5);
+            if( (repackIO.getNumOfImageBands() != io.getNumOfImageBands()) ||
+                !repackIO.bandStorageMatches(io, 1, 1) || !repackIO.bandStorageMatches(io, 2, 2) ||
+                (repackIO.getImageBandDescription(2) != io.getImageBandDescription(2)) ||
+                !compareSpatialInfo(repackIO.getSpatialInfo(), io.getSpatialInfo()) )
+            {
+                std::cout << "File not repacked correctly" << std::endl;
+                return 1;
+            }
+            KEA_DTYPE *pSrcData = (KEA_DTYPE*)calloc(IMG_XSIZE * IMG_YSIZE, sizeof(KEA_DTYPE));
+            KEA_DTYPE *pRepackData = (KEA_DTYPE*)calloc(IMG_XSIZE * IMG_YSIZE, sizeof(KEA_DTYPE));
+            io.readImageBlock2Band(1, pSrcData, 0, 0, IMG_XSIZE, IMG_YSIZE, IMG_XSIZE, IMG_YSIZE, keatype);
+            repackIO.readImageBlock2Band(1, pRepackData, 0, 0, IMG_XSIZE, IMG_YSIZE, IMG_XSIZE, IMG_YSIZE, keatype);
+            if( !compareData<KEA_DTYPE>(pSrcData, pRepackData, IMG_XSIZE, IMG_YSIZE))
+            {
+                return 1;
+            }
+            free(pSrcData);
+            free(pRepackData);
+            repackIO.close();
+        }
+        std::cout << "Checked repack" << std::endl;
+        
+        // paged layout for cloud storage, read back with a page buffer
+        std::string paged_kea_file = "test_paged_" STRINGIFY(KEA_DTYPE) ".kea";
+        {
+            HighFive::File *pagedh5 = kealib::KEAImageIO::createKEAImage(paged_kea_file,
+                            keatype, IMG_XSIZE, IMG_YSIZE, 1, &bandDescrips, &spatialInfo,
+                            kealib::KEA_IMAGE_CHUNK_SIZE, kealib::KEA_ATT_CHUNK_SIZE, kealib::KEA_MDC_NELMTS,
+                            kealib::KEA_RDCC_NELMTS, kealib::KEA_RDCC_NBYTES, kealib::KEA_RDCC_W0,
+                            kealib::KEA_SIEVE_BUF, kealib::KEA_META_BLOCKSIZE, kealib::KEA_DEFLATE,
+                            false, 65536);
+            kealib::KEAImageIO pagedIO;
+            pagedIO.openKEAImageHeader(pagedh5);
+            KEA_DTYPE *pPagedData = createDataForType<KEA_DTYPE>(IMG_XSIZE, IMG_YSIZE);
+            pagedIO.writeImageBlock2Band(1, pPagedData, 0, 0, IMG_XSIZE, IMG_YSIZE, IMG_XSIZE, IMG_YSIZE, keatype);
+            pagedIO.close();
+            
+            pagedh5 = kealib::KEAImageIO::openKeaH5RDOnly(paged_kea_file, kealib::KEA_MDC_NELMTS,
+                            kealib::KEA_RDCC_NELMTS, kealib::KEA_RDCC_NBYTES, kealib::KEA_RDCC_W0,
+                            kealib::KEA_SIEVE_BUF, kealib::KEA_META_BLOCKSIZE, 0, nullptr, 4 * 65536);
+            kealib::KEAImageIO pagedReadIO;
+            pagedReadIO.openKEAImageHeader(pagedh5);
+            KEA_DTYPE *pPagedRead = (KEA_DTYPE*)calloc(IMG_XSIZE * IMG_YSIZE, sizeof(KEA_DTYPE));
+            pagedReadIO.readImageBlock2Band(1, pPagedRead, 0, 0, IMG_XSIZE, IMG_YSIZE, IMG_XSIZE, IMG_YSIZE, keatype);
+            if( (pagedReadIO.getImageBandDescription(1) != bandDescrips[0]) || 
+                !compareData<KEA_DTYPE>(pPagedData, pPagedRead, IMG_XSIZE, IMG_YSIZE))
+            {
+                std::cout << "Paged file not read correctly" << std::endl;
+                return 1;
+            }
+            free(pPagedData);
+            free(pPagedRead);
+            pagedReadIO.close();
+        }
+        std::cout << "Checked paged file" << std::endl;
+        
+        // SWMR - write with SWMR started then read back in SWMR mode
+        std::string swmr_kea_file = "test_swmr_" STRINGIFY(KEA_DTYPE) ".kea";
+        {
+            HighFive::File *swmrh5 = kealib::KEAImageIO::createKEAImage(swmr_kea_file,
+                            keatype, IMG_XSIZE, IMG_YSIZE, 1, &bandDescrips, &spatialInfo,
+                            kealib::KEA_IMAGE_CHUNK_SIZE, kealib::KEA_ATT_CHUNK_SIZE, kealib::KEA_MDC_NELMTS,
+                            kealib::KEA_RDCC_NELMTS, kealib::KEA_RDCC_NBYTES, kealib::KEA_RDCC_W0,
+                            kealib::KEA_SIEVE_BUF, kealib::KEA_META_BLOCKSIZE, kealib::KEA_DEFLATE,
+                            false, kealib::KEA_PAGE_SIZE, true);
+            kealib::KEAImageIO swmrIO;
+            swmrIO.openKEAImageHeader(swmrh5);
+            swmrIO.createOverview(1, 1, IMG_XSIZE / 2, IMG_YSIZE / 2);
+            swmrIO.startSWMRWrite();
+            KEA_DTYPE *pSWMRData = createDataForType<KEA_DTYPE>(IMG_XSIZE, IMG_YSIZE);
+            swmrIO.writeImageBlock2Band(1, pSWMRData, 0, 0, IMG_XSIZE, IMG_YSIZE, IMG_XSIZE, IMG_YSIZE, keatype);
+            swmrIO.writeToOverview(1, 1, pSWMRData, 0, 0, IMG_XSIZE / 2, IMG_YSIZE / 2, IMG_XSIZE / 2, IMG_YSIZE / 2, keatype);
+            swmrIO.close();
+            
+            swmrh5 = kealib::KEAImageIO::openKeaH5RDOnly(swmr_kea_file, kealib::KEA_MDC_NELMTS,
+                            kealib::KEA_RDCC_NELMTS, kealib::KEA_RDCC_NBYTES, kealib::KEA_RDCC_W0,
+                            kealib::KEA_SIEVE_BUF, kealib::KEA_META_BLOCKSIZE, 0, nullptr, 
+                            kealib::KEA_PAGE_BUFFER_SIZE, false, true);
+            kealib::KEAImageIO swmrReadIO;
+            swmrReadIO.openKEAImageHeader(swmrh5);
+            swmrReadIO.refresh();
+            KEA_DTYPE *pSWMRRead = (KEA_DTYPE*)calloc(IMG_XSIZE * IMG_YSIZE, sizeof(KEA_DTYPE));
+            swmrReadIO.readImageBlock2Band(1, pSWMRRead, 0, 0, IMG_XSIZE, IMG_YSIZE, IMG_XSIZE, IMG_YSIZE, keatype);
+            if( (swmrReadIO.getNumOfOverviews(1) != 1) || 
+                !compareSpatialInfo(swmrReadIO.getSpatialInfo(), &spatialInfo) ||
+                !compareData<KEA_DTYPE>(pSWMRData, pSWMRRead, IMG_XSIZE, IMG_YSIZE))
+            {
+                std::cout << "SWMR file not read correctly" << std::endl;
+                return 1;
+            }
+            free(pSWMRData);
+            free(pSWMRRead);
+            swmrReadIO.close();
+        }
+        std::cout << "Checked SWMR file" << std::endl;
+
+        // SWMR - reopen for writing with swmr=true and read while the writer is still open
+        {
+            kealib::KEAImageIO swmrWriteIO;
+            swmrWriteIO.openKEAImageHeader(kealib::KEAImageIO::openKeaH5RW(swmr_kea_file,
+                            kealib::KEA_MDC_NELMTS, kealib::KEA_RDCC_NELMTS, kealib::KEA_RDCC_NBYTES,
+                            kealib::KEA_RDCC_W0, kealib::KEA_SIEVE_BUF, kealib::KEA_META_BLOCKSIZE, true));
+            KEA_DTYPE *pSWMRData = createDataForType<KEA_DTYPE>(IMG_XSIZE, IMG_YSIZE);
+            // flushed by writeImageBlock2Band
+            swmrWriteIO.writeImageBlock2Band(1, pSWMRData, 0, 0, IMG_XSIZE, IMG_YSIZE, IMG_XSIZE, IMG_YSIZE, keatype);
+
+            kealib::KEAImageIO swmrReadIO;
+            swmrReadIO.openKEAImageHeader(kealib::KEAImageIO::openKeaH5RDOnly(swmr_kea_file, kealib::KEA_MDC_NELMTS,
+                            kealib::KEA_RDCC_NELMTS, kealib::KEA_RDCC_NBYTES, kealib::KEA_RDCC_W0,
+                            kealib::KEA_SIEVE_BUF, kealib::KEA_META_BLOCKSIZE, 0, nullptr,
+                            kealib::KEA_PAGE_BUFFER_SIZE, false, true));
+            swmrReadIO.refresh();
+            KEA_DTYPE *pSWMRRead = (KEA_DTYPE*)calloc(IMG_XSIZE * IMG_YSIZE, sizeof(KEA_DTYPE));
+            swmrReadIO.readImageBlock2Band(1, pSWMRRead, 0, 0, IMG_XSIZE, IMG_YSIZE, IMG_XSIZE, IMG_YSIZE, keatype);
+            if( !compareData<KEA_DTYPE>(pSWMRData, pSWMRRead, IMG_XSIZE, IMG_YSIZE) )
+            {
+                std::cout << "SWMR file not read correctly while writer open" << std::endl;
+                return 1;
+            }
+
+            // write again and check the reader sees it after a refresh
+            for( uint64_t n = 0; n < (IMG_XSIZE * IMG_YSIZE); n++ )
+            {
+                pSWMRData[n] = 5;
+            }
+            swmrWriteIO.writeImageBlock2Band(1, pSWMRData, 0, 0, IMG_XSIZE, IMG_YSIZE, IMG_XSIZE, IMG_YSIZE, keatype);
+            swmrReadIO.refresh();
+            swmrReadIO.readImageBlock2Band(1, pSWMRRead, 0, 0, IMG_XSIZE, IMG_YSIZE, IMG_XSIZE, IMG_YSIZE, keatype);
+            if( !compareDataConstant<KEA_DTYPE>(pSWMRRead, 5, IMG_XSIZE, IMG_YSIZE) )
+            {
+                std::cout << "SWMR reader did not see update after refresh" << std::endl;
+                return 1;
+            }
+            free(pSWMRData);
+            free(pSWMRRead);
+            swmrReadIO.close();
+            swmrWriteIO.close();
+        }
+        std::cout << "Checked live SWMR file" << std::endl;
+        
+        // consolidated header, then open again and check it matches
+        io.createConsolidatedHeader();
+        io.setImageBandDescription(1, "Band 1 Consolidated");
+        {
+            kealib::KEAImageIO consolidatedIO;
+            consolidatedIO.openKEAImageHeader(kealib::KEAImageIO::openKeaH5RDOnly(test_kea_file));
+            uint16_t consolidatedNoData = 0;
+            consolidatedIO.getNoDataValue(1, &consolidatedNoData, kealib::kea_16uint);
+            if( !consolidatedIO.hasConsolidatedHeader() || 
+                (consolidatedIO.getNumOfImageBands() != io.getNumOfImageBands()) ||
+                (consolidatedIO.getImageBandDescription(1) != "Band 1 Consolidated") ||
+                (consolidatedIO.getImageBandDataType(1) != keatype) ||
+                (consolidatedIO.getImageBandLayerType(2) != kealib::kea_thematic) ||
+                (consolidatedIO.getImageBandClrInterp(2) != kealib::kea_redband) ||
+                (consolidatedNoData != u16nodata) ||
+                !compareSpatialInfo(consolidatedIO.getSpatialInfo(), io.getSpatialInfo()) )
+            {
+                std::cout << "Consolidated header not read correctly" << std::endl;
+                return 1;
+            }
+            consolidatedIO.close();
+        }
+        // a header without the expected layout is ignored, then replaced on the next write
+        h5file->getDataSet(kealib::KEA_DATASETNAME_HEADER_CONSOLIDATED).deleteAttribute(kealib::KEA_CONSOLIDATED_LAYOUT);
+        h5file->flush();
+        {
+            kealib::KEAImageIO consolidatedIO;
+            consolidatedIO.openKEAImageHeader(kealib::KEAImageIO::openKeaH5RDOnly(test_kea_file));
+            if( consolidatedIO.hasConsolidatedHeader() ||
+                (consolidatedIO.getImageBandDescription(1) != "Band 1 Consolidated") )
+            {
+                std::cout << "Consolidated header with old layout not ignored" << std::endl;
+                return 1;
+            }
+            consolidatedIO.close();
+        }
+        io.setImageBandDescription(1, bandDescrips[0]);
+        {
+            kealib::KEAImageIO consolidatedIO;
+            consolidatedIO.openKEAImageHeader(kealib::KEAImageIO::openKeaH5RDOnly(test_kea_file));
+            if( !consolidatedIO.hasConsolidatedHeader() ||
+                (consolidatedIO.getImageBandDescription(1) != bandDescrips[0]) )
+            {
+                std::cout << "Consolidated header with old layout not replaced" << std::endl;
+                return 1;
+            }
+            consolidatedIO.close();
+        }
+        std::cout << "Checked consolidated header" << std::endl;
+        
+        // rewrite both bands at once from separate threads, each
+        // holding its own band lock
+        {
+            KEA_DTYPE *pBandData[2];
+            for( uint32_t band = 1; band <= 2; band++ )
+            {
+                pBandData[band - 1] = (KEA_DTYPE*)calloc(IMG_XSIZE * IMG_YSIZE, sizeof(KEA_DTYPE));
+                io.readImageBlock2Band(band, pBandData[band - 1], 0, 0, IMG_XSIZE, IMG_YSIZE, IMG_XSIZE, IMG_YSIZE, keatype);
+            }
+            auto rewriteBand = [&](uint32_t band)
+            {
+                for( uint64_t yOff = 0; yOff < IMG_YSIZE; yOff += 100 )
+                {
+                    uint64_t ySize = std::min<uint64_t>(100, IMG_YSIZE - yOff);
+                    io.writeImageBlock2Band(band, pBandData[band - 1] + (yOff * IMG_XSIZE), 0, yOff, IMG_XSIZE, ySize, IMG_XSIZE, ySize, keatype);
+                }
+            };
+            std::thread band1Thread(rewriteBand, 1);
+            std::thread band2Thread(rewriteBand, 2);
+            band1Thread.join();
+            band2Thread.join();
+            
+            KEA_DTYPE *pCheckData = (KEA_DTYPE*)calloc(IMG_XSIZE * IMG_YSIZE, sizeof(KEA_DTYPE));
+            for( uint32_t band = 1; band <= 2; band++ )
+            {
+                io.readImageBlock2Band(band, pCheckData, 0, 0, IMG_XSIZE, IMG_YSIZE, IMG_XSIZE, IMG_YSIZE, keatype);
+                if( !compareData<KEA_DTYPE>(pBandData[band - 1], pCheckData, IMG_XSIZE, IMG_YSIZE))
+                {
+                    std::cout << "Bands not written correctly from threads" << std::endl;
+                    return 1;
+                }
+                free(pBandData[band - 1]);
+            }
+            free(pCheckData);
+        }
+        std::cout << "Checked writing bands from threads" << std::endl;
+        
         io.close();
         
     }